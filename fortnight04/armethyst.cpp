@@ -35,9 +35,28 @@
 
 #include "config.h"
 
-#include "SimpleMemory.h"
 #include "Processor.h"
-#include "BasicProcessor.h"
+#include "ElfLoader.h"
+#include "PCProfiler.h"
+
+#include <fstream>
+#include <vector>
+
+// (EN) Memory implementation, chosen in the makefile (MemImpl)
+// (PT) implementação de memória, escolhida no makefile (MemImpl)
+#ifndef MEMIMPL
+#define MEMIMPL SimpleMemory
+#define MEMIMPL_H "SimpleMemory.h"
+#endif
+#include MEMIMPL_H
+
+// (EN) Processor implementation, chosen in the makefile (ProcImpl)
+// (PT) implementação de processador, escolhida no makefile (ProcImpl)
+#ifndef PROCIMPL
+#define PROCIMPL BasicProcessor
+#define PROCIMPL_H "BasicProcessor.h"
+#endif
+#include PROCIMPL_H
 
 using namespace std;
 
@@ -45,23 +64,59 @@ int main()
 {	
 	// (EN) create memory
 	// (PT) cria memória
-	Memory* memory = new SimpleMemory(MEMORY_SIZE);
+	Memory* memory = new MEMIMPL(MEMORY_SIZE);
 	
 	// (EN) create processor
 	// (PT) cria processador
-	Processor* processor = new BasicProcessor(memory);
+	Processor* processor = new PROCIMPL(memory);
 		
-	// (EN) load executable binary
-	// (PT) carrega binário executável
-	memory->loadBinary(FILENAME);
+	// (EN) load and relocate the executable binary
+	// (PT) carrega e realoca o binário executável
+	ElfLoader loader(FILENAME);
+	if (loader.load()) {
+		return 1;
+	}
+	memory->loadBinary(loader.getImageFile());
 	
 	// (EN) create human readable representation of the binary file
 	// (PT) cria representação legível do arquivo binário
 	memory->writeBinaryAsText(FILENAME);
 
-	// (EN) start processor
-	// (PT) inicia processador
-	int result = processor->run(STARTADDRESS);	
+	// (EN) attach a PC profiler to each core (PROFILE_PERIOD, see config.h)
+	// (PT) liga um profiler de PCs em cada núcleo (PROFILE_PERIOD, ver config.h)
+	vector<PCProfiler*> profilers;
+	for (int core = 0; PROFILE_PERIOD && (core < processor->getCores()); core++) {
+		profilers.push_back(new PCProfiler(PROFILE_PERIOD));
+		processor->setProfiler(core, profilers.back());
+	}
+
+	// (EN) start processor at 'main'
+	// (PT) inicia processador em 'main'
+	int result = processor->run(loader.getEntryPoint());	
+	
+	// (EN) write the performance counters of each core
+	// (PT) escreve os contadores de desempenho de cada núcleo
+	ofstream perfFile(PERF_COUNTERS_FILE);
+	processor->writePerfJSON(perfFile);
+	perfFile << endl;
+	
+	// (EN) write the flat profile and the folded stacks, symbolized against
+	// the ELF symbol table
+	// (PT) escreve o perfil plano e as pilhas, simbolizados pela tabela de
+	// símbolos do ELF
+	if (!profilers.empty()) {
+		PCProfiler *profile = profilers[0];
+		for (unsigned int core = 1; core < profilers.size(); core++) {
+			profile->add(*profilers[core]);
+		}
+		for (const ElfSymbol &symbol : loader.getSymbols()) {
+			profile->addSymbol(symbol.name, symbol.address, symbol.size);
+		}
+		ofstream flatFile(PROFILE_FLAT_FILE);
+		profile->writeFlat(flatFile);
+		ofstream foldedFile(PROFILE_FOLDED_FILE);
+		profile->writeFolded(foldedFile);
+	}
 	
 	return result;
 }
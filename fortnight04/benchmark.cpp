@@ -0,0 +1,1088 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "config.h"
+
+#include "SimpleMemory.h"
+#include "PagedMemory.h"
+#include "TLBMemory.h"
+#include "CachedMemory.h"
+#include "BasicCPU.h"
+#include "InlineCPU.h"
+#include "ThreadedCPU.h"
+#include "JitCPU.h"
+#include "MultiCoreProcessor.h"
+#include "BranchMonitor.h"
+#include "PCProfiler.h"
+#include "ElfLoader.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+#define BENCH_INSTRUCTIONS 20000000
+#define BENCH_DECODES 10000000
+#define KERNEL_ADDRESS 0x40
+#define BENCH_CORE_INSTRUCTIONS 10000000
+#define BENCH_ACCESSES 20000000
+#define BENCH_ACCESS_WINDOW 0x4000
+#define BENCH_PROFILE_PERIOD 1000
+
+// Sobrecusto máximo esperado do modelo de caches (ver benchCacheModel())
+#define BENCH_CACHE_MAX_OVERHEAD 2.0
+
+// Suíte de benchmarks: repetições e instruções por caso (opções -r e -n),
+// memória do convidado e região de dados dos kernels, execuções de
+// isummation por repetição e arquivo de resultados (opção -json)
+#define BENCH_SUITE_REPETITIONS 5
+#define BENCH_SUITE_INSTRUCTIONS 2000000
+#define BENCH_SUITE_MEMORY 0x100000
+#define BENCH_SUITE_DATA 0x10000
+#define BENCH_SUITE_WORDS 0x20000
+#define BENCH_PROGRAM_RUNS 20000
+#define BENCH_SUITE_FILE "bench.json"
+
+/**
+ * Laço sintético usado no benchmark. Usa apenas instruções implementadas
+ * por BasicCPU e executa até o limite de instruções.
+ */
+static const unsigned int kernel[] = {
+	0xD10043FF,		// sub sp, sp, #16
+	0xB9400FE0,		// loop: ldr w0, [sp, 12]
+	0x0B000021,		// add w1, w1, w0
+	0xB9000BE1,		// str w1, [sp, 8]
+	0xB8647862,		// ldr w2, [x3, x4, lsl 2]
+	0xD10004A5,		// sub x5, x5, #1
+	0x17FFFFFB		// b loop
+};
+
+/**
+ * Carrega o laço sintético em KERNEL_ADDRESS da memória memory.
+ */
+Memory *loadKernel(Memory *memory)
+{
+	for (unsigned int i = 0; i < sizeof(kernel) / sizeof(kernel[0]); i++) {
+		memory->writeData32(KERNEL_ADDRESS + 4*i, kernel[i]);
+	}
+	// valor somado a cada iteração (ldr w0, [sp, 12])
+	memory->writeData32(STACKADDRESS - 16 + 12, 3);
+	return memory;
+}
+
+/**
+ * Cria uma memória (SimpleMemory) com o laço sintético carregado em
+ * KERNEL_ADDRESS.
+ */
+Memory *newKernelMemory()
+{
+	return loadKernel(new SimpleMemory(MEMORY_SIZE));
+}
+
+/**
+ * Executa o laço sintético na CPU cpu e retorna o desempenho em MIPS.
+ */
+double benchCPU(string name, BasicCPU *cpu)
+{
+	cpu->setInstructionLimit(BENCH_INSTRUCTIONS);
+
+	auto start = chrono::steady_clock::now();
+	int result = cpu->run(KERNEL_ADDRESS);
+	auto end = chrono::steady_clock::now();
+
+	double seconds = chrono::duration<double>(end - start).count();
+	double mips = cpu->getInstructionCount() / seconds / 1e6;
+
+	cout << setw(20) << left << name
+			<< setw(12) << right << cpu->getInstructionCount() << " instr  "
+			<< fixed << setprecision(3) << setw(8) << seconds << " s  "
+			<< setprecision(1) << setw(8) << mips << " MIPS";
+	if (result) {
+		cout << "  (erro na execução!)";
+	}
+	cout << endl;
+
+	return mips;
+}
+
+/**
+ * Estatísticas da cache de blocos da ThreadedCPU.
+ */
+void printBlockStats(ThreadedCPU *cpu)
+{
+	cout << "    blocos traduzidos: " << cpu->getBlocksTranslated()
+			<< ", consultas: " << cpu->getBlockLookups()
+			<< ", encadeamentos: " << cpu->getChainHits()
+			<< ", invalidações: " << cpu->getBlockInvalidations()
+			<< ", descartes: " << cpu->getBlockFlushes() << endl;
+}
+
+/**
+ * Estatísticas do JIT.
+ */
+void printJitStats(JitCPU *cpu)
+{
+	cout << "    blocos compilados: " << cpu->getBlocksCompiled()
+			<< ", instruções interpretadas: " << cpu->getInterpretedInstructions()
+			<< ", descartes: " << cpu->getJitFlushes() << endl;
+}
+
+/**
+ * Estatísticas das TLBs.
+ */
+void printTLBStats(TLBMemory *memory)
+{
+	cout << "    itlb: " << memory->getITLBHits() << " acertos, "
+			<< memory->getITLBMisses() << " faltas; dtlb: "
+			<< memory->getDTLBHits() << " acertos, "
+			<< memory->getDTLBMisses() << " faltas" << endl;
+}
+
+/**
+ * Estatísticas da hierarquia de caches.
+ */
+void printCacheStats(CachedMemory *memory)
+{
+	ostringstream stats;
+	memory->printStats(stats);
+	istringstream lines(stats.str());
+	string line;
+	while (getline(lines, line)) {
+		cout << "    " << line << endl;
+	}
+}
+
+/**
+ * Desvios retirados e MPKI de cada preditor do monitor.
+ */
+void printBranchStats(BranchMonitor *monitor, BasicCPU *cpu)
+{
+	cout << "    desvios: " << monitor->getBranches();
+	for (int p = 0; p < monitor->getPredictorCount(); p++) {
+		cout << ", " << monitor->getPredictor(p)->getName() << ": "
+				<< setprecision(3) << monitor->getMPKI(p, cpu->getInstructionCount())
+				<< " MPKI";
+	}
+	cout << endl;
+}
+
+/**
+ * Executa o laço sintético na CPU cpu com um monitor de desvios com os
+ * preditores padrão e retorna o desempenho em MIPS.
+ */
+double benchBranches(string name, BasicCPU *cpu)
+{
+	BranchMonitor *monitor = new BranchMonitor();
+	monitor->addPredictors(BRANCH_DEFAULT_PREDICTORS);
+	cpu->setBranchMonitor(monitor);
+	double mips = benchCPU(name, cpu);
+	printBranchStats(monitor, cpu);
+	delete monitor;
+	return mips;
+}
+
+/**
+ * Executa o laço sintético na CPU cpu com um profiler de PCs de período
+ * period (1: exato) e retorna o desempenho em MIPS.
+ */
+double benchProfile(string name, BasicCPU *cpu, unsigned long period)
+{
+	PCProfiler *profiler = new PCProfiler(period);
+	cpu->setProfiler(profiler);
+	double mips = benchCPU(name, cpu);
+	cout << "    amostras: " << profiler->getSamples() << ", PCs: "
+			<< profiler->getSites().size() << ", instruções estimadas: "
+			<< profiler->getInstructions() << endl;
+	cpu->setProfiler(nullptr);
+	delete profiler;
+	return mips;
+}
+
+/**
+ * Palavra escrita pelo laço na pilha (str w1, [sp, 8]), usada para
+ * conferir que as CPUs chegam ao mesmo resultado.
+ */
+void printChecksum(Memory *memory)
+{
+	cout << "    checksum: " << memory->readData32(STACKADDRESS - 16 + 8) << endl;
+}
+
+/**
+ * Executa o laço sintético em cores núcleos de um MultiCoreProcessor
+ * (BENCH_CORE_INSTRUCTIONS instruções por núcleo) e retorna o desempenho
+ * agregado em MIPS.
+ */
+double benchMultiCore(int cores, MultiCoreProcessor::ExecutionMode mode)
+{
+	Memory *memory = newKernelMemory();
+	MultiCoreProcessor *processor = new MultiCoreProcessor(memory, cores);
+	unsigned long instructions = 0;
+	
+	processor->setExecutionMode(mode);
+	for (int i = 0; i < cores; i++) {
+		// valor somado pelo laço, na pilha de cada núcleo
+		memory->writeData32(STACKADDRESS - i * MULTICORE_STACK_SIZE - 16 + 12, 3);
+		processor->getCore(i)->setInstructionLimit(BENCH_CORE_INSTRUCTIONS);
+	}
+
+	auto start = chrono::steady_clock::now();
+	int result = processor->run(KERNEL_ADDRESS);
+	auto end = chrono::steady_clock::now();
+
+	for (int i = 0; i < cores; i++) {
+		instructions += processor->getCore(i)->getInstructionCount();
+	}
+	double seconds = chrono::duration<double>(end - start).count();
+	double mips = instructions / seconds / 1e6;
+
+	cout << "    " << cores << " núcleo(s), "
+			<< setw(12) << left << ((mode == MultiCoreProcessor::QUANTUM_SYNC) ?
+					"quantum" : "livre") << right
+			<< setw(10) << instructions << " instr  "
+			<< fixed << setprecision(3) << setw(8) << seconds << " s  "
+			<< setprecision(1) << setw(8) << mips << " MIPS";
+	if (mode == MultiCoreProcessor::QUANTUM_SYNC) {
+		cout << "  (" << processor->getQuanta() << " quanta)";
+	}
+	if (result) {
+		cout << "  (erro na execução!)";
+	}
+	cout << endl;
+
+	delete processor;
+	delete memory;
+	return mips;
+}
+
+/**
+ * Desempenho agregado do MultiCoreProcessor (BasicCPU) com 1, 2 e 4
+ * núcleos, nos dois modos de execução.
+ */
+void benchMultiCores()
+{
+	cout << "MultiCoreProcessor (" << BENCH_CORE_INSTRUCTIONS
+			<< " instruções por núcleo)" << endl;
+	double single = 0;
+	for (int cores = 1; cores <= 4; cores *= 2) {
+		double mips = benchMultiCore(cores, MultiCoreProcessor::FREE_RUNNING);
+		if (cores == 1) {
+			single = mips;
+		}
+		benchMultiCore(cores, MultiCoreProcessor::QUANTUM_SYNC);
+		cout << "    " << cores << " núcleo(s), livre/1 núcleo: " << setprecision(2)
+				<< mips / single << "x" << endl;
+	}
+}
+
+/**
+ * Acesso ao decodificador de BasicCPU para o microbenchmark de decodificação.
+ */
+class DecodeBench: public BasicCPU
+{
+	public:
+		DecodeBench(Memory *memory) : BasicCPU(memory) {};
+
+		/**
+		 * Decodifica a instrução ir count vezes e retorna o tempo médio,
+		 * em ns, de cada decodificação.
+		 */
+		double time(unsigned int ir, long count) {
+			DecodedInstruction dec;
+			int result = 0;
+			
+			IR = ir;
+			auto start = chrono::steady_clock::now();
+			for (long i = 0; i < count; i++) {
+				result += decode(&dec);
+			}
+			auto end = chrono::steady_clock::now();
+			
+			failures = result;
+			return chrono::duration<double>(end - start).count() * 1e9 / count;
+		};
+		
+		long failures;
+};
+
+/**
+ * Custo da decodificação por classe de instrução.
+ */
+void benchDecode()
+{
+	static const struct {
+		const char *name;
+		unsigned int ir;
+	} classes[] = {
+		{"SUB (imm)", 0xD10043FF},
+		{"ADD (reg)", 0x0B000021},
+		{"LDR (imm)", 0xB9400FE0},
+		{"LDRSW (imm)", 0xB9800000},
+		{"STR (imm)", 0xB9000BE1},
+		{"LDR (reg)", 0xB8647862},
+		{"CMP (imm)", 0x7100241F},
+		{"B", 0x17FFFFFB},
+		{"B.cond", 0x54FFFE0D},
+		{"não implementada", 0xD503201F}
+	};
+	
+	Memory *memory = new SimpleMemory(MEMORY_SIZE);
+	DecodeBench *cpu = new DecodeBench(memory);
+	
+	cout << "Decodificação (" << BENCH_DECODES << " por classe)" << endl;
+	for (auto &c : classes) {
+		double ns = cpu->time(c.ir, BENCH_DECODES);
+		cout << "    " << setw(18) << left << c.name << right
+				<< fixed << setprecision(2) << setw(6) << ns << " ns";
+		if (cpu->failures) {
+			cout << "  (não decodificada)";
+		}
+		cout << endl;
+	}
+	cout << endl;
+	
+	delete cpu;
+	delete memory;
+}
+
+/**
+ * Custo de readData32 e readInstruction32 (chamadas virtuais, como em
+ * BasicCPU) percorrendo BENCH_ACCESS_WINDOW bytes, em ns por acesso.
+ */
+double timeAccesses(Memory *memory, bool instruction)
+{
+	volatile int sink = 0;
+	int sum = 0;
+	auto start = chrono::steady_clock::now();
+	for (unsigned long i = 0; i < BENCH_ACCESSES; i++) {
+		unsigned long address = (i * 4) & (BENCH_ACCESS_WINDOW - 1);
+		sum += instruction ? memory->readInstruction32(address)
+				: memory->readData32(address);
+	}
+	auto end = chrono::steady_clock::now();
+	sink = sum;
+	(void)sink;
+	return chrono::duration<double, nano>(end - start).count() / BENCH_ACCESSES;
+}
+
+/**
+ * Suíte de benchmarks
+ *
+ * Cada caso executa um kernel em uma combinação de CPU e memória,
+ * repetidas vezes, cada repetição com memória e CPU novas (criadas fora da
+ * medição). Os kernels sintéticos são laços infinitos, executados até o
+ * limite de instruções, sobre BENCH_SUITE_WORDS palavras de dados em
+ * BENCH_SUITE_DATA (x0 aponta para os dados e x4 é o número de palavras,
+ * ou o fim dos dados em stores):
+ *	- pointer_chase: cada leitura dá o índice da próxima, em um ciclo
+ *	  aleatório pelos dados (latência, sem paralelismo entre acessos);
+ *	- stream_sum: soma os dados em sequência;
+ *	- branchy: conta os dados menores que 128, valores aleatórios entre 0
+ *	  e 255 (um desvio condicional imprevisível por iteração);
+ *	- stores: quatro escritas de 32 bits por iteração, em sequência.
+ * O caso isummation carrega isummation.o pelo ElfLoader e o executa a
+ * partir de 'main' BENCH_PROGRAM_RUNS vezes por repetição, cada vez com
+ * uma CPU nova (a criação da CPU entra na medição): como o programa para
+ * em 'adrp' (ainda não implementada), o caso mede o custo de executar um
+ * programa curto, dominado pela criação da CPU e pela primeira
+ * decodificação ou tradução.
+ *
+ * Os acessos a dados são os contados pela CPU (PerfCounters): compilado
+ * com NO_STATS, ficam em 0.
+ */
+struct BenchKernel {
+	const char *name;
+	const unsigned int *code;
+	unsigned int length;
+};
+
+static const unsigned int pointerChase[] = {
+	0xB8617801,		// loop: ldr w1, [x0, x1, lsl 2]
+	0x91000442,		// add x2, x2, #1
+	0x17FFFFFE		// b loop
+};
+
+static const unsigned int streamSum[] = {
+	0xB8617802,		// loop: ldr w2, [x0, x1, lsl 2]
+	0x0B020063,		// add w3, w3, w2
+	0x91000421,		// add x1, x1, #1
+	0xEB04003F,		// cmp x1, x4
+	0x9A9FB021,		// csel x1, x1, xzr, lt
+	0x17FFFFFB		// b loop
+};
+
+static const unsigned int branchy[] = {
+	0xB8617802,		// loop: ldr w2, [x0, x1, lsl 2]
+	0x7102005F,		// cmp w2, #128
+	0x5400004A,		// b.ge skip
+	0x11000463,		// add w3, w3, #1
+	0x91000421,		// skip: add x1, x1, #1
+	0xEB04003F,		// cmp x1, x4
+	0x9A9FB021,		// csel x1, x1, xzr, lt
+	0x17FFFFF9		// b loop
+};
+
+static const unsigned int stores[] = {
+	0xB9000003,		// loop: str w3, [x0]
+	0xB9000403,		// str w3, [x0, #4]
+	0xB9000803,		// str w3, [x0, #8]
+	0xB9000C03,		// str w3, [x0, #12]
+	0x11000463,		// add w3, w3, #1
+	0x91004000,		// add x0, x0, #16
+	0xEB04001F,		// cmp x0, x4
+	0x9A85B000,		// csel x0, x0, x5, lt
+	0x17FFFFF8		// b loop
+};
+
+#define KERNEL(name, code) {name, code, sizeof(code) / sizeof(code[0])}
+static const BenchKernel benchKernels[] = {
+	KERNEL("pointer_chase", pointerChase),
+	KERNEL("stream_sum", streamSum),
+	KERNEL("branchy", branchy),
+	KERNEL("stores", stores),
+	{"isummation", nullptr, 0}
+};
+#undef KERNEL
+
+static const char *benchCPUs[] = {"BasicCPU", "InlineCPU", "ThreadedCPU", "JitCPU"};
+static const char *benchMemories[] = {"SimpleMemory", "PagedMemory", "TLBMemory", "CachedMemory"};
+
+/**
+ * Média, desvio padrão (amostral), mínimo e máximo de uma medida nas
+ * repetições de um caso.
+ */
+struct BenchStat {
+	double mean;
+	double stddev;
+	double min;
+	double max;
+
+	BenchStat(const vector<double> &values) {
+		mean = 0;
+		min = values.empty() ? 0 : values[0];
+		max = min;
+		for (double v : values) {
+			mean += v;
+			min = (v < min) ? v : min;
+			max = (v > max) ? v : max;
+		}
+		mean = values.empty() ? 0 : mean / values.size();
+		double sum = 0;
+		for (double v : values) {
+			sum += (v - mean) * (v - mean);
+		}
+		stddev = (values.size() > 1) ? sqrt(sum / (values.size() - 1)) : 0;
+	};
+
+	void writeJSON(ostream &out) {
+		out << "{\"mean\": " << mean << ", \"stddev\": " << stddev
+				<< ", \"min\": " << min << ", \"max\": " << max << "}";
+	};
+};
+
+/**
+ * Caso da suíte e suas medidas, uma por repetição.
+ */
+struct BenchCase {
+	string kernel;
+	string cpu;
+	string mem;
+	string error;				// erro da CPU na última repetição
+	vector<double> seconds;
+	vector<unsigned long> instructions;
+	vector<unsigned long> accesses;	// leituras e escritas de dados
+};
+
+/**
+ * Cria a memória e a CPU de nome mem e cpu, ou nullptr se a implementação
+ * não existir.
+ */
+Memory *newBenchMemory(string mem, unsigned long size)
+{
+	if (mem == "SimpleMemory") {
+		return new SimpleMemory(size);
+	}
+	if (mem == "PagedMemory") {
+		return new PagedMemory(size);
+	}
+	if (mem == "TLBMemory") {
+		return new TLBMemory(size);
+	}
+	if (mem == "CachedMemory") {
+		return new CachedMemory(size);
+	}
+	return nullptr;
+}
+
+BasicCPU *newBenchCPU(string cpu, string mem, Memory *memory)
+{
+	if (cpu == "BasicCPU") {
+		return new BasicCPU(memory);
+	}
+	if (cpu == "InlineCPU") {
+		if (mem == "SimpleMemory") {
+			return new InlineCPU<SimpleMemory>(static_cast<SimpleMemory*>(memory));
+		}
+		if (mem == "PagedMemory") {
+			return new InlineCPU<PagedMemory>(static_cast<PagedMemory*>(memory));
+		}
+		if (mem == "TLBMemory") {
+			return new InlineCPU<TLBMemory>(static_cast<TLBMemory*>(memory));
+		}
+		if (mem == "CachedMemory") {
+			return new InlineCPU<CachedMemory>(static_cast<CachedMemory*>(memory));
+		}
+	}
+	if (cpu == "ThreadedCPU") {
+		return new ThreadedCPU(memory);
+	}
+	if (cpu == "JitCPU") {
+		return new JitCPU(memory);
+	}
+	return nullptr;
+}
+
+/**
+ * Carrega o kernel e seus dados na memória e inicia os registradores da
+ * CPU (ver a descrição da suíte).
+ */
+void loadBenchKernel(const BenchKernel &kernel, Memory *memory, BasicCPU *cpu)
+{
+	for (unsigned int i = 0; i < kernel.length; i++) {
+		memory->writeData32(KERNEL_ADDRESS + 4*i, kernel.code[i]);
+	}
+	
+	// dados: ciclo aleatório (algoritmo de Sattolo) em pointer_chase,
+	// valores entre 0 e 255 nos demais
+	vector<unsigned int> data(BENCH_SUITE_WORDS);
+	uint64_t random = 0x9E3779B97F4A7C15UL;
+	auto next = [&random]() {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		return random;
+	};
+	for (unsigned int i = 0; i < BENCH_SUITE_WORDS; i++) {
+		data[i] = (kernel.code == pointerChase) ? i : next() % 256;
+	}
+	for (unsigned int i = BENCH_SUITE_WORDS - 1; (kernel.code == pointerChase) && (i > 0); i--) {
+		unsigned int j = next() % i;
+		unsigned int t = data[i];
+		data[i] = data[j];
+		data[j] = t;
+	}
+	for (unsigned int i = 0; i < BENCH_SUITE_WORDS; i++) {
+		memory->writeData32(BENCH_SUITE_DATA + 4*i, data[i]);
+	}
+
+	cpu->setStackPointer(BENCH_SUITE_MEMORY);
+	cpu->setRegister(0, BENCH_SUITE_DATA);
+	cpu->setRegister(4, BENCH_SUITE_WORDS);
+	if (kernel.code == stores) {
+		cpu->setRegister(4, BENCH_SUITE_DATA + 4 * BENCH_SUITE_WORDS);
+		cpu->setRegister(5, BENCH_SUITE_DATA);
+	}
+}
+
+/**
+ * Executa uma repetição do caso c com limit instruções por kernel
+ * sintético e acrescenta as medidas a c.
+ *
+ * Retorna 0: se executou e
+ *		   1: se a CPU ou a memória não existir.
+ */
+int runBenchCase(BenchCase &c, const BenchKernel &kernel, unsigned long limit,
+		ElfLoader &loader)
+{
+	unsigned long instructions = 0;
+	unsigned long accesses = 0;
+	double seconds;
+	
+	Memory *memory = newBenchMemory(c.mem, kernel.code ? BENCH_SUITE_MEMORY : MEMORY_SIZE);
+	if (!memory) {
+		return 1;
+	}
+	if (kernel.code) {
+		BasicCPU *cpu = newBenchCPU(c.cpu, c.mem, memory);
+		if (!cpu) {
+			delete memory;
+			return 1;
+		}
+		loadBenchKernel(kernel, memory, cpu);
+		cpu->setInstructionLimit(limit);
+		
+		auto start = chrono::steady_clock::now();
+		cpu->run(KERNEL_ADDRESS);
+		auto end = chrono::steady_clock::now();
+		
+		seconds = chrono::duration<double>(end - start).count();
+		instructions = cpu->getInstructionCount();
+		accesses = cpu->getPerfCounters()->getAccesses();
+		c.error = PerfCounters::errorName(cpu->getError());
+		delete cpu;
+	} else {
+		memory->loadBinary(loader.getImageFile());
+		
+		auto start = chrono::steady_clock::now();
+		for (int run = 0; run < BENCH_PROGRAM_RUNS; run++) {
+			BasicCPU *cpu = newBenchCPU(c.cpu, c.mem, memory);
+			if (!cpu) {
+				delete memory;
+				return 1;
+			}
+			cpu->setStackPointer(MEMORY_SIZE);
+			cpu->run(loader.getEntryPoint());
+			instructions += cpu->getInstructionCount();
+			accesses += cpu->getPerfCounters()->getAccesses();
+			c.error = PerfCounters::errorName(cpu->getError());
+			delete cpu;
+		}
+		auto end = chrono::steady_clock::now();
+		seconds = chrono::duration<double>(end - start).count();
+	}
+	delete memory;
+	
+	c.seconds.push_back(seconds);
+	c.instructions.push_back(instructions);
+	c.accesses.push_back(accesses);
+	return 0;
+}
+
+/**
+ * Medidas derivadas de cada repetição: milhões de instruções por segundo,
+ * ns por instrução e milhões de acessos a dados por segundo.
+ */
+vector<double> benchMIPS(BenchCase &c)
+{
+	vector<double> values;
+	for (unsigned int r = 0; r < c.seconds.size(); r++) {
+		values.push_back(c.instructions[r] / c.seconds[r] / 1e6);
+	}
+	return values;
+}
+
+vector<double> benchNsPerInstruction(BenchCase &c)
+{
+	vector<double> values;
+	for (unsigned int r = 0; r < c.seconds.size(); r++) {
+		values.push_back(c.instructions[r] ? c.seconds[r] * 1e9 / c.instructions[r] : 0);
+	}
+	return values;
+}
+
+vector<double> benchMAccesses(BenchCase &c)
+{
+	vector<double> values;
+	for (unsigned int r = 0; r < c.seconds.size(); r++) {
+		values.push_back(c.accesses[r] / c.seconds[r] / 1e6);
+	}
+	return values;
+}
+
+/**
+ * Sobrecusto do modelo de caches (CachedMemory sobre SimpleMemory), em
+ * tempo por acesso (readData32 e readInstruction32) e por instrução
+ * (pointer_chase em BasicCPU, com uma falta na L1D por leitura), conferido
+ * com a meta BENCH_CACHE_MAX_OVERHEAD. As duas memórias se alternam a cada
+ * uma das BENCH_SUITE_REPETITIONS repetições, e vale a melhor medida de
+ * cada uma, para que as variações do hospedeiro não pesem só sobre uma.
+ */
+void benchCacheModel()
+{
+	Memory *memories[] = {new SimpleMemory(MEMORY_SIZE), new CachedMemory(MEMORY_SIZE)};
+	ElfLoader loader(FILENAME);
+
+	cout << "Sobrecusto de CachedMemory sobre SimpleMemory (melhor de "
+			<< BENCH_SUITE_REPETITIONS << ", meta: < " << BENCH_CACHE_MAX_OVERHEAD
+			<< "x)" << endl;
+	const char *names[] = {"readData32", "readInstruction32", "pointer_chase"};
+	for (int test = 0; test < 3; test++) {
+		double best[2];
+		for (int r = 0; r < BENCH_SUITE_REPETITIONS; r++) {
+			for (int m = 0; m < 2; m++) {
+				double ns;
+				if (test < 2) {
+					ns = timeAccesses(memories[m], test == 1);
+				} else {
+					BenchCase c;
+					c.cpu = "BasicCPU";
+					c.mem = m ? "CachedMemory" : "SimpleMemory";
+					runBenchCase(c, benchKernels[0], BENCH_SUITE_INSTRUCTIONS, loader);
+					ns = benchNsPerInstruction(c)[0];
+				}
+				best[m] = ((r == 0) || (ns < best[m])) ? ns : best[m];
+			}
+		}
+		double overhead = best[1] / best[0];
+		cout << "    " << setw(18) << left << names[test] << right
+				<< fixed << setprecision(2) << "SimpleMemory " << setw(6) << best[0]
+				<< " ns, CachedMemory " << setw(6) << best[1] << " ns ("
+				<< overhead << "x): "
+				<< ((overhead < BENCH_CACHE_MAX_OVERHEAD) ? "ok" : "ACIMA DA META") << endl;
+	}
+	cout << endl;
+
+	delete memories[0];
+	delete memories[1];
+}
+
+/**
+ * Escreve os resultados da suíte em JSON: parâmetros e, por caso, as
+ * medidas de cada repetição e a média, desvio padrão, mínimo e máximo de
+ * MIPS, ns por instrução e milhões de acessos por segundo.
+ */
+void writeSuiteJSON(string filename, vector<BenchCase> &cases, int repetitions,
+		unsigned long limit)
+{
+	ofstream ofp(filename);
+	ofp << "{" << endl
+			<< "  \"stats\": " << (PERF_ENABLED ? "true" : "false") << "," << endl
+			<< "  \"repetitions\": " << repetitions << "," << endl
+			<< "  \"instructions\": " << limit << "," << endl
+			<< "  \"program_runs\": " << BENCH_PROGRAM_RUNS << "," << endl
+			<< "  \"results\": [" << endl;
+	ofp << setprecision(6);
+	for (unsigned int i = 0; i < cases.size(); i++) {
+		BenchCase &c = cases[i];
+		ofp << "    {\"kernel\": \"" << c.kernel << "\", \"cpu\": \"" << c.cpu
+				<< "\", \"mem\": \"" << c.mem << "\", \"error\": \"" << c.error
+				<< "\", \"instructions\": [";
+		for (unsigned int r = 0; r < c.instructions.size(); r++) {
+			ofp << (r ? ", " : "") << c.instructions[r];
+		}
+		ofp << "], \"accesses\": [";
+		for (unsigned int r = 0; r < c.accesses.size(); r++) {
+			ofp << (r ? ", " : "") << c.accesses[r];
+		}
+		ofp << "], \"seconds\": [";
+		for (unsigned int r = 0; r < c.seconds.size(); r++) {
+			ofp << (r ? ", " : "") << c.seconds[r];
+		}
+		ofp << "], \"mips\": ";
+		BenchStat(benchMIPS(c)).writeJSON(ofp);
+		ofp << ", \"ns_per_instruction\": ";
+		BenchStat(benchNsPerInstruction(c)).writeJSON(ofp);
+		ofp << ", \"maccesses_per_second\": ";
+		BenchStat(benchMAccesses(c)).writeJSON(ofp);
+		ofp << "}" << ((i + 1 < cases.size()) ? "," : "") << endl;
+	}
+	ofp << "  ]" << endl << "}" << endl;
+}
+
+/**
+ * Informa se name está na lista separada por vírgulas list ("": todos).
+ */
+bool benchSelected(string list, string name)
+{
+	return list.empty() || (("," + list + ",").find("," + name + ",") != string::npos);
+}
+
+/**
+ * Executa os casos da suíte selecionados pelas listas kernels, cpus e
+ * mems, repetitions vezes cada, imprime o resumo e grava os resultados em
+ * filename.
+ *
+ * Retorna 0: se executou todos os casos e
+ *		   1: se isummation.o não puder ser carregado.
+ */
+int benchSuite(int repetitions, unsigned long limit, string kernels, string cpus,
+		string mems, string filename)
+{
+	ElfLoader loader(FILENAME);
+	if (loader.load()) {
+		cout << "Falha ao carregar " << FILENAME << endl;
+		return 1;
+	}
+	
+	cout << "Suíte de benchmarks: " << repetitions << " repetições, " << limit
+			<< " instruções por kernel, " << BENCH_PROGRAM_RUNS
+			<< " execuções de " << FILENAME << endl;
+	cout << "kernel         CPU          memória            MIPS (± dp)   ns/instr"
+			<< "  Macessos/s (± dp)" << endl;
+	
+	vector<BenchCase> cases;
+	for (const BenchKernel &kernel : benchKernels) {
+		for (const char *cpu : benchCPUs) {
+			for (const char *mem : benchMemories) {
+				if (!benchSelected(kernels, kernel.name) || !benchSelected(cpus, cpu)
+						|| !benchSelected(mems, mem)) {
+					continue;
+				}
+				BenchCase c;
+				c.kernel = kernel.name;
+				c.cpu = cpu;
+				c.mem = mem;
+				for (int r = 0; r < repetitions; r++) {
+					runBenchCase(c, kernel, limit, loader);
+				}
+				BenchStat mips(benchMIPS(c));
+				BenchStat ns(benchNsPerInstruction(c));
+				BenchStat maccesses(benchMAccesses(c));
+				cout << setw(15) << left << c.kernel << setw(13) << c.cpu
+						<< setw(13) << c.mem << right << fixed
+						<< setprecision(1) << setw(10) << mips.mean
+						<< " ± " << setw(5) << mips.stddev
+						<< setprecision(2) << setw(11) << ns.mean
+						<< setprecision(1) << setw(10) << maccesses.mean
+						<< " ± " << setw(5) << maccesses.stddev;
+				if (c.error != "NONE") {
+					cout << "  (" << c.error << ")";
+				}
+				cout << endl;
+				cases.push_back(c);
+			}
+		}
+	}
+	
+	writeSuiteJSON(filename, cases, repetitions, limit);
+	cout << "Resultados em " << filename << endl;
+	return 0;
+}
+
+/**
+ * Uso: benchmark [-suite] [-r repetições] [-n instruções] [-k kernels]
+ *				  [-cpu CPUs] [-mem memórias] [-json arquivo]
+ *
+ * Sem -suite, executa antes as comparações de desempenho das
+ * implementações sobre o laço sintético. -k, -cpu e -mem selecionam os
+ * casos da suíte (listas separadas por vírgulas; padrão: todos).
+ */
+int main(int argc, char *argv[])
+{
+	bool suiteOnly = false;
+	int repetitions = BENCH_SUITE_REPETITIONS;
+	unsigned long limit = BENCH_SUITE_INSTRUCTIONS;
+	string kernels, cpus, mems;
+	string jsonFile = BENCH_SUITE_FILE;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-suite") {
+			suiteOnly = true;
+		} else if ((arg == "-r") && (i + 1 < argc)) {
+			repetitions = atoi(argv[++i]);
+		} else if ((arg == "-n") && (i + 1 < argc)) {
+			limit = strtoul(argv[++i], nullptr, 0);
+		} else if ((arg == "-k") && (i + 1 < argc)) {
+			kernels = argv[++i];
+		} else if ((arg == "-cpu") && (i + 1 < argc)) {
+			cpus = argv[++i];
+		} else if ((arg == "-mem") && (i + 1 < argc)) {
+			mems = argv[++i];
+		} else if ((arg == "-json") && (i + 1 < argc)) {
+			jsonFile = argv[++i];
+		} else {
+			cerr << "Uso: " << argv[0] << " [-suite] [-r repetições] [-n instruções]"
+					<< " [-k kernels] [-cpu CPUs] [-mem memórias] [-json arquivo]" << endl;
+			return 2;
+		}
+	}
+	if ((repetitions < 1) || (limit == 0)) {
+		cerr << "Repetições e instruções devem ser positivas" << endl;
+		return 2;
+	}
+	if (suiteOnly) {
+		return benchSuite(repetitions, limit, kernels, cpus, mems, jsonFile);
+	}
+
+	benchDecode();
+	benchCacheModel();
+
+	cout << "Benchmark: " << BENCH_INSTRUCTIONS
+			<< " instruções do laço sintético" << endl << endl;
+
+	Memory *memory = newKernelMemory();
+	BasicCPU *basicCPU = new BasicCPU(memory);
+	double basic = benchCPU("BasicCPU", basicCPU);
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	basicCPU = new BasicCPU(memory);
+	double basicBranches = benchBranches("BasicCPU (branch)", basicCPU);
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	basicCPU = new BasicCPU(memory);
+	double basicProfile = benchProfile("BasicCPU (profile)", basicCPU, 1);
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	basicCPU = new BasicCPU(memory);
+	double basicSampled = benchProfile("BasicCPU (sampled)", basicCPU, BENCH_PROFILE_PERIOD);
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	SimpleMemory *simpleMemory = static_cast<SimpleMemory*>(newKernelMemory());
+	InlineCPU<SimpleMemory> *inlineCPU = new InlineCPU<SimpleMemory>(simpleMemory);
+	double inlined = benchCPU("InlineCPU", inlineCPU);
+	printChecksum(simpleMemory);
+	delete inlineCPU;
+	delete simpleMemory;
+
+	memory = loadKernel(new PagedMemory(MEMORY_SIZE));
+	basicCPU = new BasicCPU(memory);
+	double paged = benchCPU("BasicCPU (paged)", basicCPU);
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	PagedMemory *pagedMemory = static_cast<PagedMemory*>(loadKernel(new PagedMemory(MEMORY_SIZE)));
+	InlineCPU<PagedMemory> *inlinePagedCPU = new InlineCPU<PagedMemory>(pagedMemory);
+	double inlinedPaged = benchCPU("InlineCPU (paged)", inlinePagedCPU);
+	printChecksum(pagedMemory);
+	delete inlinePagedCPU;
+	delete pagedMemory;
+
+	memory = loadKernel(new TLBMemory(MEMORY_SIZE));
+	basicCPU = new BasicCPU(memory);
+	double tlb = benchCPU("BasicCPU (TLB)", basicCPU);
+	printTLBStats(static_cast<TLBMemory*>(memory));
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	TLBMemory *tlbMemory = static_cast<TLBMemory*>(loadKernel(new TLBMemory(MEMORY_SIZE)));
+	InlineCPU<TLBMemory> *inlineTLBCPU = new InlineCPU<TLBMemory>(tlbMemory);
+	double inlinedTLB = benchCPU("InlineCPU (TLB)", inlineTLBCPU);
+	printChecksum(tlbMemory);
+	delete inlineTLBCPU;
+	delete tlbMemory;
+
+	memory = loadKernel(new CachedMemory(MEMORY_SIZE));
+	basicCPU = new BasicCPU(memory);
+	double cached = benchCPU("BasicCPU (cached)", basicCPU);
+	printCacheStats(static_cast<CachedMemory*>(memory));
+	printChecksum(memory);
+	delete basicCPU;
+	delete memory;
+
+	CachedMemory *cachedMemory = static_cast<CachedMemory*>(loadKernel(new CachedMemory(MEMORY_SIZE)));
+	InlineCPU<CachedMemory> *inlineCachedCPU = new InlineCPU<CachedMemory>(cachedMemory);
+	double inlinedCached = benchCPU("InlineCPU (cached)", inlineCachedCPU);
+	printChecksum(cachedMemory);
+	delete inlineCachedCPU;
+	delete cachedMemory;
+
+	memory = newKernelMemory();
+	ThreadedCPU *unchainedCPU = new ThreadedCPU(memory);
+	unchainedCPU->setBlockChaining(false);
+	double unchained = benchCPU("ThreadedCPU (-chain)", unchainedCPU);
+	printBlockStats(unchainedCPU);
+	delete unchainedCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	ThreadedCPU *threadedCPU = new ThreadedCPU(memory);
+	double threaded = benchCPU("ThreadedCPU", threadedCPU);
+	printBlockStats(threadedCPU);
+	printChecksum(memory);
+	delete threadedCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	threadedCPU = new ThreadedCPU(memory);
+	double threadedBranches = benchBranches("ThreadedCPU (branch)", threadedCPU);
+	printChecksum(memory);
+	delete threadedCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	threadedCPU = new ThreadedCPU(memory);
+	double threadedSampled = benchProfile("ThreadedCPU (sampled)", threadedCPU, BENCH_PROFILE_PERIOD);
+	printChecksum(memory);
+	delete threadedCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	JitCPU *jitCPU = new JitCPU(memory);
+	double jit = benchCPU("JitCPU", jitCPU);
+	printJitStats(jitCPU);
+	printChecksum(memory);
+	delete jitCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	jitCPU = new JitCPU(memory);
+	double jitBranches = benchBranches("JitCPU (branch)", jitCPU);
+	printChecksum(memory);
+	delete jitCPU;
+	delete memory;
+
+	memory = newKernelMemory();
+	jitCPU = new JitCPU(memory);
+	double jitSampled = benchProfile("JitCPU (sampled)", jitCPU, BENCH_PROFILE_PERIOD);
+	printChecksum(memory);
+	delete jitCPU;
+	delete memory;
+
+	cout << endl;
+	benchMultiCores();
+
+	cout << endl << setprecision(2)
+			<< "InlineCPU/BasicCPU: " << inlined / basic << "x" << endl
+			<< "BasicCPU (paged)/BasicCPU: " << paged / basic << "x" << endl
+			<< "InlineCPU (paged)/BasicCPU: " << inlinedPaged / basic << "x" << endl
+			<< "BasicCPU (TLB)/BasicCPU: " << tlb / basic << "x" << endl
+			<< "InlineCPU (TLB)/BasicCPU: " << inlinedTLB / basic << "x" << endl
+			<< "BasicCPU (cached)/BasicCPU: " << cached / basic << "x" << endl
+			<< "InlineCPU (cached)/BasicCPU: " << inlinedCached / basic << "x" << endl
+			<< "ThreadedCPU (-chain)/BasicCPU: " << unchained / basic << "x" << endl
+			<< "ThreadedCPU/BasicCPU: " << threaded / basic << "x" << endl
+			<< "JitCPU/BasicCPU: " << jit / basic << "x" << endl
+			<< "BasicCPU (branch)/BasicCPU: " << basicBranches / basic << "x" << endl
+			<< "BasicCPU (profile)/BasicCPU: " << basicProfile / basic << "x" << endl
+			<< "BasicCPU (sampled 1/" << BENCH_PROFILE_PERIOD << ")/BasicCPU: "
+					<< basicSampled / basic << "x" << endl
+			<< "ThreadedCPU (branch)/ThreadedCPU: " << threadedBranches / threaded << "x" << endl
+			<< "JitCPU (branch)/JitCPU: " << jitBranches / jit << "x" << endl
+			<< "ThreadedCPU (sampled 1/" << BENCH_PROFILE_PERIOD << ")/ThreadedCPU: "
+					<< threadedSampled / threaded << "x" << endl
+			<< "JitCPU (sampled 1/" << BENCH_PROFILE_PERIOD << ")/JitCPU: "
+					<< jitSampled / jit << "x" << endl;
+
+	cout << endl;
+	return benchSuite(repetitions, limit, kernels, cpus, mems, jsonFile);
+}
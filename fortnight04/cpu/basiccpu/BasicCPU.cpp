@@ -56,6 +56,16 @@ using namespace std;
 
 BasicCPU::BasicCPU(Memory *memory) {
 	this->memory = memory;
+	
+	// banco de registradores zerado (inclusive ZR) e pilha no endereço
+	// inicial
+	for (int i = 0; i < REG_FILE_SIZE; i++) {
+		R[i] = 0;
+	}
+	memset(V, 0, sizeof(V));
+	SP = STACKADDRESS;
+	
+	flushDecodeCache();
 }
 
 /**
@@ -63,29 +73,20 @@ BasicCPU::BasicCPU(Memory *memory) {
  */
 int BasicCPU::run(long startAddress)
 {
+	return run<Memory>(startAddress);
+}
 
-	// inicia PC com o valor de startAddress
-	PC = startAddress;
-
-	// ciclo da máquina
-	while ((cpuError != CPUerrorCode::NONE) && !processFinished) {
-		IF();
-		ID();
-		if (fpOP) {
-			EXF();
-		} else {
-			EXI();
-		}
-		MEM();
-		WB();
-	}
-	
-	if (cpuError) {
-		return 1;
-	}
-	
-	return 0;
-};
+/**
+ * Executa uma instrução, passando por todos os estágios.
+ *
+ * Retorna 0: se executou corretamente e
+ *		   1: se algum estágio não implementar a instrução (o estágio fica
+ *			  registrado em cpuError).
+ */
+int BasicCPU::step()
+{
+	return step<Memory>();
+}
 
 /**
  * Busca da instrução.
@@ -94,7 +95,7 @@ int BasicCPU::run(long startAddress)
  */
 void BasicCPU::IF()
 {
-	IR = memory->readInstruction32(PC);
+	IF<Memory>();
 };
 
 /**
@@ -104,417 +105,1005 @@ void BasicCPU::IF()
  * e escreve em registradores auxiliares o que será usado por estágios
  * posteriores.
  *
+ * A decodificação propriamente dita só acontece na primeira vez que a
+ * instrução em PC é executada. O resultado fica na cache de instruções
+ * decodificadas e as execuções seguintes apenas leem os registradores
+ * indicados pela entrada da cache.
+ *
  * Retorna 0: se executou corretamente e
  *		   1: se a instrução não estiver implementada.
  */
 int BasicCPU::ID()
-{	
-	int group = IR & 0x1E000000; // bits 28-25
+{
+	DecodedInstruction *dec = &decodeCache[(PC >> 2) & (DECODE_CACHE_SIZE - 1)];
 	
-	switch (group)
-	{
-		//100x Data Processing -- Immediate
-		case 0x10000000: // x = 0
-		case 0x12000000: // x = 1
-			fpOP = false;
-			return decodeDataProcImm();
-			break;
-			
-		// x101 Data Processing -- Register on page C4-278
-		case 0x0A000000: // x = 0
-		case 0x1A000000: // x = 1
-			fpOP = false;
-			return decodeDataProcReg();
-			break;
-			
-		// x1y0 -- Loads and Stores on page C4-246	
-		case 0x08000000: // x = 0 y = 0
-		case 0x0C000000: // x = 0 y = 1
-		case 0x18000000: // x = 1 y = 0
-		case 0x1C000000: // x = 1 y = 1 
-			fpOP = false;
-			return decodeLoadStore();
-			break;
-			
-		// 101x -- Branches, Exception Generating and System instructions on page C4-237
-		case 0x14000000: // x = 0
-		case 0x16000000: // x = 1
-			fpOP = false;
-			return decodeBranches();
-			break;
+	if (dec->valid && (dec->PC == PC)) {
+		decodeCacheHits++;
+	} else {
+		decodeCacheMisses++;
 		
-		default:
+		dec->valid = false;
+		if (decode(dec)) {
 			return 1; // instrução não implementada
+		}
+		
+		dec->PC = PC;
+		dec->valid = true;
+		decodeCachePages |= decodeCachePageBit(PC);
 	}
+	
+	readOperands(dec);
+	return 0;
 };
 
 /**
- * Decodifica instruções do grupo
- * 		100x Data Processing -- Immediate
+ * Codificações A64 implementadas: (mask, value, decodificador).
  *
- * C4.1.2 Data Processing -- Immediate (p. 232)
- * This section describes the encoding of the Data Processing -- Immediate group.
- * The encodings in this section are decoded from A64 instruction set encoding.
+ * Para implementar uma nova instrução basta acrescentar sua codificação
+ * aqui; a tabela de decodificação é gerada em tempo de compilação.
+ */
+constexpr DecodeEncoding BasicCPU::decodeEncodings[] = {
+	// 100x Data Processing -- Immediate (C4.1.2, p. 232)
+	{0x1F800000, 0x11000000, &BasicCPU::decodeAddSubImm},	// ADD, ADDS, SUB, SUBS (immediate)
+	
+	// 101x Branches, Exception Generating and System instructions (p. C4-237)
+	{0xFC000000, 0x14000000, &BasicCPU::decodeB},			// B
+	{0xFF000010, 0x54000000, &BasicCPU::decodeBCond},		// B.cond
+	
+	// x1x0 Loads and Stores (p. C4-246)
+	{0xFFC00000, 0xB9800000, &BasicCPU::decodeLdrswImm},	// LDRSW (immediate), unsigned offset
+	{0xFFC00000, 0xB9400000, &BasicCPU::decodeLdrImm},		// LDR (immediate), 32 bits, unsigned offset
+	{0xFFC00000, 0xB9000000, &BasicCPU::decodeStrImm},		// STR (immediate), 32 bits, unsigned offset
+	{0xFFE0FC00, 0xB8607800, &BasicCPU::decodeLdrReg},		// LDR (register), 32 bits, LSL #2
+	{0x7E000000, 0x28000000, &BasicCPU::decodeLdpStp},		// LDP, STP, LDNP, STNP, 32 e 64 bits
+	{0xBF000000, 0x39000000, &BasicCPU::decodeLoadStoreSubword},	// LDRB, LDRH, LDRSB, LDRSH, STRB, STRH, unsigned offset
+	{0xBF200000, 0x38000000, &BasicCPU::decodeLoadStoreSubword},	// idem, imm9: unscaled (LDURB...), post-index e pre-index
+	{0xBF200C00, 0x38200800, &BasicCPU::decodeLoadStoreSubword},	// idem, register offset
+	{0xBFBF0000, 0x0C000000, &BasicCPU::decodeLdSt1Multiple},	// LD1, ST1 (multiple structures), sem offset
+	{0xBFA00000, 0x0C800000, &BasicCPU::decodeLdSt1Multiple},	// idem, post-index
+	{0x3F000000, 0x3D000000, &BasicCPU::decodeLdStSimdImm},	// LDR, STR (immediate, SIMD&FP), unsigned offset
+	{0x3F200000, 0x3C000000, &BasicCPU::decodeLdStSimdImm},	// idem, imm9: unscaled (LDUR, STUR), post-index e pre-index
+	
+	// x101 Data Processing -- Register (p. C4-278)
+	{0x1F200000, 0x0B000000, &BasicCPU::decodeAddSubShiftedReg},	// ADD, ADDS, SUB, SUBS (shifted register)
+	{0x7FE00C00, 0x1A800000, &BasicCPU::decodeCsel},		// CSEL
+	
+	// x111 Data Processing -- Scalar Floating-Point and Advanced SIMD
+	{0x9F200400, 0x0E200400, &BasicCPU::decodeSimdThreeSame},	// ADD, SUB, MUL, AND, ORR, EOR, FADD, FSUB, FMUL, FDIV (vector)
+	{0xBF3FFC00, 0x0E31B800, &BasicCPU::decodeSimdAddv},	// ADDV
+	{0x9FF80C00, 0x0F000400, &BasicCPU::decodeSimdModifiedImm},	// MOVI
+	{0xBFE0FC00, 0x0E000C00, &BasicCPU::decodeSimdCopy},	// DUP (general)
+	{0xBFE0FC00, 0x0E003C00, &BasicCPU::decodeSimdCopy},	// UMOV
+	{0xFF200C00, 0x1E200800, &BasicCPU::decodeFloatTwoSource},	// FMUL, FDIV, FADD, FSUB (scalar)
+	{0x7F3EFC00, 0x1E260000, &BasicCPU::decodeFmovGeneral},	// FMOV (general), 32 e 64 bits
+};
+
+constexpr DecodeTable BasicCPU::decodeTable = buildDecodeTable(decodeEncodings,
+		sizeof(decodeEncodings) / sizeof(decodeEncodings[0]));
+
+/**
+ * Decodifica IR e preenche a instrução decodificada dec.
+ *
+ * Os bits 31-21 de IR indexam a tabela de decodificação, que dá as poucas
+ * codificações candidatas (em geral uma); a primeira cujo (mask, value)
+ * confere com IR decodifica a instrução.
  *
  * Retorna 0: se executou corretamente e
  *		   1: se a instrução não estiver implementada.
  */
-int BasicCPU::decodeDataProcImm() {
-	unsigned int n, d;
-	int imm;
+int BasicCPU::decode(DecodedInstruction *dec)
+{	
+	// valores padrão, sobrescritos pelos decodificadores de cada grupo
+	dec->n = REG_ZR;
+	dec->nMask = REG_MASK_64;
+	dec->m = REG_ZR;
+	dec->mMask = REG_MASK_64;
+	dec->shift = 0;
+	dec->amount = 0;
+	dec->imm = 0;
+	dec->d = REG_DISCARD;
+	dec->dMask = REG_MASK_64;
+	dec->d2 = REG_DISCARD;
+	dec->base = REG_DISCARD;
+	dec->wbOffset = 0;
+	dec->cond = COND_AL;
 	
-	/* Add/subtract (immediate) (pp. 233-234)
-		This section describes the encoding of the Add/subtract (immediate)
-		instruction class. The encodings in this section are decoded from
-		Data Processing -- Immediate on page C4-232.
-	*/
-	switch (IR & 0xFF800000)
-	{
-		case 0xD1000000:
-			//1 1 0 SUB (immediate) - 64-bit variant on page C6-1199
-			
-			if (IR & 0x00400000) return 1; // sh = 1 não implementado
-			
-			// ler A e B
-			n = (IR & 0x000003E0) >> 5;
-			if (n == 31) {
-				A = SP;
-			} else {
-				A = getX(n); // 64-bit variant
-			}
-			imm = (IR & 0x003FFC00) >> 10;
-			B = imm;
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);
+	dec->fpOP = false;
+	dec->vecOP = false;
+	
+	// codificações candidatas para os bits 31-21 de IR
+	static_assert(!decodeTable.overflow,
+			"DECODE_TABLE_WAYS insuficiente para a lista de codificações");
+	const uint8_t *ways = decodeTable.ways[IR >> DECODE_TABLE_SHIFT];
+	
+	for (int i = 0; (i < DECODE_TABLE_WAYS) && (ways[i] != DECODE_TABLE_EMPTY); i++) {
+		const DecodeEncoding *encoding = &decodeEncodings[ways[i]];
+		if ((IR & encoding->mask) == encoding->value) {
+			return (this->*encoding->handler)(dec);
+		}
+	}
+	
+	return 1; // instrução não implementada
+}
+
+/**
+ * Lê os registradores indicados pela instrução decodificada dec e
+ * atribui os registradores auxiliares A, B, Rd e os sinais de controle.
+ *
+ * B é Rm deslocado somado ao imediato: instruções com imediato têm
+ * m = REG_ZR e instruções com registrador têm imm = 0.
+ */
+void BasicCPU::readOperands(DecodedInstruction *dec)
+{
+	A = R[dec->n] & dec->nMask;
+	
+	B = R[dec->m] & dec->mMask;
+	switch (dec->shift) {
+		case 0: //LSL – Logical Shift Left
+			B = B << dec->amount;
+			break;
+		case 1: //LSR – Logical Shift Right
+			B = ((unsigned long) B) >> dec->amount;
+			break;
+		case 2: //ASR – Arithmetic Shift Right (Wm com extensão de sinal)
+			if (dec->mMask == REG_MASK_32) {
+				B = (int64_t)(int32_t)B;
 			}
-			
-			// atribuir ALUctrl
-			ALUctrl = ALUctrlFlag::SUB;
-			
-			// atribuir MEMctrl
-			MEMctrl = MEMctrlFlag::MEM_NONE;
-			
-			// atribuir WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			// atribuir MemtoReg
-			MemtoReg = false;
-			
-			return 0;
+			B = ((signed long) B) >> dec->amount;
+			break;
+		case 3: //SXTW – Wm com extensão de sinal, seguido de LSL
+			B = ((int64_t)(int32_t)B) << dec->amount;
+			break;
 		default:
-			// instrução não implementada
-			return 1;
+			break;
 	}
+	B += dec->imm;
 	
-	// instrução não implementada
-	return 1;
+	Rd = &R[dec->d];
+	WBmask = dec->dMask;
+	if (dec->WBctrl == WBctrlFlag::BaseWrite) {
+		Rd2 = &R[dec->d2];
+		Rbase = &R[dec->base];
+		WBoffset = dec->wbOffset;
+	} else if (dec->vecOP) {
+		readVectorOperands(dec);
+	}
+	cond = dec->cond;
+	
+	fpOP = dec->fpOP;
+	ALUctrl = dec->ALUctrl;
+	MEMctrl = dec->MEMctrl;
+	WBctrl = dec->WBctrl;
+	MemtoReg = dec->MemtoReg;
 }
 
 /**
- * 101x Branches, Exception Generating and System instructions
+ * Lê os registradores vetoriais indicados pela instrução decodificada dec.
  *
- * Retorna 0: se executou corretamente e
- *		   1: se a instrução não estiver implementada.
+ * Os acessos à memória de LD1, ST1 e LDR/STR (SIMD&FP) são calculados por
+ * EXI, como os das demais instruções de load/store, e o write-back do
+ * registrador base é feito por WB, como em LDP/STP.
  */
-int BasicCPU::decodeBranches() {
+void BasicCPU::readVectorOperands(DecodedInstruction *dec)
+{
+	AF = V[dec->vn];
+	BF = V[dec->vm];
+	Vd = &V[dec->vd];
+	Vbytes = dec->vbytes;
+	Vesize = dec->vesize;
+	Vcount = dec->vcount;
 	
-	switch (IR & 0xFC000000)
-	{
-		case 0x14000000:
-			// B C6.2.24 - Branch Incondicional
-			
-			unsigned int imm26 = IR & 0x03FFFFFF;
-			
-			A = PC;
-			
-			B = (((int32_t)imm26) << 6) >> 4; 
-			
-			// Registrador destino
-			Rd = &PC;
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-			
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::MEM_NONE;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			//MemtoReg
-			MemtoReg = false;
-			
-			return 0;
+	Rbase = &R[dec->base];
+	WBoffset = dec->wbOffset + R[dec->wbIndex];
+}
+
+/**
+ * ADD, ADDS, SUB e SUBS (immediate), 32 e 64 bits. CMP e CMN (immediate)
+ * são SUBS e ADDS com Rd = ZR.
+ *
+ * C4.1.2 Data Processing -- Immediate (p. 232)
+ * Add/subtract (immediate) (pp. 233-234)
+ */
+int BasicCPU::decodeAddSubImm(DecodedInstruction *dec) {
+	bool sf = IR & 0x80000000; // 1: 64 bits
+	bool op = IR & 0x40000000; // 1: SUB
+	bool S = IR & 0x20000000;  // 1: atualiza as flags
+	
+	// ler A e B (n = 31 é SP)
+	dec->n = (IR & 0x000003E0) >> 5;
+	dec->imm = (IR & 0x003FFC00) >> 10;
+	if (IR & 0x00400000) {
+		dec->imm <<= 12; // sh = 1
 	}
-	return 1; // instrução não implementada
+	
+	// Registrador destino (d = 31 é SP; nas variantes que atualizam as
+	// flags, d = 31 é ZR)
+	dec->d = S ? zrDest(IR & 0x0000001F) : (IR & 0x0000001F);
+	
+	if (!sf) {
+		dec->nMask = REG_MASK_32;
+		dec->dMask = REG_MASK_32;
+	}
+	
+	// atribuir ALUctrl
+	if (op) {
+		dec->ALUctrl = S ? ALUctrlFlag::SUBS : ALUctrlFlag::SUB;
+	} else {
+		dec->ALUctrl = S ? ALUctrlFlag::ADDS : ALUctrlFlag::ADD;
+	}
+	
+	// atribuir MEMctrl
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	
+	// atribuir WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	// atribuir MemtoReg
+	dec->MemtoReg = false;
+	
+	return 0;
 }
 
 /**
- * ATIVIDADE FUTURA: Decodifica instruções do grupo
- * 		x1x0 Loads and Stores on page C4-246
+ * B C6.2.24 - Branch Incondicional
+ */
+int BasicCPU::decodeB(DecodedInstruction *dec) {
+	unsigned int imm26 = IR & 0x03FFFFFF;
+	
+	dec->n = REG_PC;
+	
+	dec->imm = (((int32_t)imm26) << 6) >> 4; 
+	
+	// Registrador destino
+	dec->d = REG_PC;
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = false;
+	
+	return 0;
+}
+
+/**
+ * B.cond C6.2.23 - Branch condicional
  *
- * Retorna 0: se executou corretamente e
- *		   1: se a instrução não estiver implementada.
+ * O destino é calculado como em B; EXI (BCOND) escolhe entre o destino e a
+ * próxima instrução conforme a condição.
  */
-int BasicCPU::decodeLoadStore() {
-    int n, imm12, d;
-	switch (IR & 0xFFC00000) 
-	{
-		case 0xB9800000:
-			//LDRSW C6.2.131 Immediate (Unsigned offset)
-			
-			n = (IR & 0x000003E0) >> 5; // Rn
-			
-			imm12 = ( IR & 0x003FFC00) >> 10;
-			
-			if (n == 31) {
-				A = SP;
-			} else {
-				A = getX(n); // 64-bit variant
-			}
+int BasicCPU::decodeBCond(DecodedInstruction *dec) {
+	dec->n = REG_PC;
+	
+	// imm19 (bits 23-5) com extensão de sinal, multiplicado por 4
+	dec->imm = (int64_t)(((int32_t)(IR << 8)) >> 13) << 2;
+	
+	dec->cond = IR & 0x0000000F;
+	
+	// Registrador destino
+	dec->d = REG_PC;
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::BCOND;
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = false;
+	
+	return 0;
+}
 
-			B = imm12 << 2; //pimm que é múltiplo de 4
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);	
-			}
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-			
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::READ64;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			//MemtoReg
-			MemtoReg = true;
-			
-			return 0;
-			
-		case 0xB9400000:
-			//LDR C6.2.119 Immediate (Unsigned offset))
-			//32 Bits
-
-			n = (IR & 0x000003E0) >> 5; // Rn
-			
-			imm12 = ( IR & 0x003FFC00) >> 10;
-			
-			if (n == 31) {
-				A = SP;
-			} else {
-				A = getX(n); // 64-bit variant
-			}
+/**
+ * LDRSW C6.2.131 Immediate (Unsigned offset)
+ */
+int BasicCPU::decodeLdrswImm(DecodedInstruction *dec) {
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant
+	
+	dec->imm = ((IR & 0x003FFC00) >> 10) << 2; //pimm que é múltiplo de 4
+	
+	// Registrador destino (t = 31 é ZR)
+	dec->d = zrDest(IR & 0x0000001F);
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//MEMctrl: lê 32 bits com extensão de sinal para Xt
+	dec->MEMctrl = MEMctrlFlag::READ32;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = true;
+	
+	return 0;
+}
 
-			B = imm12 << 2; //pimm que é múltiplo de 4
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);	
+/**
+ * LDR C6.2.119 Immediate (Unsigned offset), 32 bits
+ */
+int BasicCPU::decodeLdrImm(DecodedInstruction *dec) {
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant
+	
+	dec->imm = ((IR & 0x003FFC00) >> 10) << 2; //pimm que é múltiplo de 4
+	
+	// Registrador destino (t = 31 é WZR), escrito como Wt
+	dec->d = zrDest(IR & 0x0000001F);
+	dec->dMask = REG_MASK_32;
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::READ32;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = true;
+	
+	return 0;
+}
+
+/**
+ * STR C6.2.257 Unsigned offset, 32 bits
+ */
+int BasicCPU::decodeStrImm(DecodedInstruction *dec) {
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant (n = 31 é SP)
+	
+	dec->imm = ((IR & 0x003FFC00) >> 10) << 2; //pimm que é múltiplo de 4
+	
+	// Registrador fonte do dado (t = 31 é WZR)
+	dec->d = zrSource(IR & 0x0000001F);
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::WRITE32;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::WB_NONE;
+	
+	//MemtoReg
+	dec->MemtoReg = false;
+	
+	return 0;
+}
+
+/**
+ * LDR (Register) C6.2.121 891, 32 bits
+ *
+ * A codificação só inclui size 10, option 011 e S 1 (LSL #2).
+ */
+int BasicCPU::decodeLdrReg(DecodedInstruction *dec) {
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant
+
+	dec->m = zrSource((IR & 0x001F0000) >> 16); // Xm (m = 31 é XZR)
+	dec->shift = 0; // LSL
+	dec->amount = 2;
+	
+	// Registrador destino (t = 31 é WZR), escrito como Wt
+	dec->d = zrDest(IR & 0x0000001F);
+	dec->dMask = REG_MASK_32;
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::READ32;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = true;
+	
+	return 0;
+}
+
+/**
+ * LDP e STP (load/store register pair), 32 e 64 bits: post-index,
+ * pre-index e signed offset. LDNP e STNP (sem a dica de não alocar na
+ * cache, que não se aplica aqui) são decodificados como o signed offset.
+ *
+ * O par é lido ou escrito por MEM em uma única transação. EXI calcula o
+ * endereço em ALUout (Rn no post-index) e WB escreve Rn = ALUout +
+ * wbOffset (o offset no post-index, 0 no pre-index).
+ */
+int BasicCPU::decodeLdpStp(DecodedInstruction *dec) {
+	bool sf = IR & 0x80000000; // 1: 64 bits
+	bool L = IR & 0x00400000;  // 1: LDP
+	int mode = (IR & 0x01800000) >> 23; // 0: NP, 1: post-index, 2: offset, 3: pre-index
+	
+	// imm7 (bits 21-15) com extensão de sinal, multiplicado pelo tamanho
+	// de cada registrador
+	int64_t offset = (int64_t)(((int32_t)(IR << 10)) >> 25) << (sf ? 3 : 2);
+	
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant (n = 31 é SP)
+	if (mode == 1) {
+		dec->wbOffset = offset;
+	} else {
+		dec->imm = offset;
+	}
+	if (mode & 1) {
+		dec->base = dec->n;
+	}
+	
+	// Rt e Rt2: destinos em LDP e fontes em STP (31 é ZR)
+	if (L) {
+		dec->d = zrDest(IR & 0x0000001F);
+		dec->d2 = zrDest((IR & 0x00007C00) >> 10);
+	} else {
+		dec->d = zrSource(IR & 0x0000001F);
+		dec->d2 = zrSource((IR & 0x00007C00) >> 10);
+	}
+	if (!sf) {
+		dec->dMask = REG_MASK_32;
+	}
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//MEMctrl
+	if (L) {
+		dec->MEMctrl = sf ? MEMctrlFlag::READPAIR64 : MEMctrlFlag::READPAIR32;
+	} else {
+		dec->MEMctrl = sf ? MEMctrlFlag::WRITEPAIR64 : MEMctrlFlag::WRITEPAIR32;
+	}
+	
+	//WBctrl: Rt e Rt2 (LDP) e write-back de Rn
+	dec->WBctrl = WBctrlFlag::BaseWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = L;
+	
+	return 0;
+}
+
+/**
+ * LDRB, LDRH, LDRSB, LDRSH, STRB e STRH (bytes e halfwords), nas formas
+ * unsigned offset, register offset e imm9 (unscaled, como LDURB, post-index
+ * e pre-index). LDTRB e afins (unprivileged) são decodificados como a
+ * forma unscaled.
+ *
+ * MEM lê o dado com extensão de sinal (ver Memory::readData8); LDRB e LDRH
+ * estendem com zeros pela máscara de escrita de Rt, e LDRSB e LDRSH de 32
+ * bits descartam a parte alta pela máscara de Wt. Pre-index e post-index
+ * escrevem Rn em WB, como em decodeLdpStp.
+ */
+int BasicCPU::decodeLoadStoreSubword(DecodedInstruction *dec) {
+	int size = (IR & 0x40000000) >> 30; // 0: byte, 1: halfword
+	int opc = (IR & 0x00C00000) >> 22;  // 0: STR, 1: LDR, 2: LDRS (Xt), 3: LDRS (Wt)
+	
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant (n = 31 é SP)
+	
+	if (IR & 0x01000000) {
+		// unsigned offset: imm12 multiplicado pelo tamanho do dado
+		dec->imm = ((IR & 0x003FFC00) >> 10) << size;
+	} else if (IR & 0x00200000) {
+		// register offset: Xm (LSL, SXTX) ou Wm (UXTW, SXTW), deslocado
+		// pelo tamanho do dado se S = 1
+		int option = (IR & 0x0000E000) >> 13;
+		dec->m = zrSource((IR & 0x001F0000) >> 16);
+		dec->amount = (IR & 0x00001000) ? size : 0;
+		switch (option) {
+			case 2: // UXTW
+				dec->mMask = REG_MASK_32;
+				break;
+			case 3: // LSL
+			case 7: // SXTX
+				break;
+			case 6: // SXTW
+				dec->mMask = REG_MASK_32;
+				dec->shift = 3;
+				break;
+			default:
+				return 1; // não alocado
+		}
+	} else {
+		// imm9 com extensão de sinal (bits 20-12)
+		int64_t offset = ((int32_t)(IR << 11)) >> 23;
+		int mode = (IR & 0x00000C00) >> 10; // 0: unscaled, 1: post-index, 2: unprivileged, 3: pre-index
+		if (mode == 1) {
+			dec->wbOffset = offset;
+		} else {
+			dec->imm = offset;
+		}
+		if (mode & 1) {
+			dec->base = dec->n;
+		}
+	}
+	
+	//MEMctrl, registrador do dado (t = 31 é WZR) e máscara de escrita
+	if (opc == 0) {
+		dec->d = zrSource(IR & 0x0000001F);
+		dec->MEMctrl = size ? MEMctrlFlag::WRITE16 : MEMctrlFlag::WRITE8;
+	} else {
+		dec->d = zrDest(IR & 0x0000001F);
+		dec->MEMctrl = size ? MEMctrlFlag::READ16 : MEMctrlFlag::READ8;
+		if (opc == 1) {
+			dec->dMask = size ? REG_MASK_16 : REG_MASK_8;
+		} else if (opc == 3) {
+			dec->dMask = REG_MASK_32;
+		}
+	}
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	
+	//WBctrl: Rt (loads) e, com write-back, Rn
+	if (dec->base != REG_DISCARD) {
+		dec->WBctrl = WBctrlFlag::BaseWrite;
+	} else {
+		dec->WBctrl = opc ? WBctrlFlag::RegWrite : WBctrlFlag::WB_NONE;
+	}
+	
+	//MemtoReg
+	dec->MemtoReg = (opc != 0);
+	
+	return 0;
+}
+
+/**
+ * LD1 e ST1 (multiple structures), de 1 a 4 registradores consecutivos
+ * (módulo 32), sem offset e post-index (imediato, igual ao número de bytes
+ * transferidos, ou Xm). LD2, LD3, LD4 e afins (intercalados) não estão
+ * implementados.
+ *
+ * Com o hospedeiro little endian o arranjo só importa pelo tamanho de cada
+ * registrador (8 ou 16 bytes): MEM transfere os Vcount registradores em um
+ * único bloco.
+ */
+int BasicCPU::decodeLdSt1Multiple(DecodedInstruction *dec) {
+	bool Q = IR & 0x40000000;  // 1: 128 bits
+	bool L = IR & 0x00400000;  // 1: LD1
+	int opcode = (IR & 0x0000F000) >> 12;
+	
+	decodeVectorDefaults(dec);
+	
+	switch (opcode) {
+		case 0x7: dec->vcount = 1; break;
+		case 0xA: dec->vcount = 2; break;
+		case 0x6: dec->vcount = 3; break;
+		case 0x2: dec->vcount = 4; break;
+		default:
+			return 1; // LD2, LD3, LD4, ST2, ST3, ST4
+	}
+	dec->vd = IR & 0x0000001F; // Vt
+	dec->vbytes = Q ? 16 : 8;
+	dec->vesize = (IR & 0x00000C00) >> 10;
+	
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant (n = 31 é SP)
+	if (IR & 0x00800000) {
+		// post-index: Rm = 31 é o imediato
+		int m = (IR & 0x001F0000) >> 16;
+		dec->base = dec->n;
+		if (m == 31) {
+			dec->wbOffset = dec->vcount * dec->vbytes;
+		} else {
+			dec->wbIndex = m;
+		}
+	}
+	
+	//ALUctrl: endereço calculado por EXI
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	dec->fpOP = false;
+	
+	//MEMctrl
+	dec->MEMctrl = L ? MEMctrlFlag::READV : MEMctrlFlag::WRITEV;
+	
+	//MemtoReg
+	dec->MemtoReg = L;
+	
+	return 0;
+}
+
+/**
+ * LDR e STR (immediate, SIMD&FP) de Bt, Ht, St, Dt e Qt: unsigned offset
+ * e imm9 (LDUR e STUR, post-index e pre-index), como em
+ * decodeLoadStoreSubword. A leitura zera o restante de Vt.
+ */
+int BasicCPU::decodeLdStSimdImm(DecodedInstruction *dec) {
+	int size = (IR & 0xC0000000) >> 30;
+	int opc = (IR & 0x00C00000) >> 22; // bit 0: LDR; bit 1: Qt (size = 0)
+	
+	// log2 do tamanho do dado: 0 (Bt) a 4 (Qt)
+	int scale = (opc & 2) ? 4 : size;
+	if ((opc & 2) && size) {
+		return 1; // não alocado
+	}
+	
+	decodeVectorDefaults(dec);
+	dec->vd = IR & 0x0000001F; // Vt
+	dec->vbytes = 1 << scale;
+	dec->vesize = (scale < 3) ? scale : 3;
+	
+	dec->n = (IR & 0x000003E0) >> 5; // Rn, 64-bit variant (n = 31 é SP)
+	if (IR & 0x01000000) {
+		// unsigned offset: imm12 multiplicado pelo tamanho do dado
+		dec->imm = (int64_t)((IR & 0x003FFC00) >> 10) << scale;
+	} else {
+		// imm9 com extensão de sinal (bits 20-12)
+		int64_t offset = ((int32_t)(IR << 11)) >> 23;
+		int mode = (IR & 0x00000C00) >> 10; // 0: unscaled, 1: post-index, 3: pre-index
+		if (mode == 2) {
+			return 1; // não alocado
+		}
+		if (mode == 1) {
+			dec->wbOffset = offset;
+		} else {
+			dec->imm = offset;
+		}
+		if (mode & 1) {
+			dec->base = dec->n;
+		}
+	}
+	
+	//ALUctrl: endereço calculado por EXI
+	dec->ALUctrl = ALUctrlFlag::ADD;
+	dec->fpOP = false;
+	
+	//MEMctrl
+	dec->MEMctrl = (opc & 1) ? MEMctrlFlag::READV : MEMctrlFlag::WRITEV;
+	
+	//MemtoReg
+	dec->MemtoReg = opc & 1;
+	
+	return 0;
+}
+
+/**
+ * ADD, ADDS, SUB e SUBS (shifted register), 32 e 64 bits. CMP e CMN
+ * (shifted register) são SUBS e ADDS com Rd = ZR.
+ */
+int BasicCPU::decodeAddSubShiftedReg(DecodedInstruction *dec) {
+	bool sf = IR & 0x80000000; // 1: 64 bits
+	bool op = IR & 0x40000000; // 1: SUB
+	bool S = IR & 0x20000000;  // 1: atualiza as flags
+	
+	//Shift tem três operações possíveis: LSL, LSR e ASR
+	dec->shift = (IR & 0x00C00000) >> 22;
+	if (dec->shift == 3) return 1; // reservado
+	
+	dec->amount = (IR & 0x0000FC00) >> 10; // imm6
+	if (!sf && (dec->amount & 0x20)) return 1; // reservado
+	
+	// leitura de A e B (n = 31 e m = 31 são ZR)
+	dec->n = zrSource((IR & 0x000003E0) >> 5); //Rn
+	dec->m = zrSource((IR & 0x001F0000) >> 16); //Rm
+	
+	// Registrador destino (d = 31 é ZR)
+	dec->d = zrDest(IR & 0x0000001F);
+	
+	if (!sf) {
+		dec->nMask = REG_MASK_32;
+		dec->mMask = REG_MASK_32;
+		dec->dMask = REG_MASK_32;
+	}
+	
+	//ALUctrl
+	if (op) {
+		dec->ALUctrl = S ? ALUctrlFlag::SUBS : ALUctrlFlag::SUB;
+	} else {
+		dec->ALUctrl = S ? ALUctrlFlag::ADDS : ALUctrlFlag::ADD;
+	}
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = false;
+
+	return 0;
+}
+
+/**
+ * CSEL, 32 e 64 bits: Rd = cond ? Rn : Rm.
+ */
+int BasicCPU::decodeCsel(DecodedInstruction *dec) {
+	// leitura de A e B (n = 31 e m = 31 são ZR)
+	dec->n = zrSource((IR & 0x000003E0) >> 5); //Rn
+	dec->m = zrSource((IR & 0x001F0000) >> 16); //Rm
+	
+	dec->cond = (IR & 0x0000F000) >> 12;
+	
+	// Registrador destino (d = 31 é ZR)
+	dec->d = zrDest(IR & 0x0000001F);
+	
+	if (!(IR & 0x80000000)) {
+		dec->nMask = REG_MASK_32;
+		dec->mMask = REG_MASK_32;
+		dec->dMask = REG_MASK_32;
+	}
+	
+	//ALUctrl
+	dec->ALUctrl = ALUctrlFlag::CSEL;
+	
+	//MEMctrl
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	
+	//WBctrl
+	dec->WBctrl = WBctrlFlag::RegWrite;
+	
+	//MemtoReg
+	dec->MemtoReg = false;
+
+	return 0;
+}
+
+/**
+ * Valores padrão dos campos vetoriais: Vd = Rd, Vn = Rn e Vm = Rm, um
+ * registrador de 128 bits, sem acesso à memória e com WB escrevendo
+ * ALUoutF em Vd. Os decodificadores alteram o que for diferente.
+ */
+void BasicCPU::decodeVectorDefaults(DecodedInstruction *dec) {
+	dec->vd = IR & 0x0000001F;
+	dec->vn = (IR & 0x000003E0) >> 5;
+	dec->vm = (IR & 0x001F0000) >> 16;
+	dec->vesize = 0;
+	dec->vbytes = 16;
+	dec->vcount = 1;
+	dec->wbIndex = REG_ZR;
+	
+	dec->MEMctrl = MEMctrlFlag::MEM_NONE;
+	dec->WBctrl = WBctrlFlag::VecWrite;
+	dec->MemtoReg = false;
+	dec->fpOP = true;
+	dec->vecOP = true;
+}
+
+/**
+ * ADD, SUB, MUL, AND, ORR e EOR (vector) e FADD, FSUB, FMUL e FDIV
+ * (vector), do grupo Advanced SIMD three same. Arranjos de 64 bits (Q = 0)
+ * zeram a parte alta de Vd.
+ */
+int BasicCPU::decodeSimdThreeSame(DecodedInstruction *dec) {
+	bool Q = IR & 0x40000000;  // 1: 128 bits
+	bool U = IR & 0x20000000;
+	int size = (IR & 0x00C00000) >> 22;
+	int opcode = (IR & 0x0000F800) >> 11;
+	
+	decodeVectorDefaults(dec);
+	dec->vbytes = Q ? 16 : 8;
+	dec->vesize = size;
+	
+	switch (opcode) {
+		case 0x10: // ADD, SUB
+			if ((size == 3) && !Q) {
+				return 1; // reservado
 			}
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-			
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::READ32;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			//MemtoReg
-			MemtoReg = true;
-			
+			dec->ALUctrl = U ? ALUctrlFlag::VSUB : ALUctrlFlag::VADD;
 			return 0;
-		
-		case 0xB9000000:
-			//STR C6.2.257 Unsigned offset // 
-						
-			//Variante 32 bits
-			
-			n = (IR & 0x000003E0) >> 5; // Rn
-			
-			if (n == 31) {
-				A = SP;
-			} else {
-				A = getW(n); // 32-bit variant
+		case 0x13: // MUL (U = 1 é PMUL)
+			if (U || (size == 3)) {
+				return 1;
 			}
-			
-			imm12 = ( IR & 0x003FFC00) >> 10;
-
-			B = imm12 << 2; //pimm que é múltiplo de 4
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);	
-			}
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-			
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::WRITE32;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::WB_NONE;
-			
-			//MemtoReg
-			MemtoReg = false;
-			
-			return 0;	
-	}
-	
-	switch (IR & 0xFFE0FC00) //Esse switch foi acresentado devido as características da instrução LDR (Register)
-	{
-		case 0xB8607800:
-			//LDR (Register) C6.2.121 891
-			//32 Bits
-
-			n = (IR & 0x000003E0) >> 5; // Rn
-			
-			if (n == 31) {
-				A = SP;
+			dec->ALUctrl = ALUctrlFlag::VMUL;
+			return 0;
+		case 0x03: // AND e ORR (U = 0), EOR (U = 1); BIC, ORN, BSL, BIT e BIF
+			if (!U && (size == 0)) {
+				dec->ALUctrl = ALUctrlFlag::VAND;
+			} else if (!U && (size == 2)) {
+				dec->ALUctrl = ALUctrlFlag::VORR;
+			} else if (U && (size == 0)) {
+				dec->ALUctrl = ALUctrlFlag::VEOR;
 			} else {
-				A = getX(n); // 64-bit variant
+				return 1;
 			}
+			return 0;
+		default:
+			break;
+	}
+	
+	// ponto flutuante: size<1> seleciona a operação e size<0> (sz) a
+	// precisão (0: simples, 1: dupla)
+	bool sub = size & 2;
+	dec->vesize = 2 + (size & 1);
+	if ((size & 1) && !Q) {
+		return 1; // reservado
+	}
+	if ((opcode == 0x1A) && !U) { // FADD, FSUB (U = 1 é FADDP, FABD)
+		dec->ALUctrl = sub ? ALUctrlFlag::VFSUB : ALUctrlFlag::VFADD;
+	} else if ((opcode == 0x1B) && U && !sub) { // FMUL (U = 0 é FMULX)
+		dec->ALUctrl = ALUctrlFlag::VFMUL;
+	} else if ((opcode == 0x1F) && U && !sub) { // FDIV (U = 0 é FRECPS)
+		dec->ALUctrl = ALUctrlFlag::VFDIV;
+	} else {
+		return 1; // não implementado
+	}
+	
+	return 0;
+}
 
-			n = (IR & 0x001F0000) >> 16;
-			
-			if (n == 31) {
-				B = SP << 2;
-			} else {
-				B = getX(n) << 2;// Vai entrar nesse case se for: size 10, option 011 e s 1
-			}
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);	
+/**
+ * ADDV: soma dos elementos de Vn (8B, 16B, 4H, 8H, 4S) no escalar Vd.
+ */
+int BasicCPU::decodeSimdAddv(DecodedInstruction *dec) {
+	bool Q = IR & 0x40000000;  // 1: 128 bits
+	int size = (IR & 0x00C00000) >> 22;
+	
+	if ((size == 3) || ((size == 2) && !Q)) {
+		return 1; // reservado
+	}
+	
+	decodeVectorDefaults(dec);
+	dec->vbytes = Q ? 16 : 8; // bytes somados; o resultado já vem zerado
+	dec->vesize = size;
+	dec->ALUctrl = ALUctrlFlag::VADDV;
+	
+	return 0;
+}
+
+/**
+ * MOVI (vector e Dd): bytes, halfwords e words deslocadas (LSL) e a máscara
+ * de bytes de 64 bits. O imediato é expandido para 64 bits na
+ * decodificação e replicado por EXF como DUP. MVNI, ORR, BIC, MSL e FMOV
+ * (vector, immediate) não estão implementados.
+ */
+int BasicCPU::decodeSimdModifiedImm(DecodedInstruction *dec) {
+	bool Q = IR & 0x40000000;  // 1: 128 bits
+	bool op = IR & 0x20000000;
+	int cmode = (IR & 0x0000F000) >> 12;
+	
+	// abc:defgh
+	uint64_t imm8 = ((IR & 0x00070000) >> 11) | ((IR & 0x000003E0) >> 5);
+	uint64_t imm;
+	
+	if (!op && (cmode == 0xE)) {
+		// 8 bits
+		imm = imm8 * 0x0101010101010101UL;
+	} else if (!op && ((cmode & 0x9) == 0)) {
+		// 32 bits, LSL #0, #8, #16 ou #24
+		imm = (imm8 << (8 * ((cmode & 0x6) >> 1))) * 0x0000000100000001UL;
+	} else if (!op && ((cmode & 0xD) == 0x8)) {
+		// 16 bits, LSL #0 ou #8
+		imm = (imm8 << (8 * ((cmode & 0x2) >> 1))) * 0x0001000100010001UL;
+	} else if (op && (cmode == 0xE)) {
+		// 64 bits: cada bit de abcdefgh é um byte 0x00 ou 0xFF
+		imm = 0;
+		for (int i = 0; i < 8; i++) {
+			if (imm8 & (1 << i)) {
+				imm |= 0xFFUL << (8 * i);
 			}
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::READ32;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			//MemtoReg
-			MemtoReg = true;
-			
-			return 0;
+		}
+	} else {
+		return 1; // não implementado
 	}
 	
-	return 1; // instrução não implementada
+	decodeVectorDefaults(dec);
+	dec->vbytes = Q ? 16 : 8;
+	dec->vesize = 3;
+	dec->imm = imm;
+	dec->ALUctrl = ALUctrlFlag::VDUP;
+	
+	return 0;
 }
 
 /**
- * Decodifica instruções do grupo
- * 		x101 Data Processing -- Register on page C4-278
+ * DUP (general): Rn replicado nos elementos de Vd. UMOV: elemento de Vn
+ * em Wd (bytes, halfwords e words) ou Xd (doublewords), com extensão de
+ * zeros.
  *
- * Retorna 0: se executou corretamente e
- *		   1: se a instrução não estiver implementada.
+ * O tamanho do elemento é o bit 1 menos significativo de imm5, e o índice
+ * do elemento (UMOV) são os bits acima dele.
  */
-int BasicCPU::decodeDataProcReg() {
-	int n, m, d, shift, imm6;
+int BasicCPU::decodeSimdCopy(DecodedInstruction *dec) {
+	bool Q = IR & 0x40000000;  // 1: 128 bits (UMOV: Xd)
+	uint32_t imm5 = (IR & 0x001F0000) >> 16;
 	
-	switch (IR & 0xFF200000)
-	{
-		case 0x0B000000:
-			//ADD (shifted register)
-			
-			if (IR & 0x80000000) return 1; // sh = 1 para 64 bits não implementado 
-		
-			// leitura de A e B
-			n = (IR & 0x000003E0) >> 5; //Rn
-			if (n == 31) {
-				A = SP;
-			} else {
-				A = getW(n); // Variante 32-bit 
-			}
-			
-			m = (IR & 0x001F0000) >> 16; //Rm
-			
-			B = getW(m); 
-			
-			shift = (IR & 0x00C00000) >> 22;
-			
-			imm6 = (IR & 0x0000FC00) >> 10;
-			
-			//Shift tem três operações possíveis
-			
-			switch(shift){ 
-				case 0: //LSL – Logical Shift Left
-					B = B << imm6;
-				case 1: //LSR – Logical Shift Right
-					B = ((unsigned long) B) >> imm6;
-				case 2: //ASL – Arithmetic Shift Left
-					B = ((signed long) B) >> imm6;
-				default:
-					break;
-			}
-			
-			// Registrador destino
-			d = (IR & 0x0000001F);
-			if (d == 31) {
-				Rd = &SP;
-			} else {
-				Rd = &(R[d]);
-			}
-			
-			//ALUctrl
-			ALUctrl = ALUctrlFlag::ADD;
-			
-			//TP03 
-			
-			//MEMctrl
-			MEMctrl = MEMctrlFlag::MEM_NONE;
-			
-			//WBctrl
-			WBctrl = WBctrlFlag::RegWrite;
-			
-			//MemtoReg
-			MemtoReg = false;
+	if ((imm5 & 0xF) == 0) {
+		return 1; // reservado
+	}
+	int size = __builtin_ctz(imm5);
+	
+	decodeVectorDefaults(dec);
+	dec->vesize = size;
+	
+	if (IR & 0x00002000) {
+		// UMOV: Q = 1 se e somente se o elemento tem 64 bits
+		if (Q != (size == 3)) {
+			return 1;
+		}
+		dec->imm = imm5 >> (size + 1);
+		dec->d = zrDest(IR & 0x0000001F);
+		if (!Q) {
+			dec->dMask = REG_MASK_32;
+		}
+		dec->ALUctrl = ALUctrlFlag::VUMOV;
+		dec->WBctrl = WBctrlFlag::RegWrite;
+	} else {
+		// DUP: Rn (31 é ZR) lido em B
+		if ((size == 3) && !Q) {
+			return 1; // reservado
+		}
+		dec->m = zrSource((IR & 0x000003E0) >> 5);
+		dec->vbytes = Q ? 16 : 8;
+		dec->ALUctrl = ALUctrlFlag::VDUP;
+	}
+	
+	return 0;
+}
 
-			return 0;
+/**
+ * FMUL, FDIV, FADD e FSUB (scalar), em precisão simples (Sd) e dupla (Dd).
+ * A operação é a vetorial, restrita ao elemento 0 pela escrita de Vbytes
+ * bytes em Vd.
+ */
+int BasicCPU::decodeFloatTwoSource(DecodedInstruction *dec) {
+	int ftype = (IR & 0x00C00000) >> 22; // 0: simples, 1: dupla
+	int opcode = (IR & 0x0000F000) >> 12;
+	
+	if (ftype > 1) {
+		return 1; // meia precisão e reservado
+	}
+	
+	decodeVectorDefaults(dec);
+	dec->vesize = 2 + ftype;
+	dec->vbytes = 4 << ftype;
+	
+	switch (opcode) {
+		case 0: dec->ALUctrl = ALUctrlFlag::VFMUL; break;
+		case 1: dec->ALUctrl = ALUctrlFlag::VFDIV; break;
+		case 2: dec->ALUctrl = ALUctrlFlag::VFADD; break;
+		case 3: dec->ALUctrl = ALUctrlFlag::VFSUB; break;
 		default:
-			// instrução não implementada
-			return 1;
+			return 1; // FMAX, FMIN, FNMUL e afins
 	}
-	return 1;
+	
+	return 0;
 }
 
 /**
- * ATIVIDADE FUTURA: Decodifica instruções do grupo
- * 		x111 Data Processing -- Scalar Floating-Point and Advanced SIMD
- * 				on page C4-288
- *
- * Retorna 0: se executou corretamente e
- *		   1: se a instrução não estiver implementada.
+ * FMOV (general) entre Wn e Sd e entre Xn e Dd, nos dois sentidos: de Vn
+ * para Rd como UMOV do elemento 0; de Rn para Vd como DUP em um único
+ * elemento.
  */
-int BasicCPU::decodeDataProcFloat() {
-	// instrução não implementada
-	return 1;
+int BasicCPU::decodeFmovGeneral(DecodedInstruction *dec) {
+	int sf = (IR & 0x80000000) >> 31;  // 1: 64 bits
+	int ftype = (IR & 0x00C00000) >> 22;
+	
+	if (ftype != sf) {
+		return 1; // FMOV Hd e FMOV Vd.D[1] não implementados
+	}
+	
+	decodeVectorDefaults(dec);
+	dec->vesize = 2 + sf;
+	
+	if (IR & 0x00010000) {
+		// Rn (31 é ZR) para Vd
+		dec->m = zrSource((IR & 0x000003E0) >> 5);
+		if (!sf) {
+			dec->mMask = REG_MASK_32;
+		}
+		dec->vbytes = 4 << sf;
+		dec->ALUctrl = ALUctrlFlag::VDUP;
+	} else {
+		// Vn para Rd (31 é ZR)
+		dec->d = zrDest(IR & 0x0000001F);
+		if (!sf) {
+			dec->dMask = REG_MASK_32;
+		}
+		dec->ALUctrl = ALUctrlFlag::VUMOV;
+		dec->WBctrl = WBctrlFlag::RegWrite;
+	}
+	
+	return 0;
 }
 
 
@@ -534,11 +1123,30 @@ int BasicCPU::EXI()
 	{
 		case ALUctrlFlag::SUB:
 			ALUout = A - B;
-			// ATIVIDADE FUTURA: setar flags NCZF
 			return 0;
 		case ALUctrlFlag::ADD:
 			ALUout = A + B;
 			return 0;
+		case ALUctrlFlag::SUBS:
+			// flags NZCV: apenas registra a operação (ver getNZCV())
+			ALUout = A - B;
+			flagsOp = (WBmask == REG_MASK_32) ? FlagsOp::FLAGS_SUB32 : FlagsOp::FLAGS_SUB64;
+			flagsA = A;
+			flagsB = B;
+			return 0;
+		case ALUctrlFlag::ADDS:
+			ALUout = A + B;
+			flagsOp = (WBmask == REG_MASK_32) ? FlagsOp::FLAGS_ADD32 : FlagsOp::FLAGS_ADD64;
+			flagsA = A;
+			flagsB = B;
+			return 0;
+		case ALUctrlFlag::BCOND:
+			// destino do desvio (A = PC) ou próxima instrução
+			ALUout = conditionHolds(cond) ? A + B : A + 4;
+			return 0;
+		case ALUctrlFlag::CSEL:
+			ALUout = conditionHolds(cond) ? A : B;
+			return 0;
 		default:
 			// Controle não implementado
 			return 1;
@@ -556,13 +1164,66 @@ int BasicCPU::EXI()
  * nos valores dos registradores auxiliares AF, BF e ALUctrl, e coloca o
  * resultado no registrador auxiliar ALUoutF.
  *
+ * As operações AdvSIMD e de ponto flutuante estão em AdvSIMD.h, sobre o
+ * SSE do hospedeiro. UMOV e FMOV para Rd escrevem ALUout, e não ALUoutF.
+ *
  * Retorna 0: se executou corretamente e
  *		   1: se o controle presente em ALUctrl não estiver implementado.
  */
 int BasicCPU::EXF()
 {
-	// não implementado
-	return 1;
+	switch (ALUctrl)
+	{
+		case ALUctrlFlag::VADD:
+			ALUoutF = simdAdd(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VSUB:
+			ALUoutF = simdSub(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VMUL:
+			ALUoutF = simdMul(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VAND:
+			ALUoutF = simdAnd(AF, BF);
+			return 0;
+		case ALUctrlFlag::VORR:
+			ALUoutF = simdOrr(AF, BF);
+			return 0;
+		case ALUctrlFlag::VEOR:
+			ALUoutF = simdEor(AF, BF);
+			return 0;
+		case ALUctrlFlag::VADDV:
+			ALUoutF = simdAddv(AF, Vesize, Vbytes);
+			return 0;
+		case ALUctrlFlag::VFADD:
+			ALUoutF = simdFadd(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VFSUB:
+			ALUoutF = simdFsub(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VFMUL:
+			ALUoutF = simdFmul(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VFDIV:
+			ALUoutF = simdFdiv(AF, BF, Vesize);
+			return 0;
+		case ALUctrlFlag::VDUP:
+			// B: Rn (DUP, FMOV) ou imediato expandido (MOVI)
+			ALUoutF = simdDup(B, Vesize);
+			return 0;
+		case ALUctrlFlag::VUMOV:
+			// elemento B de Vn, para Rd
+			switch (Vesize) {
+				case 0: ALUout = AF.b[B]; break;
+				case 1: ALUout = AF.h[B]; break;
+				case 2: ALUout = AF.s[B]; break;
+				default: ALUout = AF.d[B]; break;
+			}
+			return 0;
+		default:
+			// Controle não implementado
+			return 1;
+	}
 }
 
 /**
@@ -574,25 +1235,7 @@ int BasicCPU::EXF()
  */
 int BasicCPU::MEM()
 {
-    switch (MEMctrl) {
-    case MEMctrlFlag::READ32:
-        MDR = memory->readData32(ALUout);
-        return 0;
-    case MEMctrlFlag::WRITE32:
-        memory->writeData32(ALUout,*Rd);
-        return 0;
-    case MEMctrlFlag::READ64:
-        MDR = memory->readData64(ALUout);
-        return 0;
-    case MEMctrlFlag::WRITE64:
-        memory->writeData64(ALUout,*Rd);
-        return 0;
-    default:
-        return 0;
-}
-    // não implementado
-
-	return 1;
+	return MEM<Memory>();
 }
 
 
@@ -605,26 +1248,162 @@ int BasicCPU::MEM()
  */
 int BasicCPU::WB()
 {
-	// TODO
-	// Implementar o switch (WBctrl) case WBctrlFlag::XXX com as
-	// atribuições corretas do registrador destino, quando houver, ou
-	// return 0 no caso WBctrlFlag::WB_NONE.
-	
     switch (WBctrl) {
         case WBctrlFlag::WB_NONE:
             return 0;
         case WBctrlFlag::RegWrite:
             if (MemtoReg) {
-                *Rd = MDR;
+                *Rd = MDR & WBmask;
             } else {
-                *Rd = ALUout;
+                *Rd = ALUout & WBmask;
+            }
+            return 0;
+        case WBctrlFlag::BaseWrite:
+            if (MemtoReg) {
+                *Rd = MDR & WBmask;
+                *Rd2 = MDR2 & WBmask;
             }
+            *Rbase = ALUout + WBoffset;
+            return 0;
+        case WBctrlFlag::VecWrite:
+            if (MemtoReg) {
+                for (int i = 0; i < Vcount; i++) {
+                    writeVector(&V[(Vd - V + i) % VREG_COUNT], &MDRV[i * Vbytes], Vbytes);
+                }
+            } else if (MEMctrl == MEMctrlFlag::MEM_NONE) {
+                writeVector(Vd, &ALUoutF, Vbytes);
+            }
+            *Rbase = ALUout + WBoffset;
             return 0;
         default:
             // não implementado
             return 1;
     }
-	return 1;
+}
+
+
+/**
+ * Escrita em registrador vetorial: os bytes além de bytes são zerados,
+ * como nas escritas escalares e de 64 bits do AdvSIMD.
+ */
+void BasicCPU::writeVector(V128 *Vn, const void *value, int bytes) {
+	V128 result = {};
+	memcpy(&result, value, bytes);
+	*Vn = result;
+}
+
+
+/**
+ * Métodos das flags NZCV
+ */
+
+/**
+ * Calcula, se necessário, e retorna as flags NZCV a partir da última
+ * operação registrada por ADDS/SUBS.
+ */
+uint32_t BasicCPU::getNZCV() {
+	uint64_t result;
+	uint64_t sign;
+	bool carry;
+	bool overflow;
+	
+	switch (flagsOp) {
+		case FlagsOp::FLAGS_VALID:
+			return NZCV;
+		case FlagsOp::FLAGS_ADD32:
+			flagsA &= REG_MASK_32;
+			flagsB &= REG_MASK_32;
+			result = (flagsA + flagsB) & REG_MASK_32;
+			sign = 0x80000000;
+			carry = result < flagsA;
+			overflow = (~(flagsA ^ flagsB) & (flagsA ^ result)) & sign;
+			break;
+		case FlagsOp::FLAGS_ADD64:
+			result = flagsA + flagsB;
+			sign = 0x8000000000000000UL;
+			carry = result < flagsA;
+			overflow = (~(flagsA ^ flagsB) & (flagsA ^ result)) & sign;
+			break;
+		case FlagsOp::FLAGS_SUB32:
+			flagsA &= REG_MASK_32;
+			flagsB &= REG_MASK_32;
+			result = (flagsA - flagsB) & REG_MASK_32;
+			sign = 0x80000000;
+			carry = flagsA >= flagsB; // C = 1: sem empréstimo
+			overflow = ((flagsA ^ flagsB) & (flagsA ^ result)) & sign;
+			break;
+		default: // FLAGS_SUB64
+			result = flagsA - flagsB;
+			sign = 0x8000000000000000UL;
+			carry = flagsA >= flagsB;
+			overflow = ((flagsA ^ flagsB) & (flagsA ^ result)) & sign;
+			break;
+	}
+	
+	NZCV = ((result & sign) ? FLAG_N : 0) | ((result == 0) ? FLAG_Z : 0)
+			| (carry ? FLAG_C : 0) | (overflow ? FLAG_V : 0);
+	flagsOp = FlagsOp::FLAGS_VALID;
+	return NZCV;
+}
+
+/**
+ * Avalia a condição cond (C1.2.4) sobre as flags NZCV.
+ *
+ * Após SUBS (CMP), as condições de comparação são avaliadas diretamente
+ * sobre os operandos registrados; as demais calculam as flags.
+ */
+bool BasicCPU::conditionHolds(int cond) {
+	if ((flagsOp == FlagsOp::FLAGS_SUB32) || (flagsOp == FlagsOp::FLAGS_SUB64)) {
+		uint64_t a = flagsA;
+		uint64_t b = flagsB;
+		int64_t sa;
+		int64_t sb;
+		if (flagsOp == FlagsOp::FLAGS_SUB32) {
+			a &= REG_MASK_32;
+			b &= REG_MASK_32;
+			sa = (int32_t)a;
+			sb = (int32_t)b;
+		} else {
+			sa = (int64_t)a;
+			sb = (int64_t)b;
+		}
+		switch (cond) {
+			case 0x0: return a == b;		// EQ
+			case 0x1: return a != b;		// NE
+			case 0x2: return a >= b;		// CS/HS
+			case 0x3: return a < b;			// CC/LO
+			case 0x8: return a > b;			// HI
+			case 0x9: return a <= b;		// LS
+			case 0xA: return sa >= sb;		// GE
+			case 0xB: return sa < sb;		// LT
+			case 0xC: return sa > sb;		// GT
+			case 0xD: return sa <= sb;		// LE
+			case 0xE:
+			case 0xF: return true;			// AL
+			default: break;					// MI, PL, VS, VC
+		}
+	}
+	
+	uint32_t flags = getNZCV();
+	bool n = flags & FLAG_N;
+	bool z = flags & FLAG_Z;
+	bool c = flags & FLAG_C;
+	bool v = flags & FLAG_V;
+	bool result;
+	
+	switch (cond >> 1) {
+		case 0: result = z; break;				// EQ/NE
+		case 1: result = c; break;				// CS/CC
+		case 2: result = n; break;				// MI/PL
+		case 3: result = v; break;				// VS/VC
+		case 4: result = c && !z; break;		// HI/LS
+		case 5: result = (n == v); break;		// GE/LT
+		case 6: result = (n == v) && !z; break;	// GT/LE
+		default: return true;					// AL
+	}
+	
+	// condições ímpares são a negação das pares
+	return (cond & 1) ? !result : result;
 }
 
 
@@ -633,30 +1412,160 @@ int BasicCPU::WB()
  */
 
 /**
- * Lê registrador inteiro de 32 bits.
+ * Índice do campo de registrador field quando o registrador 31 é ZR: como
+ * fonte lê REG_ZR (sempre 0) e como destino escreve em REG_DISCARD.
+ */
+int BasicCPU::zrSource(uint32_t field) {
+	return (field == 31) ? (int)REG_ZR : (int)field;
+}
+
+int BasicCPU::zrDest(uint32_t field) {
+	return (field == 31) ? (int)REG_DISCARD : (int)field;
+}
+
+
+/**
+ * Métodos da cache de instruções decodificadas
+ */
+
+/**
+ * Bit que representa, em decodeCachePages, a página de texto do endereço
+ * address.
  */
-int BasicCPU::getW(int n) {
-	long wn = 0x00000000FFFFFFFF & R[n];
-	return ((int) wn);
+uint64_t BasicCPU::decodeCachePageBit(unsigned long address) {
+	return 1UL << ((address >> DECODE_CACHE_PAGE_BITS) & 63);
 }
 
 /**
- * Escreve registrador inteiro de 32 bits.
+ * Invalida as entradas da cache cujas instruções estejam nos size bytes
+ * escritos a partir de address. Como escritas em páginas de texto são
+ * raras, a página é testada primeiro e só então as entradas são verificadas.
  */
-void BasicCPU::setW(int n, int value) {
-	R[n] = (long)value;
+void BasicCPU::invalidateDecodeCache(unsigned long address, int size) {
+	if (!(decodeCachePages & (decodeCachePageBit(address)
+			| decodeCachePageBit(address + size - 1)))) {
+		return;
+	}
+	
+	for (unsigned long a = address & ~3UL; a < address + size; a += 4) {
+		DecodedInstruction *dec = &decodeCache[(a >> 2) & (DECODE_CACHE_SIZE - 1)];
+		if (dec->valid && (dec->PC == a)) {
+			dec->valid = false;
+			decodeCacheInvalidations++;
+		}
+	}
+}
+
+/**
+ * Esvazia a cache de instruções decodificadas.
+ */
+void BasicCPU::flushDecodeCache() {
+	for (int i = 0; i < DECODE_CACHE_SIZE; i++) {
+		decodeCache[i].valid = false;
+	}
+	decodeCachePages = 0;
+}
+
+unsigned long BasicCPU::getDecodeCacheHits() {
+	return decodeCacheHits;
+}
+
+unsigned long BasicCPU::getDecodeCacheMisses() {
+	return decodeCacheMisses;
+}
+
+unsigned long BasicCPU::getDecodeCacheInvalidations() {
+	return decodeCacheInvalidations;
+}
+
+void BasicCPU::setInstructionLimit(unsigned long limit) {
+	instructionLimit = limit;
+}
+
+unsigned long BasicCPU::getInstructionCount() {
+	return instructionCount;
+}
+
+void BasicCPU::setBranchMonitor(BranchMonitor *monitor) {
+	branchMonitor = monitor;
+}
+
+BranchMonitor *BasicCPU::getBranchMonitor() {
+	return branchMonitor;
+}
+
+void BasicCPU::setProfiler(PCProfiler *profiler) {
+	this->profiler = profiler;
+	profileCountdown = profiler ? profiler->nextInterval() : ULONG_MAX;
+}
+
+PCProfiler *BasicCPU::getProfiler() {
+	return profiler;
 }
 
 /**
- * Lê registrador inteiro de 64 bits.
+ * Os acessos a dados da instrução são dados por MEMctrl, que ainda é o da
+ * instrução retirada.
  */
-int BasicCPU::getX(int n) {
-	return R[n];
+void BasicCPU::profileSample(uint64_t pc) {
+	if (!profiler) {
+		profileCountdown = ULONG_MAX;
+		return;
+	}
+	profileRecord(pc, MEMctrl);
+	profileCountdown = profiler->nextInterval();
+}
+
+void BasicCPU::profileRecord(uint64_t pc, MEMctrlFlag ctrl) {
+	int loads = (ctrl == MEMctrlFlag::READ32) || (ctrl == MEMctrlFlag::READ64)
+			|| (ctrl == MEMctrlFlag::READ8) || (ctrl == MEMctrlFlag::READ16)
+			|| (ctrl == MEMctrlFlag::READPAIR32) || (ctrl == MEMctrlFlag::READPAIR64)
+			|| (ctrl == MEMctrlFlag::READV);
+	int stores = storeSize(ctrl) != 0;
+	profiler->record(pc, loads, stores);
 }
 
 /**
- * Escreve registrador inteiro de 32 bits.
+ * Executa até quantum instruções (0: sem limite de quantum) a partir do PC
+ * atual, usando o run() da implementação de CPU (ThreadedCPU e JitCPU
+ * também respeitam o limite de instruções). Ao fim do quantum,
+ * processFinished é desfeito, a não ser que o limite de instruções original
+ * tenha sido atingido.
  */
-void BasicCPU::setX(int n, long value) {
+int BasicCPU::runQuantum(unsigned long quantum) {
+	unsigned long limit = instructionLimit;
+	unsigned long quantumEnd = instructionCount + quantum;
+	
+	if (quantum && ((limit == 0) || (quantumEnd < limit))) {
+		instructionLimit = quantumEnd;
+	}
+	
+	int result = run(PC);
+	
+	if (processFinished && (instructionCount != limit)) {
+		processFinished = false;
+	}
+	instructionLimit = limit;
+	
+	return result;
+}
+
+bool BasicCPU::isFinished() {
+	return processFinished || (cpuError != CPUerrorCode::NONE);
+}
+
+CPU::CPUerrorCode BasicCPU::getError() {
+	return cpuError;
+}
+
+unsigned long BasicCPU::getDataAbortAddress() {
+	return dataAbortAddress;
+}
+
+void BasicCPU::setStackPointer(unsigned long address) {
+	SP = address;
+}
+
+void BasicCPU::setRegister(int n, long value) {
 	R[n] = value;
 }
@@ -0,0 +1,356 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) AdvSIMD - the 128-bit vector register type and the AdvSIMD
+    (NEON) integer and floating-point operations of BasicCPU, on host SSE.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) AdvSIMD - o tipo dos registradores vetoriais de 128 bits e as
+    operações inteiras e de ponto flutuante do AdvSIMD (NEON) da BasicCPU,
+    sobre o SSE do hospedeiro.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Registradores vetoriais V0-V31
+#define VREG_COUNT 32
+
+/**
+ * Registrador vetorial de 128 bits, visto como 16 bytes, 8 halfwords, 4
+ * words, 2 doublewords, 4 floats ou 2 doubles (o elemento 0 fica nos
+ * bytes menos significativos, como no ARMv8 little endian).
+ *
+ * Com SSE2 (sempre presente no x86-64) o registrador também é um
+ * registrador XMM, e cada operação abaixo é uma ou poucas instruções SSE;
+ * com SSE4.1 (-msse4.1) MUL de 32 bits usa pmulld, e com AVX2 (-mavx2) o
+ * compilador usa as formas VEX das mesmas instruções. Sem SSE2 (outros
+ * hospedeiros) as operações percorrem os elementos.
+ */
+union V128 {
+	uint8_t b[16];
+	uint16_t h[8];
+	uint32_t s[4];
+	uint64_t d[2];
+	float f[4];
+	double df[2];
+#if defined(__SSE2__)
+	__m128i i;
+	__m128 ps;
+	__m128d pd;
+#endif
+};
+
+/**
+ * Operações do AdvSIMD sobre registradores inteiros de 128 bits, com
+ * elementos de 1 << esize bytes (esize: 0 byte, 1 halfword, 2 word, 3
+ * doubleword). Arranjos de 64 bits (8B, 4H, 2S) operam sobre o registrador
+ * inteiro e a parte alta do resultado é descartada na escrita (ver
+ * BasicCPU::writeVector()).
+ */
+inline V128 simdAdd(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	switch (esize) {
+		case 0: r.i = _mm_add_epi8(a.i, b.i); break;
+		case 1: r.i = _mm_add_epi16(a.i, b.i); break;
+		case 2: r.i = _mm_add_epi32(a.i, b.i); break;
+		default: r.i = _mm_add_epi64(a.i, b.i); break;
+	}
+#else
+	switch (esize) {
+		case 0: for (int e = 0; e < 16; e++) r.b[e] = a.b[e] + b.b[e]; break;
+		case 1: for (int e = 0; e < 8; e++) r.h[e] = a.h[e] + b.h[e]; break;
+		case 2: for (int e = 0; e < 4; e++) r.s[e] = a.s[e] + b.s[e]; break;
+		default: for (int e = 0; e < 2; e++) r.d[e] = a.d[e] + b.d[e]; break;
+	}
+#endif
+	return r;
+}
+
+inline V128 simdSub(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	switch (esize) {
+		case 0: r.i = _mm_sub_epi8(a.i, b.i); break;
+		case 1: r.i = _mm_sub_epi16(a.i, b.i); break;
+		case 2: r.i = _mm_sub_epi32(a.i, b.i); break;
+		default: r.i = _mm_sub_epi64(a.i, b.i); break;
+	}
+#else
+	switch (esize) {
+		case 0: for (int e = 0; e < 16; e++) r.b[e] = a.b[e] - b.b[e]; break;
+		case 1: for (int e = 0; e < 8; e++) r.h[e] = a.h[e] - b.h[e]; break;
+		case 2: for (int e = 0; e < 4; e++) r.s[e] = a.s[e] - b.s[e]; break;
+		default: for (int e = 0; e < 2; e++) r.d[e] = a.d[e] - b.d[e]; break;
+	}
+#endif
+	return r;
+}
+
+/**
+ * MUL (vector): bytes, halfwords e words (o A64 não tem MUL de 64 bits).
+ */
+inline V128 simdMul(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	switch (esize) {
+		case 0: {
+			// o SSE não multiplica bytes: multiplica os bytes pares e os
+			// ímpares como halfwords e junta os bytes baixos dos produtos
+			__m128i even = _mm_mullo_epi16(a.i, b.i);
+			__m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a.i, 8), _mm_srli_epi16(b.i, 8));
+			r.i = _mm_or_si128(_mm_slli_epi16(odd, 8),
+					_mm_and_si128(even, _mm_set1_epi16(0xFF)));
+			break;
+		}
+		case 1:
+			r.i = _mm_mullo_epi16(a.i, b.i);
+			break;
+		default: {
+#if defined(__SSE4_1__)
+			r.i = _mm_mullo_epi32(a.i, b.i);
+#else
+			// SSE2: produtos de 64 bits das words pares e das ímpares
+			__m128i even = _mm_mul_epu32(a.i, b.i);
+			__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.i, 32), _mm_srli_epi64(b.i, 32));
+			r.i = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+					_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+			break;
+		}
+	}
+#else
+	switch (esize) {
+		case 0: for (int e = 0; e < 16; e++) r.b[e] = a.b[e] * b.b[e]; break;
+		case 1: for (int e = 0; e < 8; e++) r.h[e] = a.h[e] * b.h[e]; break;
+		default: for (int e = 0; e < 4; e++) r.s[e] = a.s[e] * b.s[e]; break;
+	}
+#endif
+	return r;
+}
+
+/**
+ * AND, ORR e EOR (vector): bit a bit, independentes do arranjo.
+ */
+inline V128 simdAnd(const V128 &a, const V128 &b)
+{
+	V128 r;
+#if defined(__SSE2__)
+	r.i = _mm_and_si128(a.i, b.i);
+#else
+	r.d[0] = a.d[0] & b.d[0];
+	r.d[1] = a.d[1] & b.d[1];
+#endif
+	return r;
+}
+
+inline V128 simdOrr(const V128 &a, const V128 &b)
+{
+	V128 r;
+#if defined(__SSE2__)
+	r.i = _mm_or_si128(a.i, b.i);
+#else
+	r.d[0] = a.d[0] | b.d[0];
+	r.d[1] = a.d[1] | b.d[1];
+#endif
+	return r;
+}
+
+inline V128 simdEor(const V128 &a, const V128 &b)
+{
+	V128 r;
+#if defined(__SSE2__)
+	r.i = _mm_xor_si128(a.i, b.i);
+#else
+	r.d[0] = a.d[0] ^ b.d[0];
+	r.d[1] = a.d[1] ^ b.d[1];
+#endif
+	return r;
+}
+
+/**
+ * ADDV: soma dos elementos dos bytes primeiros bytes de a (8 ou 16),
+ * módulo o tamanho do elemento, no elemento 0 de um registrador zerado.
+ */
+inline V128 simdAddv(const V128 &a, int esize, int bytes)
+{
+	V128 r;
+#if defined(__SSE2__)
+	__m128i v = (bytes == 8) ? _mm_move_epi64(a.i) : a.i;
+	__m128i sum;
+	switch (esize) {
+		case 0:
+			// psadbw: soma dos 8 bytes de cada metade
+			sum = _mm_sad_epu8(v, _mm_setzero_si128());
+			sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+			r.i = _mm_and_si128(sum, _mm_cvtsi32_si128(0xFF));
+			break;
+		case 1:
+			// pmaddwd com 1: soma das halfwords aos pares, em words
+			sum = _mm_madd_epi16(v, _mm_set1_epi16(1));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			r.i = _mm_and_si128(sum, _mm_cvtsi32_si128(0xFFFF));
+			break;
+		default:
+			sum = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			r.i = _mm_cvtsi32_si128(_mm_cvtsi128_si32(sum));
+			break;
+	}
+#else
+	uint32_t sum = 0;
+	switch (esize) {
+		case 0: for (int e = 0; e < bytes; e++) sum += a.b[e]; sum &= 0xFF; break;
+		case 1: for (int e = 0; e < bytes / 2; e++) sum += a.h[e]; sum &= 0xFFFF; break;
+		default: for (int e = 0; e < bytes / 4; e++) sum += a.s[e]; break;
+	}
+	r.d[0] = sum;
+	r.d[1] = 0;
+#endif
+	return r;
+}
+
+/**
+ * DUP (general): value replicado em todos os elementos.
+ */
+inline V128 simdDup(uint64_t value, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	switch (esize) {
+		case 0: r.i = _mm_set1_epi8((char)value); break;
+		case 1: r.i = _mm_set1_epi16((short)value); break;
+		case 2: r.i = _mm_set1_epi32((int)value); break;
+		default: r.i = _mm_set1_epi64x((long long)value); break;
+	}
+#else
+	switch (esize) {
+		case 0: for (int e = 0; e < 16; e++) r.b[e] = value; break;
+		case 1: for (int e = 0; e < 8; e++) r.h[e] = value; break;
+		case 2: for (int e = 0; e < 4; e++) r.s[e] = value; break;
+		default: for (int e = 0; e < 2; e++) r.d[e] = value; break;
+	}
+#endif
+	return r;
+}
+
+/**
+ * FADD, FSUB, FMUL e FDIV (vector e escalares), em precisão simples
+ * (esize 2) ou dupla (esize 3), com o arredondamento padrão do hospedeiro
+ * (ao mais próximo, como o FPCR padrão do ARMv8).
+ */
+inline V128 simdFadd(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	if (esize == 2) {
+		r.ps = _mm_add_ps(a.ps, b.ps);
+	} else {
+		r.pd = _mm_add_pd(a.pd, b.pd);
+	}
+#else
+	if (esize == 2) {
+		for (int e = 0; e < 4; e++) r.f[e] = a.f[e] + b.f[e];
+	} else {
+		for (int e = 0; e < 2; e++) r.df[e] = a.df[e] + b.df[e];
+	}
+#endif
+	return r;
+}
+
+inline V128 simdFsub(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	if (esize == 2) {
+		r.ps = _mm_sub_ps(a.ps, b.ps);
+	} else {
+		r.pd = _mm_sub_pd(a.pd, b.pd);
+	}
+#else
+	if (esize == 2) {
+		for (int e = 0; e < 4; e++) r.f[e] = a.f[e] - b.f[e];
+	} else {
+		for (int e = 0; e < 2; e++) r.df[e] = a.df[e] - b.df[e];
+	}
+#endif
+	return r;
+}
+
+inline V128 simdFmul(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	if (esize == 2) {
+		r.ps = _mm_mul_ps(a.ps, b.ps);
+	} else {
+		r.pd = _mm_mul_pd(a.pd, b.pd);
+	}
+#else
+	if (esize == 2) {
+		for (int e = 0; e < 4; e++) r.f[e] = a.f[e] * b.f[e];
+	} else {
+		for (int e = 0; e < 2; e++) r.df[e] = a.df[e] * b.df[e];
+	}
+#endif
+	return r;
+}
+
+inline V128 simdFdiv(const V128 &a, const V128 &b, int esize)
+{
+	V128 r;
+#if defined(__SSE2__)
+	if (esize == 2) {
+		r.ps = _mm_div_ps(a.ps, b.ps);
+	} else {
+		r.pd = _mm_div_pd(a.pd, b.pd);
+	}
+#else
+	if (esize == 2) {
+		for (int e = 0; e < 4; e++) r.f[e] = a.f[e] / b.f[e];
+	} else {
+		for (int e = 0; e < 2; e++) r.df[e] = a.df[e] / b.df[e];
+	}
+#endif
+	return r;
+}
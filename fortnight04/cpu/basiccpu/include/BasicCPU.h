@@ -44,12 +44,256 @@
 #pragma once
 
 #include "CPU.h"
+#include "GuestFault.h"
+#include "BranchMonitor.h"
+#include "PCProfiler.h"
+#include "AdvSIMD.h"
+#include <climits>
 #include <cstdint>
+#include <cstring>
 
 // Códigos de controle
-enum ALUctrlFlag {ALU_UNDEF, ALU_NONE, ADD, SUB};
-enum MEMctrlFlag {MEM_UNDEF, MEM_NONE, READ32, WRITE32, READ64, WRITE64};
-enum WBctrlFlag {WB_UNDEF, WB_NONE, RegWrite};
+enum ALUctrlFlag {ALU_UNDEF, ALU_NONE, ADD, SUB, ADDS, SUBS, BCOND, CSEL,
+		VADD, VSUB, VMUL, VAND, VORR, VEOR, VADDV, VFADD, VFSUB, VFMUL, VFDIV,
+		VDUP, VUMOV};
+enum MEMctrlFlag {MEM_UNDEF, MEM_NONE, READ32, WRITE32, READ64, WRITE64,
+		READ8, WRITE8, READ16, WRITE16,
+		READPAIR32, WRITEPAIR32, READPAIR64, WRITEPAIR64, READV, WRITEV};
+enum WBctrlFlag {WB_UNDEF, WB_NONE, RegWrite, BaseWrite, VecWrite};
+
+// Índices do banco de registradores unificado: 0-30 são X0-X30; 31 é SP
+// (Rn/Rd = 31 nas instruções que usam SP); REG_ZR vale sempre 0 (leitura
+// de XZR/WZR); REG_PC é PC; REG_DISCARD recebe as escritas em XZR/WZR
+enum RegIndex {REG_SP = 31, REG_ZR = 32, REG_PC = 33, REG_DISCARD = 34,
+		REG_FILE_SIZE = 35};
+
+// Última operação que atualizou as flags NZCV (ver BasicCPU::getNZCV()).
+// FLAGS_VALID: as flags já estão calculadas em NZCV
+enum FlagsOp {FLAGS_VALID, FLAGS_ADD32, FLAGS_ADD64, FLAGS_SUB32, FLAGS_SUB64};
+
+// Posição das flags em NZCV (como no registrador NZCV do ARMv8)
+#define FLAG_N 0x80000000
+#define FLAG_Z 0x40000000
+#define FLAG_C 0x20000000
+#define FLAG_V 0x10000000
+
+// Códigos de condição (C1.2.4): EQ, NE, CS/HS, CC/LO, MI, PL, VS, VC, HI,
+// LS, GE, LT, GT, LE, AL
+#define COND_AL 14
+
+// Máscaras de leitura e escrita de registradores de 64 (Xn) e 32 bits (Wn);
+// as de 16 e 8 bits estendem com zeros os dados de LDRH e LDRB
+#define REG_MASK_64 0xFFFFFFFFFFFFFFFFUL
+#define REG_MASK_32 0x00000000FFFFFFFFUL
+#define REG_MASK_16 0x000000000000FFFFUL
+#define REG_MASK_8  0x00000000000000FFUL
+
+/**
+ * Acesso à memória pelos estágios IF e MEM, resolvido em tempo de
+ * compilação pelo tipo da memória.
+ *
+ * Com MemoryImpl = Memory as chamadas são virtuais e funcionam com qualquer
+ * implementação (inclusive SimpleMemoryTest, que registra os acessos). Com
+ * uma implementação concreta (por exemplo, SimpleMemory) a chamada é
+ * qualificada, sem despacho virtual, e pode ser expandida inline.
+ */
+template <class MemoryImpl>
+struct MemoryPort
+{
+	static unsigned int readInstruction32(Memory *memory, unsigned long address) {
+		return static_cast<MemoryImpl*>(memory)->MemoryImpl::readInstruction32(address);
+	}
+	static signed char readData8(Memory *memory, unsigned long address) {
+		return static_cast<MemoryImpl*>(memory)->MemoryImpl::readData8(address);
+	}
+	static short readData16(Memory *memory, unsigned long address) {
+		return static_cast<MemoryImpl*>(memory)->MemoryImpl::readData16(address);
+	}
+	static int readData32(Memory *memory, unsigned long address) {
+		return static_cast<MemoryImpl*>(memory)->MemoryImpl::readData32(address);
+	}
+	static long readData64(Memory *memory, unsigned long address) {
+		return static_cast<MemoryImpl*>(memory)->MemoryImpl::readData64(address);
+	}
+	static void writeData8(Memory *memory, unsigned long address, signed char value) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writeData8(address, value);
+	}
+	static void writeData16(Memory *memory, unsigned long address, short value) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writeData16(address, value);
+	}
+	static void writeData32(Memory *memory, unsigned long address, int value) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writeData32(address, value);
+	}
+	static void writeData64(Memory *memory, unsigned long address, long value) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writeData64(address, value);
+	}
+	static void readBlock(Memory *memory, unsigned long address, void *buffer,
+			unsigned long size) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::readBlock(address, buffer, size);
+	}
+	static void writeBlock(Memory *memory, unsigned long address, const void *buffer,
+			unsigned long size) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writeBlock(address, buffer, size);
+	}
+	static void readPair64(Memory *memory, unsigned long address, long *first,
+			long *second) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::readPair64(address, first, second);
+	}
+	static void writePair64(Memory *memory, unsigned long address, long first,
+			long second) {
+		static_cast<MemoryImpl*>(memory)->MemoryImpl::writePair64(address, first, second);
+	}
+};
+
+template <>
+struct MemoryPort<Memory>
+{
+	static unsigned int readInstruction32(Memory *memory, unsigned long address) {
+		return memory->readInstruction32(address);
+	}
+	static signed char readData8(Memory *memory, unsigned long address) {
+		return memory->readData8(address);
+	}
+	static short readData16(Memory *memory, unsigned long address) {
+		return memory->readData16(address);
+	}
+	static int readData32(Memory *memory, unsigned long address) {
+		return memory->readData32(address);
+	}
+	static long readData64(Memory *memory, unsigned long address) {
+		return memory->readData64(address);
+	}
+	static void writeData8(Memory *memory, unsigned long address, signed char value) {
+		memory->writeData8(address, value);
+	}
+	static void writeData16(Memory *memory, unsigned long address, short value) {
+		memory->writeData16(address, value);
+	}
+	static void writeData32(Memory *memory, unsigned long address, int value) {
+		memory->writeData32(address, value);
+	}
+	static void writeData64(Memory *memory, unsigned long address, long value) {
+		memory->writeData64(address, value);
+	}
+	static void readBlock(Memory *memory, unsigned long address, void *buffer,
+			unsigned long size) {
+		memory->readBlock(address, buffer, size);
+	}
+	static void writeBlock(Memory *memory, unsigned long address, const void *buffer,
+			unsigned long size) {
+		memory->writeBlock(address, buffer, size);
+	}
+	static void readPair64(Memory *memory, unsigned long address, long *first,
+			long *second) {
+		memory->readPair64(address, first, second);
+	}
+	static void writePair64(Memory *memory, unsigned long address, long first,
+			long second) {
+		memory->writePair64(address, first, second);
+	}
+};
+
+// Cache de instruções decodificadas: número de entradas (potência de 2)
+// e tamanho, em bits, da página de texto usada na invalidação
+#define DECODE_CACHE_SIZE 1024
+#define DECODE_CACHE_PAGE_BITS 12
+
+/**
+ * Instrução decodificada.
+ *
+ * Guarda o que o estágio ID extrai de IR, de forma que uma nova execução
+ * da instrução no mesmo PC não precise decodificá-la outra vez. Os
+ * registradores são guardados como índices no banco de registradores
+ * (RegIndex), já resolvidos entre SP e ZR, e só são lidos no estágio ID.
+ */
+struct DecodedInstruction {
+	uint64_t PC;			// endereço da instrução (tag da entrada)
+	bool valid;
+
+	int n;					// Rn, fonte de A (REG_ZR se não houver)
+	uint64_t nMask;			// REG_MASK_32: A é lido como Wn
+	int m;					// Rm, fonte de B (REG_ZR se não houver)
+	uint64_t mMask;			// REG_MASK_32: B é lido como Wm
+	int shift;				// deslocamento aplicado a Rm (0: LSL, 1: LSR, 2: ASR, 3: SXTW e LSL)
+	int amount;				// quantidade de bits do deslocamento
+	int64_t imm;			// valor imediato, somado a B
+	int d;					// registrador destino (REG_DISCARD se não houver)
+	uint64_t dMask;			// REG_MASK_32: o resultado é escrito como Wd
+	int d2;					// segundo registrador de LDP/STP (Rt2)
+	int base;				// Rn com write-back (REG_DISCARD se não houver)
+	int64_t wbOffset;		// somado ao endereço no write-back de Rn
+	int cond;				// condição de B.cond e CSEL
+	
+	// AdvSIMD e ponto flutuante (ver BasicCPU::readVectorOperands())
+	int vn;					// Vn, fonte de AF
+	int vm;					// Vm, fonte de BF
+	int vd;					// Vd, destino, ou Vt, primeiro registrador de LD1/ST1
+	int vesize;				// tamanho do elemento: 1 << vesize bytes
+	int vbytes;				// bytes usados de cada registrador (1 a 16)
+	int vcount;				// número de registradores de LD1/ST1
+	int wbIndex;			// Xm somado a wbOffset (LD1/ST1 post-index; REG_ZR se não houver)
+
+	ALUctrlFlag ALUctrl;
+	MEMctrlFlag MEMctrl;
+	WBctrlFlag WBctrl;
+	bool MemtoReg;
+	bool fpOP;
+	bool vecOP;				// usa os registradores vetoriais (WBctrl = VecWrite)
+};
+
+class BasicCPU;
+
+/**
+ * Codificação A64 implementada: a instrução IR é da codificação se
+ * (IR & mask) == value, e handler extrai dela os campos da instrução
+ * decodificada.
+ */
+struct DecodeEncoding {
+	uint32_t mask;
+	uint32_t value;
+	int (BasicCPU::*handler)(DecodedInstruction *dec);
+};
+
+// Tabela de decodificação: indexada pelos bits 31-21 de IR, cada entrada
+// guarda até DECODE_TABLE_WAYS codificações candidatas (índices em
+// BasicCPU::decodeEncodings; DECODE_TABLE_EMPTY marca o fim da lista)
+#define DECODE_TABLE_SHIFT 21
+#define DECODE_TABLE_SIZE (1 << (32 - DECODE_TABLE_SHIFT))
+#define DECODE_TABLE_WAYS 4
+#define DECODE_TABLE_EMPTY 0xFF
+
+struct DecodeTable {
+	uint8_t ways[DECODE_TABLE_SIZE][DECODE_TABLE_WAYS];
+	bool overflow;			// alguma entrada tem mais candidatas que DECODE_TABLE_WAYS
+};
+
+/**
+ * Gera, em tempo de compilação, a tabela de decodificação da lista de
+ * codificações encodings. Uma codificação é candidata em todas as entradas
+ * cujos bits 31-21 são compatíveis com (mask, value).
+ */
+constexpr DecodeTable buildDecodeTable(const DecodeEncoding *encodings, int count)
+{
+	DecodeTable table {};
+	for (uint32_t prefix = 0; prefix < DECODE_TABLE_SIZE; prefix++) {
+		int ways = 0;
+		for (int i = 0; i < DECODE_TABLE_WAYS; i++) {
+			table.ways[prefix][i] = DECODE_TABLE_EMPTY;
+		}
+		for (int i = 0; i < count; i++) {
+			uint32_t mask = encodings[i].mask & (0xFFFFFFFFu << DECODE_TABLE_SHIFT);
+			if (((prefix << DECODE_TABLE_SHIFT) & mask) != (encodings[i].value & mask)) {
+				continue;
+			}
+			if (ways == DECODE_TABLE_WAYS) {
+				table.overflow = true;
+			} else {
+				table.ways[prefix][ways++] = i;
+			}
+		}
+	}
+	return table;
+}
 		
 class BasicCPU: public CPU
 {
@@ -63,13 +307,6 @@ class BasicCPU: public CPU
 		 * demais registradores auxiliares.
 		 */
 		 
-		// Registrador PC
-		uint64_t PC;
-		
-		// Registrador SP
-		// 		Registrador SP (stack pointer), de 64 bits
-		uint64_t SP;
-		
 		// Banco de registradores inteiros
 		//		Declara os registradores Rn descritos no documento
 		// 		armV8ppB181-B182_registradores.pdf. Veja que o documento
@@ -78,29 +315,64 @@ class BasicCPU: public CPU
 		//		usados como registradores de 64	bits, com nomes X0-X30 ou
 		//		podem ser usados como registradores	de 32 bits, com nomes
 		//		W0-W30.
-		uint64_t R[31];
+		//
+		//		SP, ZR e PC ficam no mesmo banco (ver RegIndex), de forma que
+		//		a decodificação resolve o registrador 31 como SP ou ZR e os
+		//		estágios seguintes apenas indexam R, sem desvios.
+		union {
+			uint64_t R[REG_FILE_SIZE];
+			struct {
+				uint64_t X[31];
+				
+				// Registrador SP
+				// 		Registrador SP (stack pointer), de 64 bits
+				uint64_t SP;
+				
+				// Registrador zero (XZR/WZR), sempre 0
+				uint64_t ZR;
+				
+				// Registrador PC
+				uint64_t PC;
+				
+				// Destino das escritas em XZR/WZR, nunca lido
+				uint64_t discard;
+			};
+		};
 		uint64_t *Rd;
 		
+		// máscara aplicada ao valor escrito em Rd no estágio WB
+		uint64_t WBmask;
+		
+		// LDP/STP: segundo registrador de dados (Rt2) e segundo dado lido
+		// da memória. Pre-index e post-index: registrador base que recebe
+		// ALUout + WBoffset no estágio WB
+		uint64_t *Rd2;
+		uint64_t *Rbase;
+		int64_t WBoffset;
+		int64_t MDR2;
+		
+		// Banco de registradores vetoriais (AdvSIMD e ponto flutuante)
+		//		V0-V31, de 128 bits. Bn, Hn, Sn, Dn e Qn são os 8, 16, 32,
+		//		64 e 128 bits menos significativos de Vn; as escritas
+		//		escalares e as de 64 bits (8B, 4H, 2S) zeram o restante do
+		//		registrador.
+		V128 V[VREG_COUNT];
+		
+		// Registrador vetorial destino e bytes escritos nele em WB;
+		// tamanho do elemento (1 << Vesize bytes); LD1/ST1: número de
+		// registradores, a partir de Vt = Vd, e dados lidos ou escritos
+		V128 *Vd;
+		int Vbytes;
+		int Vesize;
+		int Vcount;
+		alignas(16) uint8_t MDRV[4 * sizeof(V128)];
+		
 		/**
-		 * Lê registrador inteiro de 32 bits.
-		 */
-		int getW(int n);
-
-		/**
-		 * Escreve registrador inteiro de 32 bits.
-		 */
-		void setW(int n, int value);
-
-		/**
-		 * Lê registrador inteiro de 64 bits.
-		 */
-		int getX(int n);
-
-		/**
-		 * Escreve registrador inteiro de 64 bits.
+		 * Escreve os bytes bytes de value nos bytes menos significativos
+		 * de Vn e zera o restante.
 		 */
-		void setX(int n, long value);
-
+		void writeVector(V128 *Vn, const void *value, int bytes);
+		
 		// Registradores auxiliares
 		
 		// IR (instruction register), 32 bits, saída do estágio de busca
@@ -140,13 +412,103 @@ class BasicCPU: public CPU
 		// na memória.
 		bool MemtoReg = false;
 
+		// cond, saída 8 do estágio de decodificação da instrução (ID),
+		// condição avaliada por EXI em B.cond e CSEL.
+		int cond = COND_AL;
+
+		// AF e BF, 128 bits, saídas 9 e 10 do estágio de decodificação
+		// da instrução (ID) (Vn e Vm lidos do banco de registradores
+		// vetoriais)
+		V128 AF;
+		V128 BF;
+
 		// ALUout, 64 bits, saída do estágio de execução de operação
 		// inteira (EXI)
 		int64_t ALUout;
 
+		// ALUoutF, 128 bits, saída do estágio de execução de operação em
+		// ponto flutuante e AdvSIMD (EXF)
+		V128 ALUoutF;
+
 		// MDR, 64 bits, saída do estágio de acesso à memória de dados (MEM).
 		int64_t MDR;
 
+		/**
+		 * Flags NZCV, calculadas sob demanda.
+		 *
+		 * ADDS e SUBS apenas registram a operação e os operandos; as flags
+		 * só são calculadas quando lidas (B.cond, CSEL), e a maioria dos
+		 * resultados de ADDS/SUBS nunca é lida.
+		 */
+		uint32_t NZCV = 0;
+		FlagsOp flagsOp = FlagsOp::FLAGS_VALID;
+		uint64_t flagsA;
+		uint64_t flagsB;
+
+		/**
+		 * Calcula, se necessário, e retorna as flags NZCV.
+		 */
+		uint32_t getNZCV();
+
+		/**
+		 * Avalia a condição cond sobre as flags. Após SUBS (CMP), a maioria
+		 * das condições é avaliada diretamente sobre os operandos, sem
+		 * calcular as flags.
+		 */
+		bool conditionHolds(int cond);
+
+		/**
+		 * Cache de instruções decodificadas, mapeada diretamente pelo PC.
+		 *
+		 * decodeCachePages tem um bit por página de texto (módulo 64) com
+		 * alguma entrada válida, para que escritas em páginas de dados não
+		 * precisem consultar a cache.
+		 */
+		DecodedInstruction decodeCache[DECODE_CACHE_SIZE];
+		uint64_t decodeCachePages;
+		unsigned long decodeCacheHits = 0;
+		unsigned long decodeCacheMisses = 0;
+		unsigned long decodeCacheInvalidations = 0;
+
+		/**
+		 * Número de instruções executadas por run() e limite de instruções
+		 * (0: sem limite). Ao atingir o limite, run() termina sem erro.
+		 */
+		unsigned long instructionCount = 0;
+		unsigned long instructionLimit = 0;
+
+		/**
+		 * Monitor que recebe os desvios retirados (nullptr: nenhum).
+		 */
+		BranchMonitor *branchMonitor = nullptr;
+
+		/**
+		 * Informa ao monitor o desvio em pc, que acabou de escrever PC:
+		 * B.cond é condicional e tomado se PC != pc + 4; B é direto.
+		 */
+		void retireBranch(uint64_t pc);
+
+		/**
+		 * Profiler de PCs (nullptr: nenhum) e instruções que faltam para a
+		 * próxima amostra. Sem profiler a contagem só chega a 0 depois de
+		 * ULONG_MAX instruções, então step() paga apenas um decremento por
+		 * instrução, e não um teste do profiler e um decremento.
+		 */
+		PCProfiler *profiler = nullptr;
+		unsigned long profileCountdown = ULONG_MAX;
+
+		/**
+		 * Registra no profiler a instrução em pc, que acabou de ser
+		 * retirada, e sorteia o intervalo até a próxima amostra.
+		 */
+		void profileSample(uint64_t pc);
+
+		/**
+		 * Registra no profiler a instrução em pc, com os acessos a dados
+		 * dados por ctrl (o MEMctrl da instrução decodificada).
+		 */
+		void profileRecord(uint64_t pc, MEMctrlFlag ctrl);
+
 		/**
 		 * Caminho de dados (Datapath)
 		 *
@@ -155,6 +517,36 @@ class BasicCPU: public CPU
 		 * entrada, quanto como saída, os registradores da CPU.
 		 */
 
+		/**
+		 * Executa uma instrução, passando por todos os estágios.
+		 *
+		 * Retorna 0: se executou corretamente e
+		 *		   1: se algum estágio não implementar a instrução (o estágio
+		 *			  fica registrado em cpuError).
+		 */
+		int step();
+
+		/**
+		 * Versões de run(), step(), IF() e MEM() para um tipo de memória
+		 * conhecido em tempo de compilação (ver MemoryPort). As versões sem
+		 * parâmetro de template usam MemoryImpl = Memory.
+		 */
+		template <class MemoryImpl> int run(long startAddress);
+		template <class MemoryImpl> int runLoop();
+		template <class MemoryImpl> int step();
+		template <class MemoryImpl> void IF();
+		template <class MemoryImpl> int MEM();
+
+		/**
+		 * Executa loop() com uma armadilha de GuestFault armada: um acesso
+		 * do convidado às páginas de guarda da memória termina a execução
+		 * com DATA_ABORT, PC na instrução que falhou e dataAbortAddress com
+		 * o endereço acessado. Usado por run() de todas as CPUs.
+		 *
+		 * Retorna o retorno de loop() ou 1, se houve DATA_ABORT.
+		 */
+		template <class Loop> int runGuarded(Loop loop);
+
 		/**
 		 * Busca da instrução.
 		 * 
@@ -219,6 +611,55 @@ class BasicCPU: public CPU
 		 */
 		int WB();
 		
+		/**
+		 * Decodifica IR pela tabela de decodificação e preenche a instrução
+		 * decodificada dec.
+		 *
+		 * Retorna 0: se executou corretamente e
+		 *		   1: se a instrução não estiver implementada.
+		 */
+		int decode(DecodedInstruction *dec);
+
+		/**
+		 * Lê os registradores indicados pela instrução decodificada dec e
+		 * atribui os registradores auxiliares A, B, Rd e os sinais de controle.
+		 */
+		void readOperands(DecodedInstruction *dec);
+
+		/**
+		 * Parte de readOperands() das instruções com registradores
+		 * vetoriais: atribui AF, BF, Vd, Vbytes, Vesize, Vcount e o
+		 * write-back do registrador base.
+		 */
+		void readVectorOperands(DecodedInstruction *dec);
+
+		/**
+		 * Índice do campo de registrador field (Rn, Rm ou Rt) nas
+		 * instruções em que o registrador 31 é ZR, como fonte e como
+		 * destino. Nas instruções em que 31 é SP o índice é o próprio
+		 * campo.
+		 */
+		static int zrSource(uint32_t field);
+		static int zrDest(uint32_t field);
+
+		/**
+		 * Bit que representa, em decodeCachePages, a página de texto do
+		 * endereço address.
+		 */
+		uint64_t decodeCachePageBit(unsigned long address);
+
+		/**
+		 * Invalida as entradas da cache de instruções decodificadas cujas
+		 * instruções estejam nos size bytes escritos a partir de address.
+		 */
+		void invalidateDecodeCache(unsigned long address, int size);
+
+		/**
+		 * Bytes escritos na memória pelo estágio MEM com o controle ctrl
+		 * (0: nenhuma escrita).
+		 */
+		static int storeSize(MEMctrlFlag ctrl);
+		
 	public:
 		BasicCPU(Memory *memory);
 		
@@ -227,55 +668,359 @@ class BasicCPU: public CPU
 		 */
 		int run(long startAddress);
 		
-	private:
 		/**
-		 * Decodifica instruções do grupo
-		 * 		100x Data Processing -- Immediate
-		 *
-		 * C4.1.2 Data Processing -- Immediate (p. 232)
-		 * This section describes the encoding of the Data Processing -- Immediate group.
-		 * The encodings in this section are decoded from A64 instruction set encoding.
-		 *
-		 * Retorna 0: se executou corretamente e
-		 *		   1: se a instrução não estiver implementada.
+		 * Esvazia a cache de instruções decodificadas.
 		 */
-		int decodeDataProcImm();
+		void flushDecodeCache();
 
 		/**
-		 * ATIVIDADE FUTURA: Decodifica instruções do grupo
-		 * 		101x Branches, Exception Generating and System instructions
-		 *
-		 * Retorna 0: se executou corretamente e
-		 *		   1: se a instrução não estiver implementada.
+		 * Estatísticas da cache de instruções decodificadas.
 		 */
-		int decodeBranches();
+		unsigned long getDecodeCacheHits();
+		unsigned long getDecodeCacheMisses();
+		unsigned long getDecodeCacheInvalidations();
 
 		/**
-		 * ATIVIDADE FUTURA: Decodifica instruções do grupo
-		 * 		x1x0 Loads and Stores on page C4-246
-		 *
-		 * Retorna 0: se executou corretamente e
-		 *		   1: se a instrução não estiver implementada.
+		 * Limite de instruções executadas por run() (0: sem limite).
+		 */
+		void setInstructionLimit(unsigned long limit);
+
+		/**
+		 * Número de instruções executadas por run().
+		 */
+		unsigned long getInstructionCount();
+
+		/**
+		 * Monitor de desvios (nullptr desliga). A CPU não é dona do
+		 * monitor.
+		 */
+		void setBranchMonitor(BranchMonitor *monitor);
+		BranchMonitor *getBranchMonitor();
+
+		/**
+		 * Profiler de PCs (nullptr desliga). A CPU não é dona do profiler.
+		 * ThreadedCPU e JitCPU continuam executando os blocos traduzidos
+		 * e amostram na entrada de cada bloco.
 		 */
-		int decodeLoadStore();
+		void setProfiler(PCProfiler *profiler);
+		PCProfiler *getProfiler();
 
 		/**
-		 * Decodifica instruções do grupo
-		 * 		x101 Data Processing -- Register on page C4-278
+		 * Executa, a partir do PC atual, até quantum instruções (ou até o
+		 * limite de instruções, se for atingido antes; quantum = 0 executa
+		 * até o fim, como run()). Usado para
+		 * intercalar a execução de vários núcleos (MultiCoreProcessor).
 		 *
 		 * Retorna 0: se executou corretamente e
-		 *		   1: se a instrução não estiver implementada.
+		 *		   1: se algum estágio não implementar a instrução.
+		 */
+		int runQuantum(unsigned long quantum);
+
+		/**
+		 * Informa se a execução terminou (erro ou limite de instruções).
+		 */
+		bool isFinished();
+
+		/**
+		 * Erro que terminou a execução (NONE se não houve erro).
+		 */
+		CPUerrorCode getError();
+
+		/**
+		 * Endereço acessado pela instrução que causou DATA_ABORT.
+		 */
+		unsigned long getDataAbortAddress();
+
+		/**
+		 * Estado inicial de um núcleo: endereço da pilha (SP) e valor
+		 * inicial de Xn (por exemplo, argumentos da função de entrada).
+		 */
+		void setStackPointer(unsigned long address);
+		void setRegister(int n, long value);
+		
+	private:
+		/**
+		 * Codificações A64 implementadas e a tabela de decodificação
+		 * gerada a partir delas (ver buildDecodeTable()).
 		 */
-		int decodeDataProcReg();
+		static const DecodeEncoding decodeEncodings[];
+		static const DecodeTable decodeTable;
 
 		/**
-		 * ATIVIDADE FUTURA: Decodifica instruções do grupo
-		 * 		x111 Data Processing -- Scalar Floating-Point and Advanced SIMD
-		 * 				on page C4-288
+		 * Decodificadores de cada codificação da lista decodeEncodings.
 		 *
-		 * Retorna 0: se executou corretamente e
-		 *		   1: se a instrução não estiver implementada.
+		 * Retornam 0: se executou corretamente e
+		 *		    1: se a variante da instrução não estiver implementada.
+		 */
+		// 100x Data Processing -- Immediate
+		int decodeAddSubImm(DecodedInstruction *dec);
+		// 101x Branches, Exception Generating and System instructions
+		int decodeB(DecodedInstruction *dec);
+		int decodeBCond(DecodedInstruction *dec);
+		// x1x0 Loads and Stores
+		int decodeLdrswImm(DecodedInstruction *dec);
+		int decodeLdrImm(DecodedInstruction *dec);
+		int decodeStrImm(DecodedInstruction *dec);
+		int decodeLdrReg(DecodedInstruction *dec);
+		int decodeLdpStp(DecodedInstruction *dec);
+		int decodeLoadStoreSubword(DecodedInstruction *dec);
+		int decodeLdSt1Multiple(DecodedInstruction *dec);
+		int decodeLdStSimdImm(DecodedInstruction *dec);
+		// x101 Data Processing -- Register
+		int decodeAddSubShiftedReg(DecodedInstruction *dec);
+		int decodeCsel(DecodedInstruction *dec);
+		// x111 Data Processing -- Scalar Floating-Point and Advanced SIMD
+		int decodeSimdThreeSame(DecodedInstruction *dec);
+		int decodeSimdAddv(DecodedInstruction *dec);
+		int decodeSimdModifiedImm(DecodedInstruction *dec);
+		int decodeSimdCopy(DecodedInstruction *dec);
+		int decodeFloatTwoSource(DecodedInstruction *dec);
+		int decodeFmovGeneral(DecodedInstruction *dec);
+		
+		/**
+		 * Valores padrão dos campos vetoriais de uma instrução AdvSIMD ou
+		 * de ponto flutuante: Vd = Rd, Vn = Rn, Vm = Rm, sem acesso à
+		 * memória, escrita de ALUoutF em Vd por WB e execução por EXF.
 		 */
-		int decodeDataProcFloat();
+		void decodeVectorDefaults(DecodedInstruction *dec);
 	
 };
+
+/**
+ * Ciclo da máquina.
+ */
+template <class MemoryImpl>
+int BasicCPU::run(long startAddress)
+{
+	// inicia PC com o valor de startAddress
+	PC = startAddress;
+
+	return runGuarded([this]() { return runLoop<MemoryImpl>(); });
+}
+
+template <class MemoryImpl>
+int BasicCPU::runLoop()
+{
+	// ciclo da máquina
+	while ((cpuError == CPUerrorCode::NONE) && !processFinished) {
+		if (step<MemoryImpl>()) {
+			break;
+		}
+	}
+	
+	if (cpuError) {
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+ * A armadilha é armada uma vez por run(), e não a cada acesso: sigsetjmp
+ * não salva a máscara de sinais (ver GuestFault::install()). Os estágios
+ * ID, EXI e WB não são expandidos inline, então PC e instructionCount já
+ * estão na memória quando MEM falha.
+ *
+ * O erro que terminar a execução é contado em perf.stageErrors uma única
+ * vez, mesmo que runQuantum() seja chamado de novo depois dele.
+ */
+template <class Loop>
+int BasicCPU::runGuarded(Loop loop)
+{
+	GuestFault::Trap trap;
+	if (sigsetjmp(trap.env, 0)) {
+		cpuError = CPUerrorCode::DATA_ABORT;
+		dataAbortAddress = trap.address;
+		PERF_COUNT(perf.stageErrors[CPUerrorCode::DATA_ABORT]);
+		return 1;
+	}
+	CPUerrorCode previousError = cpuError;
+	GuestFault::arm(&trap);
+	int result = loop();
+	GuestFault::disarm(&trap);
+	if (cpuError != previousError) {
+		PERF_COUNT(perf.stageErrors[cpuError]);
+	}
+	return result;
+}
+
+/**
+ * Executa uma instrução, passando por todos os estágios.
+ */
+template <class MemoryImpl>
+int BasicCPU::step()
+{
+	uint64_t pc = PC;
+	
+	IF<MemoryImpl>();
+	if (ID()) {
+		cpuError = CPUerrorCode::ID_ERROR;
+		return 1;
+	}
+	if (fpOP) {
+		if (EXF()) {
+			cpuError = CPUerrorCode::EXF_ERROR;
+			return 1;
+		}
+	} else {
+		if (EXI()) {
+			cpuError = CPUerrorCode::EXI_ERROR;
+			return 1;
+		}
+	}
+	if (MEM<MemoryImpl>()) {
+		cpuError = CPUerrorCode::MEM_ERROR;
+		return 1;
+	}
+	if (WB()) {
+		cpuError = CPUerrorCode::WB_ERROR;
+		return 1;
+	}
+	
+	// avança para a próxima instrução, a não ser que a instrução
+	// executada tenha escrito em PC (desvio)
+	if (Rd != &PC) {
+		PC += 4;
+	} else {
+		PERF_COUNT(perf.branches);
+		PERF_ADD(perf.takenBranches, PC != pc + 4);
+		if (branchMonitor) {
+			retireBranch(pc);
+		}
+	}
+	
+	PERF_COUNT(perf.groups[PerfCounters::group(IR)]);
+	if (--profileCountdown == 0) {
+		profileSample(pc);
+	}
+	instructionCount++;
+	if (instructionCount == instructionLimit) {
+		processFinished = true;
+	}
+	return 0;
+}
+
+inline void BasicCPU::retireBranch(uint64_t pc)
+{
+	if (ALUctrl == ALUctrlFlag::BCOND) {
+		branchMonitor->retire(pc, PC, BRANCH_CONDITIONAL, PC != pc + 4);
+	} else {
+		branchMonitor->retire(pc, PC, BRANCH_DIRECT, true);
+	}
+}
+
+/**
+ * Busca da instrução.
+ */
+template <class MemoryImpl>
+void BasicCPU::IF()
+{
+	IR = MemoryPort<MemoryImpl>::readInstruction32(memory, PC);
+}
+
+/**
+ * Acesso a dados na memória.
+ */
+template <class MemoryImpl>
+int BasicCPU::MEM()
+{
+	switch (MEMctrl) {
+	case MEMctrlFlag::READ32:
+		MDR = MemoryPort<MemoryImpl>::readData32(memory, ALUout);
+		PERF_COUNT(perf.loads[PERF_WIDTH_32]);
+		return 0;
+	case MEMctrlFlag::WRITE32:
+		MemoryPort<MemoryImpl>::writeData32(memory, ALUout, *Rd);
+		PERF_COUNT(perf.stores[PERF_WIDTH_32]);
+		invalidateDecodeCache(ALUout, 4);
+		return 0;
+	case MEMctrlFlag::READ64:
+		MDR = MemoryPort<MemoryImpl>::readData64(memory, ALUout);
+		PERF_COUNT(perf.loads[PERF_WIDTH_64]);
+		return 0;
+	case MEMctrlFlag::WRITE64:
+		MemoryPort<MemoryImpl>::writeData64(memory, ALUout, *Rd);
+		PERF_COUNT(perf.stores[PERF_WIDTH_64]);
+		invalidateDecodeCache(ALUout, 8);
+		return 0;
+	case MEMctrlFlag::READ8:
+		MDR = MemoryPort<MemoryImpl>::readData8(memory, ALUout);
+		PERF_COUNT(perf.loads[PERF_WIDTH_8]);
+		return 0;
+	case MEMctrlFlag::WRITE8:
+		MemoryPort<MemoryImpl>::writeData8(memory, ALUout, *Rd);
+		PERF_COUNT(perf.stores[PERF_WIDTH_8]);
+		invalidateDecodeCache(ALUout, 1);
+		return 0;
+	case MEMctrlFlag::READ16:
+		MDR = MemoryPort<MemoryImpl>::readData16(memory, ALUout);
+		PERF_COUNT(perf.loads[PERF_WIDTH_16]);
+		return 0;
+	case MEMctrlFlag::WRITE16:
+		MemoryPort<MemoryImpl>::writeData16(memory, ALUout, *Rd);
+		PERF_COUNT(perf.stores[PERF_WIDTH_16]);
+		invalidateDecodeCache(ALUout, 2);
+		return 0;
+	case MEMctrlFlag::READPAIR32: {
+		uint32_t pair[2];
+		MemoryPort<MemoryImpl>::readBlock(memory, ALUout, pair, sizeof(pair));
+		MDR = pair[0];
+		MDR2 = pair[1];
+		PERF_COUNT(perf.loads[PERF_WIDTH_64]);
+		return 0;
+	}
+	case MEMctrlFlag::WRITEPAIR32: {
+		uint32_t pair[2] = {(uint32_t)*Rd, (uint32_t)*Rd2};
+		MemoryPort<MemoryImpl>::writeBlock(memory, ALUout, pair, sizeof(pair));
+		PERF_COUNT(perf.stores[PERF_WIDTH_64]);
+		invalidateDecodeCache(ALUout, 8);
+		return 0;
+	}
+	case MEMctrlFlag::READPAIR64:
+		MemoryPort<MemoryImpl>::readPair64(memory, ALUout, &MDR, &MDR2);
+		PERF_COUNT(perf.loads[PERF_WIDTH_128]);
+		return 0;
+	case MEMctrlFlag::WRITEPAIR64:
+		MemoryPort<MemoryImpl>::writePair64(memory, ALUout, *Rd, *Rd2);
+		PERF_COUNT(perf.stores[PERF_WIDTH_128]);
+		invalidateDecodeCache(ALUout, 16);
+		return 0;
+	case MEMctrlFlag::READV:
+		// LD1 e LDR (SIMD&FP): os Vcount registradores em uma transação
+		MemoryPort<MemoryImpl>::readBlock(memory, ALUout, MDRV, Vcount * Vbytes);
+		PERF_ADD(perf.loads[PerfCounters::width(Vbytes)], Vcount);
+		return 0;
+	case MEMctrlFlag::WRITEV:
+		for (int i = 0; i < Vcount; i++) {
+			memcpy(&MDRV[i * Vbytes], &V[(Vd - V + i) % VREG_COUNT], Vbytes);
+		}
+		MemoryPort<MemoryImpl>::writeBlock(memory, ALUout, MDRV, Vcount * Vbytes);
+		PERF_ADD(perf.stores[PerfCounters::width(Vbytes)], Vcount);
+		invalidateDecodeCache(ALUout, Vcount * Vbytes);
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+inline int BasicCPU::storeSize(MEMctrlFlag ctrl)
+{
+	switch (ctrl) {
+	case MEMctrlFlag::WRITE8:
+		return 1;
+	case MEMctrlFlag::WRITE16:
+		return 2;
+	case MEMctrlFlag::WRITE32:
+		return 4;
+	case MEMctrlFlag::WRITE64:
+	case MEMctrlFlag::WRITEPAIR32:
+		return 8;
+	case MEMctrlFlag::WRITEPAIR64:
+		return 16;
+	case MEMctrlFlag::WRITEV:
+		// limite superior: o tamanho depende de Vcount e Vbytes
+		return 4 * sizeof(V128);
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) InlineCPU - a BasicCPU bound at compile time to a concrete Memory
+    type, so that memory accesses are not virtual calls.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) InlineCPU - uma BasicCPU ligada em tempo de compilação a um tipo
+    concreto de Memory, para que os acessos à memória não sejam chamadas
+    virtuais.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BasicCPU.h"
+
+/**
+ * BasicCPU cujo ciclo da máquina (IF, MEM) acessa a memória pelo tipo
+ * concreto MemoryImpl, sem despacho virtual (ver MemoryPort). Por exemplo,
+ * InlineCPU<SimpleMemory> permite que o compilador expanda readData32 e
+ * readInstruction32 dentro dos estágios.
+ *
+ * A memória deve ser exatamente do tipo MemoryImpl: uma subclasse (como
+ * SimpleMemoryTest) teria suas redefinições ignoradas. Para os testes,
+ * continua sendo usada BasicCPU, com chamadas virtuais.
+ */
+template <class MemoryImpl>
+class InlineCPU: public BasicCPU
+{
+	public:
+		InlineCPU(MemoryImpl *memory) : BasicCPU(memory) {};
+
+		/**
+		 * Métodos herdados de CPU
+		 */
+		int run(long startAddress) {
+			return BasicCPU::run<MemoryImpl>(startAddress);
+		};
+};
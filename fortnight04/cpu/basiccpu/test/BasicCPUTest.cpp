@@ -43,6 +43,14 @@ BasicCPUTest::BasicCPUTest(Memory *memory)
 {
 }
 	
+void BasicCPUTest::setPC(long address) {
+	PC = address;
+}
+
+long BasicCPUTest::getPC() {
+	return PC;
+}
+
 void BasicCPUTest::setSP(long address) {
 	SP = address;
 }
@@ -59,11 +67,11 @@ int BasicCPUTest::getIR() {
 }
 
 void BasicCPUTest::setW(int n, int value) {
-	BasicCPU::setW(n,value);
+	setRegister(n, (uint32_t)value); // Wn estendido com zeros para Xn
 }
 
 void BasicCPUTest::setX(int n, long value) {
-	BasicCPU::setX(n,value);
+	setRegister(n, value);
 }
 
 long BasicCPUTest::getA() {
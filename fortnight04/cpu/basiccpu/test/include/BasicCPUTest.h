@@ -50,6 +50,8 @@ class BasicCPUTest: public BasicCPU
 		BasicCPUTest(Memory *memory);
 		
 		// registers
+		long getPC();
+		void setPC(long address);
 		void setSP(long address);
 		void setW(int n, int value);
 		void setX(int n, long value);
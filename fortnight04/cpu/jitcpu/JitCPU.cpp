@@ -0,0 +1,805 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "JitCPU.h"
+#include "SimpleMemory.h"
+
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <typeinfo>
+#include <sys/mman.h>
+
+// área de código seguida dos contadores de execuções das traduções
+#define JIT_AREA_SIZE (JIT_CODE_CACHE_SIZE + JIT_MAX_TRANSLATIONS * sizeof(uint64_t))
+
+// o código gerado escreve flagsOp com 'mov dword' e grava os desvios no
+// lote do monitor (ver emitRetireBranch())
+static_assert(sizeof(FlagsOp) == 4, "FlagsOp deve ter 32 bits");
+static_assert((sizeof(BranchEvent) == 24) && (offsetof(BranchEvent, next) == 8)
+		&& (offsetof(BranchEvent, kind) == 16) && (offsetof(BranchEvent, taken) == 20),
+		"leiaute de BranchEvent");
+
+JitCPU::JitCPU(Memory *memory)
+	: BasicCPU(memory)
+{
+	// o código gerado acessa diretamente os dados de uma SimpleMemory
+	SimpleMemory *simpleMemory = dynamic_cast<SimpleMemory*>(memory);
+	jitEnabled = simpleMemory && (typeid(*memory) == typeid(SimpleMemory))
+			&& (simpleMemory->getSize() < INT_MAX);
+	data = simpleMemory ? simpleMemory->getData() : nullptr;
+	dataSize = simpleMemory ? simpleMemory->getSize() : 0;
+
+	codeCache = nullptr;
+#if defined(__x86_64__)
+	if (jitEnabled) {
+		void *area = mmap(nullptr, JIT_AREA_SIZE,
+				PROT_READ | PROT_WRITE | PROT_EXEC,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (area != MAP_FAILED) {
+			codeCache = (uint8_t*)area;
+		}
+	}
+#endif
+	jitEnabled = jitEnabled && codeCache;
+	translationExecutions = codeCache ?
+			(uint64_t*)(codeCache + JIT_CODE_CACHE_SIZE) : nullptr;
+
+	flushJit();
+	jitFlushes = 0;
+}
+
+JitCPU::~JitCPU()
+{
+	if (codeCache) {
+		munmap(codeCache, JIT_AREA_SIZE);
+	}
+}
+
+/**
+ * Métodos herdados de CPU
+ *
+ * Executa os blocos traduzidos enquanto houver. Instruções sem modelo de
+ * tradução, e os blocos que não cabem no limite de instruções ou que
+ * contêm a próxima amostra do profiler de PCs, são executados uma
+ * instrução por vez pelos estágios de BasicCPU.
+ */
+int JitCPU::run(long startAddress)
+{
+	if (!jitEnabled) {
+		return BasicCPU::run(startAddress);
+	}
+
+	// inicia PC com o valor de startAddress
+	PC = startAddress;
+
+	return runGuarded([this]() { return runJit(); });
+}
+
+int JitCPU::runJit()
+{
+	while ((cpuError == CPUerrorCode::NONE) && !processFinished) {
+		JitBlock *block = lookupBlock();
+		int steps = 1;
+		
+		if (block) {
+			long budget = instructionLimit ?
+					(long)(instructionLimit - instructionCount) : LONG_MAX;
+			// o bloco que contém a próxima amostra sai por
+			// JIT_EXIT_BUDGET (sem profiler, a contagem passa de LONG_MAX)
+			if (profileCountdown <= (unsigned long)budget) {
+				budget = profileCountdown - 1;
+			}
+			long startBudget = budget;
+			
+			int exitCode = ((int (*)(JitCPU*, char*, long*))block->entry)(
+					this, data, &budget);
+			
+			instructionCount += startBudget - budget;
+			profileCountdown -= startBudget - budget;
+			if (instructionLimit && (instructionCount == instructionLimit)) {
+				processFinished = true;
+			}
+			
+			if (exitCode == JitExit::JIT_EXIT_BRANCH) {
+				continue;
+			}
+			if (exitCode == JitExit::JIT_EXIT_FAULT) {
+				cpuError = CPUerrorCode::DATA_ABORT;
+				break;
+			}
+			if (exitCode == JitExit::JIT_EXIT_SMC) {
+				flushJit();
+				continue;
+			}
+			if (processFinished) {
+				break;
+			}
+			// JIT_EXIT_BUDGET: o bloco inteiro é executado pelos
+			// estágios, que registram a amostra
+			steps = block->count;
+		}
+		
+		// instrução sem modelo de tradução: executa pelos estágios. Ela
+		// fica na cache de instruções decodificadas, então as escritas do
+		// código gerado sobre ela também precisam sair por JIT_EXIT_SMC
+		for (int i = 0; (i < steps) && !processFinished; i++) {
+			interpretedInstructions++;
+			coverCode(PC, PC + 4);
+			if (step()) {
+				break;
+			}
+			if (storeSize(MEMctrl) && ((uint64_t)ALUout < codeHigh)
+					&& ((uint64_t)ALUout + storeSize(MEMctrl) > codeLow)) {
+				flushJit();
+			}
+		}
+	}
+	
+	foldCounts();
+	
+	if (cpuError) {
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+ * Retorna o bloco que começa em PC, traduzindo-o se necessário, ou nullptr
+ * se a instrução em PC não puder ser traduzida.
+ */
+JitBlock *JitCPU::lookupBlock()
+{
+	JitBlock *block = &blockCache[(PC >> 2) & (JIT_BLOCK_CACHE_SIZE - 1)];
+	
+	if (block->valid && (block->PC == PC)) {
+		return block;
+	}
+	
+	if (compileBlock(block)) {
+		return nullptr;
+	}
+	return block;
+}
+
+/**
+ * Traduz o bloco que começa em PC.
+ *
+ * O bloco termina na primeira instrução que escreve em PC (desvio), antes
+ * da primeira instrução sem modelo de tradução ou ao atingir
+ * JIT_BLOCK_MAX_INSTRUCTIONS. O código gerado começa verificando se o
+ * limite de instruções (budget) permite executar o bloco inteiro.
+ *
+ * Retorna 0: se traduziu corretamente e
+ *		   1: se a primeira instrução não puder ser traduzida.
+ */
+int JitCPU::compileBlock(JitBlock *block)
+{
+	DecodedInstruction decoded[JIT_BLOCK_MAX_INSTRUCTIONS];
+	int groups[JIT_BLOCK_MAX_INSTRUCTIONS];
+	uint64_t startPC = PC;
+	int count = 0;
+	
+	while (count < JIT_BLOCK_MAX_INSTRUCTIONS) {
+		PC = startPC + 4 * count;
+		IF();
+		if (decode(&decoded[count]) || !hasTemplate(&decoded[count])) {
+			break;
+		}
+		groups[count] = PerfCounters::group(IR);
+		count++;
+		if (decoded[count - 1].d == REG_PC) {
+			break;
+		}
+	}
+	PC = startPC;
+	
+	if (count == 0) {
+		return 1;
+	}
+	
+	if ((codeCacheUsed + JIT_MAX_BLOCK_CODE > JIT_CODE_CACHE_SIZE)
+			|| (translationCounts.size() == JIT_MAX_TRANSLATIONS)) {
+		flushJit();
+	}
+	code = codeCache + codeCacheUsed;
+	
+	block->PC = startPC;
+	block->count = count;
+	block->entry = code;
+	
+	// if (*budget < count) goto budgetExit; *budget -= count;
+	emit8(0x48); emit8(0x83); emit8(0x3A); emit8(count);	// cmp qword [rdx], count
+	emit8(0x0F); emit8(0x82); emit32(0);					// jb budgetExit
+	uint8_t *budgetJump = code;
+	emit8(0x48); emit8(0x83); emit8(0x2A); emit8(count);	// sub qword [rdx], count
+	
+	blockPerf.reset();
+	blockExecutions = &translationExecutions[translationCounts.size()];
+	blockFlagsOp = FlagsOp::FLAGS_VALID;
+	for (int i = 0; i < count; i++) {
+		compileInstruction(&decoded[i], startPC + 4 * i, groups[i], i, count);
+	}
+	if (decoded[count - 1].d != REG_PC) {
+		emitCountBlock();
+		emitJumpTo(startPC + 4 * count);
+	}
+	translationCounts.push_back(blockPerf);
+	
+	*(int32_t*)(budgetJump - 4) = (int32_t)(code - budgetJump);
+	emitExit(startPC, JitExit::JIT_EXIT_BUDGET, 0);
+	
+	codeCacheUsed = code - codeCache;
+	block->valid = true;
+	blocksCompiled++;
+	
+	// escritas em [codeLow, codeHigh) podem atingir código traduzido
+	coverCode(startPC, startPC + 4 * count);
+	
+	// liga os desvios que esperavam por este bloco
+	auto jumps = pendingJumps.equal_range(startPC);
+	for (auto it = jumps.first; it != jumps.second; it++) {
+		*(int32_t*)it->second = (int32_t)(block->entry - (it->second + 4));
+	}
+	pendingJumps.erase(startPC);
+	
+	return 0;
+}
+
+/**
+ * codeLow desconta o tamanho da maior escrita, para que o teste do código
+ * gerado (endereço inicial da escrita em [codeLow, codeHigh)) pegue as
+ * escritas que começam antes de low e a atingem.
+ */
+void JitCPU::coverCode(uint64_t low, uint64_t high)
+{
+	uint64_t start = (low < 8) ? 0 : low - 8;
+	if (start < codeLow) {
+		codeLow = start;
+	}
+	if (high > codeHigh) {
+		codeHigh = high;
+	}
+}
+
+/**
+ * Informa se há modelo de tradução para a instrução decodificada.
+ */
+bool JitCPU::hasTemplate(DecodedInstruction *dec)
+{
+	if (dec->fpOP) {
+		return false;
+	}
+	
+	if ((dec->MEMctrl == MEMctrlFlag::MEM_NONE)
+			&& (dec->WBctrl == WBctrlFlag::RegWrite) && !dec->MemtoReg) {
+		// desvios (B e B.cond)
+		if (dec->d == REG_PC) {
+			return (dec->n == REG_PC) && (dec->m == REG_ZR)
+					&& ((dec->ALUctrl == ALUctrlFlag::ADD)
+					|| (dec->ALUctrl == ALUctrlFlag::BCOND));
+		}
+		// ADD, SUB, ADDS, SUBS (CMN e CMP) e CSEL
+		switch (dec->ALUctrl) {
+			case ALUctrlFlag::ADD:
+			case ALUctrlFlag::SUB:
+			case ALUctrlFlag::ADDS:
+			case ALUctrlFlag::SUBS:
+			case ALUctrlFlag::CSEL:
+				return true;
+			default:
+				return false;
+		}
+	}
+	
+	if ((dec->ALUctrl != ALUctrlFlag::ADD) || (dec->d == REG_PC)
+			|| (dec->n == REG_PC) || (dec->m == REG_PC)) {
+		return false;
+	}
+	
+	// LDR, LDRSW e STR
+	switch (dec->MEMctrl) {
+		case MEMctrlFlag::READ32:
+		case MEMctrlFlag::READ64:
+			return dec->MemtoReg && (dec->WBctrl == WBctrlFlag::RegWrite);
+		case MEMctrlFlag::WRITE32:
+		case MEMctrlFlag::WRITE64:
+			return (dec->WBctrl == WBctrlFlag::WB_NONE);
+		default:
+			return false;
+	}
+}
+
+/**
+ * Gera o código da instrução decodificada dec, que está no endereço pc, é
+ * do grupo de decodificação group e é a instrução index de um bloco de
+ * count instruções.
+ *
+ * Registradores do hospedeiro: rdi = JitCPU, rsi = memória do convidado,
+ * rdx = &budget; rax e rcx são temporários.
+ *
+ * Os contadores de desempenho da instrução são somados a blockPerf depois
+ * que seu código é gerado, de forma que a saída por falha, gerada antes,
+ * não a conta.
+ */
+void JitCPU::compileInstruction(DecodedInstruction *dec, uint64_t pc,
+		int group, int index, int count)
+{
+	int32_t rdOffset = offsetOf(&R[dec->d]);
+	uint8_t *skip;
+	
+	// B: o destino é constante
+	if ((dec->d == REG_PC) && (dec->ALUctrl == ALUctrlFlag::ADD)) {
+		PERF_COUNT(blockPerf.groups[group]);
+		PERF_COUNT(blockPerf.branches);
+		if (dec->imm != 4) {
+			PERF_COUNT(blockPerf.takenBranches);
+		}
+		emitCountBlock();
+		emitRetireBranch(pc, pc + dec->imm, BRANCH_DIRECT);
+		emitJumpTo(pc + dec->imm);
+		return;
+	}
+	
+	// B.cond: o bloco termina com dois sucessores, ligados como o de B; o
+	// desvio tomado é contado no caminho do destino
+	if (dec->d == REG_PC) {
+		PERF_COUNT(blockPerf.groups[group]);
+		PERF_COUNT(blockPerf.branches);
+		emitCountBlock();
+		if (dec->cond < COND_AL) {
+			uint8_t cc = emitCondition(dec->cond);
+			emit8(0x0F); emit8(0x80 | cc); emit32(0);			// jcc taken
+			uint8_t *taken = code;
+			emitRetireBranch(pc, pc + 4, BRANCH_CONDITIONAL);
+			emitJumpTo(pc + 4);
+			*(int32_t*)(taken - 4) = (int32_t)(code - taken);
+		}
+		if (PERF_ENABLED && (dec->imm != 4)) {
+			emit8(0x48); emit8(0xFF); emit8(0x87);
+			emit32(offsetOf(&perf.takenBranches));				// inc qword [rdi+takenBranches]
+		}
+		emitRetireBranch(pc, pc + dec->imm, BRANCH_CONDITIONAL);
+		emitJumpTo(pc + dec->imm);
+		return;
+	}
+	
+	// CSEL: rax = Rn, rcx = Rm e, se a condição não vale, rax = rcx (mov
+	// não altera as flags do hospedeiro)
+	if (dec->ALUctrl == ALUctrlFlag::CSEL) {
+		uint8_t cc = (dec->cond < COND_AL) ? emitCondition(dec->cond) : 0;
+		emitLoadOperand(dec->n, dec->nMask, pc, false);
+		if (dec->cond < COND_AL) {
+			emitLoadOperand(dec->m, dec->mMask, pc, true);
+			emit8(0x48); emit8(0x0F); emit8(0x40 | (cc ^ 1)); emit8(0xC1);	// cmov!cc rax, rcx
+		}
+		emit8(0x48); emit8(0x89); emit8(0x87); emit32(rdOffset);	// mov [rdi+Rd], rax
+		PERF_COUNT(blockPerf.groups[group]);
+		return;
+	}
+	
+	// ADDS e SUBS: rax = A, rcx = B; registram a operação e os operandos,
+	// como EXI, para que as flags sejam calculadas só quando lidas
+	if ((dec->ALUctrl == ALUctrlFlag::ADDS) || (dec->ALUctrl == ALUctrlFlag::SUBS)) {
+		bool subs = (dec->ALUctrl == ALUctrlFlag::SUBS);
+		bool w = (dec->dMask == REG_MASK_32);
+		blockFlagsOp = subs ? (w ? FlagsOp::FLAGS_SUB32 : FlagsOp::FLAGS_SUB64)
+				: (w ? FlagsOp::FLAGS_ADD32 : FlagsOp::FLAGS_ADD64);
+		emitLoadOperand(dec->n, dec->nMask, pc, false);
+		if (dec->m != REG_ZR) {
+			emitLoadShifted(dec, pc);
+			if (dec->imm) {
+				emit8(0x48); emit8(0x81); emit8(0xC1); emit32((uint32_t)dec->imm);	// add rcx, imm32
+			}
+		} else {
+			emit8(0x48); emit8(0xC7); emit8(0xC1); emit32((uint32_t)dec->imm);		// mov rcx, imm32
+		}
+		emit8(0x48); emit8(0x89); emit8(0x87); emit32(offsetOf(&flagsA));	// mov [rdi+flagsA], rax
+		emit8(0x48); emit8(0x89); emit8(0x8F); emit32(offsetOf(&flagsB));	// mov [rdi+flagsB], rcx
+		emit8(0xC7); emit8(0x87); emit32(offsetOf(&flagsOp));
+		emit32(blockFlagsOp);												// mov dword [rdi+flagsOp], op
+		emit8(0x48); emit8(subs ? 0x29 : 0x01); emit8(0xC8);				// sub/add rax, rcx
+		if (w) {
+			emit8(0x89); emit8(0xC0);										// mov eax, eax
+		}
+		emit8(0x48); emit8(0x89); emit8(0x87); emit32(rdOffset);			// mov [rdi+Rd], rax
+		PERF_COUNT(blockPerf.groups[group]);
+		return;
+	}
+	
+	// rax = A
+	emitLoadOperand(dec->n, dec->nMask, pc, false);
+	
+	// rax = A + B ou A - B, com B = Rm deslocado + imm (m = REG_ZR nas
+	// formas com imediato)
+	bool sub = (dec->ALUctrl == ALUctrlFlag::SUB);
+	if (dec->m != REG_ZR) {
+		emitLoadShifted(dec, pc);
+		emit8(0x48); emit8(sub ? 0x29 : 0x01); emit8(0xC8);	// sub/add rax, rcx
+	}
+	if (dec->imm) {
+		emit8(0x48); emit8(sub ? 0x2D : 0x05);				// sub/add rax, imm32
+		emit32((uint32_t)dec->imm);
+	}
+	
+	if (dec->MEMctrl == MEMctrlFlag::MEM_NONE) {
+		if (dec->dMask == REG_MASK_32) {
+			emit8(0x89); emit8(0xC0);							// mov eax, eax
+		}
+		emit8(0x48); emit8(0x89); emit8(0x87); emit32(rdOffset);	// mov [rdi+Rd], rax
+		PERF_COUNT(blockPerf.groups[group]);
+		return;
+	}
+	
+	// acesso à memória: sem alinhamento, como em SimpleMemory (o x86 lê e
+	// escreve endereços desalinhados), e com verificação de limites (as
+	// páginas de guarda de SimpleMemory também pegariam o acesso, mas um
+	// siglongjmp de dentro do bloco perderia o budget e o PC exatos que a
+	// saída guarda)
+	int size = ((dec->MEMctrl == MEMctrlFlag::READ64)
+			|| (dec->MEMctrl == MEMctrlFlag::WRITE64)) ? 8 : 4;
+	emit8(0x48); emit8(0x3D); emit32(dataSize - size);			// cmp rax, dataSize - size
+	emit8(0x76); emit8(0);										// jbe ok
+	skip = code;
+	emit8(0x48); emit8(0x89); emit8(0x87); emit32(offsetOf(&dataAbortAddress));	// mov [rdi+dataAbortAddress], rax
+	emitCounts();
+	emitExit(pc, JitExit::JIT_EXIT_FAULT, count - index);
+	skip[-1] = (uint8_t)(code - skip);
+	
+	switch (dec->MEMctrl) {
+		case MEMctrlFlag::READ32:
+			emit8(0x48); emit8(0x63); emit8(0x04); emit8(0x06);	// movsxd rax, dword [rsi+rax]
+			if (dec->dMask == REG_MASK_32) {
+				emit8(0x89); emit8(0xC0);						// mov eax, eax
+			}
+			emit8(0x48); emit8(0x89); emit8(0x87); emit32(rdOffset);
+			PERF_COUNT(blockPerf.loads[PERF_WIDTH_32]);
+			PERF_COUNT(blockPerf.groups[group]);
+			return;
+		case MEMctrlFlag::READ64:
+			emit8(0x48); emit8(0x8B); emit8(0x04); emit8(0x06);	// mov rax, [rsi+rax]
+			emit8(0x48); emit8(0x89); emit8(0x87); emit32(rdOffset);
+			PERF_COUNT(blockPerf.loads[PERF_WIDTH_64]);
+			PERF_COUNT(blockPerf.groups[group]);
+			return;
+		case MEMctrlFlag::WRITE32:
+			emit8(0x8B); emit8(0x8F); emit32(rdOffset);			// mov ecx, [rdi+Rd]
+			emit8(0x89); emit8(0x0C); emit8(0x06);				// mov [rsi+rax], ecx
+			PERF_COUNT(blockPerf.stores[PERF_WIDTH_32]);
+			break;
+		default:
+			emit8(0x48); emit8(0x8B); emit8(0x8F); emit32(rdOffset);	// mov rcx, [rdi+Rd]
+			emit8(0x48); emit8(0x89); emit8(0x0C); emit8(0x06);		// mov [rsi+rax], rcx
+			PERF_COUNT(blockPerf.stores[PERF_WIDTH_64]);
+			break;
+	}
+	PERF_COUNT(blockPerf.groups[group]);
+	
+	// escrita sobre código traduzido: sai para que o código seja descartado
+	emit8(0x48); emit8(0x3B); emit8(0x87); emit32(offsetOf(&codeLow));	// cmp rax, codeLow
+	emit8(0x72); emit8(0);												// jb skip
+	uint8_t *skipLow = code;
+	emit8(0x48); emit8(0x3B); emit8(0x87); emit32(offsetOf(&codeHigh));	// cmp rax, codeHigh
+	emit8(0x73); emit8(0);												// jae skip
+	uint8_t *skipHigh = code;
+	emitCounts();
+	emitExit(pc + 4, JitExit::JIT_EXIT_SMC, count - index - 1);
+	skipLow[-1] = (uint8_t)(code - skipLow);
+	skipHigh[-1] = (uint8_t)(code - skipHigh);
+}
+
+/**
+ * Carrega o registrador do convidado de índice n em rax (ou rcx), com a
+ * mesma semântica de BasicCPU::readOperands(): o registrador é lido com a
+ * máscara mask (REG_MASK_32 lê Wn, estendido com zeros) e PC é a
+ * constante pc.
+ */
+void JitCPU::emitLoadOperand(int n, uint64_t mask, uint64_t pc, bool rcx)
+{
+	uint8_t modrm = rcx ? 0x8F : 0x87;
+	
+	if (n == REG_PC) {
+		emit8(0x48); emit8(rcx ? 0xB9 : 0xB8); emit64(pc & mask);	// mov rax/rcx, pc
+	} else if (mask == REG_MASK_32) {
+		emit8(0x8B); emit8(modrm); emit32(offsetOf(&R[n]));		// mov eax/ecx, [rdi+Rn]
+	} else {
+		emit8(0x48); emit8(0x8B); emit8(modrm); emit32(offsetOf(&R[n]));	// mov rax/rcx, [rdi+Rn]
+	}
+}
+
+/**
+ * Carrega em rcx o registrador Rm da instrução decodificada dec,
+ * deslocado como em BasicCPU::readOperands().
+ */
+void JitCPU::emitLoadShifted(DecodedInstruction *dec, uint64_t pc)
+{
+	emitLoadOperand(dec->m, dec->mMask, pc, true);		// rcx = Rm
+	if ((dec->shift >= 2) && (dec->mMask == REG_MASK_32)) {
+		emit8(0x48); emit8(0x63); emit8(0xC9);			// movsxd rcx, ecx
+	}
+	if (dec->amount) {
+		emit8(0x48); emit8(0xC1);
+		switch (dec->shift) {
+			case 1: emit8(0xE9); break;					// shr rcx, amount
+			case 2: emit8(0xF9); break;					// sar rcx, amount
+			default: emit8(0xE1); break;				// shl rcx, amount (LSL, SXTW)
+		}
+		emit8(dec->amount);
+	}
+}
+
+/**
+ * Gera o teste da condição cond (exceto AL) e retorna o código de
+ * condição x86 (os 4 bits baixos de jcc e cmovcc) que vale se cond vale.
+ *
+ * Se as flags vêm de um SUBS (CMP) do próprio bloco, os operandos
+ * registrados são comparados com 'cmp', que dá ao x86 as mesmas flags
+ * (com C invertido, o empréstimo). Senão, o código chama
+ * BasicCPU::conditionHolds(), que calcula as flags se preciso.
+ * rax e rcx são alterados.
+ */
+uint8_t JitCPU::emitCondition(int cond)
+{
+	// EQ, NE, CS/HS, CC/LO, MI, PL, VS, VC, HI, LS, GE, LT, GT, LE
+	static const uint8_t subsCondition[COND_AL] = {
+		0x4, 0x5, 0x3, 0x2, 0x8, 0x9, 0x0, 0x1, 0x7, 0x6, 0xD, 0xC, 0xF, 0xE
+	};
+	
+	if ((blockFlagsOp == FlagsOp::FLAGS_SUB32) || (blockFlagsOp == FlagsOp::FLAGS_SUB64)) {
+		emit8(0x48); emit8(0x8B); emit8(0x87); emit32(offsetOf(&flagsA));	// mov rax, [rdi+flagsA]
+		emit8(0x48); emit8(0x8B); emit8(0x8F); emit32(offsetOf(&flagsB));	// mov rcx, [rdi+flagsB]
+		if (blockFlagsOp == FlagsOp::FLAGS_SUB64) {
+			emit8(0x48);
+		}
+		emit8(0x39); emit8(0xC8);										// cmp eax/rax, ecx/rcx
+		return subsCondition[cond];
+	}
+	
+	// a chamada preserva rdi, rsi e rdx (ver emitRetireBranch())
+	emit8(0x57); emit8(0x56); emit8(0x52);					// push rdi; push rsi; push rdx
+	emit8(0xBE); emit32(cond);								// mov esi, cond
+	emit8(0x48); emit8(0xB8); emit64((uint64_t)&JitCPU::jitConditionHolds);	// mov rax, jitConditionHolds
+	emit8(0xFF); emit8(0xD0);								// call rax
+	emit8(0x5A); emit8(0x5E); emit8(0x5F);					// pop rdx; pop rsi; pop rdi
+	emit8(0x85); emit8(0xC0);								// test eax, eax
+	return 0x5;												// NE
+}
+
+/**
+ * Sai do código gerado com PC = pc, devolvendo refund instruções ao budget
+ * (as instruções do bloco que não chegaram a ser executadas).
+ */
+void JitCPU::emitExit(uint64_t pc, JitExit exitCode, int refund)
+{
+	if (refund) {
+		emit8(0x48); emit8(0x83); emit8(0x02); emit8(refund);	// add qword [rdx], refund
+	}
+	emit8(0x48); emit8(0xB8); emit64(pc);							// mov rax, pc
+	emit8(0x48); emit8(0x89); emit8(0x87); emit32(offsetOf(&PC));	// mov [rdi+PC], rax
+	emit8(0xB8); emit32(exitCode);									// mov eax, exitCode
+	emit8(0xC3);													// ret
+}
+
+/**
+ * Grava o desvio em pc, do tipo kind, com próximo PC target, no lote do
+ * monitor de desvios, se houver, como BranchMonitor::retire() (o teste é
+ * feito no código gerado, que assim não depende do monitor). Só a
+ * execução dos preditores, quando o lote enche, sai do código gerado:
+ * rdi, rsi e rdx são preservados na pilha; com o endereço de retorno de
+ * entry e os três push, a pilha fica alinhada em 16 bytes para a chamada.
+ * r8 também é usado como temporário.
+ */
+void JitCPU::emitRetireBranch(uint64_t pc, uint64_t target, BranchKind kind)
+{
+	// como em BasicCPU::retireBranch(), B.cond é tomado se target != pc + 4
+	uint64_t taken = (kind == BRANCH_DIRECT) || (target != pc + 4);
+	int32_t events = (int32_t)BranchMonitor::eventsOffset();
+	int32_t pending = (int32_t)BranchMonitor::pendingOffset();
+	
+	emit8(0x48); emit8(0x8B); emit8(0x87); emit32(offsetOf(&branchMonitor));	// mov rax, [rdi+branchMonitor]
+	emit8(0x48); emit8(0x85); emit8(0xC0);					// test rax, rax
+	emit8(0x0F); emit8(0x84); emit32(0);					// je skip
+	uint8_t *skip = code;
+	emit8(0x48); emit8(0x63); emit8(0x88); emit32(pending);	// movsxd rcx, dword [rax+pending]
+	emit8(0x48); emit8(0x8D); emit8(0x0C); emit8(0x49);	// lea rcx, [rcx+rcx*2]
+	emit8(0x48); emit8(0x8D); emit8(0x8C); emit8(0xC8);
+	emit32(events);											// lea rcx, [rax+rcx*8+events]
+	emit8(0x49); emit8(0xB8); emit64(pc);					// mov r8, pc
+	emit8(0x4C); emit8(0x89); emit8(0x01);					// mov [rcx+PC], r8
+	emit8(0x49); emit8(0xB8); emit64(target);				// mov r8, target
+	emit8(0x4C); emit8(0x89); emit8(0x41); emit8(8);		// mov [rcx+next], r8
+	emit8(0x49); emit8(0xB8); emit64(kind | (taken << 32));	// mov r8, kind | taken << 32
+	emit8(0x4C); emit8(0x89); emit8(0x41); emit8(16);		// mov [rcx+kind], r8 (kind e taken)
+	emit8(0xFF); emit8(0x80); emit32(pending);				// inc dword [rax+pending]
+	emit8(0x81); emit8(0xB8); emit32(pending);
+	emit32(BRANCH_BATCH_SIZE);								// cmp dword [rax+pending], BRANCH_BATCH_SIZE
+	emit8(0x0F); emit8(0x85); emit32(0);					// jne skip
+	uint8_t *full = code;
+	emit8(0x57); emit8(0x56); emit8(0x52);					// push rdi; push rsi; push rdx
+	emit8(0x48); emit8(0x89); emit8(0xC7);					// mov rdi, rax
+	emit8(0x48); emit8(0xB8); emit64((uint64_t)&JitCPU::flushJitBranches);	// mov rax, flushJitBranches
+	emit8(0xFF); emit8(0xD0);								// call rax
+	emit8(0x5A); emit8(0x5E); emit8(0x5F);					// pop rdx; pop rsi; pop rdi
+	*(int32_t*)(skip - 4) = (int32_t)(code - skip);
+	*(int32_t*)(full - 4) = (int32_t)(code - full);
+}
+
+/**
+ * Soma a perf os contadores de blockPerf que não são 0: a saída no meio do
+ * bloco conta de uma vez as instruções executadas até ela (nada é gerado
+ * com NO_STATS, em que blockPerf fica em 0).
+ */
+void JitCPU::emitCounts()
+{
+	uint64_t *counts = (uint64_t*)&blockPerf;
+	uint64_t *counters = (uint64_t*)&perf;
+	
+	for (unsigned int i = 0; i < sizeof(PerfCounters) / sizeof(uint64_t); i++) {
+		if (counts[i] == 0) {
+			continue;
+		}
+		emit8(0x48);
+		if (counts[i] < 128) {
+			emit8(0x83); emit8(0x87); emit32(offsetOf(&counters[i]));
+			emit8(counts[i]);										// add qword [rdi+counter], imm8
+		} else {
+			emit8(0x81); emit8(0x87); emit32(offsetOf(&counters[i]));
+			emit32(counts[i]);										// add qword [rdi+counter], imm32
+		}
+	}
+}
+
+/**
+ * Conta uma execução completa do bloco em tradução (nada é gerado com
+ * NO_STATS). O contador fica logo após a área de código, ao alcance de um
+ * endereçamento relativo a rip.
+ */
+void JitCPU::emitCountBlock()
+{
+	if (PERF_ENABLED) {
+		emit8(0x48); emit8(0xFF); emit8(0x05); emit32(0);	// inc qword [rip+executions]
+		*(int32_t*)(code - 4) = (int32_t)((uint8_t*)blockExecutions - code);
+	}
+}
+
+void JitCPU::foldCounts()
+{
+	uint64_t *counters = (uint64_t*)&perf;
+	
+	for (unsigned long t = 0; t < translationCounts.size(); t++) {
+		uint64_t executions = translationExecutions[t];
+		if (executions == 0) {
+			continue;
+		}
+		uint64_t *counts = (uint64_t*)&translationCounts[t];
+		for (unsigned int i = 0; i < sizeof(PerfCounters) / sizeof(uint64_t); i++) {
+			counters[i] += executions * counts[i];
+		}
+		translationExecutions[t] = 0;
+	}
+}
+
+/**
+ * Chamado pelo código gerado quando o lote do monitor de desvios enche.
+ */
+void JitCPU::flushJitBranches(BranchMonitor *monitor)
+{
+	monitor->flush();
+}
+
+/**
+ * Chamado pelo código gerado para avaliar cond sobre as flags de antes do
+ * bloco (ou de um ADDS do bloco).
+ */
+int JitCPU::jitConditionHolds(JitCPU *cpu, int cond)
+{
+	return cpu->conditionHolds(cond);
+}
+
+/**
+ * Segue para o bloco que começa em pc. Se ele ainda não foi traduzido, o
+ * 'jmp' é ligado quando for e, até lá, o código sai para run().
+ */
+void JitCPU::emitJumpTo(uint64_t pc)
+{
+	JitBlock *target = &blockCache[(pc >> 2) & (JIT_BLOCK_CACHE_SIZE - 1)];
+	
+	emit8(0xE9); emit32(0);									// jmp rel32
+	if (target->valid && (target->PC == pc)) {
+		*(int32_t*)(code - 4) = (int32_t)(target->entry - code);
+		return;
+	}
+	
+	// jmp rel32 = 0 cai na saída logo abaixo até ser ligado
+	pendingJumps.insert(std::make_pair(pc, code - 4));
+	emitExit(pc, JitExit::JIT_EXIT_BRANCH, 0);
+}
+
+/**
+ * Descarta todo o código gerado.
+ */
+void JitCPU::flushJit()
+{
+	foldCounts();
+	translationCounts.clear();
+	for (int i = 0; i < JIT_BLOCK_CACHE_SIZE; i++) {
+		blockCache[i].valid = false;
+	}
+	pendingJumps.clear();
+	codeCacheUsed = 0;
+	codeLow = ULONG_MAX;
+	codeHigh = 0;
+	flushDecodeCache();
+	jitFlushes++;
+}
+
+void JitCPU::emit8(uint8_t value)
+{
+	*code++ = value;
+}
+
+void JitCPU::emit32(uint32_t value)
+{
+	memcpy(code, &value, 4);
+	code += 4;
+}
+
+void JitCPU::emit64(uint64_t value)
+{
+	memcpy(code, &value, 8);
+	code += 8;
+}
+
+/**
+ * Deslocamento de um campo desta CPU em relação a this (rdi no código
+ * gerado).
+ */
+int32_t JitCPU::offsetOf(void *field)
+{
+	return (int32_t)((char*)field - (char*)this);
+}
+
+unsigned long JitCPU::getBlocksCompiled() {
+	return blocksCompiled;
+}
+
+unsigned long JitCPU::getInterpretedInstructions() {
+	return interpretedInstructions;
+}
+
+unsigned long JitCPU::getJitFlushes() {
+	return jitFlushes;
+}
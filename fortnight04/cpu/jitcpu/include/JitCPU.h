@@ -0,0 +1,247 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) JitCPU - a BasicCPU with a dynamic binary translator that emits
+		x86-64 host code for each basic block of the A64 subset BasicCPU
+		implements. Encodings without a template run on the BasicCPU stages.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) JitCPU - uma BasicCPU com um tradutor binário dinâmico que gera código
+		x86-64 do hospedeiro para cada bloco básico do subconjunto A64
+		implementado por BasicCPU. Codificações sem modelo de tradução são
+		executadas pelos estágios de BasicCPU.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BasicCPU.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Cache de blocos: número de blocos (potência de 2), número máximo de
+// instruções por bloco, tamanho da área de código gerado e número máximo de
+// traduções entre dois descartes da área
+#define JIT_BLOCK_CACHE_SIZE 1024
+#define JIT_BLOCK_MAX_INSTRUCTIONS 64
+#define JIT_CODE_CACHE_SIZE (4 << 20)
+#define JIT_MAX_BLOCK_CODE (JIT_BLOCK_MAX_INSTRUCTIONS * 320)
+#define JIT_MAX_TRANSLATIONS (JIT_CODE_CACHE_SIZE / 128)
+
+/**
+ * Motivo da saída do código gerado.
+ *
+ * JIT_EXIT_BRANCH: o bloco terminou e PC tem o endereço do próximo bloco.
+ * JIT_EXIT_BUDGET: o limite de instruções não permite executar o bloco.
+ * JIT_EXIT_FAULT: acesso fora da memória (DATA_ABORT); PC aponta para a
+ *		instrução e dataAbortAddress tem o endereço acessado.
+ * JIT_EXIT_SMC: escrita sobre código traduzido; PC aponta para a próxima
+ *		instrução.
+ */
+enum JitExit {JIT_EXIT_BRANCH, JIT_EXIT_BUDGET, JIT_EXIT_FAULT, JIT_EXIT_SMC};
+
+/**
+ * Bloco traduzido para código do hospedeiro.
+ *
+ * entry é uma função int entry(JitCPU *cpu, char *data, long *budget):
+ * cpu dá acesso ao banco de registradores, data é a memória do convidado e
+ * budget é o número de instruções que ainda podem ser executadas.
+ */
+struct JitBlock {
+	uint64_t PC;			// endereço da primeira instrução (tag)
+	bool valid;
+	int count;				// número de instruções
+	uint8_t *entry;
+};
+
+class JitCPU: public BasicCPU
+{
+	protected:
+		/**
+		 * Memória acessada diretamente pelo código gerado. Se a memória
+		 * não for uma SimpleMemory (por exemplo, SimpleMemoryTest, que
+		 * registra os acessos), o JIT fica desligado e run() é o de
+		 * BasicCPU.
+		 */
+		char *data;
+		unsigned long dataSize;
+		bool jitEnabled;
+
+		/**
+		 * Área de código gerado e cache de blocos, mapeada diretamente
+		 * pelo PC inicial do bloco.
+		 */
+		uint8_t *codeCache;
+		unsigned long codeCacheUsed;
+		uint8_t *code;			// posição de emissão
+		JitBlock blockCache[JIT_BLOCK_CACHE_SIZE];
+
+		/**
+		 * Contadores de desempenho de cada tradução desde o último
+		 * flushJit(), na ordem em que foram geradas: execuções completas
+		 * ainda não somadas a perf (logo após a área de código, onde o
+		 * código gerado as incrementa) e contadores de uma execução
+		 * completa.
+		 *
+		 * Eles pertencem à tradução, e não à entrada da cache de blocos:
+		 * quando um bloco a 4 KiB de distância ocupa a entrada, o código
+		 * antigo continua a ser executado pelos desvios já ligados a ele.
+		 */
+		uint64_t *translationExecutions;
+		std::vector<PerfCounters> translationCounts;
+
+		/**
+		 * Desvios para blocos ainda não traduzidos: endereço do convidado
+		 * -> posição do 'jmp rel32' a ser ligado quando o bloco existir.
+		 */
+		std::multimap<uint64_t, uint8_t*> pendingJumps;
+
+		/**
+		 * Intervalo de endereços com código traduzido ou interpretado
+		 * (guardado na cache de instruções decodificadas). Lido pelo
+		 * código gerado após cada escrita na memória.
+		 */
+		uint64_t codeLow;
+		uint64_t codeHigh;
+
+		/**
+		 * Estende [codeLow, codeHigh) para conter as instruções em
+		 * [low, high).
+		 */
+		void coverCode(uint64_t low, uint64_t high);
+
+		/**
+		 * Contadores de desempenho das instruções já geradas do bloco em
+		 * tradução e seu contador de execuções. As saídas no meio do
+		 * bloco somam blockPerf a perf; a saída no fim só incrementa
+		 * blockExecutions.
+		 */
+		PerfCounters blockPerf;
+		uint64_t *blockExecutions;
+
+		/**
+		 * Operação do último ADDS/SUBS já gerado do bloco em tradução
+		 * (FLAGS_VALID se nenhum: as flags vêm de antes do bloco).
+		 */
+		FlagsOp blockFlagsOp;
+
+		/**
+		 * Soma a perf os contadores das execuções de todas as traduções e
+		 * zera as execuções.
+		 */
+		void foldCounts();
+
+		// estatísticas
+		unsigned long blocksCompiled = 0;
+		unsigned long interpretedInstructions = 0;
+		unsigned long jitFlushes = 0;
+
+		/**
+		 * Retorna o bloco que começa em PC, traduzindo-o se necessário, ou
+		 * nullptr se a instrução em PC não puder ser traduzida.
+		 */
+		JitBlock *lookupBlock();
+
+		/**
+		 * Traduz o bloco que começa em PC.
+		 *
+		 * Retorna 0: se traduziu corretamente e
+		 *		   1: se a primeira instrução não puder ser traduzida.
+		 */
+		int compileBlock(JitBlock *block);
+
+		/**
+		 * Informa se há modelo de tradução para a instrução decodificada.
+		 */
+		bool hasTemplate(DecodedInstruction *dec);
+
+		/**
+		 * Gera o código da instrução decodificada dec, que está no endereço
+		 * pc, é do grupo de decodificação group (PerfGroup) e é a instrução
+		 * index de um bloco de count instruções.
+		 */
+		void compileInstruction(DecodedInstruction *dec, uint64_t pc,
+				int group, int index, int count);
+
+		/**
+		 * Ciclo da máquina com o JIT ligado, a partir do PC atual (ver
+		 * run()).
+		 */
+		int runJit();
+
+		/**
+		 * Descarta todo o código gerado.
+		 */
+		void flushJit();
+
+		/**
+		 * Emissão de código x86-64.
+		 */
+		void emit8(uint8_t value);
+		void emit32(uint32_t value);
+		void emit64(uint64_t value);
+		int32_t offsetOf(void *field);
+		void emitLoadOperand(int n, uint64_t mask, uint64_t pc, bool rcx);
+		void emitLoadShifted(DecodedInstruction *dec, uint64_t pc);
+		uint8_t emitCondition(int cond);
+		void emitExit(uint64_t pc, JitExit exitCode, int refund);
+		void emitJumpTo(uint64_t pc);
+		void emitRetireBranch(uint64_t pc, uint64_t target, BranchKind kind);
+		void emitCounts();
+		void emitCountBlock();
+
+		/**
+		 * Executa os preditores sobre o lote cheio de monitor e avalia a
+		 * condição cond sobre as flags de cpu (chamados pelo código
+		 * gerado).
+		 */
+		static void flushJitBranches(BranchMonitor *monitor);
+		static int jitConditionHolds(JitCPU *cpu, int cond);
+
+	public:
+		JitCPU(Memory *memory);
+		~JitCPU();
+
+		/**
+		 * Métodos herdados de CPU
+		 */
+		int run(long startAddress);
+
+		/**
+		 * Estatísticas do JIT.
+		 */
+		unsigned long getBlocksCompiled();
+		unsigned long getInterpretedInstructions();
+		unsigned long getJitFlushes();
+};
@@ -0,0 +1,86 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) JitCPUTest - test class for JitCPU. Allows access to registers
+	and protected methods.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) JitCPUTest - classe de teste de JitCPU. Permite acesso aos
+	registradores e métodos protegidos.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "JitCPU.h"
+#include "Memory.h"
+
+class JitCPUTest: public JitCPU
+{
+	public:
+		JitCPUTest(Memory *memory);
+		
+		// registers
+		long getPC();
+		void setPC(long address);
+		void setSP(long address);
+		void setW(int n, int value);
+		void setX(int n, long value);
+
+		// flags
+		void resetFlags();
+
+		// IF
+		int getIR();
+		void runIF();
+		
+		// ID
+		int runID();
+		ALUctrlFlag getALUctrl();
+		MEMctrlFlag getMEMctrl();
+		WBctrlFlag getWBctrl();
+		long getA();
+		long getB();
+
+		// EXI
+		int runEXI();
+		long getALUout();
+		
+		// MEM
+		int runMEM();
+ 		long getMDR();
+		
+		// WB
+		int runWB();
+		unsigned long getRd();
+		
+};
@@ -0,0 +1,510 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "ThreadedCPU.h"
+
+ThreadedCPU::ThreadedCPU(Memory *memory)
+	: BasicCPU(memory)
+{
+	codeBuffer = new ThreadedInstruction[CODE_BUFFER_SIZE];
+	flushBlocks();
+	blockFlushes = 0;
+}
+
+ThreadedCPU::~ThreadedCPU()
+{
+	delete[] codeBuffer;
+}
+
+/**
+ * Leitura dos operandos de uma instrução traduzida, com a mesma semântica
+ * de BasicCPU::readOperands().
+ */
+#define READ_N(t) (*(t)->Rn & (t)->nMask)
+#define READ_M(t) (*(t)->Rm & (t)->mMask)
+
+/**
+ * Métodos herdados de CPU
+ *
+ * Cada tratador executa a instrução inteira e salta diretamente para o
+ * tratador da próxima instrução do bloco (NEXT). Ao fim do bloco, segue
+ * para o sucessor encadeado ou, se não houver, consulta a cache de blocos,
+ * traduzindo o bloco na primeira execução.
+ */
+int ThreadedCPU::run(long startAddress)
+{
+	// inicia PC com o valor de startAddress
+	PC = startAddress;
+
+	return runGuarded([this]() { return runBlocks(); });
+}
+
+int ThreadedCPU::runBlocks()
+{
+	static const void *handlers[THR_NUM_OPS] = {
+		&&stages, &&add_imm, &&sub_imm, &&add_reg, &&sub_reg,
+		&&load32_imm, &&load32_reg, &&load64_imm,
+		&&store32_imm, &&store64_imm, &&branch
+	};
+	TranslatedBlock *block;
+	TranslatedBlock *nextBlock;
+	ThreadedInstruction *t;
+	ThreadedInstruction *tEnd;
+	int64_t b;
+	unsigned long address;
+
+	if ((cpuError != CPUerrorCode::NONE) || processFinished) {
+		goto finish;
+	}
+
+// conta a instrução executada e segue para a próxima do bloco
+#define NEXT() \
+	PERF_COUNT(perf.groups[t->group]); \
+	instructionCount++; \
+	if (instructionCount == instructionLimit) { \
+		processFinished = true; \
+		goto finish; \
+	} \
+	if (++t == tEnd) { \
+		goto block_end; \
+	} \
+	goto *handlers[t->op]
+
+// depois de uma escrita na memória: se ela invalidou o próprio bloco, as
+// instruções seguintes são traduzidas de novo a partir de PC
+#define NEXT_AFTER_STORE() \
+	if (!block->valid) { \
+		tEnd = t + 1; \
+	} \
+	NEXT()
+
+// B: Rm deslocado somado ao imediato
+#define READ_B(t) \
+	b = READ_M(t); \
+	switch ((t)->shift) { \
+		case 0: b = b << (t)->amount; break; \
+		case 1: b = ((unsigned long) b) >> (t)->amount; break; \
+		case 2: \
+			if ((t)->mMask == REG_MASK_32) { \
+				b = (int64_t)(int32_t)b; \
+			} \
+			b = ((signed long) b) >> (t)->amount; \
+			break; \
+		case 3: b = ((int64_t)(int32_t)b) << (t)->amount; break; \
+		default: break; \
+	} \
+	b += (t)->imm
+
+	block = lookupBlock();
+	if (!block) {
+		cpuError = CPUerrorCode::ID_ERROR;
+		goto finish;
+	}
+
+block_enter:
+	t = block->code;
+	tEnd = t + block->count;
+	// sem profiler, a contagem nunca chega ao tamanho de um bloco
+	if (profileCountdown <= (unsigned long)block->count) {
+		profileBlock(block);
+	} else {
+		profileCountdown -= block->count;
+	}
+	goto *handlers[t->op];
+
+block_end:
+	// sucessor já encadeado
+	if (blockChaining) {
+		for (int i = 0; i < 2; i++) {
+			nextBlock = block->next[i];
+			if ((block->nextPC[i] == PC) && nextBlock
+					&& nextBlock->valid && (nextBlock->PC == PC)) {
+				chainHits++;
+				block = nextBlock;
+				goto block_enter;
+			}
+		}
+	}
+	
+	// consulta a cache de blocos e encadeia o sucessor
+	nextBlock = lookupBlock();
+	if (!nextBlock) {
+		cpuError = CPUerrorCode::ID_ERROR;
+		goto finish;
+	}
+	if (blockChaining && block->valid) {
+		int i = (block->next[0] && block->next[0]->valid) ? 1 : 0;
+		block->next[i] = nextBlock;
+		block->nextPC[i] = PC;
+	}
+	block = nextBlock;
+	goto block_enter;
+
+add_imm:
+	*t->Rd = (READ_N(t) + t->imm) & t->dMask;
+	PC += 4;
+	NEXT();
+
+sub_imm:
+	*t->Rd = (READ_N(t) - t->imm) & t->dMask;
+	PC += 4;
+	NEXT();
+
+add_reg:
+	READ_B(t);
+	*t->Rd = (READ_N(t) + b) & t->dMask;
+	PC += 4;
+	NEXT();
+
+sub_reg:
+	READ_B(t);
+	*t->Rd = (READ_N(t) - b) & t->dMask;
+	PC += 4;
+	NEXT();
+
+load32_imm:
+	*t->Rd = (int64_t)memory->readData32(READ_N(t) + t->imm) & t->dMask;
+	PERF_COUNT(perf.loads[PERF_WIDTH_32]);
+	PC += 4;
+	NEXT();
+
+load32_reg:
+	READ_B(t);
+	*t->Rd = (int64_t)memory->readData32(READ_N(t) + b) & t->dMask;
+	PERF_COUNT(perf.loads[PERF_WIDTH_32]);
+	PC += 4;
+	NEXT();
+
+load64_imm:
+	*t->Rd = memory->readData64(READ_N(t) + t->imm) & t->dMask;
+	PERF_COUNT(perf.loads[PERF_WIDTH_64]);
+	PC += 4;
+	NEXT();
+
+store32_imm:
+	address = READ_N(t) + t->imm;
+	memory->writeData32(address, *t->Rd);
+	PERF_COUNT(perf.stores[PERF_WIDTH_32]);
+	invalidateTranslations(address, 4);
+	PC += 4;
+	NEXT_AFTER_STORE();
+
+store64_imm:
+	address = READ_N(t) + t->imm;
+	memory->writeData64(address, *t->Rd);
+	PERF_COUNT(perf.stores[PERF_WIDTH_64]);
+	invalidateTranslations(address, 8);
+	PC += 4;
+	NEXT_AFTER_STORE();
+
+branch:
+	PC = *t->Rn + t->imm;
+	PERF_COUNT(perf.branches);
+	PERF_ADD(perf.takenBranches, PC != t->PC + 4);
+	if (branchMonitor) {
+		branchMonitor->retire(t->PC, PC, BRANCH_DIRECT, true);
+	}
+	NEXT();
+
+stages:
+	// instrução sem tratador especializado: executa pelos estágios
+	readOperands(&t->dec);
+	if (fpOP) {
+		if (EXF()) {
+			cpuError = CPUerrorCode::EXF_ERROR;
+			goto finish;
+		}
+	} else {
+		if (EXI()) {
+			cpuError = CPUerrorCode::EXI_ERROR;
+			goto finish;
+		}
+	}
+	if (MEM()) {
+		cpuError = CPUerrorCode::MEM_ERROR;
+		goto finish;
+	}
+	if (storeSize(MEMctrl)) {
+		invalidateTranslations(ALUout, storeSize(MEMctrl));
+	}
+	if (WB()) {
+		cpuError = CPUerrorCode::WB_ERROR;
+		goto finish;
+	}
+	if (Rd != &PC) {
+		PC += 4;
+	} else {
+		PERF_COUNT(perf.branches);
+		PERF_ADD(perf.takenBranches, PC != t->PC + 4);
+		if (branchMonitor) {
+			retireBranch(t->PC);
+		}
+	}
+	NEXT_AFTER_STORE();
+
+#undef NEXT
+#undef NEXT_AFTER_STORE
+#undef READ_B
+
+finish:
+	if (cpuError) {
+		return 1;
+	}
+	
+	return 0;
+}
+
+/**
+ * A amostra cai na instrução em que profileCountdown chegaria a 0, e os
+ * intervalos seguintes são sorteados enquanto couberem no bloco.
+ */
+void ThreadedCPU::profileBlock(TranslatedBlock *block)
+{
+	unsigned long left = profileCountdown;
+	
+	if (!profiler) {
+		profileCountdown = ULONG_MAX;
+		return;
+	}
+	while (left <= (unsigned long)block->count) {
+		ThreadedInstruction *t = &block->code[left - 1];
+		profileRecord(t->PC, t->dec.MEMctrl);
+		left += profiler->nextInterval();
+	}
+	profileCountdown = left - block->count;
+}
+
+/**
+ * Retorna o bloco que começa em PC, traduzindo-o se necessário, ou nullptr
+ * se a instrução em PC não estiver implementada.
+ */
+TranslatedBlock *ThreadedCPU::lookupBlock()
+{
+	TranslatedBlock *block = &blockCache[(PC >> 2) & (BLOCK_CACHE_SIZE - 1)];
+	
+	blockLookups++;
+	if (block->valid && (block->PC == PC)) {
+		return block;
+	}
+	
+	if (translateBlock(block)) {
+		return nullptr;
+	}
+	return block;
+}
+
+/**
+ * Traduz o bloco que começa em PC para a entrada block.
+ *
+ * Cada instrução do bloco é registrada em blockMap. Se a entrada do mapa já
+ * pertencer a outro bloco, esse bloco é invalidado, para que toda instrução
+ * traduzida possa ser encontrada quando for sobrescrita.
+ *
+ * Retorna 0: se traduziu corretamente e
+ *		   1: se a primeira instrução não estiver implementada.
+ */
+int ThreadedCPU::translateBlock(TranslatedBlock *block)
+{
+	uint64_t startPC = PC;
+	
+	if (codeBufferUsed + BLOCK_MAX_INSTRUCTIONS > CODE_BUFFER_SIZE) {
+		flushBlocks();
+	}
+	
+	block->valid = false;
+	block->PC = startPC;
+	block->count = 0;
+	block->code = &codeBuffer[codeBufferUsed];
+	block->next[0] = block->next[1] = nullptr;
+	block->nextPC[0] = block->nextPC[1] = 0;
+	
+	while (block->count < BLOCK_MAX_INSTRUCTIONS) {
+		ThreadedInstruction *t = &block->code[block->count];
+		
+		PC = startPC + 4 * block->count;
+		if (translate(t)) {
+			break; // instrução não implementada encerra o bloco
+		}
+		block->count++;
+		
+		BlockMapEntry *entry = &blockMap[(PC >> 2) & (BLOCK_CACHE_SIZE - 1)];
+		if (entry->block && (entry->block != block) && entry->block->valid) {
+			entry->block->valid = false;
+			blockInvalidations++;
+		}
+		entry->PC = PC;
+		entry->block = block;
+		
+		// instrução que escreve em PC (desvio) encerra o bloco
+		if ((t->op == ThreadedOp::THR_BRANCH) || (t->dec.d == REG_PC)) {
+			break;
+		}
+	}
+	PC = startPC;
+	
+	if (block->count == 0) {
+		return 1;
+	}
+	
+	codeBufferUsed += block->count;
+	block->valid = true;
+	blocksTranslated++;
+	return 0;
+}
+
+/**
+ * Busca e traduz a instrução em PC para a entrada t.
+ *
+ * A decodificação é a de BasicCPU; a tradução apenas escolhe o tratador
+ * especializado para a combinação de sinais de controle e resolve os
+ * índices de registradores em ponteiros.
+ *
+ * Retorna 0: se traduziu corretamente e
+ *		   1: se a instrução não estiver implementada.
+ */
+int ThreadedCPU::translate(ThreadedInstruction *t)
+{
+	DecodedInstruction *dec = &t->dec;
+	
+	IF();
+	if (decode(dec)) {
+		return 1; // instrução não implementada
+	}
+	
+	t->PC = PC;
+	t->group = PerfCounters::group(IR);
+	t->Rn = &R[dec->n];
+	t->nMask = dec->nMask;
+	t->Rm = &R[dec->m];
+	t->mMask = dec->mMask;
+	t->shift = dec->shift;
+	t->amount = dec->amount;
+	t->imm = dec->imm;
+	t->Rd = &R[dec->d];
+	t->dMask = dec->dMask;
+	
+	// formas com imediato têm m = REG_ZR
+	bool reg = (dec->m != REG_ZR);
+	
+	// escolhe o tratador
+	t->op = ThreadedOp::THR_STAGES;
+	if (dec->fpOP) {
+		// executa pelos estágios
+	} else if ((dec->MEMctrl == MEMctrlFlag::MEM_NONE)
+			&& (dec->WBctrl == WBctrlFlag::RegWrite) && !dec->MemtoReg) {
+		if ((dec->d == REG_PC) && (dec->n == REG_PC)
+				&& (dec->ALUctrl == ALUctrlFlag::ADD) && !reg) {
+			t->op = ThreadedOp::THR_BRANCH;
+		} else if (dec->ALUctrl == ALUctrlFlag::ADD) {
+			t->op = reg ? ThreadedOp::THR_ADD_REG : ThreadedOp::THR_ADD_IMM;
+		} else if (dec->ALUctrl == ALUctrlFlag::SUB) {
+			t->op = reg ? ThreadedOp::THR_SUB_REG : ThreadedOp::THR_SUB_IMM;
+		}
+		
+		// só o desvio pode escrever em PC
+		if ((dec->d == REG_PC) && (t->op != ThreadedOp::THR_BRANCH)) {
+			t->op = ThreadedOp::THR_STAGES;
+		}
+	} else if (dec->ALUctrl == ALUctrlFlag::ADD) {
+		if ((dec->MEMctrl == MEMctrlFlag::READ32) && dec->MemtoReg
+				&& (dec->WBctrl == WBctrlFlag::RegWrite)) {
+			t->op = reg ? ThreadedOp::THR_LOAD32_REG : ThreadedOp::THR_LOAD32_IMM;
+		} else if ((dec->MEMctrl == MEMctrlFlag::READ64) && dec->MemtoReg
+				&& (dec->WBctrl == WBctrlFlag::RegWrite) && !reg) {
+			t->op = ThreadedOp::THR_LOAD64_IMM;
+		} else if ((dec->MEMctrl == MEMctrlFlag::WRITE32)
+				&& (dec->WBctrl == WBctrlFlag::WB_NONE) && !reg) {
+			t->op = ThreadedOp::THR_STORE32_IMM;
+		} else if ((dec->MEMctrl == MEMctrlFlag::WRITE64)
+				&& (dec->WBctrl == WBctrlFlag::WB_NONE) && !reg) {
+			t->op = ThreadedOp::THR_STORE64_IMM;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+ * Invalida os blocos que contêm instruções nos size bytes escritos a partir
+ * de address.
+ */
+void ThreadedCPU::invalidateTranslations(unsigned long address, int size)
+{
+	for (unsigned long a = address & ~3UL; a < address + size; a += 4) {
+		BlockMapEntry *entry = &blockMap[(a >> 2) & (BLOCK_CACHE_SIZE - 1)];
+		if ((entry->PC == a) && entry->block && entry->block->valid) {
+			entry->block->valid = false;
+			entry->block = nullptr;
+			blockInvalidations++;
+		}
+	}
+}
+
+/**
+ * Descarta todos os blocos traduzidos e libera o buffer de código.
+ */
+void ThreadedCPU::flushBlocks()
+{
+	for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		blockCache[i].valid = false;
+		blockMap[i].block = nullptr;
+	}
+	codeBufferUsed = 0;
+	blockFlushes++;
+}
+
+void ThreadedCPU::setBlockChaining(bool enabled) {
+	blockChaining = enabled;
+}
+
+unsigned long ThreadedCPU::getBlocksTranslated() {
+	return blocksTranslated;
+}
+
+unsigned long ThreadedCPU::getBlockLookups() {
+	return blockLookups;
+}
+
+unsigned long ThreadedCPU::getChainHits() {
+	return chainHits;
+}
+
+unsigned long ThreadedCPU::getBlockInvalidations() {
+	return blockInvalidations;
+}
+
+unsigned long ThreadedCPU::getBlockFlushes() {
+	return blockFlushes;
+}
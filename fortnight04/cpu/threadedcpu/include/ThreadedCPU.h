@@ -0,0 +1,210 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) ThreadedCPU - a BasicCPU that executes threaded code: straight-line
+		instructions are translated once into basic blocks of specialized
+		handlers, chained with computed goto, and the blocks are chained
+		directly to their successors, skipping the IF-ID-EXI-MEM-WB stages.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) ThreadedCPU - uma BasicCPU que executa código encadeado (threaded code):
+		instruções sem desvio são traduzidas uma vez para blocos básicos de
+		tratadores especializados, encadeados com goto computado, e os blocos
+		são ligados diretamente aos seus sucessores, sem passar pelos
+		estágios IF-ID-EXI-MEM-WB.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BasicCPU.h"
+
+// Cache de blocos traduzidos: número de blocos (potência de 2), número
+// máximo de instruções por bloco e capacidade do buffer de código
+#define BLOCK_CACHE_SIZE 1024
+#define BLOCK_MAX_INSTRUCTIONS 64
+#define CODE_BUFFER_SIZE 8192
+
+/**
+ * Tratadores especializados da ThreadedCPU.
+ *
+ * THR_STAGES executa a instrução pelos estágios de BasicCPU e é usado para
+ * qualquer instrução decodificada que não tenha tratador especializado.
+ */
+enum ThreadedOp {THR_STAGES, THR_ADD_IMM, THR_SUB_IMM, THR_ADD_REG,
+		THR_SUB_REG, THR_LOAD32_IMM, THR_LOAD32_REG, THR_LOAD64_IMM,
+		THR_STORE32_IMM, THR_STORE64_IMM, THR_BRANCH, THR_NUM_OPS};
+
+/**
+ * Instrução traduzida.
+ *
+ * Os operandos já apontam para os registradores do banco, de forma que o
+ * tratador não precisa resolver índices. As máscaras são as da instrução
+ * decodificada (REG_MASK_32 para Wn).
+ */
+struct ThreadedInstruction {
+	uint64_t PC;			// endereço da instrução
+	ThreadedOp op;			// tratador
+	int group;				// grupo de decodificação (PerfGroup)
+
+	uint64_t *Rn;
+	uint64_t nMask;
+	uint64_t *Rm;
+	uint64_t mMask;
+	int shift;
+	int amount;
+	int64_t imm;
+	uint64_t *Rd;
+	uint64_t dMask;
+
+	// instrução decodificada, usada por THR_STAGES
+	DecodedInstruction dec;
+};
+
+/**
+ * Bloco básico traduzido.
+ *
+ * Sequência de instruções traduzidas que começa em PC e termina na primeira
+ * instrução que escreve em PC (desvio), antes de uma instrução não
+ * implementada ou ao atingir BLOCK_MAX_INSTRUCTIONS. Os dois últimos
+ * sucessores executados ficam encadeados em next/nextPC, de forma que a
+ * execução passa de um bloco ao seguinte sem consultar a cache.
+ */
+struct TranslatedBlock {
+	uint64_t PC;			// endereço da primeira instrução (tag)
+	bool valid;
+	int count;				// número de instruções
+	ThreadedInstruction *code;
+
+	TranslatedBlock *next[2];
+	uint64_t nextPC[2];
+};
+
+/**
+ * Entrada do mapa instrução -> bloco, usado para invalidar o bloco que
+ * contém uma instrução sobrescrita.
+ */
+struct BlockMapEntry {
+	uint64_t PC;
+	TranslatedBlock *block;
+};
+
+class ThreadedCPU: public BasicCPU
+{
+	protected:
+		/**
+		 * Cache de blocos, mapeada diretamente pelo PC inicial do bloco, e
+		 * buffer de onde as instruções traduzidas são alocadas.
+		 */
+		TranslatedBlock blockCache[BLOCK_CACHE_SIZE];
+		BlockMapEntry blockMap[BLOCK_CACHE_SIZE];
+		ThreadedInstruction *codeBuffer;
+		int codeBufferUsed;
+		bool blockChaining = true;
+
+		// estatísticas da cache de blocos
+		unsigned long blocksTranslated = 0;
+		unsigned long blockLookups = 0;
+		unsigned long chainHits = 0;
+		unsigned long blockInvalidations = 0;
+		unsigned long blockFlushes = 0;
+
+		/**
+		 * Busca e traduz a instrução em PC para a entrada t.
+		 *
+		 * Retorna 0: se traduziu corretamente e
+		 *		   1: se a instrução não estiver implementada.
+		 */
+		int translate(ThreadedInstruction *t);
+
+		/**
+		 * Retorna o bloco que começa em PC, traduzindo-o se necessário, ou
+		 * nullptr se a instrução em PC não estiver implementada.
+		 */
+		TranslatedBlock *lookupBlock();
+
+		/**
+		 * Traduz o bloco que começa em PC para a entrada block.
+		 *
+		 * Retorna 0: se traduziu corretamente e
+		 *		   1: se a primeira instrução não estiver implementada.
+		 */
+		int translateBlock(TranslatedBlock *block);
+
+		/**
+		 * Invalida os blocos que contêm instruções nos size bytes escritos a
+		 * partir de address.
+		 */
+		void invalidateTranslations(unsigned long address, int size);
+
+		/**
+		 * Registra no profiler as amostras que caem em block, que vai
+		 * ser executado a partir da primeira instrução. O bloco é
+		 * amostrado como se fosse executado inteiro.
+		 */
+		void profileBlock(TranslatedBlock *block);
+
+		/**
+		 * Ciclo da máquina sobre os blocos traduzidos, a partir do PC
+		 * atual (ver run()).
+		 */
+		int runBlocks();
+
+	public:
+		ThreadedCPU(Memory *memory);
+		~ThreadedCPU();
+
+		/**
+		 * Métodos herdados de CPU
+		 */
+		int run(long startAddress);
+
+		/**
+		 * Liga ou desliga o encadeamento direto entre blocos. Desligado,
+		 * todo fim de bloco consulta a cache de blocos.
+		 */
+		void setBlockChaining(bool enabled);
+
+		/**
+		 * Descarta todos os blocos traduzidos.
+		 */
+		void flushBlocks();
+
+		/**
+		 * Estatísticas da cache de blocos.
+		 */
+		unsigned long getBlocksTranslated();
+		unsigned long getBlockLookups();
+		unsigned long getChainHits();
+		unsigned long getBlockInvalidations();
+		unsigned long getBlockFlushes();
+};
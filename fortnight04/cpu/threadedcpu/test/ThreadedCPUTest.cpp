@@ -0,0 +1,127 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "ThreadedCPUTest.h"
+
+/**
+ * Start PC without executing machine cycles.
+ */
+ThreadedCPUTest::ThreadedCPUTest(Memory *memory)
+	: ThreadedCPU(memory)
+{
+}
+	
+void ThreadedCPUTest::setPC(long address) {
+	PC = address;
+}
+
+long ThreadedCPUTest::getPC() {
+	return PC;
+}
+
+void ThreadedCPUTest::setSP(long address) {
+	SP = address;
+}
+
+void ThreadedCPUTest::resetFlags() {
+	ALUctrl = ALUctrlFlag::ALU_UNDEF;
+	fpOP = false;
+	MEMctrl = MEMctrlFlag::MEM_UNDEF;
+	WBctrl = WBctrlFlag::WB_UNDEF;
+}
+	
+int ThreadedCPUTest::getIR() {
+	return IR;
+}
+
+void ThreadedCPUTest::setW(int n, int value) {
+	setRegister(n, (uint32_t)value); // Wn estendido com zeros para Xn
+}
+
+void ThreadedCPUTest::setX(int n, long value) {
+	setRegister(n, value);
+}
+
+long ThreadedCPUTest::getA() {
+	return A;
+}
+
+long ThreadedCPUTest::getB() {
+	return B;
+}
+
+ALUctrlFlag ThreadedCPUTest::getALUctrl() {
+	return ALUctrl;
+}
+	
+MEMctrlFlag ThreadedCPUTest::getMEMctrl() {
+	return MEMctrl;
+}
+	
+WBctrlFlag ThreadedCPUTest::getWBctrl() {
+	return WBctrl;
+}
+	
+long ThreadedCPUTest::getALUout() {
+	return ALUout;
+}
+
+long ThreadedCPUTest::getMDR() {
+	return MDR;
+}
+
+void ThreadedCPUTest::runIF() {
+	IF();
+}
+
+int ThreadedCPUTest::runID() {
+	return ID();
+}
+
+int ThreadedCPUTest::runEXI() {
+	return EXI();
+}
+
+int ThreadedCPUTest::runMEM() {
+	return MEM();
+}
+
+int ThreadedCPUTest::runWB() {
+	return WB();
+}
+
+unsigned long ThreadedCPUTest::getRd() {
+	return *Rd;
+}
@@ -0,0 +1,591 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "config.h"
+
+#include "SimpleMemory.h"
+#include "PagedMemory.h"
+#include "TLBMemory.h"
+#include "BasicCPU.h"
+#include "InlineCPU.h"
+#include "ThreadedCPU.h"
+#include "JitCPU.h"
+#include "BasicProcessor.h"
+#include "BranchMonitor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Farm de simulações: executa, em um único processo, os jobs de um
+ * manifesto em um pool de threads com roubo de trabalho (work stealing).
+ *
+ * Cada linha do manifesto descreve um job (linhas vazias e iniciadas por #
+ * são ignoradas):
+ *
+ *	binário endereço_inicial tamanho_da_memória CPU memória [limite]
+ *
+ * Os números aceitam os prefixos 0x (hexadecimal) e 0 (octal). CPU é
+ * BasicCPU, InlineCPU, ThreadedCPU ou JitCPU; memória é SimpleMemory,
+ * PagedMemory ou TLBMemory (nas duas últimas, o tamanho da memória só
+ * define o topo da pilha); o limite de instruções é opcional (0: sem
+ * limite). Cada job tem sua própria memória e seu próprio BasicProcessor,
+ * com a pilha no fim da memória.
+ *
+ * Os desvios retirados por cada job passam por um BranchMonitor, e o
+ * resumo traz o MPKI de cada preditor e os desvios estáticos com mais
+ * erros. Sem -bp, os jobs de BasicCPU e InlineCPU usam os preditores
+ * padrão (BRANCH_DEFAULT_PREDICTORS, de custo baixo; ver BranchMonitor) e
+ * os de ThreadedCPU e JitCPU rodam sem monitor, que custaria boa parte da
+ * sua velocidade. A opção -bp vale para todos os jobs: escolhe os
+ * preditores (lista separada por vírgulas, default para
+ * BRANCH_DEFAULT_PREDICTORS, all para BRANCH_ALL_PREDICTORS) ou desliga o
+ * monitor (none). Jobs sem monitor ficam sem MPKI no resumo.
+ *
+ * O JSON traz também os contadores de desempenho (PerfCounters) da CPU de
+ * cada job.
+ *
+ * Uso: farm manifesto [-j threads] [-csv arquivo] [-json arquivo] [-bp preditores]
+ */
+
+// Desvios estáticos com mais erros listados por job no JSON
+#define FARM_HOT_BRANCHES 5
+
+/**
+ * Job do manifesto e seu resultado.
+ */
+struct FarmJob {
+	int line;					// linha do manifesto
+	string binary;
+	unsigned long startAddress;
+	unsigned long memorySize;
+	string cpuImpl;
+	string memImpl;
+	unsigned long instructionLimit;
+	string predictors;			// preditores de desvios ("": nenhum)
+
+	int exitCode = -1;			// retorno de Processor::run() (-1: não executado)
+	string error;				// erro da CPU ou do job
+	unsigned long instructions = 0;
+	double seconds = 0;
+	double mips = 0;
+	int worker = -1;			// thread que executou o job
+
+	unsigned long branches = 0;
+	vector<double> mpki;		// MPKI de cada preditor
+	vector<BranchSite> hotBranches;	// desvios estáticos com mais erros
+
+	PerfCounters perf;			// contadores de desempenho da CPU
+};
+
+/**
+ * Lê o manifesto filename em jobs.
+ *
+ * Retorna 0: se leu corretamente e
+ *		   1: se o arquivo não existir ou alguma linha for inválida.
+ */
+int readManifest(string filename, vector<FarmJob> &jobs)
+{
+	ifstream file(filename);
+	string text;
+	int line = 0;
+
+	if (!file.is_open()) {
+		cerr << "Não foi possível abrir o manifesto " << filename << endl;
+		return 1;
+	}
+	while (getline(file, text)) {
+		line++;
+		size_t first = text.find_first_not_of(" \t\r");
+		if ((first == string::npos) || (text[first] == '#')) {
+			continue;
+		}
+
+		istringstream fields(text);
+		string start, size, limit = "0";
+		FarmJob job;
+		
+		job.line = line;
+		if (!(fields >> job.binary >> start >> size >> job.cpuImpl >> job.memImpl)) {
+			cerr << filename << ":" << line << ": job incompleto" << endl;
+			return 1;
+		}
+		fields >> limit;
+		try {
+			job.startAddress = stoul(start, nullptr, 0);
+			job.memorySize = stoul(size, nullptr, 0);
+			job.instructionLimit = stoul(limit, nullptr, 0);
+		} catch (exception &e) {
+			cerr << filename << ":" << line << ": número inválido" << endl;
+			return 1;
+		}
+		jobs.push_back(job);
+	}
+	return 0;
+}
+
+/**
+ * Cria a memória e a CPU escolhidas pelo job, ou nullptr se a
+ * implementação não existir.
+ */
+Memory *newFarmMemory(FarmJob &job)
+{
+	if (job.memImpl == "SimpleMemory") {
+		return new SimpleMemory(job.memorySize);
+	}
+	if (job.memImpl == "PagedMemory") {
+		return new PagedMemory(job.memorySize);
+	}
+	if (job.memImpl == "TLBMemory") {
+		return new TLBMemory(job.memorySize);
+	}
+	return nullptr;
+}
+
+BasicCPU *newFarmCPU(FarmJob &job, Memory *memory)
+{
+	if (job.cpuImpl == "BasicCPU") {
+		return new BasicCPU(memory);
+	}
+	if ((job.cpuImpl == "InlineCPU") && (job.memImpl == "SimpleMemory")) {
+		return new InlineCPU<SimpleMemory>(static_cast<SimpleMemory*>(memory));
+	}
+	if ((job.cpuImpl == "InlineCPU") && (job.memImpl == "PagedMemory")) {
+		return new InlineCPU<PagedMemory>(static_cast<PagedMemory*>(memory));
+	}
+	if ((job.cpuImpl == "InlineCPU") && (job.memImpl == "TLBMemory")) {
+		return new InlineCPU<TLBMemory>(static_cast<TLBMemory*>(memory));
+	}
+	if (job.cpuImpl == "ThreadedCPU") {
+		return new ThreadedCPU(memory);
+	}
+	if (job.cpuImpl == "JitCPU") {
+		return new JitCPU(memory);
+	}
+	return nullptr;
+}
+
+/**
+ * Guarda no job o MPKI de cada preditor e os FARM_HOT_BRANCHES desvios
+ * estáticos com mais erros (somados entre os preditores).
+ */
+void collectBranches(FarmJob &job, BranchMonitor *monitor)
+{
+	int predictors = monitor->getPredictorCount();
+	
+	job.branches = monitor->getBranches();
+	for (int p = 0; p < predictors; p++) {
+		job.mpki.push_back(monitor->getMPKI(p, job.instructions));
+	}
+	
+	auto errors = [predictors](const BranchSite &site) {
+		unsigned long sum = 0;
+		for (int p = 0; p < predictors; p++) {
+			sum += site.mispredictions[p];
+		}
+		return sum;
+	};
+	job.hotBranches = monitor->getSites();
+	stable_sort(job.hotBranches.begin(), job.hotBranches.end(),
+			[&](const BranchSite &a, const BranchSite &b) {
+		return errors(a) > errors(b);
+	});
+	if (job.hotBranches.size() > FARM_HOT_BRANCHES) {
+		job.hotBranches.resize(FARM_HOT_BRANCHES);
+	}
+}
+
+/**
+ * Executa o job: cria memória e processador, carrega o binário e executa a
+ * partir do endereço inicial. Apenas a execução é cronometrada.
+ */
+void runJob(FarmJob &job)
+{
+	ifstream file(job.binary, ios::in|ios::binary|ios::ate);
+	if (!file.is_open()) {
+		job.error = "binário não encontrado";
+		return;
+	}
+	if ((unsigned long)file.tellg() > job.memorySize) {
+		job.error = "binário maior que a memória";
+		return;
+	}
+	file.close();
+
+	Memory *memory = newFarmMemory(job);
+	if (!memory) {
+		job.error = "memória desconhecida: " + job.memImpl;
+		return;
+	}
+	BasicCPU *cpu = newFarmCPU(job, memory);
+	if (!cpu) {
+		job.error = "CPU desconhecida: " + job.cpuImpl;
+		delete memory;
+		return;
+	}
+	cpu->setStackPointer(job.memorySize);
+	cpu->setInstructionLimit(job.instructionLimit);
+	BranchMonitor *monitor = nullptr;
+	if (!job.predictors.empty()) {
+		monitor = new BranchMonitor();
+		monitor->addPredictors(job.predictors);
+		cpu->setBranchMonitor(monitor);
+	}
+	Processor *processor = new BasicProcessor(memory, cpu);
+
+	memory->loadBinary(job.binary);
+
+	auto start = chrono::steady_clock::now();
+	job.exitCode = processor->run(job.startAddress);
+	auto end = chrono::steady_clock::now();
+
+	job.seconds = chrono::duration<double>(end - start).count();
+	job.instructions = cpu->getInstructionCount();
+	job.mips = (job.seconds > 0) ? job.instructions / job.seconds / 1e6 : 0;
+	job.error = PerfCounters::errorName(cpu->getError());
+	job.perf = *cpu->getPerfCounters();
+	if (monitor) {
+		collectBranches(job, monitor);
+	}
+
+	delete processor;
+	delete monitor;
+	delete memory;
+}
+
+/**
+ * Pool de threads com roubo de trabalho.
+ *
+ * Cada thread tem sua fila de jobs (índices em jobs), distribuídos
+ * inicialmente em rodízio. A thread retira jobs do fim da própria fila e,
+ * quando ela esvazia, rouba do início da fila das demais. Como jobs não
+ * criam novos jobs, uma thread que não encontra nada para roubar termina.
+ */
+class FarmPool
+{
+	public:
+		FarmPool(vector<FarmJob> &jobs, int threads) : jobs(jobs), queues(threads) {
+			for (unsigned int i = 0; i < jobs.size(); i++) {
+				queues[i % threads].jobs.push_back(i);
+			}
+		};
+
+		/**
+		 * Executa todos os jobs e espera o fim de todas as threads.
+		 */
+		void run() {
+			vector<thread> threads;
+			for (unsigned int i = 0; i < queues.size(); i++) {
+				threads.emplace_back(&FarmPool::worker, this, i);
+			}
+			for (thread &t : threads) {
+				t.join();
+			}
+		};
+
+		unsigned long getSteals() {
+			unsigned long steals = 0;
+			for (WorkQueue &q : queues) {
+				steals += q.steals;
+			}
+			return steals;
+		};
+
+	private:
+		struct WorkQueue {
+			mutex lock;
+			deque<int> jobs;
+			unsigned long steals = 0;	// jobs roubados por esta thread
+		};
+
+		vector<FarmJob> &jobs;
+		vector<WorkQueue> queues;
+
+		/**
+		 * Próximo job da thread self (-1: não há mais jobs).
+		 */
+		int nextJob(int self) {
+			{
+				lock_guard<mutex> guard(queues[self].lock);
+				if (!queues[self].jobs.empty()) {
+					int job = queues[self].jobs.back();
+					queues[self].jobs.pop_back();
+					return job;
+				}
+			}
+			for (unsigned int i = 1; i < queues.size(); i++) {
+				WorkQueue &victim = queues[(self + i) % queues.size()];
+				lock_guard<mutex> guard(victim.lock);
+				if (!victim.jobs.empty()) {
+					int job = victim.jobs.front();
+					victim.jobs.pop_front();
+					queues[self].steals++;
+					return job;
+				}
+			}
+			return -1;
+		};
+
+		void worker(int self) {
+			int job;
+			while ((job = nextJob(self)) != -1) {
+				jobs[job].worker = self;
+				runJob(jobs[job]);
+			}
+		};
+};
+
+/**
+ * Texto entre aspas, com escape, para CSV e JSON.
+ */
+static string quoteCSV(const string &text)
+{
+	string quoted = "\"";
+	for (char c : text) {
+		if (c == '"') {
+			quoted += '"';
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+static string quoteJSON(const string &text)
+{
+	string quoted = "\"";
+	for (char c : text) {
+		if ((c == '"') || (c == '\\')) {
+			quoted += '\\';
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+/**
+ * Resumo dos jobs em CSV (uma linha por job), com uma coluna de MPKI por
+ * preditor de predictors.
+ */
+void writeCSV(string filename, vector<FarmJob> &jobs, vector<string> &predictors)
+{
+	ofstream ofp(filename);
+	ofp << "line,binary,start,memory,cpu,mem,limit,exit,error,instructions,seconds,mips,branches";
+	for (string &name : predictors) {
+		ofp << ",mpki_" << name;
+	}
+	ofp << endl;
+	for (FarmJob &job : jobs) {
+		ofp << job.line << "," << quoteCSV(job.binary) << ","
+				<< job.startAddress << "," << job.memorySize << ","
+				<< job.cpuImpl << "," << job.memImpl << ","
+				<< job.instructionLimit << "," << job.exitCode << ","
+				<< quoteCSV(job.error) << "," << job.instructions << ","
+				<< fixed << setprecision(6) << job.seconds << ","
+				<< setprecision(1) << job.mips << "," << job.branches;
+		for (unsigned int p = 0; p < predictors.size(); p++) {
+			ofp << ",";
+			if (p < job.mpki.size()) {
+				ofp << setprecision(3) << job.mpki[p];
+			}
+		}
+		ofp << endl;
+	}
+}
+
+/**
+ * MPKI de cada preditor de predictors (valores em mpki), como objeto JSON
+ * (vazio para um job sem monitor).
+ */
+static string mpkiJSON(vector<string> &predictors, vector<double> mpki)
+{
+	ostringstream text;
+	text << "{" << fixed << setprecision(3);
+	for (unsigned int p = 0; (p < predictors.size()) && (p < mpki.size()); p++) {
+		text << (p ? ", " : "") << quoteJSON(predictors[p]) << ": " << mpki[p];
+	}
+	text << "}";
+	return text.str();
+}
+
+/**
+ * Resumo em JSON: totais e a lista de jobs.
+ */
+void writeJSON(string filename, vector<FarmJob> &jobs, int threads,
+		double wallSeconds, unsigned long instructions, vector<string> &predictors)
+{
+	ofstream ofp(filename);
+	ofp << "{" << endl
+			<< "  \"threads\": " << threads << "," << endl
+			<< "  \"jobs\": " << jobs.size() << "," << endl
+			<< "  \"instructions\": " << instructions << "," << endl
+			<< fixed << setprecision(6)
+			<< "  \"wall_seconds\": " << wallSeconds << "," << endl
+			<< setprecision(1)
+			<< "  \"mips\": " << instructions / wallSeconds / 1e6 << "," << endl
+			<< "  \"results\": [" << endl;
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		FarmJob &job = jobs[i];
+		ofp << "    {\"line\": " << job.line
+				<< ", \"binary\": " << quoteJSON(job.binary)
+				<< ", \"start\": " << job.startAddress
+				<< ", \"memory\": " << job.memorySize
+				<< ", \"cpu\": " << quoteJSON(job.cpuImpl)
+				<< ", \"mem\": " << quoteJSON(job.memImpl)
+				<< ", \"limit\": " << job.instructionLimit
+				<< ", \"exit\": " << job.exitCode
+				<< ", \"error\": " << quoteJSON(job.error)
+				<< ", \"instructions\": " << job.instructions
+				<< setprecision(6) << ", \"seconds\": " << job.seconds
+				<< setprecision(1) << ", \"mips\": " << job.mips
+				<< ", \"branches\": " << job.branches
+				<< ", \"mpki\": " << mpkiJSON(predictors, job.mpki)
+				<< ", \"perf\": ";
+		job.perf.writeJSON(ofp);
+		ofp << ", \"hot_branches\": [";
+		for (unsigned int h = 0; h < job.hotBranches.size(); h++) {
+			BranchSite &site = job.hotBranches[h];
+			vector<double> mpki;
+			for (unsigned int p = 0; p < predictors.size(); p++) {
+				mpki.push_back(job.instructions
+						? 1000.0 * site.mispredictions[p] / job.instructions : 0);
+			}
+			ofp << (h ? ", " : "") << "{\"pc\": " << site.PC
+					<< ", \"kind\": " << quoteJSON(BranchMonitor::kindName(site.kind))
+					<< ", \"executed\": " << site.executed
+					<< ", \"taken\": " << site.taken
+					<< ", \"mpki\": " << mpkiJSON(predictors, mpki) << "}";
+		}
+		ofp << "]}" << ((i + 1 < jobs.size()) ? "," : "") << endl;
+	}
+	ofp << "  ]" << endl << "}" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+	string manifest;
+	string csvFile = "farm.csv";
+	string jsonFile = "farm.json";
+	string predictorList = BRANCH_DEFAULT_PREDICTORS;
+	bool predictorsChosen = false;
+	int threads = thread::hardware_concurrency();
+	vector<FarmJob> jobs;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if ((arg == "-j") && (i + 1 < argc)) {
+			threads = atoi(argv[++i]);
+		} else if ((arg == "-csv") && (i + 1 < argc)) {
+			csvFile = argv[++i];
+		} else if ((arg == "-json") && (i + 1 < argc)) {
+			jsonFile = argv[++i];
+		} else if ((arg == "-bp") && (i + 1 < argc)) {
+			predictorList = argv[++i];
+			predictorsChosen = true;
+		} else {
+			manifest = arg;
+		}
+	}
+	if (manifest.empty()) {
+		cerr << "Uso: " << argv[0]
+				<< " manifesto [-j threads] [-csv arquivo] [-json arquivo] [-bp preditores]" << endl;
+		return 2;
+	}
+	if (predictorList == "none") {
+		predictorList = "";
+	} else if (predictorList == "default") {
+		predictorList = BRANCH_DEFAULT_PREDICTORS;
+	} else if (predictorList == "all") {
+		predictorList = BRANCH_ALL_PREDICTORS;
+	}
+	BranchMonitor check;
+	if (!predictorList.empty() && check.addPredictors(predictorList)) {
+		cerr << "Preditores de desvios inválidos: " << predictorList << endl;
+		return 2;
+	}
+	vector<string> predictors;
+	for (int p = 0; p < check.getPredictorCount(); p++) {
+		predictors.push_back(check.getPredictor(p)->getName());
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	if (readManifest(manifest, jobs)) {
+		return 2;
+	}
+	for (FarmJob &job : jobs) {
+		if (predictorsChosen || ((job.cpuImpl != "ThreadedCPU")
+				&& (job.cpuImpl != "JitCPU"))) {
+			job.predictors = predictorList;
+		}
+	}
+
+	FarmPool pool(jobs, threads);
+	auto start = chrono::steady_clock::now();
+	pool.run();
+	auto end = chrono::steady_clock::now();
+	double wallSeconds = chrono::duration<double>(end - start).count();
+
+	unsigned long instructions = 0;
+	int failed = 0;
+	for (FarmJob &job : jobs) {
+		instructions += job.instructions;
+		if (job.exitCode != 0) {
+			failed++;
+		}
+	}
+
+	writeCSV(csvFile, jobs, predictors);
+	writeJSON(jsonFile, jobs, threads, wallSeconds, instructions, predictors);
+
+	cout << jobs.size() << " jobs em " << threads << " threads ("
+			<< pool.getSteals() << " roubados), "
+			<< failed << " com erro" << endl
+			<< instructions << " instruções em " << fixed << setprecision(3)
+			<< wallSeconds << " s: " << setprecision(1)
+			<< instructions / wallSeconds / 1e6 << " MIPS agregados" << endl
+			<< "Resumo em " << csvFile << " e " << jsonFile << endl;
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BranchPredictor - interface of the branch predictors
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BranchPredictor - interface dos preditores de desvios
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Tipo do desvio retirado.
+ *
+ * BRANCH_CONDITIONAL: B.cond (e, futuramente, CBZ/CBNZ, TBZ/TBNZ).
+ * BRANCH_DIRECT: B, sempre tomado, destino relativo ao PC.
+ * BRANCH_CALL: BL/BLR, escreve o endereço de retorno em X30.
+ * BRANCH_RETURN: RET, destino em registrador (X30).
+ * BRANCH_INDIRECT: BR, destino em registrador.
+ *
+ * BL, BLR, RET e BR ainda não são decodificados, então a CPU só retira
+ * desvios BRANCH_CONDITIONAL e BRANCH_DIRECT.
+ */
+enum BranchKind {BRANCH_CONDITIONAL, BRANCH_DIRECT, BRANCH_CALL,
+		BRANCH_RETURN, BRANCH_INDIRECT, BRANCH_KINDS};
+
+/**
+ * Desvio retirado pela CPU: endereço, próximo PC executado (PC + 4 se não
+ * foi tomado), tipo e direção.
+ */
+struct BranchEvent {
+	uint64_t PC;
+	uint64_t next;
+	uint32_t kind;			// BranchKind
+	uint32_t taken;
+};
+
+/**
+ * Preditor de desvios.
+ *
+ * Os desvios chegam em lotes (ver BranchMonitor): cada preditor percorre o
+ * lote inteiro, predizendo e atualizando um desvio de cada vez, como se
+ * fosse predito na busca e atualizado ao ser retirado. Assim há uma
+ * chamada virtual por lote, e não por desvio, e as tabelas do preditor
+ * ficam na cache do hospedeiro durante o lote.
+ *
+ * Preditores de direção (bimodal, gshare, TAGE) só erram em desvios
+ * condicionais: o destino dos demais é dado pela decodificação ou por um
+ * preditor de destino. Preditores de destino (BTB) predizem o próximo
+ * PC de qualquer desvio.
+ */
+class BranchPredictor
+{
+	public:
+		virtual ~BranchPredictor() {};
+
+		/**
+		 * Nome curto do preditor (usado em relatórios, CSV e JSON).
+		 */
+		virtual const char *getName() = 0;
+
+		/**
+		 * Prediz e atualiza, em ordem, os count desvios de events.
+		 * mispredicted[i] recebe 1 se a predição de events[i] errou e 0
+		 * se acertou.
+		 */
+		virtual void simulate(const BranchEvent *events, int count,
+				uint8_t *mispredicted) = 0;
+
+		/**
+		 * Volta ao estado inicial (tabelas e históricos).
+		 */
+		virtual void reset() = 0;
+};
@@ -43,13 +43,31 @@
 #pragma once
 
 #include "Memory.h"
+#include "PerfCounters.h"
+
+class PCProfiler;
 
 class CPU
 {
 public:
-	enum CPUerrorCode {NONE}; // ATIVIDADE FUTURA: acrescentar erros
+	// NONE: sem erro; XX_ERROR: o estágio XX não implementa a instrução;
+	// DATA_ABORT: acesso fora da memória do convidado (ver GuestFault.h)
+	enum CPUerrorCode {NONE, ID_ERROR, EXI_ERROR, EXF_ERROR, MEM_ERROR, WB_ERROR,
+			DATA_ABORT};
+	virtual ~CPU() {};
 	virtual int run(long startAddress) = 0;
 	
+	/**
+	 * Contadores de desempenho deste núcleo (ver PerfCounters.h).
+	 */
+	PerfCounters *getPerfCounters() { return &perf; };
+	
+	/**
+	 * Profiler de PCs (nullptr desliga; ver PCProfiler.h). A CPU não é
+	 * dona do profiler; CPUs sem suporte o ignoram.
+	 */
+	virtual void setProfiler(PCProfiler *) {};
+	
 protected:
 	Memory *memory;
 	
@@ -58,4 +76,10 @@ protected:
 	 */
 	CPUerrorCode cpuError = CPUerrorCode::NONE;
 	bool processFinished = false;
+	unsigned long dataAbortAddress = 0;	// endereço do DATA_ABORT
+	
+	/**
+	 * Contadores de desempenho, em linhas de cache só suas
+	 */
+	PerfCounters perf;
 };
@@ -0,0 +1,237 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) GuestFault - Translates host faults on the guard pages around guest
+	memory into guest data aborts. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) GuestFault - Traduz falhas do hospedeiro nas páginas de guarda em torno
+	da memória do convidado em data aborts do convidado. Parte do projeto
+	armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <atomic>
+#include <csetjmp>
+#include <csignal>
+
+// Número máximo de regiões de memória protegidas ao mesmo tempo
+#define GUEST_FAULT_REGIONS 256
+
+using namespace std;
+
+/**
+ * Tradução de falhas de segmentação do hospedeiro em data aborts do
+ * convidado.
+ *
+ * Uma memória (SimpleMemory) registra com addRegion a região que reservou,
+ * formada pelos dados do convidado cercados por páginas de guarda
+ * PROT_NONE. A CPU arma uma armadilha (Trap) ao entrar em run(): um acesso
+ * do convidado fora da memória cai nas páginas de guarda, o tratador de
+ * SIGSEGV encontra a região, calcula o endereço do convidado e volta para
+ * a armadilha com siglongjmp. Nenhuma verificação é feita nos acessos que
+ * dão certo.
+ *
+ * SIGSEGV fora das regiões registradas, ou sem armadilha armada na thread,
+ * continua sendo um erro do simulador e é repassado ao tratador anterior,
+ * sem desinstalar o de GuestFault.
+ */
+class GuestFault
+{
+public:
+	/**
+	 * Armadilha armada por uma thread. address recebe o endereço do
+	 * convidado que falhou.
+	 */
+	struct Trap {
+		sigjmp_buf env;
+		unsigned long address;
+		Trap *previous;
+	};
+
+	/**
+	 * Registra a região [low, high), cujos dados do convidado começam em
+	 * base, e instala o tratador de SIGSEGV, se necessário.
+	 *
+	 * Retorna o índice da região ou -1 se não houver espaço (a região
+	 * fica sem proteção: suas falhas continuam sendo fatais). removeRegion
+	 * ignora índices inválidos, inclusive o -1.
+	 */
+	static int addRegion(char *low, char *high, char *base);
+	static void removeRegion(int region);
+
+	/**
+	 * Arma a armadilha trap na thread corrente, guardando a anterior (as
+	 * armadilhas podem ser aninhadas), e a desarma.
+	 */
+	static void arm(Trap *trap);
+	static void disarm(Trap *trap);
+
+private:
+	struct Region {
+		atomic<char*> low;
+		atomic<char*> high;
+		atomic<char*> base;
+	};
+
+	static Region *regions();
+	static Trap *&current();
+	static struct sigaction *previousAction();
+	static void install();
+	static void handler(int signal, siginfo_t *info, void *context);
+	static void chain(int signal, siginfo_t *info, void *context);
+};
+
+/**
+ * Os métodos são definidos aqui, com o estado em variáveis estáticas
+ * locais, para que qualquer CPU ou memória possa usá-los sem depender de
+ * um objeto em particular.
+ */
+inline GuestFault::Region *GuestFault::regions()
+{
+	static Region table[GUEST_FAULT_REGIONS];
+	return table;
+}
+
+inline GuestFault::Trap *&GuestFault::current()
+{
+	static thread_local Trap *trap = nullptr;
+	return trap;
+}
+
+inline struct sigaction *GuestFault::previousAction()
+{
+	static struct sigaction action;
+	return &action;
+}
+
+inline int GuestFault::addRegion(char *low, char *high, char *base)
+{
+	install();
+	Region *table = regions();
+	for (int i = 0; i < GUEST_FAULT_REGIONS; i++) {
+		char *expected = nullptr;
+		if (table[i].high.load() == nullptr
+				&& table[i].low.compare_exchange_strong(expected, low)) {
+			table[i].base.store(base);
+			table[i].high.store(high);
+			return i;
+		}
+	}
+	return -1;
+}
+
+inline void GuestFault::removeRegion(int region)
+{
+	if ((region >= 0) && (region < GUEST_FAULT_REGIONS)) {
+		Region *table = regions();
+		table[region].high.store(nullptr);
+		table[region].base.store(nullptr);
+		table[region].low.store(nullptr);
+	}
+}
+
+inline void GuestFault::arm(Trap *trap)
+{
+	trap->previous = current();
+	current() = trap;
+}
+
+inline void GuestFault::disarm(Trap *trap)
+{
+	current() = trap->previous;
+}
+
+/**
+ * SA_NODEFER deixa SIGSEGV desbloqueado após o siglongjmp, sem que a
+ * armadilha precise salvar a máscara de sinais (sigsetjmp(env, 0), sem
+ * chamada de sistema em run()).
+ */
+inline void GuestFault::install()
+{
+	static bool installed = [] {
+		struct sigaction action = {};
+		action.sa_sigaction = handler;
+		action.sa_flags = SA_SIGINFO | SA_NODEFER;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, previousAction());
+		return true;
+	}();
+	(void)installed;
+}
+
+inline void GuestFault::handler(int signal, siginfo_t *info, void *context)
+{
+	char *fault = (char*)info->si_addr;
+	Trap *trap = current();
+	Region *table = regions();
+
+	if (trap) {
+		for (int i = 0; i < GUEST_FAULT_REGIONS; i++) {
+			char *high = table[i].high.load();
+			if (high && (fault >= table[i].low.load()) && (fault < high)) {
+				trap->address = (unsigned long)(fault - table[i].base.load());
+				current() = trap->previous;
+				siglongjmp(trap->env, 1);
+			}
+		}
+	}
+
+	// não é uma falha do convidado
+	chain(signal, info, context);
+}
+
+/**
+ * Entrega o sinal ao tratador que estava instalado antes de GuestFault.
+ * Com a ação padrão (ou SIG_IGN numa falha de verdade, que se repetiria
+ * para sempre), ela é restaurada só para reenviar o sinal, que termina o
+ * processo.
+ */
+inline void GuestFault::chain(int signal, siginfo_t *info, void *context)
+{
+	struct sigaction *previous = previousAction();
+
+	if (previous->sa_flags & SA_SIGINFO) {
+		previous->sa_sigaction(signal, info, context);
+	} else if ((previous->sa_handler != SIG_DFL)
+			&& (previous->sa_handler != SIG_IGN)) {
+		previous->sa_handler(signal);
+	} else if ((previous->sa_handler == SIG_DFL) || (info->si_code > 0)) {
+		struct sigaction action = {};
+		action.sa_handler = SIG_DFL;
+		sigemptyset(&action.sa_mask);
+		sigaction(signal, &action, nullptr);
+		raise(signal);
+	}
+}
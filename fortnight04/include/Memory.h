@@ -37,6 +37,7 @@
 
 #include "config.h"
 
+#include <cstring>
 #include <string>
 #include <fstream>
 
@@ -45,6 +46,7 @@ using namespace std;
 class Memory
 {
 public:
+	virtual ~Memory() {};
 
 	virtual void loadBinary(string filename) = 0;
 	virtual void writeBinaryAsText (string basename) = 0;
@@ -55,24 +57,89 @@ public:
 	virtual unsigned int readInstruction32(unsigned long address) = 0;
 
 	/**
-	 * L um dado de 32 bits considerando um endereamento em bytes.
+	 * Acessos a dados de 8, 16, 32 e 64 bits considerando um endereamento
+	 * em bytes. O endereo no precisa ser alinhado: o acesso cobre
+	 * exatamente os bytes address a address + tamanho - 1, em little
+	 * endian, como os acessos desalinhados do ARMv8.
+	 *
+	 * As leituras de 8 e 16 bits retornam o dado com sinal; quem precisa
+	 * da extenso com zeros (LDRB, LDRH) mascara o resultado.
 	 */
+	virtual signed char readData8(unsigned long address) = 0;
+	virtual short readData16(unsigned long address) = 0;
 	virtual int readData32(unsigned long address) = 0;
-
-	/**
-	 * L um dado de 64 bits considerando um endereamento em bytes.
-	 */
 	virtual long readData64(unsigned long address) = 0;
 	
 	/**
-	 * Escreve um dado (value) de 32 bits considerando um endereamento em bytes.
+	 * Escreve um dado (value) de 8, 16, 32 ou 64 bits considerando um
+	 * endereamento em bytes, sem alinhamento.
 	 */
+	virtual void writeData8(unsigned long address, signed char value) = 0;
+	virtual void writeData16(unsigned long address, short value) = 0;
 	virtual void writeData32(unsigned long address, int value) = 0;
+	virtual void writeData64(unsigned long address, long value) = 0;
 
 	/**
-	 * Escreve um dado (value) de 64 bits considerando um endereamento em bytes.
+	 * Copia os size bytes a partir de address para buffer (readBlock) ou
+	 * de buffer para a memria (writeBlock), em uma nica transao.
+	 *
+	 * As verses padro usam os acessos de 32 bits; as memrias que
+	 * guardam os dados em blocos contguos copiam com memcpy.
 	 */
-	virtual void writeData64(unsigned long address, long value) = 0;
+	virtual void readBlock(unsigned long address, void *buffer, unsigned long size);
+	virtual void writeBlock(unsigned long address, const void *buffer, unsigned long size);
+
+	/**
+	 * L ou escreve dois dados de 64 bits consecutivos (LDP/STP de 64
+	 * bits, em address e address + 8) em uma nica transao.
+	 */
+	virtual void readPair64(unsigned long address, long *first, long *second);
+	virtual void writePair64(unsigned long address, long first, long second);
 	
 };
 
+/**
+ * Verses padro dos acessos em bloco e em pares.
+ */
+inline void Memory::readBlock(unsigned long address, void *buffer, unsigned long size)
+{
+	char *out = (char*)buffer;
+	while (size > 0) {
+		unsigned long offset = address & 3;
+		unsigned long n = (4 - offset < size) ? 4 - offset : size;
+		int word = readData32(address - offset);
+		memcpy(out, (char*)&word + offset, n);
+		out += n;
+		address += n;
+		size -= n;
+	}
+}
+
+inline void Memory::writeBlock(unsigned long address, const void *buffer, unsigned long size)
+{
+	const char *in = (const char*)buffer;
+	while (size > 0) {
+		unsigned long offset = address & 3;
+		unsigned long n = (4 - offset < size) ? 4 - offset : size;
+		// palavras incompletas so lidas, alteradas e escritas
+		int word = (n < 4) ? readData32(address - offset) : 0;
+		memcpy((char*)&word + offset, in, n);
+		writeData32(address - offset, word);
+		in += n;
+		address += n;
+		size -= n;
+	}
+}
+
+inline void Memory::readPair64(unsigned long address, long *first, long *second)
+{
+	*first = readData64(address);
+	*second = readData64(address + 8);
+}
+
+inline void Memory::writePair64(unsigned long address, long first, long second)
+{
+	writeData64(address, first);
+	writeData64(address + 8, second);
+}
+
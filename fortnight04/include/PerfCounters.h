@@ -0,0 +1,209 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) PerfCounters - performance counters of a simulated CPU
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) PerfCounters - contadores de desempenho de uma CPU simulada
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+/**
+ * Contagem dos eventos. Com NO_STATS (make Stats=no) as contagens somem do
+ * código das CPUs e os contadores ficam sempre em 0.
+ */
+#ifdef NO_STATS
+#define PERF_ENABLED 0
+#define PERF_COUNT(counter) do {} while (0)
+#define PERF_ADD(counter, value) do {} while (0)
+#else
+#define PERF_ENABLED 1
+#define PERF_COUNT(counter) ((counter)++)
+#define PERF_ADD(counter, value) ((counter) += (value))
+#endif
+
+// Tamanho da linha de cache do hospedeiro: os contadores de cada núcleo
+// ocupam linhas só suas
+#define PERF_LINE_SIZE 64
+
+/**
+ * Grupos de decodificação do A64, dados pelos bits 28-25 de IR (op0,
+ * C4.1): 100x Data Processing -- Immediate; 101x Branches, Exception
+ * Generating and System; x1x0 Loads and Stores; x101 Data Processing --
+ * Register; x111 Data Processing -- Scalar Floating-Point and Advanced
+ * SIMD; 00xx reservado, SVE e não alocado (PERF_GROUP_OTHER).
+ */
+enum PerfGroup {PERF_GROUP_DP_IMM, PERF_GROUP_BRANCH, PERF_GROUP_LOADSTORE,
+		PERF_GROUP_DP_REG, PERF_GROUP_SIMD_FP, PERF_GROUP_OTHER, PERF_GROUPS};
+
+/**
+ * Largura dos acessos a dados: 8, 16, 32, 64 e 128 bits (pares de 64 bits
+ * de LDP/STP, contados como um único acesso, e registradores Qn). LD1 e
+ * ST1 contam um acesso por registrador.
+ */
+enum PerfWidth {PERF_WIDTH_8, PERF_WIDTH_16, PERF_WIDTH_32, PERF_WIDTH_64,
+		PERF_WIDTH_128, PERF_WIDTHS};
+
+// Códigos de CPU::CPUerrorCode (NONE inclusive)
+#define PERF_CPU_ERRORS 7
+
+/**
+ * Contadores de desempenho de um núcleo.
+ *
+ * Cada CPU tem os seus, escritos apenas pela thread que a executa; os de
+ * um processador são a soma dos de seus núcleos (ver Processor). Cada
+ * instrução retirada é contada em exatamente um grupo, de forma que
+ * getInstructions() é a soma dos grupos.
+ */
+struct alignas(PERF_LINE_SIZE) PerfCounters {
+	uint64_t groups[PERF_GROUPS];		// instruções retiradas por grupo
+	uint64_t loads[PERF_WIDTHS];		// leituras de dados por largura
+	uint64_t stores[PERF_WIDTHS];		// escritas de dados por largura
+	uint64_t branches;					// desvios retirados
+	uint64_t takenBranches;				// desvios tomados
+	uint64_t stageErrors[PERF_CPU_ERRORS];	// run() terminado por cada erro
+
+	PerfCounters() {
+		reset();
+	};
+
+	void reset() {
+		memset(this, 0, sizeof(*this));
+	};
+
+	/**
+	 * Grupo de decodificação da instrução IR.
+	 */
+	static PerfGroup group(uint32_t IR) {
+		static const uint8_t groupOf[16] = {
+			PERF_GROUP_OTHER, PERF_GROUP_OTHER, PERF_GROUP_OTHER, PERF_GROUP_OTHER,
+			PERF_GROUP_LOADSTORE, PERF_GROUP_DP_REG, PERF_GROUP_LOADSTORE, PERF_GROUP_SIMD_FP,
+			PERF_GROUP_DP_IMM, PERF_GROUP_DP_IMM, PERF_GROUP_BRANCH, PERF_GROUP_BRANCH,
+			PERF_GROUP_LOADSTORE, PERF_GROUP_DP_REG, PERF_GROUP_LOADSTORE, PERF_GROUP_SIMD_FP
+		};
+		return (PerfGroup)groupOf[(IR >> 25) & 0xF];
+	};
+
+	/**
+	 * Largura de um acesso de size bytes (1, 2, 4, 8 ou 16).
+	 */
+	static PerfWidth width(int size) {
+		return (PerfWidth)__builtin_ctz(size);
+	};
+
+	uint64_t getInstructions() const {
+		uint64_t instructions = 0;
+		for (int g = 0; g < PERF_GROUPS; g++) {
+			instructions += groups[g];
+		}
+		return instructions;
+	};
+
+	/**
+	 * Acessos a dados, somadas as larguras.
+	 */
+	uint64_t getAccesses() const {
+		uint64_t accesses = 0;
+		for (int w = 0; w < PERF_WIDTHS; w++) {
+			accesses += loads[w] + stores[w];
+		}
+		return accesses;
+	};
+
+	PerfCounters &operator+=(const PerfCounters &other) {
+		for (int g = 0; g < PERF_GROUPS; g++) {
+			groups[g] += other.groups[g];
+		}
+		for (int w = 0; w < PERF_WIDTHS; w++) {
+			loads[w] += other.loads[w];
+			stores[w] += other.stores[w];
+		}
+		branches += other.branches;
+		takenBranches += other.takenBranches;
+		for (int e = 0; e < PERF_CPU_ERRORS; e++) {
+			stageErrors[e] += other.stageErrors[e];
+		}
+		return *this;
+	};
+
+	static const char *groupName(int group) {
+		static const char *names[PERF_GROUPS] = {
+			"dp_imm", "branch", "load_store", "dp_reg", "simd_fp", "other"
+		};
+		return names[group];
+	};
+
+	static const char *errorName(int error) {
+		static const char *names[PERF_CPU_ERRORS] = {
+			"NONE", "ID_ERROR", "EXI_ERROR", "EXF_ERROR", "MEM_ERROR", "WB_ERROR",
+			"DATA_ABORT"
+		};
+		return ((error >= 0) && (error < PERF_CPU_ERRORS)) ? names[error] : "?";
+	};
+
+	/**
+	 * Escreve os contadores em out como um objeto JSON:
+	 *
+	 *	{"instructions": n, "groups": {"dp_imm": n, ...},
+	 *	 "loads": {"8": n, "16": n, "32": n, "64": n, "128": n}, "stores": {...},
+	 *	 "branches": n, "taken_branches": n,
+	 *	 "stage_errors": {"ID_ERROR": n, ...}}
+	 */
+	void writeJSON(std::ostream &out) const {
+		static const char *widths[PERF_WIDTHS] = {"8", "16", "32", "64", "128"};
+		std::ios::fmtflags flags = out.flags();
+		out << std::dec << "{\"instructions\": " << getInstructions() << ", \"groups\": {";
+		for (int g = 0; g < PERF_GROUPS; g++) {
+			out << (g ? ", " : "") << "\"" << groupName(g) << "\": " << groups[g];
+		}
+		for (int s = 0; s < 2; s++) {
+			const uint64_t *counts = s ? stores : loads;
+			out << "}, \"" << (s ? "stores" : "loads") << "\": {";
+			for (int w = 0; w < PERF_WIDTHS; w++) {
+				out << (w ? ", " : "") << "\"" << widths[w] << "\": " << counts[w];
+			}
+		}
+		out << "}, \"branches\": " << branches
+				<< ", \"taken_branches\": " << takenBranches << ", \"stage_errors\": {";
+		for (int e = 1; e < PERF_CPU_ERRORS; e++) {
+			out << (e > 1 ? ", " : "") << "\"" << errorName(e) << "\": " << stageErrors[e];
+		}
+		out << "}}";
+		out.flags(flags);
+	};
+};
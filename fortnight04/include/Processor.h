@@ -44,10 +44,54 @@
 #include "Memory.h"
 #include "CPU.h"
 
+#include <ostream>
+
 class Processor
 {
 	public:
 		virtual int run(int startAddress) = 0;
+		virtual ~Processor() {};
+
+		/**
+		 * Nmero de ncleos e contadores de desempenho do ncleo core,
+		 * lidos aps run().
+		 */
+		virtual int getCores() { return 1; };
+		virtual PerfCounters *getPerfCounters(int) { return cpu->getPerfCounters(); };
+
+		/**
+		 * Liga o profiler de PCs do ncleo core (nullptr desliga; ver
+		 * CPU::setProfiler()), antes de run().
+		 */
+		virtual void setProfiler(int, PCProfiler *profiler) { cpu->setProfiler(profiler); };
+
+		/**
+		 * Soma dos contadores de desempenho de todos os ncleos.
+		 */
+		PerfCounters getPerfTotals() {
+			PerfCounters total;
+			for (int core = 0; core < getCores(); core++) {
+				total += *getPerfCounters(core);
+			}
+			return total;
+		};
+
+		/**
+		 * Escreve os contadores de desempenho em out como JSON:
+		 * {"stats": (false se compilado com NO_STATS), "cores": [contadores
+		 * de cada ncleo], "total": soma dos ncleos} (ver
+		 * PerfCounters::writeJSON()).
+		 */
+		void writePerfJSON(std::ostream &out) {
+			out << "{\"stats\": " << (PERF_ENABLED ? "true" : "false") << ", \"cores\": [";
+			for (int core = 0; core < getCores(); core++) {
+				out << (core ? ", " : "");
+				getPerfCounters(core)->writeJSON(out);
+			}
+			out << "], \"total\": ";
+			getPerfTotals().writeJSON(out);
+			out << "}";
+		};
 
 	protected:
 		Memory *memory;
@@ -37,5 +37,15 @@
 
 #define MEMORY_SIZE 65536
 #define FILENAME "isummation.o"
-#define STARTADDRESS 0x40
+#define STACKADDRESS MEMORY_SIZE
 #define MEMORY_LOG_FILE "saida.txt"
+#define MEMORY_TRACE_FILE "saida.trace"
+#define PERF_COUNTERS_FILE "perf.json"
+
+// Profiler de PCs do armethyst (Profile no makefile): 0 desliga, 1 conta
+// todas as instruções, N amostra 1 em N
+#ifndef PROFILE_PERIOD
+#define PROFILE_PERIOD 0
+#endif
+#define PROFILE_FLAT_FILE "profile.txt"
+#define PROFILE_FOLDED_FILE "profile.folded"
@@ -0,0 +1,719 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) ElfLoader - An ELF64 AArch64 loader that lays out sections, applies
+	relocations and caches the relocated image. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) ElfLoader - Um carregador ELF64 AArch64 que posiciona as seções, aplica
+	as realocações e guarda a imagem realocada em cache. Parte do projeto
+	armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "ElfLoader.h"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+ElfLoader::ElfLoader(string filename)
+{
+	this->filename = filename;
+	temporaryImage = false;
+	imageSize = 0;
+	entryPoint = 0;
+	relocations = 0;
+	cached = false;
+}
+
+ElfLoader::~ElfLoader()
+{
+	if (temporaryImage) {
+		unlink(imageFile.c_str());
+	}
+}
+
+/**
+ * Mapeia o arquivo, calcula seu hash e busca a imagem na cache; se ela não
+ * estiver lá, monta a imagem com build().
+ */
+int ElfLoader::load()
+{
+	struct stat fileStat;
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if ((fd < 0) || (fstat(fd, &fileStat) < 0)) {
+		cout << "Unable to open file " << filename << endl;
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 1;
+	}
+	unsigned long size = fileStat.st_size;
+	if (size < sizeof(Elf64_Ehdr)) {
+		cout << "File " << filename << " is not an ELF64 file" << endl;
+		close(fd);
+		return 1;
+	}
+	const unsigned char *file = (const unsigned char *)mmap(nullptr, size,
+			PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+		cout << "Unable to map file " << filename << endl;
+		return 1;
+	}
+
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016lx", hashFile(file, size));
+	string cacheBase = string(ELF_CACHE_DIR) + "/" + hash;
+
+	int result = 0;
+	if (readCache(cacheBase) == 0) {
+		cached = true;
+	} else {
+		result = build(file, size, cacheBase);
+	}
+	munmap((void *)file, size);
+	return result;
+}
+
+string ElfLoader::getImageFile()
+{
+	return imageFile;
+}
+
+unsigned long ElfLoader::getImageSize()
+{
+	return imageSize;
+}
+
+unsigned long ElfLoader::getEntryPoint()
+{
+	return entryPoint;
+}
+
+const ElfSymbol *ElfLoader::findSymbol(string name)
+{
+	for (const ElfSymbol &symbol : symbols) {
+		if (symbol.name == name) {
+			return &symbol;
+		}
+	}
+	return nullptr;
+}
+
+const ElfSection *ElfLoader::findSection(string name)
+{
+	for (const ElfSection &section : sections) {
+		if (section.name == name) {
+			return &section;
+		}
+	}
+	return nullptr;
+}
+
+const vector<ElfSection> &ElfLoader::getSections()
+{
+	return sections;
+}
+
+const vector<ElfSymbol> &ElfLoader::getSymbols()
+{
+	return symbols;
+}
+
+unsigned long ElfLoader::getRelocations()
+{
+	return relocations;
+}
+
+bool ElfLoader::isCached()
+{
+	return cached;
+}
+
+unsigned long ElfLoader::hashFile(const unsigned char *file, unsigned long size)
+{
+	unsigned long hash = 14695981039346656037UL ^ ELF_CACHE_VERSION;
+	for (unsigned long i = 0; i < size; i++) {
+		hash = (hash ^ file[i]) * 1099511628211UL;
+	}
+	return hash;
+}
+
+/**
+ * A tabela de símbolos cacheada (cacheBase.sym) tem uma linha por item:
+ *		entry <endereço>
+ *		size <tamanho da imagem>
+ *		section <nome> <endereço> <tamanho>
+ *		symbol <nome> <endereço> <tamanho>
+ * e a imagem (cacheBase.img) deve ter o tamanho registrado.
+ */
+int ElfLoader::readCache(string cacheBase)
+{
+	ifstream ifp(cacheBase + ".sym");
+	if (!ifp) {
+		return 1;
+	}
+
+	vector<ElfSection> cachedSections;
+	vector<ElfSymbol> cachedSymbols;
+	unsigned long cachedEntry = 0, cachedSize = 0;
+	bool sizeRead = false;
+	string line;
+	while (getline(ifp, line)) {
+		istringstream fields(line);
+		string kind, name;
+		unsigned long address, size;
+		fields >> kind >> hex;
+		if (kind == "entry") {
+			fields >> cachedEntry;
+		} else if (kind == "size") {
+			sizeRead = (bool)(fields >> cachedSize);
+		} else if ((kind == "section") && (fields >> name >> address >> size)) {
+			cachedSections.push_back({name, address, size});
+		} else if ((kind == "symbol") && (fields >> name >> address >> size)) {
+			cachedSymbols.push_back({name, address, size});
+		} else {
+			return 1;
+		}
+	}
+
+	struct stat imageStat;
+	string cachedImage = cacheBase + ".img";
+	if (!sizeRead || (stat(cachedImage.c_str(), &imageStat) < 0)
+			|| ((unsigned long)imageStat.st_size != cachedSize)) {
+		return 1;
+	}
+
+	imageFile = cachedImage;
+	imageSize = cachedSize;
+	entryPoint = cachedEntry;
+	sections = cachedSections;
+	symbols = cachedSymbols;
+	return 0;
+}
+
+/**
+ * Grava o arquivo path, primeiro com um nome temporário e depois
+ * renomeando-o, de forma que outro processo nunca leia um arquivo pela
+ * metade.
+ */
+static int writeFileAtomic(string path, const void *data, unsigned long size)
+{
+	string temporary = path + ".tmp." + to_string(getpid());
+	ofstream ofp(temporary, ios::binary);
+	ofp.write((const char *)data, size);
+	ofp.close();
+	if (!ofp || (rename(temporary.c_str(), path.c_str()) < 0)) {
+		unlink(temporary.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int ElfLoader::writeCache(string cacheBase, const vector<unsigned char> &image)
+{
+	mkdir(ELF_CACHE_DIR, 0755);
+
+	ostringstream sym;
+	sym << hex << "entry " << entryPoint << endl
+			<< "size " << imageSize << endl;
+	for (const ElfSection &section : sections) {
+		sym << "section " << section.name << " " << section.address
+				<< " " << section.size << endl;
+	}
+	for (const ElfSymbol &symbol : symbols) {
+		sym << "symbol " << symbol.name << " " << symbol.address
+				<< " " << symbol.size << endl;
+	}
+	string symText = sym.str();
+
+	// a tabela de símbolos é gravada por último: sem ela a imagem não é lida
+	if (writeFileAtomic(cacheBase + ".img", image.data(), image.size())
+			|| writeFileAtomic(cacheBase + ".sym", symText.data(), symText.size())) {
+		return 1;
+	}
+	imageFile = cacheBase + ".img";
+	return 0;
+}
+
+/**
+ * Lê/escreve uma palavra de 32 ou 64 bits da imagem (little-endian, como o
+ * hospedeiro).
+ */
+static inline unsigned int readWord32(unsigned char *p)
+{
+	unsigned int word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+static inline void writeWord32(unsigned char *p, unsigned int word)
+{
+	memcpy(p, &word, sizeof(word));
+}
+
+static inline void writeWord64(unsigned char *p, unsigned long word)
+{
+	memcpy(p, &word, sizeof(word));
+}
+
+/**
+ * Verifica se value cabe em um inteiro com sinal de bits bits.
+ */
+static inline bool fitsSigned(long value, int bits)
+{
+	return (value >= -(1L << (bits - 1))) && (value < (1L << (bits - 1)));
+}
+
+/**
+ * Aplica a realocação do tipo type no endereço P da imagem, com o valor
+ * S + A do símbolo mais o addend.
+ *
+ * Retorna
+ *		0: sucesso
+ *		1: tipo não suportado
+ *		2: valor fora do alcance da instrução
+ */
+static int applyRelocation(unsigned char *p, unsigned int type,
+		unsigned long S_A, unsigned long P)
+{
+	long delta = (long)(S_A - P);
+	long pageDelta = (long)((S_A & ~0xFFFUL) - (P & ~0xFFFUL)) >> 12;
+	unsigned int lo12 = S_A & 0xFFF;
+	unsigned int insn;
+
+	switch (type) {
+		case R_AARCH64_NONE:
+			return 0;
+		case R_AARCH64_ABS64:
+		case R_AARCH64_RELATIVE:
+			writeWord64(p, S_A);
+			return 0;
+		case R_AARCH64_PREL64:
+			writeWord64(p, delta);
+			return 0;
+		case R_AARCH64_ABS32:
+			if (S_A > 0xFFFFFFFFUL) {
+				return 2;
+			}
+			writeWord32(p, S_A);
+			return 0;
+		case R_AARCH64_PREL32:
+			if (!fitsSigned(delta, 32)) {
+				return 2;
+			}
+			writeWord32(p, delta);
+			return 0;
+
+		// ADR/ADRP: immlo nos bits 30:29, immhi nos bits 23:5
+		case R_AARCH64_ADR_PREL_LO21:
+		case R_AARCH64_ADR_PREL_PG_HI21:
+		case R_AARCH64_ADR_PREL_PG_HI21_NC: {
+			long imm = (type == R_AARCH64_ADR_PREL_LO21) ? delta : pageDelta;
+			if ((type != R_AARCH64_ADR_PREL_PG_HI21_NC) && !fitsSigned(imm, 21)) {
+				return 2;
+			}
+			insn = readWord32(p) & ~((3U << 29) | (0x7FFFFU << 5));
+			insn |= ((imm & 3) << 29) | (((imm >> 2) & 0x7FFFF) << 5);
+			writeWord32(p, insn);
+			return 0;
+		}
+
+		// ADD e LDR/STR com imediato de 12 bits (bits 21:10), escalado pelo
+		// tamanho do acesso
+		case R_AARCH64_ADD_ABS_LO12_NC:
+		case R_AARCH64_LDST8_ABS_LO12_NC:
+		case R_AARCH64_LDST16_ABS_LO12_NC:
+		case R_AARCH64_LDST32_ABS_LO12_NC:
+		case R_AARCH64_LDST64_ABS_LO12_NC:
+		case R_AARCH64_LDST128_ABS_LO12_NC: {
+			int scale = (type == R_AARCH64_LDST16_ABS_LO12_NC) ? 1
+					: (type == R_AARCH64_LDST32_ABS_LO12_NC) ? 2
+					: (type == R_AARCH64_LDST64_ABS_LO12_NC) ? 3
+					: (type == R_AARCH64_LDST128_ABS_LO12_NC) ? 4 : 0;
+			insn = readWord32(p) & ~(0xFFFU << 10);
+			insn |= (lo12 >> scale) << 10;
+			writeWord32(p, insn);
+			return 0;
+		}
+
+		// desvios relativos ao PC, em palavras
+		case R_AARCH64_JUMP26:
+		case R_AARCH64_CALL26:
+			if (!fitsSigned(delta, 28)) {
+				return 2;
+			}
+			insn = readWord32(p) & ~0x3FFFFFFU;
+			writeWord32(p, insn | ((delta >> 2) & 0x3FFFFFF));
+			return 0;
+		case R_AARCH64_CONDBR19:
+			if (!fitsSigned(delta, 21)) {
+				return 2;
+			}
+			insn = readWord32(p) & ~(0x7FFFFU << 5);
+			writeWord32(p, insn | (((delta >> 2) & 0x7FFFF) << 5));
+			return 0;
+		case R_AARCH64_TSTBR14:
+			if (!fitsSigned(delta, 16)) {
+				return 2;
+			}
+			insn = readWord32(p) & ~(0x3FFFU << 5);
+			writeWord32(p, insn | (((delta >> 2) & 0x3FFF) << 5));
+			return 0;
+
+		// MOVZ/MOVK: 16 bits do valor absoluto (bits 20:5)
+		case R_AARCH64_MOVW_UABS_G0:
+		case R_AARCH64_MOVW_UABS_G0_NC:
+		case R_AARCH64_MOVW_UABS_G1:
+		case R_AARCH64_MOVW_UABS_G1_NC:
+		case R_AARCH64_MOVW_UABS_G2:
+		case R_AARCH64_MOVW_UABS_G2_NC:
+		case R_AARCH64_MOVW_UABS_G3: {
+			int shift = (type <= R_AARCH64_MOVW_UABS_G0_NC) ? 0
+					: (type <= R_AARCH64_MOVW_UABS_G1_NC) ? 16
+					: (type <= R_AARCH64_MOVW_UABS_G2_NC) ? 32 : 48;
+			bool check = (type == R_AARCH64_MOVW_UABS_G0)
+					|| (type == R_AARCH64_MOVW_UABS_G1)
+					|| (type == R_AARCH64_MOVW_UABS_G2);
+			if (check && ((S_A >> shift) > 0xFFFF)) {
+				return 2;
+			}
+			insn = readWord32(p) & ~(0xFFFFU << 5);
+			writeWord32(p, insn | (((S_A >> shift) & 0xFFFF) << 5));
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Valor (endereço realocado) de cada símbolo de uma tabela de símbolos e se
+ * ele está definido.
+ */
+struct SymbolValues {
+	vector<unsigned long> value;
+	vector<bool> defined;
+};
+
+int ElfLoader::build(const unsigned char *file, unsigned long size,
+		string cacheBase)
+{
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)file;
+	if ((memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0)
+			|| (ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+			|| (ehdr->e_ident[EI_DATA] != ELFDATA2LSB)
+			|| (ehdr->e_machine != EM_AARCH64)) {
+		cout << "File " << filename << " is not an ELF64 AArch64 little-endian file" << endl;
+		return 1;
+	}
+	bool relocatable = (ehdr->e_type == ET_REL);
+
+	unsigned int shnum = ehdr->e_shnum;
+	if ((shnum > 0) && ((ehdr->e_shentsize != sizeof(Elf64_Shdr))
+			|| (ehdr->e_shoff + shnum * sizeof(Elf64_Shdr) > size)
+			|| (ehdr->e_shstrndx >= shnum))) {
+		cout << "File " << filename << ": invalid section headers" << endl;
+		return 1;
+	}
+	const Elf64_Shdr *shdr = (const Elf64_Shdr *)(file + ehdr->e_shoff);
+	for (unsigned int i = 0; i < shnum; i++) {
+		if ((shdr[i].sh_type != SHT_NOBITS)
+				&& (shdr[i].sh_offset + shdr[i].sh_size > size)) {
+			cout << "File " << filename << ": section " << i
+					<< " is out of the file" << endl;
+			return 1;
+		}
+	}
+	auto sectionName = [&](unsigned int i) -> string {
+		const Elf64_Shdr &strtab = shdr[ehdr->e_shstrndx];
+		if (shdr[i].sh_name >= strtab.sh_size) {
+			return "";
+		}
+		const char *name = (const char *)file + strtab.sh_offset + shdr[i].sh_name;
+		return string(name, strnlen(name, strtab.sh_size - shdr[i].sh_name));
+	};
+
+	//
+	// leiaute da imagem
+	//
+	vector<unsigned char> image;
+	vector<unsigned long> sectionAddress(shnum, 0);
+	if (relocatable) {
+		image.assign(file, file + size);
+		unsigned long end = size;
+		for (unsigned int i = 0; i < shnum; i++) {
+			if (!(shdr[i].sh_flags & SHF_ALLOC)) {
+				continue;
+			}
+			if (shdr[i].sh_type == SHT_NOBITS) {
+				unsigned long align = shdr[i].sh_addralign ? shdr[i].sh_addralign : 1;
+				end = (end + align - 1) / align * align;
+				sectionAddress[i] = end;
+				end += shdr[i].sh_size;
+			} else {
+				sectionAddress[i] = shdr[i].sh_offset;
+			}
+		}
+		image.resize(end, 0);
+	} else {
+		if ((ehdr->e_phentsize != sizeof(Elf64_Phdr))
+				|| (ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > size)) {
+			cout << "File " << filename << ": invalid program headers" << endl;
+			return 1;
+		}
+		const Elf64_Phdr *phdr = (const Elf64_Phdr *)(file + ehdr->e_phoff);
+		unsigned long end = 0;
+		for (unsigned int i = 0; i < ehdr->e_phnum; i++) {
+			if (phdr[i].p_type != PT_LOAD) {
+				continue;
+			}
+			if ((phdr[i].p_offset + phdr[i].p_filesz > size)
+					|| (phdr[i].p_filesz > phdr[i].p_memsz)) {
+				cout << "File " << filename << ": segment " << i
+						<< " is out of the file" << endl;
+				return 1;
+			}
+			end = max(end, phdr[i].p_vaddr + phdr[i].p_memsz);
+		}
+		image.assign(end, 0);
+		for (unsigned int i = 0; i < ehdr->e_phnum; i++) {
+			if (phdr[i].p_type == PT_LOAD) {
+				memcpy(image.data() + phdr[i].p_vaddr, file + phdr[i].p_offset,
+						phdr[i].p_filesz);
+			}
+		}
+		for (unsigned int i = 0; i < shnum; i++) {
+			sectionAddress[i] = shdr[i].sh_addr;
+		}
+	}
+	imageSize = image.size();
+
+	sections.clear();
+	for (unsigned int i = 0; i < shnum; i++) {
+		if (shdr[i].sh_flags & SHF_ALLOC) {
+			sections.push_back({sectionName(i), sectionAddress[i], shdr[i].sh_size});
+		}
+	}
+
+	//
+	// tabelas de símbolos (.symtab e, em executáveis dinâmicos, .dynsym)
+	//
+	map<unsigned int, SymbolValues> symbolValues;
+	symbols.clear();
+	for (unsigned int t = 0; t < shnum; t++) {
+		if ((shdr[t].sh_type != SHT_SYMTAB) && (shdr[t].sh_type != SHT_DYNSYM)) {
+			continue;
+		}
+		const Elf64_Sym *sym = (const Elf64_Sym *)(file + shdr[t].sh_offset);
+		unsigned long count = shdr[t].sh_size / sizeof(Elf64_Sym);
+		unsigned int strndx = shdr[t].sh_link;
+		if (strndx >= shnum) {
+			cout << "File " << filename << ": invalid symbol table" << endl;
+			return 1;
+		}
+		const Elf64_Shdr &strtab = shdr[strndx];
+		SymbolValues &values = symbolValues[t];
+		values.value.assign(count, 0);
+		values.defined.assign(count, false);
+		for (unsigned long i = 0; i < count; i++) {
+			unsigned int shndx = sym[i].st_shndx;
+			if (shndx == SHN_UNDEF) {
+				// símbolos fracos não definidos valem 0
+				values.defined[i] = (i == 0) || (ELF64_ST_BIND(sym[i].st_info) == STB_WEAK);
+				continue;
+			}
+			if (shndx == SHN_ABS) {
+				values.value[i] = sym[i].st_value;
+			} else if (shndx < shnum) {
+				values.value[i] = relocatable
+						? sectionAddress[shndx] + sym[i].st_value : sym[i].st_value;
+			} else {
+				continue;	// SHN_COMMON e outros índices especiais
+			}
+			values.defined[i] = true;
+
+			// só funções e variáveis com nome entram na tabela (os símbolos
+			// de mapeamento $x/$d e os de seção ficam de fora)
+			int type = ELF64_ST_TYPE(sym[i].st_info);
+			if ((shdr[t].sh_type != SHT_SYMTAB) || (sym[i].st_name == 0)
+					|| (sym[i].st_name >= strtab.sh_size)
+					|| ((type != STT_FUNC) && (type != STT_OBJECT) && (type != STT_NOTYPE))) {
+				continue;
+			}
+			const char *name = (const char *)file + strtab.sh_offset + sym[i].st_name;
+			if (name[0] != '$') {
+				symbols.push_back({string(name, strnlen(name, strtab.sh_size - sym[i].st_name)),
+						values.value[i], sym[i].st_size});
+			}
+		}
+	}
+
+	//
+	// realocações, uma seção SHT_RELA por vez ou em paralelo
+	//
+	vector<unsigned int> relaSections;
+	unsigned long relaCount = 0;
+	for (unsigned int i = 0; i < shnum; i++) {
+		if (shdr[i].sh_type == SHT_REL) {
+			cout << "File " << filename << ": SHT_REL relocations are not supported" << endl;
+			return 1;
+		}
+		if ((shdr[i].sh_type != SHT_RELA) || (shdr[i].sh_size == 0)) {
+			continue;
+		}
+		// em arquivos realocáveis, seções não alocadas (depuração) são ignoradas
+		if (relocatable && ((shdr[i].sh_info >= shnum)
+				|| !(shdr[i].sh_flags & SHF_INFO_LINK)
+				|| !(shdr[shdr[i].sh_info].sh_flags & SHF_ALLOC))) {
+			continue;
+		}
+		relaSections.push_back(i);
+		relaCount += shdr[i].sh_size / sizeof(Elf64_Rela);
+	}
+
+	vector<string> errors(relaSections.size());
+	auto relocateSection = [&](unsigned long k) {
+		const Elf64_Shdr &rela = shdr[relaSections[k]];
+		const Elf64_Rela *entry = (const Elf64_Rela *)(file + rela.sh_offset);
+		unsigned long count = rela.sh_size / sizeof(Elf64_Rela);
+		// em executáveis r_offset já é o endereço
+		unsigned long base = relocatable ? sectionAddress[rela.sh_info] : 0;
+		auto values = symbolValues.find(rela.sh_link);
+		for (unsigned long i = 0; i < count; i++) {
+			unsigned int type = ELF64_R_TYPE(entry[i].r_info);
+			unsigned long symndx = ELF64_R_SYM(entry[i].r_info);
+			unsigned long S = 0;
+			if (symndx != 0) {
+				if ((values == symbolValues.end())
+						|| (symndx >= values->second.value.size())
+						|| !values->second.defined[symndx]) {
+					errors[k] = "undefined symbol in relocation " + to_string(i)
+							+ " of section " + sectionName(relaSections[k]);
+					return;
+				}
+				S = values->second.value[symndx];
+			}
+			unsigned long P = base + entry[i].r_offset;
+			unsigned long width = ((type == R_AARCH64_ABS64)
+					|| (type == R_AARCH64_PREL64) || (type == R_AARCH64_RELATIVE)) ? 8 : 4;
+			if (P + width > image.size()) {
+				errors[k] = "relocation " + to_string(i) + " of section "
+						+ sectionName(relaSections[k]) + " is out of the image";
+				return;
+			}
+			int result = applyRelocation(image.data() + P, type,
+					S + entry[i].r_addend, P);
+			if (result) {
+				ostringstream error;
+				error << ((result == 1) ? "unsupported relocation type "
+						: "relocation overflow, type ") << type
+						<< " at 0x" << hex << P;
+				errors[k] = error.str();
+				return;
+			}
+		}
+	};
+
+	unsigned int threads = thread::hardware_concurrency();
+	if ((relaCount >= ELF_PARALLEL_RELOCATIONS) && (relaSections.size() > 1)
+			&& (threads > 1)) {
+		atomic<unsigned long> next(0);
+		vector<thread> pool;
+		for (unsigned int t = 0; t < min((unsigned long)threads, relaSections.size()); t++) {
+			pool.emplace_back([&]() {
+				for (unsigned long k; (k = next++) < relaSections.size(); ) {
+					relocateSection(k);
+				}
+			});
+		}
+		for (thread &t : pool) {
+			t.join();
+		}
+	} else {
+		for (unsigned long k = 0; k < relaSections.size(); k++) {
+			relocateSection(k);
+		}
+	}
+	for (const string &error : errors) {
+		if (!error.empty()) {
+			cout << "File " << filename << ": " << error << endl;
+			return 1;
+		}
+	}
+	relocations = relaCount;
+
+	//
+	// ponto de entrada
+	//
+	const ElfSymbol *mainSymbol = findSymbol("main");
+	const ElfSection *text = findSection(".text");
+	if (mainSymbol) {
+		entryPoint = mainSymbol->address;
+	} else if (!relocatable) {
+		entryPoint = ehdr->e_entry;
+	} else if (text) {
+		entryPoint = text->address;
+	}
+
+	// sem cache gravável, a imagem vai para um arquivo temporário
+	if (writeCache(cacheBase, image)) {
+		char temporary[] = "/tmp/armethyst-image-XXXXXX";
+		int fd = mkstemp(temporary);
+		if ((fd < 0) || (write(fd, image.data(), image.size()) != (long)image.size())) {
+			cout << "Unable to write the image of " << filename << endl;
+			if (fd >= 0) {
+				close(fd);
+				unlink(temporary);
+			}
+			return 1;
+		}
+		close(fd);
+		imageFile = temporary;
+		temporaryImage = true;
+	}
+	return 0;
+}
@@ -0,0 +1,192 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) ElfLoader - An ELF64 AArch64 loader that lays out sections, applies
+	relocations and caches the relocated image. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) ElfLoader - Um carregador ELF64 AArch64 que posiciona as seções, aplica
+	as realocações e guarda a imagem realocada em cache. Parte do projeto
+	armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+// Diretório da cache de imagens realocadas, relativo ao diretório corrente,
+// e versão do formato da cache (entra no hash: mudar o carregador invalida
+// as imagens antigas)
+#define ELF_CACHE_DIR ".armethyst-cache"
+#define ELF_CACHE_VERSION 1
+
+// Número mínimo de realocações para aplicá-las em paralelo
+#define ELF_PARALLEL_RELOCATIONS 4096
+
+using namespace std;
+
+/**
+ * Seção alocada na imagem: endereço no espaço do programa simulado e
+ * tamanho em bytes.
+ */
+struct ElfSection {
+	string name;
+	unsigned long address;
+	unsigned long size;
+};
+
+/**
+ * Símbolo definido no arquivo (função ou variável), já realocado.
+ */
+struct ElfSymbol {
+	string name;
+	unsigned long address;
+	unsigned long size;
+};
+
+/**
+ * Carregador de arquivos ELF64 AArch64 (little-endian).
+ *
+ * load() lê os cabeçalhos de seção e de programa e a tabela de símbolos,
+ * monta a imagem do programa e aplica as realocações R_AARCH64_*. A imagem
+ * é gravada em um arquivo binário plano, em que a posição de cada byte é o
+ * seu endereço, carregado pela memória com Memory::loadBinary.
+ *
+ * Leiaute da imagem:
+ *	- arquivo realocável (ET_REL): o arquivo inteiro é copiado e cada seção
+ *	  fica no endereço igual à sua posição no arquivo (.text de isummation.o
+ *	  fica em 0x40, como antes); as seções SHT_NOBITS (.bss) ficam depois
+ *	  do fim do arquivo, zeradas;
+ *	- executável (ET_EXEC, ET_DYN): os segmentos PT_LOAD ficam em p_vaddr e
+ *	  o que passa de p_filesz é zerado.
+ *
+ * As seções de realocação são independentes (cada uma altera uma única
+ * seção), então, em arquivos grandes, são aplicadas em paralelo.
+ *
+ * A imagem realocada e a tabela de símbolos são guardadas em ELF_CACHE_DIR,
+ * com nome dado pelo hash do conteúdo do arquivo. Uma nova carga do mesmo
+ * arquivo só calcula o hash e lê a tabela de símbolos.
+ */
+class ElfLoader
+{
+public:
+	ElfLoader(string filename);
+	~ElfLoader();
+
+	/**
+	 * Carrega o arquivo, da cache se possível.
+	 *
+	 * Retorna
+	 *		0: sucesso
+	 *		1: arquivo inválido, realocação não suportada ou erro de E/S
+	 */
+	int load();
+
+	/**
+	 * Arquivo com a imagem realocada, para Memory::loadBinary, e seu tamanho.
+	 */
+	string getImageFile();
+	unsigned long getImageSize();
+
+	/**
+	 * Endereço de 'main'; sem 'main', o ponto de entrada do cabeçalho ELF
+	 * ou, em arquivos realocáveis, o início de .text.
+	 */
+	unsigned long getEntryPoint();
+
+	/**
+	 * Busca o símbolo ou a seção name.
+	 * 
+	 * Retorna nullptr se não existir.
+	 */
+	const ElfSymbol *findSymbol(string name);
+	const ElfSection *findSection(string name);
+
+	const vector<ElfSection> &getSections();
+	const vector<ElfSymbol> &getSymbols();
+
+	/**
+	 * Número de realocações aplicadas (0 se a imagem veio da cache) e se a
+	 * imagem veio da cache.
+	 */
+	unsigned long getRelocations();
+	bool isCached();
+
+private:
+	string filename;
+	string imageFile;
+	bool temporaryImage;	// imagem fora da cache, apagada no destrutor
+	unsigned long imageSize;
+	unsigned long entryPoint;
+	unsigned long relocations;
+	bool cached;
+
+	vector<ElfSection> sections;
+	vector<ElfSymbol> symbols;
+
+	/**
+	 * Hash FNV-1a de 64 bits do conteúdo do arquivo (e da versão da cache).
+	 */
+	static unsigned long hashFile(const unsigned char *file, unsigned long size);
+
+	/**
+	 * Lê a imagem cacheada de nome base cacheBase.
+	 *
+	 * Retorna
+	 *		0: sucesso
+	 *		1: imagem não está na cache
+	 */
+	int readCache(string cacheBase);
+
+	/**
+	 * Monta e realoca a imagem a partir do arquivo mapeado em file e a grava
+	 * na cache (ou em um arquivo temporário, se a cache não for gravável).
+	 *
+	 * Retorna
+	 *		0: sucesso
+	 *		1: arquivo inválido ou realocação não suportada
+	 */
+	int build(const unsigned char *file, unsigned long size, string cacheBase);
+
+	/**
+	 * Grava a imagem e a tabela de símbolos com nome base cacheBase.
+	 *
+	 * Retorna
+	 *		0: sucesso
+	 *		1: erro de E/S
+	 */
+	int writeCache(string cacheBase, const vector<unsigned char> &image);
+};
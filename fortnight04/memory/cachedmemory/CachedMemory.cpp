@@ -0,0 +1,491 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) CachedMemory - A Memory decorator that models split L1I/L1D caches and
+	a unified L2. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) CachedMemory - Um decorador de Memory que modela caches L1I/L1D
+	separadas e uma L2 unificada. Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "CachedMemory.h"
+#include "SimpleMemory.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <typeinfo>
+
+using namespace std;
+
+/**
+ * Verifica se value é potência de 2 (e não é 0).
+ */
+static bool isPowerOf2(unsigned long value)
+{
+	return value && !(value & (value - 1));
+}
+
+CacheLevel::CacheLevel(string name, CacheConfig config)
+{
+	this->name = name;
+	this->config = config;
+
+	unsigned long sets = (config.lineSize && config.ways)
+			? config.size / ((unsigned long)config.lineSize * config.ways) : 0;
+	if (!isPowerOf2(config.lineSize) || (config.lineSize < 8) || !isPowerOf2(sets)
+			|| ((config.replacement == CacheReplacement::PLRU)
+					&& (!isPowerOf2(config.ways) || (config.ways > 64)))) {
+		cout << "Invalid configuration for cache " << name << ": size="
+				<< config.size << " ways=" << config.ways << " line="
+				<< config.lineSize << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+
+	lineBits = __builtin_ctzl(config.lineSize);
+	setMask = sets - 1;
+	stride = (config.ways + CACHE_TAG_LANES - 1) / CACHE_TAG_LANES * CACHE_TAG_LANES;
+	treeLevels = __builtin_ctzl(config.ways);
+
+	// tags alinhados para as cargas SIMD alinhadas
+	unsigned long entries = sets * stride;
+	if (posix_memalign((void**)&tags, 32, entries * sizeof(uint64_t))) {
+		cout << "Unable to allocate cache " << name << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	stamps = new uint64_t[entries];
+	plru = new uint64_t[sets];
+
+	// PLRU: o acesso à via way faz cada nó do caminho da raiz até ela
+	// apontar para o lado contrário
+	plruKeep = new uint64_t[config.ways];
+	plruPoint = new uint64_t[config.ways];
+	for (unsigned int way = 0; way < config.ways; way++) {
+		unsigned int node = 1;
+		plruKeep[way] = ~0UL;
+		plruPoint[way] = 0;
+		for (int level = treeLevels - 1; level >= 0; level--) {
+			unsigned int bit = (way >> level) & 1;
+			plruKeep[way] &= ~(1UL << node);
+			plruPoint[way] |= (uint64_t)!bit << node;
+			node = 2 * node + bit;
+		}
+	}
+	dirty = new uint8_t[entries];
+	filled = new unsigned int[sets];
+	random = 0x9E3779B97F4A7C15UL;
+
+	invalidate();
+	resetStats();
+}
+
+CacheLevel::~CacheLevel()
+{
+	free(tags);
+	delete[] stamps;
+	delete[] plru;
+	delete[] plruKeep;
+	delete[] plruPoint;
+	delete[] dirty;
+	delete[] filled;
+}
+
+/**
+ * Usa primeiro uma via inválida; se todas forem válidas, segue a política
+ * de substituição. As linhas só são invalidadas todas juntas, e as vias
+ * são preenchidas em ordem: as inválidas são as de filled[set] em diante,
+ * sem busca no conjunto.
+ */
+int CacheLevel::victimWay(unsigned long set)
+{
+	int way;
+	if (filled[set] < config.ways) {
+		return filled[set]++;
+	}
+
+	switch (config.replacement) {
+		case CacheReplacement::LRU: {
+			uint64_t *setStamps = stamps + set * stride;
+			way = 0;
+			for (unsigned int i = 1; i < config.ways; i++) {
+				if (setStamps[i] < setStamps[way]) {
+					way = i;
+				}
+			}
+			return way;
+		}
+		case CacheReplacement::PLRU: {
+			unsigned int node = 1;
+			way = 0;
+			for (unsigned int level = 0; level < treeLevels; level++) {
+				unsigned int bit = (plru[set] >> node) & 1;
+				way = 2 * way + bit;
+				node = 2 * node + bit;
+			}
+			return way;
+		}
+		default:
+			// xorshift64
+			random ^= random << 13;
+			random ^= random >> 7;
+			random ^= random << 17;
+			return random % config.ways;
+	}
+}
+
+bool CacheLevel::fill(unsigned long address, bool dirtyLine, unsigned long *victim)
+{
+	uint64_t tag = address >> lineBits;
+	unsigned long set = tag & setMask;
+	int way = victimWay(set);
+	unsigned long index = set * stride + way;
+
+	bool writeback = false;
+	if (tags[index] != CACHE_INVALID_TAG) {
+		stats.evictions++;
+		if (dirty[index]) {
+			writeback = true;
+			*victim = tags[index] << lineBits;
+		}
+	}
+	tags[index] = tag;
+	dirty[index] = dirtyLine;
+	touch(set, way);
+	setLast(tag, index);
+	return writeback;
+}
+
+void CacheLevel::invalidate()
+{
+	unsigned long entries = (setMask + 1) * stride;
+	for (unsigned long i = 0; i < entries; i++) {
+		tags[i] = CACHE_INVALID_TAG;
+		stamps[i] = 0;
+		dirty[i] = 0;
+	}
+	memset(plru, 0, (setMask + 1) * sizeof(uint64_t));
+	memset(filled, 0, (setMask + 1) * sizeof(unsigned int));
+	clock = 0;
+	lastTag = CACHE_INVALID_TAG;
+	lastLine = 0;
+	lastSize = 0;
+	lastIndex = 0;
+}
+
+string CacheLevel::getName()
+{
+	return name;
+}
+
+CacheConfig CacheLevel::getConfig()
+{
+	return config;
+}
+
+CacheStats CacheLevel::getStats()
+{
+	CacheStats current = stats;
+	current.hits = current.reads + current.writes - current.misses;
+	return current;
+}
+
+void CacheLevel::resetStats()
+{
+	stats = {0, 0, 0, 0, 0, 0};
+}
+
+void CacheLevel::countWriteback()
+{
+	stats.writebacks++;
+}
+
+CachedMemory::CachedMemory(unsigned long size) : CachedMemory(new SimpleMemory(size))
+{
+}
+
+CachedMemory::CachedMemory(Memory *memory) : CachedMemory(memory,
+		{CACHE_L1_SIZE, CACHE_L1_WAYS, CACHE_LINE_SIZE,
+				CacheReplacement::PLRU, CacheWritePolicy::WRITE_BACK},
+		{CACHE_L1_SIZE, CACHE_L1_WAYS, CACHE_LINE_SIZE,
+				CacheReplacement::PLRU, CacheWritePolicy::WRITE_BACK},
+		{CACHE_L2_SIZE, CACHE_L2_WAYS, CACHE_LINE_SIZE,
+				CacheReplacement::LRU, CacheWritePolicy::WRITE_BACK})
+{
+}
+
+CachedMemory::CachedMemory(Memory *memory, CacheConfig l1i, CacheConfig l1d,
+		CacheConfig l2)
+{
+	this->memory = memory;
+	simpleMemory = (typeid(*memory) == typeid(SimpleMemory))
+			? static_cast<SimpleMemory*>(memory) : nullptr;
+	levels[L1I] = new CacheLevel("L1I", l1i);
+	levels[L1D] = new CacheLevel("L1D", l1d);
+	levels[L2] = new CacheLevel("L2", l2);
+	for (int i = 0; i < CACHE_LEVELS; i++) {
+		writeThrough[i] = (levels[i]->getConfig().writePolicy
+				== CacheWritePolicy::WRITE_THROUGH);
+	}
+}
+
+CachedMemory::~CachedMemory()
+{
+	for (int i = 0; i < CACHE_LEVELS; i++) {
+		delete levels[i];
+	}
+	delete memory;
+}
+
+void CachedMemory::loadBinary(string filename)
+{
+	memory->loadBinary(filename);
+	for (int i = 0; i < CACHE_LEVELS; i++) {
+		levels[i]->invalidate();
+	}
+}
+
+void CachedMemory::writeBinaryAsText(string basename)
+{
+	memory->writeBinaryAsText(basename);
+}
+
+void CachedMemory::accessSet(Level level, unsigned long address, bool write)
+{
+	bool hit = levels[level]->lookup(address, write);
+	if (!hit || (write && writeThrough[level])) {
+		miss(level, address, write, hit);
+	}
+}
+
+unsigned int CachedMemory::fetchSet(unsigned long address)
+{
+	accessSet(L1I, address, false);
+	return simpleMemory ? simpleMemory->SimpleMemory::readInstruction32(address)
+			: memory->readInstruction32(address);
+}
+
+long CachedMemory::readSet(unsigned long address, unsigned long size)
+{
+	dataSet(address, size, false);
+	switch (size) {
+		case sizeof(signed char):
+			return simpleMemory ? simpleMemory->SimpleMemory::readData8(address)
+					: memory->readData8(address);
+		case sizeof(short):
+			return simpleMemory ? simpleMemory->SimpleMemory::readData16(address)
+					: memory->readData16(address);
+		case sizeof(int):
+			return simpleMemory ? simpleMemory->SimpleMemory::readData32(address)
+					: memory->readData32(address);
+		default:
+			return simpleMemory ? simpleMemory->SimpleMemory::readData64(address)
+					: memory->readData64(address);
+	}
+}
+
+void CachedMemory::writeSet(unsigned long address, unsigned long size, long value)
+{
+	dataSet(address, size, true);
+	switch (size) {
+		case sizeof(signed char):
+			if (simpleMemory) {
+				simpleMemory->SimpleMemory::writeData8(address, value);
+			} else {
+				memory->writeData8(address, value);
+			}
+			break;
+		case sizeof(short):
+			if (simpleMemory) {
+				simpleMemory->SimpleMemory::writeData16(address, value);
+			} else {
+				memory->writeData16(address, value);
+			}
+			break;
+		case sizeof(int):
+			if (simpleMemory) {
+				simpleMemory->SimpleMemory::writeData32(address, value);
+			} else {
+				memory->writeData32(address, value);
+			}
+			break;
+		default:
+			if (simpleMemory) {
+				simpleMemory->SimpleMemory::writeData64(address, value);
+			} else {
+				memory->writeData64(address, value);
+			}
+			break;
+	}
+}
+
+void CachedMemory::dataSet(unsigned long address, unsigned long size, bool write)
+{
+	if (address & (size - 1)) {
+		accessRange(L1D, address, size, write);
+	} else {
+		accessSet(L1D, address, write);
+	}
+}
+
+void CachedMemory::accessRange(Level level, unsigned long address, unsigned long size,
+		bool write)
+{
+	if (size == 0) {
+		return;
+	}
+	unsigned long lineSize = levels[level]->getConfig().lineSize;
+	unsigned long last = (address + size - 1) & ~(lineSize - 1);
+	for (unsigned long line = address & ~(lineSize - 1); ; line += lineSize) {
+		access(level, line, write);
+		if (line == last) {
+			break;
+		}
+	}
+}
+
+void CachedMemory::readBlock(unsigned long address, void *buffer, unsigned long size)
+{
+	accessRange(L1D, address, size, false);
+	memory->readBlock(address, buffer, size);
+}
+
+void CachedMemory::writeBlock(unsigned long address, const void *buffer, unsigned long size)
+{
+	accessRange(L1D, address, size, true);
+	memory->writeBlock(address, buffer, size);
+}
+
+void CachedMemory::readPair64(unsigned long address, long *first, long *second)
+{
+	accessRange(L1D, address, 16, false);
+	memory->readPair64(address, first, second);
+}
+
+void CachedMemory::writePair64(unsigned long address, long first, long second)
+{
+	accessRange(L1D, address, 16, true);
+	memory->writePair64(address, first, second);
+}
+
+/**
+ * Falta (ou escrita WRITE_THROUGH, com hit indicando se a linha estava
+ * presente).
+ *
+ * Escritas WRITE_THROUGH seguem para o nível seguinte sem alocar a linha.
+ * Nos demais casos a linha é lida do nível seguinte e alocada; se a linha
+ * despejada estiver suja, ela é escrita no nível seguinte.
+ */
+void CachedMemory::miss(Level level, unsigned long address, bool write, bool hit)
+{
+	CacheLevel *cache = levels[level];
+
+	if (write && writeThrough[level]) {
+		cache->countWriteback();
+		next(level, address, true);
+		return;
+	}
+	if (hit) {
+		return;
+	}
+
+	unsigned long victim;
+	next(level, address, false);
+	if (cache->fill(address, write, &victim)) {
+		cache->countWriteback();
+		next(level, victim, true);
+	}
+}
+
+void CachedMemory::next(Level level, unsigned long address, bool write)
+{
+	if (level == L2) {
+		if (write) {
+			memoryWrites++;
+		} else {
+			memoryReads++;
+		}
+		return;
+	}
+	access(L2, address, write);
+}
+
+Memory *CachedMemory::getMemory()
+{
+	return memory;
+}
+
+CacheLevel *CachedMemory::getLevel(Level level)
+{
+	return levels[level];
+}
+
+unsigned long CachedMemory::getMemoryReads()
+{
+	return memoryReads;
+}
+
+unsigned long CachedMemory::getMemoryWrites()
+{
+	return memoryWrites;
+}
+
+void CachedMemory::resetStats()
+{
+	for (int i = 0; i < CACHE_LEVELS; i++) {
+		levels[i]->resetStats();
+	}
+	memoryReads = 0;
+	memoryWrites = 0;
+}
+
+void CachedMemory::printStats(ostream &ofp)
+{
+	for (int i = 0; i < CACHE_LEVELS; i++) {
+		CacheStats stats = levels[i]->getStats();
+		unsigned long accesses = stats.reads + stats.writes;
+		ofp << setw(4) << left << levels[i]->getName() << right << dec
+				<< " leituras: " << stats.reads
+				<< ", escritas: " << stats.writes
+				<< ", acertos: " << stats.hits
+				<< ", faltas: " << stats.misses
+				<< " (" << fixed << setprecision(2)
+				<< (accesses ? 100.0 * stats.misses / accesses : 0.0) << "%)"
+				<< ", despejos: " << stats.evictions
+				<< ", write-backs: " << stats.writebacks << endl;
+	}
+	ofp << "mem  leituras: " << memoryReads << ", escritas: " << memoryWrites << endl;
+}
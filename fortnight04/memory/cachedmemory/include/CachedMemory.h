@@ -0,0 +1,557 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) CachedMemory - A Memory decorator that models split L1I/L1D caches and
+	a unified L2. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) CachedMemory - Um decorador de Memory que modela caches L1I/L1D
+	separadas e uma L2 unificada. Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "Memory.h"
+#include "SimpleMemory.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Configuração padrão: L1I e L1D de 32 KiB, 8 vias, e L2 de 1 MiB, 16
+// vias, com linhas de 64 bytes
+#define CACHE_LINE_SIZE 64
+#define CACHE_L1_SIZE (32 * 1024)
+#define CACHE_L1_WAYS 8
+#define CACHE_L2_SIZE (1024 * 1024)
+#define CACHE_L2_WAYS 16
+
+// Tag de via inválida: os tags são endereços de linha (address >>
+// bits da linha), que nunca têm todos os bits em 1
+#define CACHE_INVALID_TAG (~0UL)
+
+// Número de tags comparados por instrução SIMD; as vias de cada conjunto
+// são completadas até um múltiplo dele com tags inválidos
+#define CACHE_TAG_LANES 4
+
+using namespace std;
+
+enum class CacheReplacement {LRU, PLRU, RANDOM};
+
+/**
+ * WRITE_BACK: escrita com alocação; a linha fica suja e só é escrita no
+ * nível seguinte ao ser despejada.
+ * WRITE_THROUGH: escrita sem alocação; toda escrita segue para o nível
+ * seguinte e a linha, se presente, continua limpa.
+ */
+enum class CacheWritePolicy {WRITE_BACK, WRITE_THROUGH};
+
+/**
+ * Configuração de um nível: tamanho e linha em bytes, número de vias
+ * (size / (lineSize * ways) conjuntos, potência de 2), substituição
+ * (PLRU exige número de vias potência de 2) e política de escrita.
+ */
+struct CacheConfig {
+	unsigned long size;
+	unsigned int ways;
+	unsigned int lineSize;
+	CacheReplacement replacement;
+	CacheWritePolicy writePolicy;
+};
+
+/**
+ * Estatísticas de um nível. writebacks conta as escritas enviadas ao nível
+ * seguinte: linhas sujas despejadas (WRITE_BACK) ou todas as escritas
+ * (WRITE_THROUGH). hits não é contado nos acessos: é calculado por
+ * getStats().
+ */
+struct CacheStats {
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long writebacks;
+};
+
+/**
+ * Um nível de cache associativa por conjunto.
+ *
+ * Só os tags são modelados (os dados continuam na memória decorada). Os
+ * vetores de estado são separados (SoA): os tags de um conjunto ficam
+ * contíguos e alinhados, e a busca compara CACHE_TAG_LANES tags por vez
+ * (AVX2) ou 2 (SSE2).
+ */
+class CacheLevel
+{
+public:
+	CacheLevel(string name, CacheConfig config);
+	~CacheLevel();
+
+	/**
+	 * Procura a linha de address e conta o acesso. Em acerto atualiza a
+	 * substituição e, em escritas WRITE_BACK, marca a linha como suja.
+	 *
+	 * Retorna true em acerto.
+	 */
+	bool lookup(unsigned long address, bool write);
+
+	/**
+	 * Acerto na última linha acessada, o caso comum dos acessos em
+	 * sequência: se os bytes de address a last estão nela, conta o acesso
+	 * como lookup() e retorna true. Nos demais casos não conta nada e
+	 * retorna false.
+	 */
+	bool lookupLast(unsigned long address, unsigned long last, bool write);
+
+	/**
+	 * Coloca a linha de address (suja se dirty) no lugar da via escolhida
+	 * pela política de substituição.
+	 *
+	 * Retorna true se a linha despejada estava suja, com seu endereço em
+	 * victim.
+	 */
+	bool fill(unsigned long address, bool dirty, unsigned long *victim);
+
+	/**
+	 * Invalida todas as linhas, sem escrevê-las.
+	 */
+	void invalidate();
+
+	string getName();
+	CacheConfig getConfig();
+	CacheStats getStats();
+	void resetStats();
+
+	/**
+	 * Conta uma escrita enviada ao nível seguinte.
+	 */
+	void countWriteback();
+
+private:
+	string name;
+	CacheConfig config;
+	unsigned int lineBits;
+	unsigned long setMask;
+	unsigned int stride;		// vias por conjunto nos vetores (múltiplo de CACHE_TAG_LANES)
+	unsigned int treeLevels;	// níveis da árvore de PLRU
+	CacheStats stats;
+
+	uint64_t *tags;			// [conjunto * stride + via]
+	uint64_t *stamps;		// LRU: último acesso de cada via
+	uint64_t *plru;			// PLRU: bits da árvore de cada conjunto
+	uint64_t *plruKeep;		// PLRU: bits que um acesso à via não altera
+	uint64_t *plruPoint;	// PLRU: novos valores dos bits no caminho da via
+	uint8_t *dirty;			// [conjunto * stride + via]
+	unsigned int *filled;	// vias válidas de cada conjunto
+	uint64_t clock;
+	uint64_t random;
+
+	/**
+	 * Última linha acessada (tag, endereço e posição nos vetores). Um novo
+	 * acesso a ela não muda a substituição (já é a mais recente, em LRU e
+	 * PLRU) e dispensa a busca no conjunto. lastSize é o tamanho da linha,
+	 * ou 0 se não há última linha, para que lookupLast() a teste sem
+	 * deslocamentos.
+	 */
+	uint64_t lastTag;
+	unsigned long lastLine;
+	unsigned long lastSize;
+	unsigned long lastIndex;
+
+	/**
+	 * Torna a linha de tag tag, na posição index, a última acessada.
+	 */
+	void setLast(uint64_t tag, unsigned long index);
+
+	/**
+	 * Via do conjunto set (primeiro tag do conjunto) com o tag tag, ou -1.
+	 */
+	int findWay(const uint64_t *set, uint64_t tag);
+
+	/**
+	 * Atualiza a substituição após um acesso à via way do conjunto set e
+	 * escolhe a via a despejar do conjunto set.
+	 */
+	void touch(unsigned long set, int way);
+	int victimWay(unsigned long set);
+};
+
+/**
+ * Decorador de Memory que modela uma hierarquia de caches: L1I (busca de
+ * instruções) e L1D (dados) separadas e uma L2 unificada, não inclusiva,
+ * na frente da memória decorada, que continua guardando os dados.
+ *
+ * Um acesso a dados desalinhado que cruza linhas consulta a L1D uma vez
+ * por linha tocada, como os acessos em bloco. A hierarquia não é compartilhável entre threads: com
+ * MultiCoreProcessor, use uma CachedMemory por núcleo ou nenhuma.
+ *
+ * CachedMemory é dona da memória decorada e a libera no destrutor.
+ */
+class CachedMemory : public Memory
+{
+public:
+	enum Level {L1I, L1D, L2, CACHE_LEVELS};
+
+	/**
+	 * Decora memory com a configuração padrão ou com as configurações
+	 * dadas. O construtor com size decora uma SimpleMemory de size bytes
+	 * (para uso como MemImpl).
+	 */
+	CachedMemory(unsigned long size);
+	CachedMemory(Memory *memory);
+	CachedMemory(Memory *memory, CacheConfig l1i, CacheConfig l1d, CacheConfig l2);
+	~CachedMemory();
+
+	/**
+	 * Carregar um binário invalida as caches.
+	 */
+	void loadBinary(string filename);
+	void writeBinaryAsText (string basename);
+
+	/**
+	 * Acessos pela hierarquia de caches.
+	 */
+	unsigned int readInstruction32(unsigned long address);
+	signed char readData8(unsigned long address);
+	short readData16(unsigned long address);
+	int readData32(unsigned long address);
+	long readData64(unsigned long address);
+	void writeData8(unsigned long address, signed char value);
+	void writeData16(unsigned long address, short value);
+	void writeData32(unsigned long address, int value);
+	void writeData64(unsigned long address, long value);
+
+	/**
+	 * Acessos largos: uma consulta à L1D por linha tocada pelo acesso (um
+	 * par que não cruza linhas é um único acesso) e uma única transação
+	 * na memória decorada.
+	 */
+	void readBlock(unsigned long address, void *buffer, unsigned long size);
+	void writeBlock(unsigned long address, const void *buffer, unsigned long size);
+	void readPair64(unsigned long address, long *first, long *second);
+	void writePair64(unsigned long address, long first, long second);
+
+	/**
+	 * Memória decorada, nível level e leituras e escritas de linhas que
+	 * chegaram à memória.
+	 */
+	Memory *getMemory();
+	CacheLevel *getLevel(Level level);
+	unsigned long getMemoryReads();
+	unsigned long getMemoryWrites();
+	void resetStats();
+
+	/**
+	 * Escreve as estatísticas de todos os níveis em ofp.
+	 */
+	void printStats(ostream &ofp);
+
+protected:
+	Memory *memory;
+	CacheLevel *levels[CACHE_LEVELS];
+
+	/**
+	 * memory, se ela for exatamente uma SimpleMemory (senão nullptr): os
+	 * acessos a ela são chamados diretamente, sem a segunda chamada
+	 * virtual por acesso.
+	 */
+	SimpleMemory *simpleMemory;
+	bool writeThrough[CACHE_LEVELS];
+	unsigned long memoryReads = 0;
+	unsigned long memoryWrites = 0;
+
+	/**
+	 * Acesso ao nível level: o acerto na última linha do nível é
+	 * resolvido inline e o resto, fora de linha, por lookup() em
+	 * accessSet() e, na falta, por miss().
+	 */
+	void access(Level level, unsigned long address, bool write);
+	void accessSet(Level level, unsigned long address, bool write);
+
+	/**
+	 * Acesso ao nível level de cada linha dos size bytes a partir de
+	 * address.
+	 */
+	void accessRange(Level level, unsigned long address, unsigned long size, bool write);
+
+	/**
+	 * Acessos à L1I (busca, alinhada, que nunca cruza linhas) e à L1D (um
+	 * dado de size bytes, potência de 2): o acerto na última linha
+	 * acessada do nível é testado inline por lastFetch() e lastData(),
+	 * antes do acesso à memória decorada. Fora da última linha, dataSet()
+	 * faz o acesso à L1D (um acesso alinhado não cruza linhas e é um único
+	 * accessSet()).
+	 */
+	bool lastFetch(unsigned long address);
+	bool lastData(unsigned long address, unsigned long size, bool write);
+	void dataSet(unsigned long address, unsigned long size, bool write);
+
+	/**
+	 * Busca, leitura e escrita de size bytes fora da última linha: o
+	 * acesso ao nível e à memória decorada. Ficam fora de linha, chamados
+	 * como última operação dos acessos, para que o caminho do acerto não
+	 * precise salvar registradores.
+	 */
+	unsigned int fetchSet(unsigned long address);
+	long readSet(unsigned long address, unsigned long size);
+	void writeSet(unsigned long address, unsigned long size, long value);
+
+	/**
+	 * Trata uma falta (ou uma escrita WRITE_THROUGH) no nível level,
+	 * acessando o nível seguinte (L2 ou a memória).
+	 */
+	void miss(Level level, unsigned long address, bool write, bool hit);
+
+	/**
+	 * Leitura ou escrita de uma linha no nível seguinte a level.
+	 */
+	void next(Level level, unsigned long address, bool write);
+};
+
+/**
+ * A busca e o acerto são definidos aqui para serem expandidos inline nos
+ * acessos de CachedMemory.
+ */
+inline int CacheLevel::findWay(const uint64_t *set, uint64_t tag)
+{
+#if defined(__AVX2__)
+	__m256i key = _mm256_set1_epi64x(tag);
+	for (unsigned int way = 0; way < stride; way += 4) {
+		__m256i eq = _mm256_cmpeq_epi64(
+				_mm256_load_si256((const __m256i*)(set + way)), key);
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+		if (mask) {
+			return way + __builtin_ctz(mask);
+		}
+	}
+	return -1;
+#elif defined(__SSE2__)
+	// SSE2 não compara 64 bits: as duas metades de 32 bits devem ser iguais
+	__m128i key = _mm_set1_epi64x(tag);
+	for (unsigned int way = 0; way < stride; way += 2) {
+		__m128i eq = _mm_cmpeq_epi32(
+				_mm_load_si128((const __m128i*)(set + way)), key);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+		if (mask) {
+			return way + __builtin_ctz(mask);
+		}
+	}
+	return -1;
+#else
+	for (unsigned int way = 0; way < stride; way++) {
+		if (set[way] == tag) {
+			return way;
+		}
+	}
+	return -1;
+#endif
+}
+
+inline bool CacheLevel::lookup(unsigned long address, bool write)
+{
+	uint64_t tag = address >> lineBits;
+	unsigned long set = tag & setMask;
+
+	if (write) {
+		stats.writes++;
+	} else {
+		stats.reads++;
+	}
+	unsigned long index = lastIndex;
+	if (tag != lastTag) {
+		int way = findWay(tags + set * stride, tag);
+		if (way < 0) {
+			stats.misses++;
+			return false;
+		}
+		touch(set, way);
+		index = set * stride + way;
+		setLast(tag, index);
+	}
+	if (write && (config.writePolicy == CacheWritePolicy::WRITE_BACK)) {
+		dirty[index] = 1;
+	}
+	return true;
+}
+
+inline bool CacheLevel::lookupLast(unsigned long address, unsigned long last, bool write)
+{
+	// um só desvio: address e last estão na última linha
+	if (((address ^ lastLine) | (last ^ lastLine)) >= lastSize) {
+		return false;
+	}
+	if (write) {
+		stats.writes++;
+		if (config.writePolicy == CacheWritePolicy::WRITE_BACK) {
+			dirty[lastIndex] = 1;
+		}
+	} else {
+		stats.reads++;
+	}
+	return true;
+}
+
+inline void CacheLevel::setLast(uint64_t tag, unsigned long index)
+{
+	lastTag = tag;
+	lastLine = tag << lineBits;
+	lastSize = config.lineSize;
+	lastIndex = index;
+}
+
+inline void CacheLevel::touch(unsigned long set, int way)
+{
+	switch (config.replacement) {
+		case CacheReplacement::LRU:
+			stamps[set * stride + way] = ++clock;
+			break;
+		case CacheReplacement::PLRU:
+			plru[set] = (plru[set] & plruKeep[way]) | plruPoint[way];
+			break;
+		default:
+			break;
+	}
+}
+
+inline void CachedMemory::access(Level level, unsigned long address, bool write)
+{
+	if ((write && writeThrough[level]) || !levels[level]->lookupLast(address, address, write)) {
+		accessSet(level, address, write);
+	}
+}
+
+inline bool CachedMemory::lastFetch(unsigned long address)
+{
+	return levels[L1I]->lookupLast(address, address, false);
+}
+
+inline bool CachedMemory::lastData(unsigned long address, unsigned long size, bool write)
+{
+	return !(write && writeThrough[L1D])
+			&& levels[L1D]->lookupLast(address, address + size - 1, write);
+}
+
+inline unsigned int CachedMemory::readInstruction32(unsigned long address)
+{
+	if (lastFetch(address)) {
+		return simpleMemory ? simpleMemory->SimpleMemory::readInstruction32(address)
+				: memory->readInstruction32(address);
+	}
+	return fetchSet(address);
+}
+
+inline signed char CachedMemory::readData8(unsigned long address)
+{
+	if (lastData(address, sizeof(signed char), false)) {
+		return simpleMemory ? simpleMemory->SimpleMemory::readData8(address)
+				: memory->readData8(address);
+	}
+	return readSet(address, sizeof(signed char));
+}
+
+inline short CachedMemory::readData16(unsigned long address)
+{
+	if (lastData(address, sizeof(short), false)) {
+		return simpleMemory ? simpleMemory->SimpleMemory::readData16(address)
+				: memory->readData16(address);
+	}
+	return readSet(address, sizeof(short));
+}
+
+inline int CachedMemory::readData32(unsigned long address)
+{
+	if (lastData(address, sizeof(int), false)) {
+		return simpleMemory ? simpleMemory->SimpleMemory::readData32(address)
+				: memory->readData32(address);
+	}
+	return readSet(address, sizeof(int));
+}
+
+inline long CachedMemory::readData64(unsigned long address)
+{
+	if (lastData(address, sizeof(long), false)) {
+		return simpleMemory ? simpleMemory->SimpleMemory::readData64(address)
+				: memory->readData64(address);
+	}
+	return readSet(address, sizeof(long));
+}
+
+inline void CachedMemory::writeData8(unsigned long address, signed char value)
+{
+	if (!lastData(address, sizeof(value), true)) {
+		writeSet(address, sizeof(value), value);
+	} else if (simpleMemory) {
+		simpleMemory->SimpleMemory::writeData8(address, value);
+	} else {
+		memory->writeData8(address, value);
+	}
+}
+
+inline void CachedMemory::writeData16(unsigned long address, short value)
+{
+	if (!lastData(address, sizeof(value), true)) {
+		writeSet(address, sizeof(value), value);
+	} else if (simpleMemory) {
+		simpleMemory->SimpleMemory::writeData16(address, value);
+	} else {
+		memory->writeData16(address, value);
+	}
+}
+
+inline void CachedMemory::writeData32(unsigned long address, int value)
+{
+	if (!lastData(address, sizeof(value), true)) {
+		writeSet(address, sizeof(value), value);
+	} else if (simpleMemory) {
+		simpleMemory->SimpleMemory::writeData32(address, value);
+	} else {
+		memory->writeData32(address, value);
+	}
+}
+
+inline void CachedMemory::writeData64(unsigned long address, long value)
+{
+	if (!lastData(address, sizeof(value), true)) {
+		writeSet(address, sizeof(value), value);
+	} else if (simpleMemory) {
+		simpleMemory->SimpleMemory::writeData64(address, value);
+	} else {
+		memory->writeData64(address, value);
+	}
+}
@@ -0,0 +1,327 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) PagedMemory - A sparse paged memory covering the 64-bit address space,
+	with pages allocated on first touch. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) PagedMemory - Uma memória paginada esparsa que cobre o espaço de
+	endereçamento de 64 bits, com páginas alocadas no primeiro acesso.
+	Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "PagedMemory.h"
+
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static_assert(GUEST_PAGE_BITS + PAGE_TABLE_LEVELS * PAGE_TABLE_LEVEL_BITS == 64,
+		"a tabela de páginas deve cobrir os 64 bits de endereço");
+
+PagedMemory::PagedMemory(unsigned long size)
+{
+	this->size = size;
+	fileSize = 0;
+	pagesAllocated = 0;
+	tablesAllocated = 1;
+	root = new PageTable();
+}
+
+PagedMemory::~PagedMemory()
+{
+	freeTable(root, 0);
+	for (auto &mapping : fileMappings) {
+		munmap(mapping.first, mapping.second);
+	}
+}
+
+/**
+ * Libera a tabela table do nível level, suas subtabelas e páginas.
+ */
+void PagedMemory::freeTable(PageTable *table, int level)
+{
+	for (int i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+		void *entry = table->entries[i].load(memory_order_relaxed);
+		if (!entry) {
+			continue;
+		}
+		if (level == PAGE_TABLE_LEVELS - 1) {
+			releasePage((char*)entry);
+		} else {
+			freeTable((PageTable*)entry, level + 1);
+		}
+	}
+	delete table;
+}
+
+/**
+ * Percorre a tabela de páginas até o último nível, alocando as tabelas que
+ * ainda não existirem. Se dois núcleos alocarem a mesma entrada ao mesmo
+ * tempo, o compare-and-swap mantém uma das alocações e a outra é
+ * descartada.
+ */
+atomic<void*> *PagedMemory::pageEntry(unsigned long address)
+{
+	PageTable *table = root;
+	
+	for (int level = 0; level < PAGE_TABLE_LEVELS - 1; level++) {
+		atomic<void*> &entry = table->entries[tableIndex(address, level)];
+		void *next = entry.load(memory_order_acquire);
+		
+		if (!next) {
+			PageTable *allocated = new PageTable();
+			if (entry.compare_exchange_strong(next, allocated,
+					memory_order_acq_rel, memory_order_acquire)) {
+				next = allocated;
+				tablesAllocated++;
+			} else {
+				delete allocated;
+			}
+		}
+		table = (PageTable*)next;
+	}
+	return &table->entries[tableIndex(address, PAGE_TABLE_LEVELS - 1)];
+}
+
+/**
+ * Página do endereço address, alocada (zerada) se ainda não existir.
+ */
+char *PagedMemory::touchPage(unsigned long address)
+{
+	atomic<void*> *entry = pageEntry(address);
+	void *page = entry->load(memory_order_acquire);
+	
+	if (!page) {
+		char *allocated = new char[GUEST_PAGE_SIZE]();
+		if (entry->compare_exchange_strong(page, allocated,
+				memory_order_acq_rel, memory_order_acquire)) {
+			page = allocated;
+			pagesAllocated++;
+		} else {
+			delete[] allocated;
+		}
+	}
+	return (char*)page;
+}
+
+/**
+ * Troca a página do endereço address por page. Quem guarda traduções da
+ * página anterior é avisado por pageRemapped() antes que ela seja liberada.
+ */
+void PagedMemory::mapPage(unsigned long address, char *page)
+{
+	char *previous = (char*)pageEntry(address)->exchange(page, memory_order_acq_rel);
+	if (previous) {
+		pageRemapped(address);
+		releasePage(previous);
+	}
+}
+
+void PagedMemory::releasePage(char *page)
+{
+	for (auto &mapping : fileMappings) {
+		if ((page >= mapping.first) && (page < mapping.first + mapping.second)) {
+			filePages--;
+			return;
+		}
+	}
+	delete[] page;
+	pagesAllocated--;
+}
+
+/**
+ * Remove a página do endereço address da tabela (as tabelas intermediárias
+ * são mantidas) e avisa pageRemapped() antes de liberá-la.
+ */
+void PagedMemory::unmapPage(unsigned long address)
+{
+	PageTable *table = root;
+	for (int level = 0; level < PAGE_TABLE_LEVELS - 1; level++) {
+		table = (PageTable*)table->entries[tableIndex(address, level)]
+				.load(memory_order_acquire);
+		if (!table) {
+			return;
+		}
+	}
+	
+	char *page = (char*)table->entries[tableIndex(address, PAGE_TABLE_LEVELS - 1)]
+			.exchange(nullptr, memory_order_acq_rel);
+	if (page) {
+		pageRemapped(address);
+		releasePage(page);
+	}
+}
+
+/**
+ * Cópia em blocos: cada trecho dentro de uma página é um memcpy.
+ */
+void PagedMemory::readBlock(unsigned long address, void *buffer, unsigned long size)
+{
+	char *out = (char*)buffer;
+	while (size > 0) {
+		unsigned long offset = address & GUEST_PAGE_MASK;
+		unsigned long n = (GUEST_PAGE_SIZE - offset < size) ? GUEST_PAGE_SIZE - offset : size;
+		char *page = findPage(address);
+		if (page) {
+			memcpy(out, page + offset, n);
+		} else {
+			memset(out, 0, n);
+		}
+		out += n;
+		address += n;
+		size -= n;
+	}
+}
+
+void PagedMemory::writeBlock(unsigned long address, const void *buffer, unsigned long size)
+{
+	const char *in = (const char*)buffer;
+	while (size > 0) {
+		unsigned long offset = address & GUEST_PAGE_MASK;
+		unsigned long n = (GUEST_PAGE_SIZE - offset < size) ? GUEST_PAGE_SIZE - offset : size;
+		memcpy(touchPage(address) + offset, in, n);
+		in += n;
+		address += n;
+		size -= n;
+	}
+}
+
+/**
+ * carrega arquivo binário na memória, a partir do endereço 0, mapeando o
+ * arquivo e apontando as páginas da tabela para o mapeamento. Se a página
+ * do hospedeiro não for do tamanho de GUEST_PAGE_SIZE, o arquivo é copiado
+ * para páginas alocadas.
+ */
+void PagedMemory::loadBinary(string filename)
+{
+	struct stat fileStat;
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if ((fd < 0) || (fstat(fd, &fileStat) < 0)) {
+		cout << "Unable to open file " << filename << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	fileSize = fileStat.st_size;
+	if (!fileSize) {
+		close(fd);
+		return;
+	}
+
+	if (sysconf(_SC_PAGESIZE) != GUEST_PAGE_SIZE) {
+		for (unsigned long address = 0; address < fileSize; address += GUEST_PAGE_SIZE) {
+			if (pread(fd, touchPage(address), GUEST_PAGE_SIZE, address) < 0) {
+				break;
+			}
+		}
+		close(fd);
+		return;
+	}
+
+	// o restante da última página, após o fim do arquivo, é lido como 0
+	char *mapping = (char*)mmap(nullptr, fileSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		cout << "Unable to map file " << filename << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	fileMappings.push_back(make_pair(mapping, fileSize));
+	for (unsigned long address = 0; address < fileSize; address += GUEST_PAGE_SIZE) {
+		mapPage(address, mapping + address);
+		filePages++;
+	}
+}
+
+/**
+ * Escreve arquivo binario em um arquivo legível
+ */
+#define LINE_SIZE 4
+void PagedMemory::writeBinaryAsText (string basename) {
+	string filename = "txt_" + basename + ".txt";
+	ofstream ofp;
+	unsigned long i;
+	int j;
+
+	cout << "Gerado arquivo " << filename << endl << endl;
+	ofp.open(filename);
+
+	ofp << uppercase << hex;
+
+	// caption
+	ofp << "ADDR    ";
+	for (j=0; j<LINE_SIZE; j++) {
+		ofp << "ADDR+" << setfill('0') << setw(2) << 4*j << "  ";
+	}
+	ofp << endl << "----------------------------------------------------------------------------" << endl;
+
+	// binary
+	for (i = 0; i < fileSize; i += 4*LINE_SIZE) {
+		ofp << setw(4) << i << "    ";
+		for (j=0; j<LINE_SIZE; j++) {
+			ofp << setw(8) << readInstruction32(i + 4*j) << " ";
+		}
+		ofp << endl;
+	}
+	ofp.close();
+}
+
+unsigned long PagedMemory::getSize()
+{
+	return size;
+}
+
+unsigned long PagedMemory::getPagesAllocated()
+{
+	return pagesAllocated;
+}
+
+unsigned long PagedMemory::getTablesAllocated()
+{
+	return tablesAllocated;
+}
+
+unsigned long PagedMemory::getFilePages()
+{
+	return filePages;
+}
@@ -0,0 +1,340 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) PagedMemory - A sparse paged memory covering the 64-bit address space,
+	with pages allocated on first touch. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) PagedMemory - Uma memória paginada esparsa que cobre o espaço de
+	endereçamento de 64 bits, com páginas alocadas no primeiro acesso.
+	Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "Memory.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Páginas de 4 KiB e tabela de páginas de PAGE_TABLE_LEVELS níveis, cada
+// nível indexado por PAGE_TABLE_LEVEL_BITS bits do endereço:
+// 12 + 4 * 13 = 64 bits
+#define GUEST_PAGE_BITS 12
+#define GUEST_PAGE_SIZE (1UL << GUEST_PAGE_BITS)
+#define GUEST_PAGE_MASK (GUEST_PAGE_SIZE - 1)
+#define PAGE_TABLE_LEVELS 4
+#define PAGE_TABLE_LEVEL_BITS 13
+#define PAGE_TABLE_ENTRIES (1 << PAGE_TABLE_LEVEL_BITS)
+
+using namespace std;
+
+/**
+ * Memória paginada esparsa.
+ *
+ * Todo o espaço de endereçamento de 64 bits é válido, mas só as páginas
+ * escritas (ou carregadas por loadBinary) ocupam memória do hospedeiro: a
+ * página e as tabelas intermediárias são alocadas na primeira escrita.
+ * Leituras de páginas nunca escritas retornam 0 sem alocar nada.
+ *
+ * Os acessos a dados não precisam ser alinhados (ver Memory.h). Um acesso
+ * dentro de uma página é um único memcpy de tamanho constante; os raros
+ * acessos que cruzam páginas passam por readBlock e writeBlock.
+ *
+ * loadBinary mapeia o arquivo binário (mmap, MAP_PRIVATE) e aponta as
+ * entradas da tabela para as páginas do mapeamento, sem cópia: as páginas
+ * só são lidas do disco quando acessadas e são compartilhadas com outras
+ * instâncias até serem escritas (copy-on-write).
+ *
+ * As entradas da tabela são atômicas e a alocação usa compare-and-swap, de
+ * forma que vários núcleos (MultiCoreProcessor) podem tocar páginas novas
+ * ao mesmo tempo.
+ */
+class PagedMemory : public Memory
+{
+public:
+	/**
+	 * size é o tamanho nominal da memória (por exemplo, o topo da pilha em
+	 * config.h) e não limita os endereços válidos.
+	 */
+	PagedMemory(unsigned long size);
+	~PagedMemory();
+
+	void loadBinary(std::string filename);
+	void writeBinaryAsText (std::string basename);
+
+	/**
+	 * Lê uma instrução de 32 bits considerando um endereçamento em bytes.
+	 */
+	unsigned int readInstruction32(unsigned long address);
+
+	/**
+	 * Acessos a dados de 8, 16, 32 e 64 bits, sem alinhamento.
+	 */
+	signed char readData8(unsigned long address);
+	short readData16(unsigned long address);
+	int readData32(unsigned long address);
+	long readData64(unsigned long address);
+	void writeData8(unsigned long address, signed char value);
+	void writeData16(unsigned long address, short value);
+	void writeData32(unsigned long address, int value);
+	void writeData64(unsigned long address, long value);
+
+	/**
+	 * Acessos em bloco, copiados com memcpy página a página (páginas
+	 * nunca escritas são lidas como 0), e em pares, que, como os demais
+	 * acessos, só passam pelos blocos quando cruzam páginas.
+	 */
+	void readBlock(unsigned long address, void *buffer, unsigned long size);
+	void writeBlock(unsigned long address, const void *buffer, unsigned long size);
+	void readPair64(unsigned long address, long *first, long *second);
+	void writePair64(unsigned long address, long first, long second);
+
+	/**
+	 * Página do hospedeiro que contém o endereço address: findPage retorna
+	 * nullptr se a página nunca foi escrita e touchPage a aloca, se
+	 * necessário.
+	 */
+	char *findPage(unsigned long address);
+	char *touchPage(unsigned long address);
+
+	/**
+	 * Libera a página que contém o endereço address, que volta a ser lida
+	 * como 0. Implementações que guardam traduções de endereço (TLBMemory)
+	 * são avisadas por pageRemapped().
+	 */
+	void unmapPage(unsigned long address);
+
+	/**
+	 * Tamanho nominal, número de páginas e tabelas alocadas e número de
+	 * páginas mapeadas do arquivo binário.
+	 */
+	unsigned long getSize();
+	unsigned long getPagesAllocated();
+	unsigned long getTablesAllocated();
+	unsigned long getFilePages();
+
+protected:
+	/**
+	 * Leitura e escrita de um dado do tipo T em address, usadas por todos
+	 * os acessos a dados.
+	 */
+	template <class T> T load(unsigned long address);
+	template <class T> void store(unsigned long address, T value);
+
+	/**
+	 * Nível da tabela de páginas. Nos níveis intermediários as entradas
+	 * apontam para tabelas do nível seguinte e no último nível, para
+	 * páginas.
+	 */
+	struct PageTable {
+		atomic<void*> entries[PAGE_TABLE_ENTRIES];
+	};
+
+	PageTable *root;
+	unsigned long size;			// tamanho nominal
+	unsigned long fileSize;		// tamanho do arquivo binário carregado
+	atomic<unsigned long> pagesAllocated;
+	atomic<unsigned long> tablesAllocated;
+
+	/**
+	 * Mapeamentos de arquivos binários (início e tamanho): suas páginas
+	 * não foram alocadas com new e são liberadas com munmap.
+	 */
+	vector<pair<char*, unsigned long>> fileMappings;
+	unsigned long filePages = 0;
+
+	/**
+	 * Índice, na tabela do nível level (0 é a raiz), da entrada que cobre
+	 * o endereço address.
+	 */
+	static unsigned int tableIndex(unsigned long address, int level);
+
+	/**
+	 * Libera a tabela table do nível level e tudo que ela aponta.
+	 */
+	void freeTable(PageTable *table, int level);
+
+	/**
+	 * Entrada do último nível da tabela que aponta para a página do
+	 * endereço address, alocando as tabelas intermediárias se necessário.
+	 */
+	atomic<void*> *pageEntry(unsigned long address);
+
+	/**
+	 * Aponta a entrada da página do endereço address para page (nullptr
+	 * desmapeia a página) e libera a página anterior, se houver.
+	 */
+	void mapPage(unsigned long address, char *page);
+
+	/**
+	 * Libera a página page, a não ser que ela pertença a um mapeamento
+	 * de arquivo.
+	 */
+	void releasePage(char *page);
+
+	/**
+	 * Chamado quando a página que contém o endereço address deixa de estar
+	 * no endereço do hospedeiro em que estava.
+	 */
+	virtual void pageRemapped(unsigned long) {};
+};
+
+/**
+ * Os acessos e a busca na tabela de páginas são definidos aqui para que
+ * uma CPU que conheça o tipo concreto da memória (ver MemoryPort em
+ * BasicCPU.h) possa expandi-los inline.
+ */
+inline unsigned int PagedMemory::tableIndex(unsigned long address, int level)
+{
+	return (address >> (GUEST_PAGE_BITS
+			+ (PAGE_TABLE_LEVELS - 1 - level) * PAGE_TABLE_LEVEL_BITS))
+			& (PAGE_TABLE_ENTRIES - 1);
+}
+
+inline char *PagedMemory::findPage(unsigned long address)
+{
+	PageTable *table = root;
+	for (int level = 0; level < PAGE_TABLE_LEVELS - 1; level++) {
+		table = (PageTable*)table->entries[tableIndex(address, level)]
+				.load(memory_order_acquire);
+		if (!table) {
+			return nullptr;
+		}
+	}
+	return (char*)table->entries[tableIndex(address, PAGE_TABLE_LEVELS - 1)]
+			.load(memory_order_acquire);
+}
+
+inline unsigned int PagedMemory::readInstruction32(unsigned long address)
+{
+	char *page = findPage(address);
+	return page ? *(unsigned int*)(page + (address & GUEST_PAGE_MASK & ~3UL)) : 0;
+}
+
+template <class T>
+inline T PagedMemory::load(unsigned long address)
+{
+	T value;
+	unsigned long offset = address & GUEST_PAGE_MASK;
+	if (offset > GUEST_PAGE_SIZE - sizeof(T)) {
+		PagedMemory::readBlock(address, &value, sizeof(T)); // cruza páginas
+		return value;
+	}
+	char *page = findPage(address);
+	if (!page) {
+		return 0;
+	}
+	memcpy(&value, page + offset, sizeof(T));
+	return value;
+}
+
+template <class T>
+inline void PagedMemory::store(unsigned long address, T value)
+{
+	unsigned long offset = address & GUEST_PAGE_MASK;
+	if (offset > GUEST_PAGE_SIZE - sizeof(T)) {
+		PagedMemory::writeBlock(address, &value, sizeof(T)); // cruza páginas
+		return;
+	}
+	memcpy(touchPage(address) + offset, &value, sizeof(T));
+}
+
+inline signed char PagedMemory::readData8(unsigned long address)
+{
+	return load<signed char>(address);
+}
+
+inline short PagedMemory::readData16(unsigned long address)
+{
+	return load<short>(address);
+}
+
+inline int PagedMemory::readData32(unsigned long address)
+{
+	return load<int>(address);
+}
+
+inline long PagedMemory::readData64(unsigned long address)
+{
+	return load<long>(address);
+}
+
+inline void PagedMemory::writeData8(unsigned long address, signed char value)
+{
+	store<signed char>(address, value);
+}
+
+inline void PagedMemory::writeData16(unsigned long address, short value)
+{
+	store<short>(address, value);
+}
+
+inline void PagedMemory::writeData32(unsigned long address, int value)
+{
+	store<int>(address, value);
+}
+
+inline void PagedMemory::writeData64(unsigned long address, long value)
+{
+	store<long>(address, value);
+}
+
+inline void PagedMemory::readPair64(unsigned long address, long *first, long *second)
+{
+	long pair[2] = {0, 0};
+	unsigned long offset = address & GUEST_PAGE_MASK;
+	if (offset > GUEST_PAGE_SIZE - sizeof(pair)) {
+		PagedMemory::readBlock(address, pair, sizeof(pair));
+	} else {
+		char *page = findPage(address);
+		if (page) {
+			memcpy(pair, page + offset, sizeof(pair));
+		}
+	}
+	*first = pair[0];
+	*second = pair[1];
+}
+
+inline void PagedMemory::writePair64(unsigned long address, long first, long second)
+{
+	long pair[2] = {first, second};
+	unsigned long offset = address & GUEST_PAGE_MASK;
+	if (offset > GUEST_PAGE_SIZE - sizeof(pair)) {
+		PagedMemory::writeBlock(address, pair, sizeof(pair));
+		return;
+	}
+	memcpy(touchPage(address) + offset, pair, sizeof(pair));
+}
@@ -34,86 +34,99 @@
 */
 
 #include "SimpleMemory.h"
+#include "GuestFault.h"
 
 #include <iostream>
 #include <iomanip>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
 SimpleMemory::SimpleMemory(int size)
 {
-	data = new char[size];
+	unsigned long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long dataSize = (size + pageSize - 1) / pageSize * pageSize;
+
+	// reserva guardas e dados sem acesso e libera o acesso aos dados
+	reservationSize = SIMPLEMEMORY_GUARD_SIZE + dataSize + SIMPLEMEMORY_GUARD_SIZE;
+	reservation = (char*)mmap(nullptr, reservationSize, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	data = reservation + SIMPLEMEMORY_GUARD_SIZE;
+	if ((reservation == MAP_FAILED)
+			|| (mprotect(data, dataSize, PROT_READ | PROT_WRITE) < 0)) {
+		cout << "Unable to allocate " << size << " bytes of memory" << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	faultRegion = GuestFault::addRegion(reservation,
+			reservation + reservationSize, data);
+	if (faultRegion < 0) {
+		cout << "Unable to protect memory: more than " << GUEST_FAULT_REGIONS
+				<< " memories allocated" << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	this->size = size;
+	fileSize = 0;
 }
 
 SimpleMemory::~SimpleMemory()
 {
-	delete[] data;
-}
-
-/**
- * L uma instruo de 32 bits considerando um endereamento em bytes.
- *
- * SimpleMemory.cpp implementa a arquitetura de Von Neumman, com apenas uma
- * memria, que armazena instrues e dados.
- */
-unsigned int SimpleMemory::readInstruction32(unsigned long address)
-{
-	return ((int*)data)[address >> 2];
+	GuestFault::removeRegion(faultRegion);
+	munmap(reservation, reservationSize);
 }
 
 /**
- * L um dado de 32 bits considerando um endereamento em bytes.
+ * Acesso direto aos dados da memria, para quem precisa evitar as chamadas
+ * de readData/writeData (por exemplo, cdigo gerado por JIT).
  */
-int SimpleMemory::readData32(unsigned long address)
+char *SimpleMemory::getData()
 {
-	return ((int*)data)[address >> 2];
+	return data;
 }
 
 /**
- * L um dado de 64 bits considerando um endereamento em bytes.
+ * Tamanho da memria em bytes.
  */
-long SimpleMemory::readData64(unsigned long address)
+unsigned long SimpleMemory::getSize()
 {
-	return ((long*)data)[address >> 3];
+	return size;
 }
 
 /**
- * Escreve um dado (value) de 32 bits considerando um endereamento em bytes.
- */
-void SimpleMemory::writeData32(unsigned long address, int value)
-{
-	((int*)data)[address >> 2] = value;
-}
-
-/**
- * Escreve um dado (value) de 64 bits considerando um endereamento em bytes.
- */
-void SimpleMemory::writeData64(unsigned long address, long value)
-{
-	((long*)data)[address >> 3] = value;
-}
-
-/**
- * carrega arquivo binrio na memria
+ * carrega arquivo binrio na memria, mapeando-o (MAP_PRIVATE | MAP_FIXED)
+ * sobre o incio de data
  */
 void SimpleMemory::loadBinary(string filename)
 {
-    streampos size;
-
-    ifstream file(filename, ios::in|ios::binary|ios::ate);
-    if (file.is_open())
-    {
-        fileSize = file.tellg();
-        file.seekg (0, ios::beg);
-        file.read (data, fileSize);
-        file.close();
-    }
-    else {
-        cout << "Unable to open file " << filename << endl;
+	struct stat fileStat;
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if ((fd < 0) || (fstat(fd, &fileStat) < 0)) {
+		cout << "Unable to open file " << filename << endl;
 		cout << "Aborting... " << endl;
 		exit(1);
-    }
+	}
+	fileSize = fileStat.st_size;
+	if (fileSize > size) {
+		cout << "File " << filename << " (" << fileSize
+				<< " bytes) does not fit in memory (" << size << " bytes)" << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
 
+	// o restante da ltima pgina, aps o fim do arquivo,  lido como 0
+	if (fileSize && (mmap(data, fileSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+		cout << "Unable to map file " << filename << endl;
+		cout << "Aborting... " << endl;
+		exit(1);
+	}
+	close(fd);
 }
 
 
@@ -124,7 +137,8 @@ void SimpleMemory::loadBinary(string filename)
 void SimpleMemory::writeBinaryAsText (string basename) {
     string filename = "txt_" + basename + ".txt";
     ofstream ofp;
-    int i,j;
+    unsigned long i;
+    int j;
 
     cout << "Gerado arquivo " << filename << endl << endl;
     ofp.open(filename);
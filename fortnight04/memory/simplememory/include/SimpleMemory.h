@@ -39,8 +39,27 @@
 #include <string>
 #include <fstream>
 
+// Pginas de guarda (PROT_NONE) antes e depois dos dados: cobrem qualquer
+// deslocamento de 32 bits, positivo ou negativo (endereos "negativos",
+// como SP - 16 com SP = 0, caem antes dos dados)
+#define SIMPLEMEMORY_GUARD_SIZE (1UL << 32)
+
 using namespace std;
 
+/**
+ * Memria de size bytes, alocada com mmap. loadBinary mapeia o arquivo
+ * binrio diretamente no incio da memria (MAP_PRIVATE), sem cpia: as
+ * pginas do arquivo so compartilhadas entre as instncias que carregam o
+ * mesmo binrio at serem escritas (copy-on-write), e s as pginas
+ * acessadas so lidas do disco.
+ *
+ * Os dados ficam entre duas regies de SIMPLEMEMORY_GUARD_SIZE bytes
+ * reservadas com PROT_NONE (sem ocupar memria), registradas em
+ * GuestFault: um acesso do convidado fora da memria termina a execuo
+ * da CPU com DATA_ABORT, sem nenhuma verificao nos acessos. S no so
+ * detectados acessos ao resto da ltima pgina, quando size no 
+ * mltiplo do tamanho da pgina, e a endereos alm das guardas.
+ */
 class SimpleMemory : public Memory
 {
 public:
@@ -56,28 +75,127 @@ public:
 	unsigned int readInstruction32(unsigned long address);
 
 	/**
-	 * L um dado de 32 bits considerando um endereamento em bytes.
+	 * Acessos a dados de 8, 16, 32 e 64 bits, sem alinhamento (ver
+	 * Memory.h): cada acesso  um memcpy de tamanho constante, que o
+	 * compilador traduz em uma nica instruo de leitura ou escrita do
+	 * hospedeiro.
 	 */
+	signed char readData8(unsigned long address);
+	short readData16(unsigned long address);
 	int readData32(unsigned long address);
-
-	/**
-	 * L um dado de 64 bits considerando um endereamento em bytes.
-	 */
 	long readData64(unsigned long address);
-	
+	void writeData8(unsigned long address, signed char value);
+	void writeData16(unsigned long address, short value);
+	void writeData32(unsigned long address, int value);
+	void writeData64(unsigned long address, long value);
+
 	/**
-	 * Escreve um dado (value) de 32 bits considerando um endereamento em bytes.
+	 * Acessos em bloco e em pares: os dados so contguos, ento cada
+	 * acesso  um nico memcpy (vetorizado pela libc ou, com tamanho
+	 * constante, pelo compilador).
 	 */
-	void writeData32(unsigned long address, int value);
+	void readBlock(unsigned long address, void *buffer, unsigned long size);
+	void writeBlock(unsigned long address, const void *buffer, unsigned long size);
+	void readPair64(unsigned long address, long *first, long *second);
+	void writePair64(unsigned long address, long first, long second);
 
 	/**
-	 * Escreve um dado (value) de 64 bits considerando um endereamento em bytes.
+	 * Acesso direto aos dados e tamanho da memria em bytes.
 	 */
-	void writeData64(unsigned long address, long value);
+	char *getData();
+	unsigned long getSize();
 
 protected:
 	char* data;        //memory data
-	unsigned short fileSize;    //size of the loaded binary file
+	unsigned long size;    //memory size in bytes
+	unsigned long fileSize;    //size of the loaded binary file
+	char* reservation;    //guard pages + data + guard pages
+	unsigned long reservationSize;
+	int faultRegion;    //GuestFault region
 
 };
 
+/**
+ * Os acessos so definidos aqui para que uma CPU que conhea o tipo
+ * concreto da memria (ver MemoryPort em BasicCPU.h) possa expandi-los
+ * inline.
+ *
+ * SimpleMemory implementa a arquitetura de Von Neumman, com apenas uma
+ * memria, que armazena instrues e dados.
+ */
+inline unsigned int SimpleMemory::readInstruction32(unsigned long address)
+{
+	return ((int*)data)[address >> 2];
+}
+
+inline signed char SimpleMemory::readData8(unsigned long address)
+{
+	signed char value;
+	memcpy(&value, data + address, sizeof(value));
+	return value;
+}
+
+inline short SimpleMemory::readData16(unsigned long address)
+{
+	short value;
+	memcpy(&value, data + address, sizeof(value));
+	return value;
+}
+
+inline int SimpleMemory::readData32(unsigned long address)
+{
+	int value;
+	memcpy(&value, data + address, sizeof(value));
+	return value;
+}
+
+inline long SimpleMemory::readData64(unsigned long address)
+{
+	long value;
+	memcpy(&value, data + address, sizeof(value));
+	return value;
+}
+
+inline void SimpleMemory::writeData8(unsigned long address, signed char value)
+{
+	memcpy(data + address, &value, sizeof(value));
+}
+
+inline void SimpleMemory::writeData16(unsigned long address, short value)
+{
+	memcpy(data + address, &value, sizeof(value));
+}
+
+inline void SimpleMemory::writeData32(unsigned long address, int value)
+{
+	memcpy(data + address, &value, sizeof(value));
+}
+
+inline void SimpleMemory::writeData64(unsigned long address, long value)
+{
+	memcpy(data + address, &value, sizeof(value));
+}
+
+inline void SimpleMemory::readBlock(unsigned long address, void *buffer, unsigned long size)
+{
+	memcpy(buffer, data + address, size);
+}
+
+inline void SimpleMemory::writeBlock(unsigned long address, const void *buffer, unsigned long size)
+{
+	memcpy(data + address, buffer, size);
+}
+
+inline void SimpleMemory::readPair64(unsigned long address, long *first, long *second)
+{
+	long pair[2];
+	memcpy(pair, data + address, sizeof(pair));
+	*first = pair[0];
+	*second = pair[1];
+}
+
+inline void SimpleMemory::writePair64(unsigned long address, long first, long second)
+{
+	long pair[2] = {first, second};
+	memcpy(data + address, pair, sizeof(pair));
+}
@@ -34,18 +34,41 @@
 */
 #include "SimpleMemoryTest.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 using namespace std;
 
-SimpleMemoryTest::SimpleMemoryTest(int size) : SimpleMemory{size}
+/*
+ * Registros das memórias ainda não destruídas, fechados no exit(): runtest
+ * termina com exit(1) na primeira falha sem destruir a memória, e o
+ * registro até a falha é o que interessa.
+ */
+static vector<AsyncTraceWriter*> openTraces;
+static void closeOpenTraces()
+{
+	for (AsyncTraceWriter *trace : openTraces) {
+		trace->close();
+	}
+}
+
+SimpleMemoryTest::SimpleMemoryTest(int size)
+	: SimpleMemory{size}, memTrace{MEMORY_TRACE_FILE}
 {
-    memLogStream.open(MEMORY_LOG_FILE);
+	static bool atExit = false;
+	if (!atExit) {
+		atexit(closeOpenTraces);
+		atExit = true;
+	}
+	openTraces.push_back(&memTrace);
 }
 SimpleMemoryTest::~SimpleMemoryTest()
 {
-	memLogStream.close();
+	openTraces.erase(find(openTraces.begin(), openTraces.end(), &memTrace));
+	memTrace.close();
 }
 
 /**
@@ -53,16 +76,36 @@ SimpleMemoryTest::~SimpleMemoryTest()
  */
 unsigned int SimpleMemoryTest::readInstruction32(unsigned long address)
 {
-    memLogStream << hex << "ri " << setfill('0') << setw(16) << address << endl;
+	memTrace.record(TRACE_READ_INSTRUCTION, 4, address);
  	return SimpleMemory::readInstruction32(address);
 }
 
+/**
+ * Log de Memory::readData8(long address)
+ */
+signed char SimpleMemoryTest::readData8(unsigned long address)
+{
+	memTrace.record(TRACE_READ_DATA, 1, address);
+	lastDataMemAccess = MemAccessType::MAT_READ8;
+	return SimpleMemory::readData8(address);
+}
+
+/**
+ * Log de Memory::readData16(long address)
+ */
+short SimpleMemoryTest::readData16(unsigned long address)
+{
+	memTrace.record(TRACE_READ_DATA, 2, address);
+	lastDataMemAccess = MemAccessType::MAT_READ16;
+	return SimpleMemory::readData16(address);
+}
+
 /**
  * Log de Memory::readData32(long address)
  */
 int SimpleMemoryTest::readData32(unsigned long address)
 {
-    memLogStream << hex << "rd " << setfill('0') << setw(16) << address << endl;
+	memTrace.record(TRACE_READ_DATA, 4, address);
 	lastDataMemAccess = MemAccessType::MAT_READ32;
  	return SimpleMemory::readData32(address);
 }
@@ -72,17 +115,37 @@ int SimpleMemoryTest::readData32(unsigned long address)
  */
 long SimpleMemoryTest::readData64(unsigned long address)
 {
-    memLogStream << hex << "rd " << setfill('0') << setw(16) << address << endl;
+	memTrace.record(TRACE_READ_DATA, 8, address);
 	lastDataMemAccess = MemAccessType::MAT_READ64;
  	return SimpleMemory::readData64(address);
 }
 
+/**
+ * Log de Memory::writeData8(long address)
+ */
+void SimpleMemoryTest::writeData8(unsigned long address, signed char value)
+{
+	memTrace.record(TRACE_WRITE_DATA, 1, address);
+	lastDataMemAccess = MemAccessType::MAT_WRITE8;
+	SimpleMemory::writeData8(address, value);
+}
+
+/**
+ * Log de Memory::writeData16(long address)
+ */
+void SimpleMemoryTest::writeData16(unsigned long address, short value)
+{
+	memTrace.record(TRACE_WRITE_DATA, 2, address);
+	lastDataMemAccess = MemAccessType::MAT_WRITE16;
+	SimpleMemory::writeData16(address, value);
+}
+
 /**
  * Log de Memory::writeData32(long address)
  */
 void SimpleMemoryTest::writeData32(unsigned long address, int value)
 {
-    memLogStream << hex << "wd " << setfill('0') << setw(16) << address << endl;
+	memTrace.record(TRACE_WRITE_DATA, 4, address);
 	lastDataMemAccess = MemAccessType::MAT_WRITE32;
  	SimpleMemory::writeData32(address, value);
 }
@@ -92,11 +155,51 @@ void SimpleMemoryTest::writeData32(unsigned long address, int value)
  */
 void SimpleMemoryTest::writeData64(unsigned long address, long value)
 {
-    memLogStream << hex << "wd " << setfill('0') << setw(16) << address << endl;
+	memTrace.record(TRACE_WRITE_DATA, 8, address);
 	lastDataMemAccess = MemAccessType::MAT_WRITE64;
  	SimpleMemory::writeData64(address, value);
 }
 
+/**
+ * Log de Memory::readBlock(long address, void *buffer, long size)
+ */
+void SimpleMemoryTest::readBlock(unsigned long address, void *buffer, unsigned long size)
+{
+	memTrace.record(TRACE_READ_DATA, size, address);
+	lastDataMemAccess = MemAccessType::MAT_READBLOCK;
+	SimpleMemory::readBlock(address, buffer, size);
+}
+
+/**
+ * Log de Memory::writeBlock(long address, void *buffer, long size)
+ */
+void SimpleMemoryTest::writeBlock(unsigned long address, const void *buffer, unsigned long size)
+{
+	memTrace.record(TRACE_WRITE_DATA, size, address);
+	lastDataMemAccess = MemAccessType::MAT_WRITEBLOCK;
+	SimpleMemory::writeBlock(address, buffer, size);
+}
+
+/**
+ * Log de Memory::readPair64(long address, long *first, long *second)
+ */
+void SimpleMemoryTest::readPair64(unsigned long address, long *first, long *second)
+{
+	memTrace.record(TRACE_READ_DATA, 16, address);
+	lastDataMemAccess = MemAccessType::MAT_READPAIR64;
+	SimpleMemory::readPair64(address, first, second);
+}
+
+/**
+ * Log de Memory::writePair64(long address, long first, long second)
+ */
+void SimpleMemoryTest::writePair64(unsigned long address, long first, long second)
+{
+	memTrace.record(TRACE_WRITE_DATA, 16, address);
+	lastDataMemAccess = MemAccessType::MAT_WRITEPAIR64;
+	SimpleMemory::writePair64(address, first, second);
+}
+
 SimpleMemoryTest::MemAccessType SimpleMemoryTest::getLastDataMemAccess() {
 	return lastDataMemAccess;
 }
@@ -116,7 +219,8 @@ void SimpleMemoryTest::resetLastDataMemAccess() {
 void SimpleMemoryTest::writeBinaryAsTextELF (string basename) {
     string filename = "elf_" + basename + ".txt";
     ofstream ofp;
-    int i,j;
+    unsigned long i;
+    int j;
 
     ofp.open(filename);
 
@@ -172,30 +276,4 @@ void SimpleMemoryTest::writeBinaryAsTextELF (string basename) {
     ofp.close();
 }
 
-/**
- * Realoca endereços das variáveis.
- * 
- * Específico para o arquivo de teste usado.
- */
-void SimpleMemoryTest::relocateManual() {
-	unsigned int *uiData = (unsigned int *)data;
-	long address;
-	unsigned int instruction;
-	
-	//0x0050		91000000		fazer | 0x00028000
-	address = 0x50>>2;
-	instruction = uiData[address];
-	uiData[address] = instruction | 0x00027000;
-	
-	//0x0060		91000000		fazer | 0x00027000
-	address = 0x60>>2;
-	instruction = uiData[address];
-	uiData[address] = instruction | 0x00028000;
-
-	//0x0070		91000000		fazer | 0x00027000
-	address = 0x70>>2;
-	instruction = uiData[address];
-	uiData[address] = instruction | 0x00028000;
-}
-
  
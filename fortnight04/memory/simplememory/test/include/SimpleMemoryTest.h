@@ -33,35 +33,53 @@
    ----------------------------------------------------------------------------
 */
 #include "SimpleMemory.h"
+#include "AsyncTraceWriter.h"
 
 using namespace std;
 
 class SimpleMemoryTest : public SimpleMemory
 {
 public:
-	enum MemAccessType {MAT_NONE, MAT_READ32, MAT_WRITE32, MAT_READ64, MAT_WRITE64};
+	enum MemAccessType {MAT_NONE, MAT_READ32, MAT_WRITE32, MAT_READ64, MAT_WRITE64,
+			MAT_READBLOCK, MAT_WRITEBLOCK, MAT_READPAIR64, MAT_WRITEPAIR64,
+			MAT_READ8, MAT_WRITE8, MAT_READ16, MAT_WRITE16};
 
 	SimpleMemoryTest(int size);
 	~SimpleMemoryTest();
 		
-	void relocateManual();
 	void writeBinaryAsTextELF (string basename);
 	
 	MemAccessType getLastDataMemAccess();
 	void resetLastDataMemAccess();
 	
 	/*
-	 * Logs dos métodos da superclasse.
+	 * Logs dos métodos da superclasse, no registro binário
+	 * MEMORY_TRACE_FILE, escrito por uma thread de fundo (ver
+	 * AsyncTraceWriter.h; 'make saida.txt' o converte para o texto
+	 * MEMORY_LOG_FILE).
 	 */
 	unsigned int readInstruction32(unsigned long address);
+	signed char readData8(unsigned long address);
+	short readData16(unsigned long address);
 	int readData32(unsigned long address);
 	long readData64(unsigned long address);
+	void writeData8(unsigned long address, signed char value);
+	void writeData16(unsigned long address, short value);
 	void writeData32(unsigned long address, int value);
 	void writeData64(unsigned long address, long value);
 
+	/*
+	 * Os acessos em bloco e em pares são registrados como um único acesso
+	 * largo (size bytes; 16 bytes nos pares).
+	 */
+	void readBlock(unsigned long address, void *buffer, unsigned long size);
+	void writeBlock(unsigned long address, const void *buffer, unsigned long size);
+	void readPair64(unsigned long address, long *first, long *second);
+	void writePair64(unsigned long address, long first, long second);
+
 private:
 	MemAccessType lastDataMemAccess;
-	ofstream memLogStream;
+	AsyncTraceWriter memTrace;
 	
 };
 
@@ -0,0 +1,122 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) TLBMemory - A PagedMemory with software TLBs for instruction fetches
+	and data accesses. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) TLBMemory - Uma PagedMemory com TLBs em software para a busca de
+	instruções e para o acesso a dados. Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "TLBMemory.h"
+
+TLBMemory::TLBMemory(unsigned long size) : PagedMemory{size}
+{
+	flushTLB();
+}
+
+/**
+ * Falta na TLB de instruções.
+ */
+char *TLBMemory::itlbMiss(unsigned long address)
+{
+	itlbMisses++;
+	char *page = findPage(address);
+	if (page) {
+		TLBEntry *entry = tlbEntry(itlb, address);
+		entry->tag = address & ~GUEST_PAGE_MASK;
+		entry->addend = (long)page - (long)entry->tag;
+	}
+	return page;
+}
+
+/**
+ * Falta na TLB de dados. Nas leituras (touch = false) uma página nunca
+ * escrita não é alocada nem entra na TLB.
+ */
+char *TLBMemory::dtlbMiss(unsigned long address, bool touch)
+{
+	dtlbMisses++;
+	char *page = touch ? touchPage(address) : findPage(address);
+	if (page) {
+		TLBEntry *entry = tlbEntry(dtlb, address);
+		entry->tag = address & ~GUEST_PAGE_MASK;
+		entry->addend = (long)page - (long)entry->tag;
+	}
+	return page;
+}
+
+/**
+ * Invalida as entradas das duas TLBs que traduzem a página de address.
+ */
+void TLBMemory::pageRemapped(unsigned long address)
+{
+	unsigned long tag = address & ~GUEST_PAGE_MASK;
+	TLBEntry *entry = tlbEntry(itlb, address);
+	if (entry->tag == tag) {
+		entry->tag = TLB_INVALID_TAG;
+	}
+	entry = tlbEntry(dtlb, address);
+	if (entry->tag == tag) {
+		entry->tag = TLB_INVALID_TAG;
+	}
+}
+
+void TLBMemory::flushTLB()
+{
+	for (int i = 0; i < TLB_ENTRIES; i++) {
+		itlb[i].tag = TLB_INVALID_TAG;
+		dtlb[i].tag = TLB_INVALID_TAG;
+	}
+}
+
+unsigned long TLBMemory::getITLBHits()
+{
+	return itlbHits;
+}
+
+unsigned long TLBMemory::getITLBMisses()
+{
+	return itlbMisses;
+}
+
+unsigned long TLBMemory::getDTLBHits()
+{
+	return dtlbHits;
+}
+
+unsigned long TLBMemory::getDTLBMisses()
+{
+	return dtlbMisses;
+}
@@ -0,0 +1,288 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) TLBMemory - A PagedMemory with software TLBs for instruction fetches
+	and data accesses. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) TLBMemory - Uma PagedMemory com TLBs em software para a busca de
+	instruções e para o acesso a dados. Parte do projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "PagedMemory.h"
+
+// Número de entradas de cada TLB (potência de 2, mapeamento direto pelo
+// número da página)
+#define TLB_ENTRIES 64
+
+// Tag de entrada inválida: nenhum endereço de página (múltiplo de
+// GUEST_PAGE_SIZE) é igual a ela
+#define TLB_INVALID_TAG 1UL
+
+/**
+ * Entrada da TLB: tag é o endereço da página no convidado e addend é a
+ * diferença entre o endereço da página no hospedeiro e tag, de forma que
+ * um acerto custa uma comparação e uma soma.
+ */
+struct TLBEntry {
+	unsigned long tag;
+	long addend;
+};
+
+/**
+ * PagedMemory com duas TLBs em software de mapeamento direto, uma para a
+ * busca de instruções (readInstruction32) e outra para os dados, na frente
+ * da tabela de páginas.
+ *
+ * Uma falta percorre a tabela de páginas e preenche a entrada; páginas
+ * nunca escritas não entram na TLB (a leitura continua retornando 0 sem
+ * alocar). Quando uma página é liberada (unmapPage), as entradas das duas
+ * TLBs que a traduzem são invalidadas.
+ *
+ * As TLBs não são compartilháveis entre threads: com MultiCoreProcessor
+ * use PagedMemory.
+ */
+class TLBMemory : public PagedMemory
+{
+public:
+	TLBMemory(unsigned long size);
+
+	/**
+	 * Acessos pelas TLBs. Os acessos a dados que cruzam páginas passam
+	 * pelos blocos de PagedMemory, sem consultar a TLB.
+	 */
+	unsigned int readInstruction32(unsigned long address);
+	signed char readData8(unsigned long address);
+	short readData16(unsigned long address);
+	int readData32(unsigned long address);
+	long readData64(unsigned long address);
+	void writeData8(unsigned long address, signed char value);
+	void writeData16(unsigned long address, short value);
+	void writeData32(unsigned long address, int value);
+	void writeData64(unsigned long address, long value);
+
+	/**
+	 * Pares pela TLB de dados, com uma tradução por par. Os blocos usam
+	 * as cópias de PagedMemory, que percorrem a tabela de páginas uma vez
+	 * por página.
+	 */
+	void readPair64(unsigned long address, long *first, long *second);
+	void writePair64(unsigned long address, long first, long second);
+
+	/**
+	 * Invalida todas as entradas das duas TLBs.
+	 */
+	void flushTLB();
+
+	/**
+	 * Estatísticas das TLBs.
+	 */
+	unsigned long getITLBHits();
+	unsigned long getITLBMisses();
+	unsigned long getDTLBHits();
+	unsigned long getDTLBMisses();
+
+protected:
+	TLBEntry itlb[TLB_ENTRIES];
+	TLBEntry dtlb[TLB_ENTRIES];
+	unsigned long itlbHits = 0;
+	unsigned long itlbMisses = 0;
+	unsigned long dtlbHits = 0;
+	unsigned long dtlbMisses = 0;
+
+	/**
+	 * Entrada da TLB tlb que traduz o endereço address.
+	 */
+	static TLBEntry *tlbEntry(TLBEntry *tlb, unsigned long address);
+
+	/**
+	 * Endereço no hospedeiro do byte address pela TLB de dados, para uma
+	 * leitura ou uma escrita (que aloca a página, se necessário).
+	 * translateRead retorna nullptr se a página nunca foi escrita.
+	 */
+	char *translateRead(unsigned long address);
+	char *translateWrite(unsigned long address);
+
+	/**
+	 * Leitura e escrita de um dado do tipo T pela TLB de dados.
+	 */
+	template <class T> T load(unsigned long address);
+	template <class T> void store(unsigned long address, T value);
+
+	/**
+	 * Tratamento das faltas: percorre a tabela de páginas (touch: aloca a
+	 * página, se necessário) e preenche a entrada. Retornam o endereço no
+	 * hospedeiro do início da página, ou nullptr se a página não existir.
+	 */
+	char *itlbMiss(unsigned long address);
+	char *dtlbMiss(unsigned long address, bool touch);
+
+	/**
+	 * Invalida as entradas que traduzem a página do endereço address.
+	 */
+	void pageRemapped(unsigned long address);
+};
+
+/**
+ * Os acessos são definidos aqui para que uma CPU que conheça o tipo
+ * concreto da memória (ver MemoryPort em BasicCPU.h) possa expandi-los
+ * inline. Só o acerto fica inline; as faltas são tratadas em TLBMemory.cpp.
+ */
+inline TLBEntry *TLBMemory::tlbEntry(TLBEntry *tlb, unsigned long address)
+{
+	return &tlb[(address >> GUEST_PAGE_BITS) & (TLB_ENTRIES - 1)];
+}
+
+inline unsigned int TLBMemory::readInstruction32(unsigned long address)
+{
+	TLBEntry *entry = tlbEntry(itlb, address);
+	if (entry->tag == (address & ~GUEST_PAGE_MASK)) {
+		itlbHits++;
+		return *(unsigned int*)((address & ~3UL) + entry->addend);
+	}
+	char *page = itlbMiss(address);
+	return page ? *(unsigned int*)(page + (address & GUEST_PAGE_MASK & ~3UL)) : 0;
+}
+
+inline char *TLBMemory::translateRead(unsigned long address)
+{
+	TLBEntry *entry = tlbEntry(dtlb, address);
+	if (entry->tag == (address & ~GUEST_PAGE_MASK)) {
+		dtlbHits++;
+		return (char*)(address + entry->addend);
+	}
+	char *page = dtlbMiss(address, false);
+	return page ? page + (address & GUEST_PAGE_MASK) : nullptr;
+}
+
+inline char *TLBMemory::translateWrite(unsigned long address)
+{
+	TLBEntry *entry = tlbEntry(dtlb, address);
+	if (entry->tag == (address & ~GUEST_PAGE_MASK)) {
+		dtlbHits++;
+		return (char*)(address + entry->addend);
+	}
+	return dtlbMiss(address, true) + (address & GUEST_PAGE_MASK);
+}
+
+template <class T>
+inline T TLBMemory::load(unsigned long address)
+{
+	T value = 0;
+	if ((address & GUEST_PAGE_MASK) > GUEST_PAGE_SIZE - sizeof(T)) {
+		PagedMemory::readBlock(address, &value, sizeof(T)); // cruza páginas
+		return value;
+	}
+	char *host = translateRead(address);
+	if (host) {
+		memcpy(&value, host, sizeof(T));
+	}
+	return value;
+}
+
+template <class T>
+inline void TLBMemory::store(unsigned long address, T value)
+{
+	if ((address & GUEST_PAGE_MASK) > GUEST_PAGE_SIZE - sizeof(T)) {
+		PagedMemory::writeBlock(address, &value, sizeof(T)); // cruza páginas
+		return;
+	}
+	memcpy(translateWrite(address), &value, sizeof(T));
+}
+
+inline signed char TLBMemory::readData8(unsigned long address)
+{
+	return load<signed char>(address);
+}
+
+inline short TLBMemory::readData16(unsigned long address)
+{
+	return load<short>(address);
+}
+
+inline int TLBMemory::readData32(unsigned long address)
+{
+	return load<int>(address);
+}
+
+inline long TLBMemory::readData64(unsigned long address)
+{
+	return load<long>(address);
+}
+
+inline void TLBMemory::writeData8(unsigned long address, signed char value)
+{
+	store<signed char>(address, value);
+}
+
+inline void TLBMemory::writeData16(unsigned long address, short value)
+{
+	store<short>(address, value);
+}
+
+inline void TLBMemory::writeData32(unsigned long address, int value)
+{
+	store<int>(address, value);
+}
+
+inline void TLBMemory::writeData64(unsigned long address, long value)
+{
+	store<long>(address, value);
+}
+
+inline void TLBMemory::readPair64(unsigned long address, long *first, long *second)
+{
+	long pair[2] = {0, 0};
+	if ((address & GUEST_PAGE_MASK) > GUEST_PAGE_SIZE - sizeof(pair)) {
+		PagedMemory::readBlock(address, pair, sizeof(pair));
+	} else {
+		char *host = translateRead(address);
+		if (host) {
+			memcpy(pair, host, sizeof(pair));
+		}
+	}
+	*first = pair[0];
+	*second = pair[1];
+}
+
+inline void TLBMemory::writePair64(unsigned long address, long first, long second)
+{
+	long pair[2] = {first, second};
+	if ((address & GUEST_PAGE_MASK) > GUEST_PAGE_SIZE - sizeof(pair)) {
+		PagedMemory::writeBlock(address, pair, sizeof(pair));
+		return;
+	}
+	memcpy(translateWrite(address), pair, sizeof(pair));
+}
@@ -0,0 +1,87 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BimodalPredictor - a table of 2-bit saturating counters indexed by PC
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BimodalPredictor - uma tabela de contadores saturados de 2 bits indexada pelo PC
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "BimodalPredictor.h"
+
+#include <cstring>
+
+BimodalPredictor::BimodalPredictor(int tableBits)
+{
+	mask = (1UL << tableBits) - 1;
+	counters = new uint8_t[mask + 1];
+	reset();
+}
+
+BimodalPredictor::~BimodalPredictor()
+{
+	delete[] counters;
+}
+
+const char *BimodalPredictor::getName()
+{
+	return "bimodal";
+}
+
+/**
+ * Prediz pelo contador da entrada de PC e o atualiza com a direção real.
+ */
+void BimodalPredictor::simulate(const BranchEvent *events, int count,
+		uint8_t *mispredicted)
+{
+	for (int i = 0; i < count; i++) {
+		const BranchEvent *e = &events[i];
+		if (e->kind != BRANCH_CONDITIONAL) {
+			mispredicted[i] = 0;
+			continue;
+		}
+		uint8_t *counter = &counters[(e->PC >> 2) & mask];
+		bool predicted = *counter >= 2;
+		mispredicted[i] = (predicted != (bool)e->taken);
+		if (e->taken) {
+			*counter += (*counter < 3);
+		} else {
+			*counter -= (*counter > 0);
+		}
+	}
+}
+
+void BimodalPredictor::reset()
+{
+	memset(counters, 1, mask + 1);
+}
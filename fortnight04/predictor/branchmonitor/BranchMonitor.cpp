@@ -0,0 +1,300 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BranchMonitor - observes the branches retired by a CPU and runs branch predictors over them
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BranchMonitor - observa os desvios retirados por uma CPU e executa preditores de desvios sobre eles
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "BranchMonitor.h"
+#include "BimodalPredictor.h"
+#include "GsharePredictor.h"
+#include "TagePredictor.h"
+#include "BTBPredictor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+BranchMonitor::BranchMonitor()
+{
+	predictorCount = 0;
+	siteBits = BRANCH_SITES_BITS;
+	sites = new BranchSite[1UL << siteBits];
+	reset();
+}
+
+BranchMonitor::~BranchMonitor()
+{
+	for (int p = 0; p < predictorCount; p++) {
+		delete predictors[p];
+	}
+	delete[] sites;
+}
+
+BranchPredictor *BranchMonitor::newPredictor(string name)
+{
+	if (name == "bimodal") {
+		return new BimodalPredictor();
+	}
+	if (name == "gshare") {
+		return new GsharePredictor();
+	}
+	if (name == "tage") {
+		return new TagePredictor();
+	}
+	if (name == "btb") {
+		return new BTBPredictor();
+	}
+	return nullptr;
+}
+
+int BranchMonitor::addPredictor(BranchPredictor *predictor)
+{
+	if (predictorCount == BRANCH_MAX_PREDICTORS) {
+		return 1;
+	}
+	flush();
+	predictors[predictorCount++] = predictor;
+	return 0;
+}
+
+int BranchMonitor::addPredictors(string names)
+{
+	istringstream list(names);
+	string name;
+
+	while (getline(list, name, ',')) {
+		BranchPredictor *predictor = newPredictor(name);
+		if (!predictor) {
+			return 1;
+		}
+		if (addPredictor(predictor)) {
+			delete predictor;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int BranchMonitor::getPredictorCount()
+{
+	return predictorCount;
+}
+
+BranchPredictor *BranchMonitor::getPredictor(int p)
+{
+	return predictors[p];
+}
+
+/**
+ * Cada preditor percorre o lote, e só então os erros são somados por
+ * desvio estático, com uma consulta à tabela por desvio.
+ */
+void BranchMonitor::flush()
+{
+	for (int p = 0; p < predictorCount; p++) {
+		predictors[p]->simulate(events, pending, mispredicted[p]);
+	}
+	BranchSite *site = nullptr;
+	for (int i = 0; i < pending; i++) {
+		const BranchEvent *e = &events[i];
+		if (!site || (site->PC != e->PC)) {
+			site = findSite(e->PC, (BranchKind)e->kind);
+		}
+		site->executed++;
+		site->taken += e->taken;
+		for (int p = 0; p < predictorCount; p++) {
+			site->mispredictions[p] += mispredicted[p][i];
+			mispredictions[p] += mispredicted[p][i];
+		}
+	}
+	branches += pending;
+	pending = 0;
+}
+
+size_t BranchMonitor::eventsOffset()
+{
+	return offsetof(BranchMonitor, events);
+}
+
+size_t BranchMonitor::pendingOffset()
+{
+	return offsetof(BranchMonitor, pending);
+}
+
+/**
+ * Sondagem linear a partir do espalhamento multiplicativo de pc / 4. A
+ * tabela dobra quando passa da metade da capacidade.
+ */
+BranchSite *BranchMonitor::findSite(uint64_t pc, BranchKind kind)
+{
+	unsigned long mask = (1UL << siteBits) - 1;
+	unsigned long i = ((pc >> 2) * 0x9E3779B97F4A7C15UL) >> (64 - siteBits);
+
+	while (sites[i].executed) {
+		if (sites[i].PC == pc) {
+			return &sites[i];
+		}
+		i = (i + 1) & mask;
+	}
+
+	if (2 * (siteCount + 1) > (1UL << siteBits)) {
+		growSites();
+		return findSite(pc, kind);
+	}
+	siteCount++;
+	sites[i].PC = pc;
+	sites[i].kind = kind;
+	return &sites[i];
+}
+
+void BranchMonitor::growSites()
+{
+	BranchSite *old = sites;
+	unsigned long oldSize = 1UL << siteBits;
+
+	siteBits++;
+	sites = new BranchSite[1UL << siteBits];
+	memset(sites, 0, (1UL << siteBits) * sizeof(BranchSite));
+	siteCount = 0;
+	for (unsigned long i = 0; i < oldSize; i++) {
+		if (old[i].executed) {
+			*findSite(old[i].PC, old[i].kind) = old[i];
+		}
+	}
+	delete[] old;
+}
+
+unsigned long BranchMonitor::getBranches()
+{
+	flush();
+	return branches;
+}
+
+unsigned long BranchMonitor::getMispredictions(int p)
+{
+	flush();
+	return mispredictions[p];
+}
+
+double BranchMonitor::getMPKI(int p, unsigned long instructions)
+{
+	return instructions ? 1000.0 * getMispredictions(p) / instructions : 0;
+}
+
+vector<BranchSite> BranchMonitor::getSites()
+{
+	vector<BranchSite> list;
+
+	flush();
+	for (unsigned long i = 0; i < (1UL << siteBits); i++) {
+		if (sites[i].executed) {
+			list.push_back(sites[i]);
+		}
+	}
+	sort(list.begin(), list.end(), [](const BranchSite &a, const BranchSite &b) {
+		return a.PC < b.PC;
+	});
+	return list;
+}
+
+void BranchMonitor::printReport(ostream &out, unsigned long instructions, int top)
+{
+	vector<BranchSite> list = getSites();
+	ios::fmtflags flags = out.flags();
+	char fill = out.fill(' ');
+
+	out << "Desvios: " << dec << branches << " (" << list.size()
+			<< " estáticos), instruções: " << instructions << endl;
+	for (int p = 0; p < predictorCount; p++) {
+		out << "    " << left << setw(8) << predictors[p]->getName() << right
+				<< " erros: " << setw(10) << mispredictions[p]
+				<< "  MPKI: " << fixed << setprecision(3) << setw(8)
+				<< getMPKI(p, instructions) << endl;
+	}
+
+	// desvios estáticos com mais erros
+	auto errors = [this](const BranchSite &site) {
+		unsigned long sum = 0;
+		for (int p = 0; p < predictorCount; p++) {
+			sum += site.mispredictions[p];
+		}
+		return sum;
+	};
+	stable_sort(list.begin(), list.end(), [&](const BranchSite &a, const BranchSite &b) {
+		return errors(a) > errors(b);
+	});
+	if ((int)list.size() > top) {
+		list.resize(top);
+	}
+	out << "Desvios estáticos com mais erros (MPKI por preditor):" << endl;
+	for (BranchSite &site : list) {
+		out << "    0x" << hex << setw(8) << setfill('0') << site.PC << setfill(' ')
+				<< dec << " " << left << setw(5) << kindName(site.kind) << right
+				<< " execuções: " << setw(10) << site.executed
+				<< " tomados: " << setw(10) << site.taken;
+		for (int p = 0; p < predictorCount; p++) {
+			out << " " << predictors[p]->getName() << ": " << fixed
+					<< setprecision(3) << (instructions
+						? 1000.0 * site.mispredictions[p] / instructions : 0);
+		}
+		out << endl;
+	}
+	out.flags(flags);
+	out.fill(fill);
+}
+
+void BranchMonitor::reset()
+{
+	pending = 0;
+	branches = 0;
+	siteCount = 0;
+	memset(sites, 0, (1UL << siteBits) * sizeof(BranchSite));
+	for (int p = 0; p < BRANCH_MAX_PREDICTORS; p++) {
+		mispredictions[p] = 0;
+	}
+	for (int p = 0; p < predictorCount; p++) {
+		predictors[p]->reset();
+	}
+}
+
+const char *BranchMonitor::kindName(BranchKind kind)
+{
+	static const char *names[BRANCH_KINDS] = {"cond", "b", "call", "ret", "ind"};
+	return names[kind];
+}
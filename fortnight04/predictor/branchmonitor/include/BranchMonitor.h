@@ -0,0 +1,212 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BranchMonitor - observes the branches retired by a CPU and runs branch predictors over them
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BranchMonitor - observa os desvios retirados por uma CPU e executa preditores de desvios sobre eles
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BranchPredictor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Desvios acumulados antes de executar os preditores, número máximo de
+// preditores por monitor e capacidade inicial (log2) da tabela de desvios
+// estáticos
+#define BRANCH_BATCH_SIZE 4096
+#define BRANCH_MAX_PREDICTORS 8
+#define BRANCH_SITES_BITS 10
+
+// Preditores usados quando nenhum é escolhido (ver addPredictors()),
+// todos os preditores e número de desvios estáticos listados por
+// printReport()
+#define BRANCH_DEFAULT_PREDICTORS "bimodal"
+#define BRANCH_ALL_PREDICTORS "bimodal,gshare,tage,btb"
+#define BRANCH_REPORT_TOP 10
+
+/**
+ * Desvio estático (um endereço de desvio) e seus contadores: execuções,
+ * vezes em que foi tomado e erros de cada preditor do monitor.
+ */
+struct BranchSite {
+	uint64_t PC;
+	BranchKind kind;
+	unsigned long executed;
+	unsigned long taken;
+	unsigned long mispredictions[BRANCH_MAX_PREDICTORS];
+};
+
+/**
+ * Monitor de desvios.
+ *
+ * A CPU informa cada desvio retirado com retire(), que só grava o desvio
+ * em um lote. Quando o lote enche (ou quando as estatísticas são lidas),
+ * cada preditor percorre o lote inteiro (ver BranchPredictor) e os erros
+ * são somados por desvio estático. O custo por desvio na CPU é o de
+ * gravar 24 bytes; o dos preditores é pago fora do ciclo da máquina,
+ * com as tabelas de cada preditor na cache do hospedeiro.
+ *
+ * O padrão (BRANCH_DEFAULT_PREDICTORS) é só o bimodal, barato perto do
+ * ciclo da máquina de BasicCPU; gshare, TAGE e BTB são pedidos
+ * explicitamente. JitCPU grava o lote direto no código gerado, mas mesmo
+ * assim o custo de flush() por desvio é comparável ao de executar o
+ * bloco (ver benchmark).
+ *
+ * Os erros são reportados em MPKI (erros por mil instruções), no total e
+ * por desvio estático. O monitor não é thread-safe: cada CPU tem o seu.
+ */
+class BranchMonitor
+{
+	public:
+		BranchMonitor();
+		~BranchMonitor();
+
+		/**
+		 * Cria o preditor de nome name (bimodal, gshare, tage ou btb), ou
+		 * retorna nullptr se não existir.
+		 */
+		static BranchPredictor *newPredictor(std::string name);
+
+		/**
+		 * Acrescenta predictor ao monitor, que passa a ser seu dono.
+		 *
+		 * Retorna 0: se acrescentou e
+		 *		   1: se já houver BRANCH_MAX_PREDICTORS preditores.
+		 */
+		int addPredictor(BranchPredictor *predictor);
+
+		/**
+		 * Acrescenta os preditores da lista names, separada por vírgulas
+		 * (por exemplo, BRANCH_DEFAULT_PREDICTORS).
+		 *
+		 * Retorna 0: se acrescentou todos e
+		 *		   1: se algum nome não existir ou não couber.
+		 */
+		int addPredictors(std::string names);
+
+		int getPredictorCount();
+		BranchPredictor *getPredictor(int p);
+
+		/**
+		 * Registra o desvio retirado em pc, cujo próximo PC executado é
+		 * next.
+		 */
+		void retire(uint64_t pc, uint64_t next, BranchKind kind, bool taken) {
+			BranchEvent *e = &events[pending];
+			e->PC = pc;
+			e->next = next;
+			e->kind = kind;
+			e->taken = taken;
+			if (++pending == BRANCH_BATCH_SIZE) {
+				flush();
+			}
+		};
+
+		/**
+		 * Executa os preditores sobre os desvios pendentes do lote.
+		 */
+		void flush();
+
+		/**
+		 * Posição do lote e do número de desvios pendentes no monitor. O
+		 * código gerado por JitCPU grava os desvios como retire(), sem
+		 * chamá-lo, e chama flush() quando o lote enche.
+		 */
+		static size_t eventsOffset();
+		static size_t pendingOffset();
+
+		/**
+		 * Estatísticas (incluem os desvios pendentes). instructions é o
+		 * número de instruções executadas, base do MPKI.
+		 */
+		unsigned long getBranches();
+		unsigned long getMispredictions(int p);
+		double getMPKI(int p, unsigned long instructions);
+
+		/**
+		 * Desvios estáticos, em ordem de endereço.
+		 */
+		std::vector<BranchSite> getSites();
+
+		/**
+		 * Imprime o resumo de cada preditor e os top desvios estáticos
+		 * com mais erros (somados entre os preditores).
+		 */
+		void printReport(std::ostream &out, unsigned long instructions,
+				int top = BRANCH_REPORT_TOP);
+
+		/**
+		 * Descarta as estatísticas e volta os preditores ao estado inicial.
+		 */
+		void reset();
+
+		/**
+		 * Nome curto do tipo de desvio.
+		 */
+		static const char *kindName(BranchKind kind);
+
+	private:
+		// lote de desvios pendentes e erros de cada preditor no lote
+		BranchEvent events[BRANCH_BATCH_SIZE];
+		int pending;
+		uint8_t mispredicted[BRANCH_MAX_PREDICTORS][BRANCH_BATCH_SIZE];
+
+		BranchPredictor *predictors[BRANCH_MAX_PREDICTORS];
+		int predictorCount;
+
+		// desvios estáticos: tabela de espalhamento com endereçamento
+		// aberto (entradas vazias têm executed = 0)
+		BranchSite *sites;
+		int siteBits;
+		unsigned long siteCount;
+
+		unsigned long branches;
+		unsigned long mispredictions[BRANCH_MAX_PREDICTORS];
+
+		/**
+		 * Entrada do desvio estático em pc, criada se necessário.
+		 */
+		BranchSite *findSite(uint64_t pc, BranchKind kind);
+
+		/**
+		 * Dobra a capacidade da tabela de desvios estáticos.
+		 */
+		void growSites();
+};
@@ -0,0 +1,137 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BTBPredictor - branch target buffer and return address stack
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BTBPredictor - buffer de destinos de desvios e pilha de endereços de retorno
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "BTBPredictor.h"
+
+BTBPredictor::BTBPredictor()
+{
+	entries = new BTBEntry[(1 << BTB_SET_BITS) * BTB_WAYS];
+	reset();
+}
+
+BTBPredictor::~BTBPredictor()
+{
+	delete[] entries;
+}
+
+const char *BTBPredictor::getName()
+{
+	return "btb";
+}
+
+void BTBPredictor::simulate(const BranchEvent *events, int count,
+		uint8_t *mispredicted)
+{
+	for (int i = 0; i < count; i++) {
+		mispredicted[i] = (predictAndUpdate(&events[i]) != events[i].next);
+	}
+}
+
+/**
+ * Prediz o próximo PC do desvio e e atualiza a BTB com o próximo PC
+ * executado.
+ */
+uint64_t BTBPredictor::predictAndUpdate(const BranchEvent *e)
+{
+	BTBEntry *entry = find(e->PC);
+	uint64_t predicted = e->PC + 4;
+
+	if (entry) {
+		entry->stamp = ++clock;
+		if ((e->kind != BRANCH_CONDITIONAL) || (entry->counter >= 2)) {
+			predicted = entry->target;
+		}
+	}
+
+	if (e->taken) {
+		if (!entry) {
+			entry = allocate(e->PC);
+		}
+		entry->target = e->next;
+		entry->counter += (entry->counter < 3);
+	} else if (entry) {
+		entry->counter -= (entry->counter > 0);
+	}
+
+	return predicted;
+}
+
+BTBEntry *BTBPredictor::find(uint64_t pc)
+{
+	BTBEntry *set = &entries[((pc >> 2) & ((1 << BTB_SET_BITS) - 1)) * BTB_WAYS];
+	for (int w = 0; w < BTB_WAYS; w++) {
+		if (set[w].valid && (set[w].PC == pc)) {
+			return &set[w];
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Aloca uma entrada para pc. O contador começa em 1 e o desvio tomado
+ * que causou a alocação o leva a 2 (fracamente tomado).
+ */
+BTBEntry *BTBPredictor::allocate(uint64_t pc)
+{
+	BTBEntry *set = &entries[((pc >> 2) & ((1 << BTB_SET_BITS) - 1)) * BTB_WAYS];
+	BTBEntry *victim = &set[0];
+	for (int w = 0; w < BTB_WAYS; w++) {
+		if (!set[w].valid) {
+			victim = &set[w];
+			break;
+		}
+		if (set[w].stamp < victim->stamp) {
+			victim = &set[w];
+		}
+	}
+	victim->PC = pc;
+	victim->valid = true;
+	victim->counter = 1;
+	victim->stamp = ++clock;
+	return victim;
+}
+
+void BTBPredictor::reset()
+{
+	for (int i = 0; i < (1 << BTB_SET_BITS) * BTB_WAYS; i++) {
+		entries[i].valid = false;
+		entries[i].stamp = 0;
+	}
+	clock = 0;
+}
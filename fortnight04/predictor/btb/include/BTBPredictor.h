@@ -0,0 +1,107 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) BTBPredictor - branch target buffer and return address stack
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) BTBPredictor - buffer de destinos de desvios e pilha de endereços de retorno
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BranchPredictor.h"
+
+// BTB: número de conjuntos (log2) e vias
+#define BTB_SET_BITS 9
+#define BTB_WAYS 4
+
+/**
+ * Entrada da BTB: endereço do desvio (tag), destino, contador de 2 bits
+ * que decide se um desvio condicional é predito tomado e instante do
+ * último uso (LRU).
+ */
+struct BTBEntry {
+	uint64_t PC;
+	uint64_t target;
+	uint64_t stamp;
+	uint8_t counter;
+	bool valid;
+};
+
+/**
+ * Preditor de destino: BTB associativa por conjunto.
+ *
+ * Prediz o próximo PC de todo desvio. Um desvio que não está na BTB é
+ * predito não tomado (próximo PC = PC + 4); um que está é predito tomado
+ * para o destino guardado, exceto o condicional cujo contador está abaixo
+ * de 2. Só desvios tomados são alocados na BTB. Não há pilha de
+ * endereços de retorno: RET é predito pelo último destino, como qualquer
+ * desvio, até que BL e RET sejam decodificados.
+ *
+ * Erra quando o próximo PC predito é diferente do executado.
+ */
+class BTBPredictor: public BranchPredictor
+{
+	public:
+		BTBPredictor();
+		~BTBPredictor();
+
+		/**
+		 * Métodos herdados de BranchPredictor
+		 */
+		const char *getName();
+		void simulate(const BranchEvent *events, int count, uint8_t *mispredicted);
+		void reset();
+
+	private:
+		BTBEntry *entries;		// [conjunto * BTB_WAYS + via]
+		uint64_t clock;
+
+		/**
+		 * Prediz e atualiza um desvio.
+		 *
+		 * Retorna o próximo PC predito.
+		 */
+		uint64_t predictAndUpdate(const BranchEvent *e);
+
+		/**
+		 * Entrada do desvio em pc, ou nullptr se não estiver na BTB.
+		 */
+		BTBEntry *find(uint64_t pc);
+
+		/**
+		 * Aloca uma entrada para o desvio em pc (inválida ou a menos
+		 * recentemente usada do conjunto).
+		 */
+		BTBEntry *allocate(uint64_t pc);
+};
@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) GsharePredictor - 2-bit counters indexed by PC xor global history
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) GsharePredictor - contadores de 2 bits indexados por PC xor histórico global
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BranchPredictor.h"
+
+// Número padrão de contadores (log2), igual ao número de bits de histórico
+#define GSHARE_TABLE_BITS 14
+
+/**
+ * Preditor gshare (McFarling): contadores saturados de 2 bits indexados
+ * por PC / 4 xor o histórico global das direções dos últimos desvios
+ * condicionais. Os contadores começam em 1 (fracamente não tomado).
+ */
+class GsharePredictor: public BranchPredictor
+{
+	public:
+		GsharePredictor(int tableBits = GSHARE_TABLE_BITS);
+		~GsharePredictor();
+
+		/**
+		 * Métodos herdados de BranchPredictor
+		 */
+		const char *getName();
+		void simulate(const BranchEvent *events, int count, uint8_t *mispredicted);
+		void reset();
+
+	private:
+		uint8_t *counters;
+		uint64_t mask;
+		uint64_t history;
+};
@@ -0,0 +1,237 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) TagePredictor - a small TAGE predictor (tagged geometric history lengths)
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) TagePredictor - um preditor TAGE reduzido (históricos de tamanhos geométricos com tags)
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "TagePredictor.h"
+
+#include <cstring>
+
+// Tamanhos dos históricos das tabelas com tag, em desvios
+static const int tageHistoryLengths[TAGE_TABLES] = {5, 15, 44, 130};
+
+TagePredictor::TagePredictor()
+{
+	base = new uint8_t[1 << TAGE_BASE_BITS];
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		tables[t] = new TageEntry[1 << TAGE_TABLE_BITS];
+	}
+	reset();
+}
+
+TagePredictor::~TagePredictor()
+{
+	delete[] base;
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		delete[] tables[t];
+	}
+}
+
+const char *TagePredictor::getName()
+{
+	return "tage";
+}
+
+void TagePredictor::simulate(const BranchEvent *events, int count,
+		uint8_t *mispredicted)
+{
+	for (int i = 0; i < count; i++) {
+		const BranchEvent *e = &events[i];
+		if (e->kind != BRANCH_CONDITIONAL) {
+			mispredicted[i] = 0;
+			continue;
+		}
+		mispredicted[i] = (predictAndUpdate(e->PC, e->taken) != (bool)e->taken);
+	}
+}
+
+/**
+ * Prediz o desvio condicional em pc e atualiza as tabelas e o histórico
+ * com a direção real taken.
+ */
+bool TagePredictor::predictAndUpdate(uint64_t pc, bool taken)
+{
+	uint64_t p = pc >> 2;
+	uint32_t index[TAGE_TABLES];
+	uint16_t tag[TAGE_TABLES];
+	int provider = -1;
+	int alternate = -1;
+
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		index[t] = (p ^ (p >> TAGE_TABLE_BITS) ^ indexHistory[t].value)
+				& ((1 << TAGE_TABLE_BITS) - 1);
+		tag[t] = (p ^ tagHistory[t][0].value ^ (tagHistory[t][1].value << 1))
+				& ((1 << TAGE_TAG_BITS) - 1);
+	}
+	for (int t = TAGE_TABLES - 1; t >= 0; t--) {
+		if (tables[t][index[t]].tag == tag[t]) {
+			if (provider < 0) {
+				provider = t;
+			} else {
+				alternate = t;
+				break;
+			}
+		}
+	}
+
+	uint8_t *baseCounter = &base[p & ((1 << TAGE_BASE_BITS) - 1)];
+	bool basePrediction = *baseCounter >= 2;
+	bool alternatePrediction = (alternate >= 0)
+			? (tables[alternate][index[alternate]].counter >= 0) : basePrediction;
+	bool providerPrediction = basePrediction;
+	bool prediction = basePrediction;
+	TageEntry *entry = nullptr;
+
+	if (provider >= 0) {
+		entry = &tables[provider][index[provider]];
+		providerPrediction = entry->counter >= 0;
+		bool weak = (entry->counter == 0) || (entry->counter == -1);
+		prediction = (weak && (entry->useful == 0))
+				? alternatePrediction : providerPrediction;
+	}
+
+	// aloca uma entrada em uma tabela de histórico maior que o da
+	// provedora; se nenhuma estiver livre, envelhece as candidatas
+	if ((providerPrediction != taken) && (provider < TAGE_TABLES - 1)) {
+		int allocated = -1;
+		for (int t = provider + 1; t < TAGE_TABLES; t++) {
+			if (tables[t][index[t]].useful == 0) {
+				allocated = t;
+				break;
+			}
+		}
+		if (allocated >= 0) {
+			TageEntry *a = &tables[allocated][index[allocated]];
+			a->counter = taken ? 0 : -1;
+			a->useful = 0;
+			a->tag = tag[allocated];
+		} else {
+			for (int t = provider + 1; t < TAGE_TABLES; t++) {
+				tables[t][index[t]].useful--;
+			}
+		}
+	}
+
+	// atualiza a provedora (ou a base)
+	if (entry) {
+		if (taken) {
+			entry->counter += (entry->counter < 3);
+		} else {
+			entry->counter -= (entry->counter > -4);
+		}
+		if (providerPrediction != alternatePrediction) {
+			if (providerPrediction == taken) {
+				entry->useful += (entry->useful < 3);
+			} else {
+				entry->useful -= (entry->useful > 0);
+			}
+		}
+	} else if (taken) {
+		*baseCounter += (*baseCounter < 3);
+	} else {
+		*baseCounter -= (*baseCounter > 0);
+	}
+
+	// envelhecimento periódico da utilidade
+	if ((++updates % TAGE_USEFUL_PERIOD) == 0) {
+		for (int t = 0; t < TAGE_TABLES; t++) {
+			for (int i = 0; i < (1 << TAGE_TABLE_BITS); i++) {
+				tables[t][i].useful >>= 1;
+			}
+		}
+	}
+
+	pushHistory(taken);
+	return prediction;
+}
+
+/**
+ * Acrescenta a direção taken ao histórico global e às versões dobradas.
+ */
+void TagePredictor::pushHistory(bool taken)
+{
+	historyPointer = (historyPointer - 1) & (TAGE_HISTORY_SIZE - 1);
+	history[historyPointer] = taken;
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		updateFolded(&indexHistory[t]);
+		updateFolded(&tagHistory[t][0]);
+		updateFolded(&tagHistory[t][1]);
+	}
+}
+
+void TagePredictor::initFolded(TageFoldedHistory *folded, int origLength, int length)
+{
+	folded->value = 0;
+	folded->length = length;
+	folded->origLength = origLength;
+	folded->outpoint = origLength % length;
+}
+
+/**
+ * Dobra o bit mais novo do histórico e retira o bit que deixou a janela
+ * de origLength desvios.
+ */
+void TagePredictor::updateFolded(TageFoldedHistory *folded)
+{
+	uint32_t newest = history[historyPointer];
+	uint32_t oldest = history[(historyPointer + folded->origLength) & (TAGE_HISTORY_SIZE - 1)];
+
+	folded->value = (folded->value << 1) ^ newest;
+	folded->value ^= oldest << folded->outpoint;
+	folded->value ^= folded->value >> folded->length;
+	folded->value &= (1U << folded->length) - 1;
+}
+
+/**
+ * Contadores da base em 1 (fracamente não tomado), tabelas com tag vazias
+ * (tag fora do intervalo das tags calculadas) e histórico zerado.
+ */
+void TagePredictor::reset()
+{
+	memset(base, 1, 1 << TAGE_BASE_BITS);
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		for (int i = 0; i < (1 << TAGE_TABLE_BITS); i++) {
+			tables[t][i] = {0, 0, 0xFFFF};
+		}
+		initFolded(&indexHistory[t], tageHistoryLengths[t], TAGE_TABLE_BITS);
+		initFolded(&tagHistory[t][0], tageHistoryLengths[t], TAGE_TAG_BITS);
+		initFolded(&tagHistory[t][1], tageHistoryLengths[t], TAGE_TAG_BITS - 1);
+	}
+	memset(history, 0, sizeof(history));
+	historyPointer = 0;
+	updates = 0;
+}
@@ -0,0 +1,130 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) TagePredictor - a small TAGE predictor (tagged geometric history lengths)
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) TagePredictor - um preditor TAGE reduzido (históricos de tamanhos geométricos com tags)
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "BranchPredictor.h"
+
+// Tabela base (bimodal) e tabelas com tag: número de tabelas, entradas
+// (log2) e bits de tag de cada uma
+#define TAGE_BASE_BITS 12
+#define TAGE_TABLES 4
+#define TAGE_TABLE_BITS 10
+#define TAGE_TAG_BITS 9
+
+// Histórico global: capacidade do buffer circular (potência de 2, maior
+// que o maior histórico usado pelas tabelas)
+#define TAGE_HISTORY_SIZE 256
+
+// Período, em desvios condicionais, do envelhecimento dos bits de utilidade
+#define TAGE_USEFUL_PERIOD (1 << 18)
+
+/**
+ * Histórico global dobrado (comprimido) em length bits, atualizado a cada
+ * desvio em tempo constante: entra o bit mais novo e sai o bit de posição
+ * origLength (Michaud, PPM-like).
+ */
+struct TageFoldedHistory {
+	uint32_t value;
+	int length;
+	int origLength;
+	int outpoint;
+};
+
+/**
+ * Entrada de uma tabela com tag: contador de 3 bits com sinal (tomado se
+ * >= 0), utilidade de 2 bits e tag.
+ */
+struct TageEntry {
+	int8_t counter;
+	uint8_t useful;
+	uint16_t tag;
+};
+
+/**
+ * Preditor TAGE reduzido (Seznec e Michaud).
+ *
+ * Uma tabela base bimodal e TAGE_TABLES tabelas com tag indexadas por PC e
+ * por históricos globais de tamanhos em progressão geométrica (5, 15, 44 e
+ * 130 desvios). A predição vem da tabela de maior histórico cuja tag
+ * confere (provedora); uma entrada recém-alocada, ainda fraca e sem
+ * utilidade, cede a predição à alternativa (a próxima tabela que confere,
+ * ou a base). Em um erro, uma entrada é alocada em uma tabela de histórico
+ * maior que o da provedora.
+ *
+ * Em relação ao TAGE completo, não há contador de uso da alternativa,
+ * histórico de caminho nem escolha aleatória da tabela alocada.
+ */
+class TagePredictor: public BranchPredictor
+{
+	public:
+		TagePredictor();
+		~TagePredictor();
+
+		/**
+		 * Métodos herdados de BranchPredictor
+		 */
+		const char *getName();
+		void simulate(const BranchEvent *events, int count, uint8_t *mispredicted);
+		void reset();
+
+	private:
+		uint8_t *base;
+		TageEntry *tables[TAGE_TABLES];
+
+		// histórico global (bit mais novo em history[historyPointer]) e
+		// suas versões dobradas para o índice e para a tag de cada tabela
+		uint8_t history[TAGE_HISTORY_SIZE];
+		int historyPointer;
+		TageFoldedHistory indexHistory[TAGE_TABLES];
+		TageFoldedHistory tagHistory[TAGE_TABLES][2];
+
+		unsigned long updates;
+
+		/**
+		 * Prediz e atualiza um desvio condicional.
+		 *
+		 * Retorna a direção predita.
+		 */
+		bool predictAndUpdate(uint64_t pc, bool taken);
+
+		void initFolded(TageFoldedHistory *folded, int origLength, int length);
+		void updateFolded(TageFoldedHistory *folded);
+		void pushHistory(bool taken);
+};
@@ -40,12 +40,30 @@
 */
 
 #include "BasicProcessor.h"
-#include "BasicCPU.h"
+
+// (EN) CPU implementation, chosen in the makefile (CPUImpl)
+// (PT) implementao de CPU, escolhida no makefile (CPUImpl)
+#ifndef CPUIMPL
+#define CPUIMPL BasicCPU
+#define CPUIMPL_H "BasicCPU.h"
+#endif
+#include CPUIMPL_H
 
 BasicProcessor::BasicProcessor(Memory* _memory)
 {
 	memory = _memory;
-	cpu = new BasicCPU(memory);
+	cpu = new CPUIMPL(memory);
+}
+
+BasicProcessor::BasicProcessor(Memory* _memory, CPU* _cpu)
+{
+	memory = _memory;
+	cpu = _cpu;
+}
+
+BasicProcessor::~BasicProcessor()
+{
+	delete cpu;
 }
 
 int BasicProcessor::run(int startAddress)
@@ -45,6 +45,14 @@ class BasicProcessor: public Processor
 {
 	public:
 		BasicProcessor(Memory* _memory);
+
+		/**
+		 * Processador com uma CPU criada pelo chamador (por exemplo, o
+		 * farm, que escolhe a implementao de CPU de cada job). A CPU
+		 * passa a pertencer ao processador.
+		 */
+		BasicProcessor(Memory* _memory, CPU* _cpu);
+		~BasicProcessor();
 		
 		int run(int startAddress);
 };
@@ -0,0 +1,211 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) MultiCoreProcessor - A multi-core processor running one CPU per host
+	thread over a shared memory. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) MultiCoreProcessor - Um processador de vários núcleos, com uma CPU
+	por thread do hospedeiro sobre uma memória compartilhada. Parte do
+	projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "MultiCoreProcessor.h"
+
+#include "config.h"
+#include "BasicCPU.h"
+
+// (EN) CPU implementation, chosen in the makefile (CPUImpl)
+// (PT) implementação de CPU, escolhida no makefile (CPUImpl)
+#ifndef CPUIMPL
+#define CPUIMPL BasicCPU
+#define CPUIMPL_H "BasicCPU.h"
+#endif
+#include CPUIMPL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+MultiCoreProcessor::MultiCoreProcessor(Memory* _memory, int _cores)
+{
+	memory = _memory;
+	cores = _cores;
+	for (int i = 0; i < cores; i++) {
+		cpus.push_back(new CPUIMPL(memory));
+		entryPoints.push_back(-1);
+	}
+	cpu = cpus[0];
+}
+
+MultiCoreProcessor::~MultiCoreProcessor()
+{
+	for (BasicCPU *c : cpus) {
+		delete c;
+	}
+}
+
+/**
+ * Prepara o estado inicial de cada núcleo (PC, SP e X0) e executa os núcleos
+ * no modo escolhido.
+ */
+int MultiCoreProcessor::run(int startAddress)
+{
+	vector<int> results(cores, 0);
+	
+	for (int i = 0; i < cores; i++) {
+		long entry = (entryPoints[i] == -1) ? startAddress : entryPoints[i];
+		cpus[i]->setRegister(REG_PC, entry);
+		cpus[i]->setStackPointer(STACKADDRESS - i * MULTICORE_STACK_SIZE);
+		cpus[i]->setRegister(0, i);
+	}
+	
+	if (mode == ExecutionMode::QUANTUM_SYNC) {
+		runQuantumSync(results);
+	} else {
+		runFree(results);
+	}
+	
+	for (int result : results) {
+		if (result) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Cada núcleo executa em sua thread, sem sincronização, até terminar.
+ */
+void MultiCoreProcessor::runFree(vector<int> &results)
+{
+	vector<thread> threads;
+	
+	for (int i = 0; i < cores; i++) {
+		threads.emplace_back([this, &results, i]() {
+			results[i] = cpus[i]->runQuantum(0);
+		});
+	}
+	for (thread &t : threads) {
+		t.join();
+	}
+}
+
+/**
+ * Cada núcleo executa em sua thread um quantum de cada vez e espera os
+ * demais em uma barreira. O último núcleo a chegar na barreira conta o
+ * quantum e decide se há outro (algum núcleo ainda não terminou).
+ */
+void MultiCoreProcessor::runQuantumSync(vector<int> &results)
+{
+	mutex barrierMutex;
+	condition_variable barrierCV;
+	int arrived = 0;
+	unsigned long generation = 0;
+	bool done = false;
+	vector<thread> threads;
+	
+	quanta = 0;
+	for (int i = 0; i < cores; i++) {
+		threads.emplace_back([&, i]() {
+			BasicCPU *core = cpus[i];
+			
+			while (true) {
+				if (!core->isFinished()) {
+					results[i] = core->runQuantum(quantum);
+				}
+				
+				unique_lock<mutex> lock(barrierMutex);
+				if (++arrived == cores) {
+					arrived = 0;
+					quanta++;
+					done = true;
+					for (BasicCPU *c : cpus) {
+						if (!c->isFinished()) {
+							done = false;
+						}
+					}
+					generation++;
+					barrierCV.notify_all();
+				} else {
+					unsigned long g = generation;
+					barrierCV.wait(lock, [&]() { return generation != g; });
+				}
+				if (done) {
+					return;
+				}
+			}
+		});
+	}
+	for (thread &t : threads) {
+		t.join();
+	}
+}
+
+void MultiCoreProcessor::setEntryPoint(int core, long address)
+{
+	entryPoints[core] = address;
+}
+
+void MultiCoreProcessor::setExecutionMode(ExecutionMode mode, unsigned long quantum)
+{
+	this->mode = mode;
+	this->quantum = quantum;
+}
+
+int MultiCoreProcessor::getCores()
+{
+	return cores;
+}
+
+BasicCPU *MultiCoreProcessor::getCore(int core)
+{
+	return cpus[core];
+}
+
+PerfCounters *MultiCoreProcessor::getPerfCounters(int core)
+{
+	return cpus[core]->getPerfCounters();
+}
+
+void MultiCoreProcessor::setProfiler(int core, PCProfiler *profiler)
+{
+	cpus[core]->setProfiler(profiler);
+}
+
+unsigned long MultiCoreProcessor::getQuanta()
+{
+	return quanta;
+}
@@ -0,0 +1,133 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) MultiCoreProcessor - A multi-core processor running one CPU per host
+	thread over a shared memory. Part of armethyst project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) MultiCoreProcessor - Um processador de vários núcleos, com uma CPU
+	por thread do hospedeiro sobre uma memória compartilhada. Parte do
+	projeto armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "Processor.h"
+
+#include <vector>
+
+class BasicCPU;
+
+// Configuração padrão: número de núcleos, tamanho da pilha de cada núcleo
+// (as pilhas ficam abaixo de STACKADDRESS, uma após a outra) e número de
+// instruções de cada quantum no modo sincronizado
+#define MULTICORE_CORES 4
+#define MULTICORE_STACK_SIZE 0x1000
+#define MULTICORE_QUANTUM 10000
+
+/**
+ * Processador com N núcleos (CPUs da implementação escolhida no makefile)
+ * sobre a mesma memória, cada núcleo executado em uma thread do hospedeiro.
+ *
+ * O núcleo i começa no seu ponto de entrada (startAddress, se não for
+ * definido por setEntryPoint()), com SP = STACKADDRESS - i *
+ * MULTICORE_STACK_SIZE e X0 = i.
+ *
+ * Modos de execução:
+ *	- FREE_RUNNING: cada núcleo executa livremente até terminar; a
+ *	  intercalação dos acessos à memória fica a cargo do hospedeiro.
+ *	- QUANTUM_SYNC: os núcleos executam quanta de quantum instruções e
+ *	  esperam uns pelos outros ao fim de cada quantum, de forma que
+ *	  nenhum núcleo se adianta mais de um quantum em relação aos demais.
+ *
+ * A cache de instruções decodificadas de cada núcleo só é invalidada por
+ * escritas do próprio núcleo: código modificado por outro núcleo não é
+ * visto por quem já o decodificou.
+ */
+class MultiCoreProcessor: public Processor
+{
+	public:
+		enum ExecutionMode {FREE_RUNNING, QUANTUM_SYNC};
+
+		MultiCoreProcessor(Memory* _memory, int _cores = MULTICORE_CORES);
+		~MultiCoreProcessor();
+		
+		/**
+		 * Executa todos os núcleos até que todos terminem.
+		 *
+		 * Retorna 0: se todos os núcleos terminaram sem erro e
+		 *		   1: se algum núcleo terminou com erro.
+		 */
+		int run(int startAddress);
+
+		/**
+		 * Ponto de entrada do núcleo core (-1: startAddress de run()).
+		 */
+		void setEntryPoint(int core, long address);
+
+		/**
+		 * Modo de execução e, no modo QUANTUM_SYNC, tamanho do quantum.
+		 */
+		void setExecutionMode(ExecutionMode mode,
+				unsigned long quantum = MULTICORE_QUANTUM);
+
+		/**
+		 * Número de núcleos, acesso à CPU de cada núcleo, contadores de
+		 * desempenho e profiler de PCs de cada núcleo (ver Processor).
+		 */
+		int getCores();
+		BasicCPU *getCore(int core);
+		PerfCounters *getPerfCounters(int core);
+		void setProfiler(int core, PCProfiler *profiler);
+
+		/**
+		 * Número de quanta executados pelo último run() no modo QUANTUM_SYNC.
+		 */
+		unsigned long getQuanta();
+
+	private:
+		int cores;
+		std::vector<BasicCPU*> cpus;
+		std::vector<long> entryPoints;
+		
+		ExecutionMode mode = ExecutionMode::FREE_RUNNING;
+		unsigned long quantum = MULTICORE_QUANTUM;
+		unsigned long quanta = 0;
+
+		/**
+		 * Execução dos núcleos em cada modo. results[i] recebe o resultado
+		 * do núcleo i.
+		 */
+		void runFree(std::vector<int> &results);
+		void runQuantumSync(std::vector<int> &results);
+};
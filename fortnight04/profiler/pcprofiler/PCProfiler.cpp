@@ -0,0 +1,345 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) PCProfiler - Counts retired instructions and data accesses per PC,
+	exactly or sampled, and reports them by ELF symbol. Part of armethyst
+	project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) PCProfiler - Conta instruções retiradas e acessos a dados por PC,
+	exata ou amostralmente, e os relata por símbolo ELF. Parte do projeto
+	armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "PCProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+PCProfiler::PCProfiler(unsigned long period)
+{
+	this->period = period ? period : 1;
+	// semente distinta por profiler, para que os núcleos não amostrem em
+	// sincronia
+	random = (0x9E3779B97F4A7C15UL ^ (uint64_t)this) | 1;
+	siteBits = PROFILE_SITES_BITS;
+	sites = new ProfileSite[1UL << siteBits];
+	symbolsSorted = true;
+	reset();
+}
+
+PCProfiler::~PCProfiler()
+{
+	delete[] sites;
+}
+
+unsigned long PCProfiler::getPeriod()
+{
+	return period;
+}
+
+int PCProfiler::add(PCProfiler &other)
+{
+	if (other.period != period) {
+		return 1;
+	}
+	for (unsigned long i = 0; i < (1UL << other.siteBits); i++) {
+		const ProfileSite &site = other.sites[i];
+		if (site.samples) {
+			ProfileSite *mine = findSite(site.PC);
+			mine->samples += site.samples;
+			mine->loads += site.loads;
+			mine->stores += site.stores;
+		}
+	}
+	samples += other.samples;
+	last = nullptr;
+	return 0;
+}
+
+void PCProfiler::addSymbol(string name, uint64_t address, uint64_t size)
+{
+	symbols.push_back({name, address, size});
+	symbolsSorted = false;
+}
+
+int PCProfiler::getSymbolCount()
+{
+	return symbols.size();
+}
+
+/**
+ * Sondagem linear a partir do espalhamento multiplicativo de pc / 4, como
+ * em BranchMonitor. A tabela dobra quando passa da metade da capacidade.
+ * A entrada criada só passa a contar como ocupada quando o chamador
+ * incrementa samples, o que acontece logo em seguida.
+ */
+ProfileSite *PCProfiler::findSite(uint64_t pc)
+{
+	unsigned long mask = (1UL << siteBits) - 1;
+	unsigned long i = ((pc >> 2) * 0x9E3779B97F4A7C15UL) >> (64 - siteBits);
+
+	while (sites[i].samples) {
+		if (sites[i].PC == pc) {
+			return &sites[i];
+		}
+		i = (i + 1) & mask;
+	}
+
+	if (2 * (siteCount + 1) > (1UL << siteBits)) {
+		growSites();
+		return findSite(pc);
+	}
+	siteCount++;
+	sites[i].PC = pc;
+	return &sites[i];
+}
+
+void PCProfiler::growSites()
+{
+	ProfileSite *old = sites;
+	unsigned long oldSize = 1UL << siteBits;
+
+	siteBits++;
+	sites = new ProfileSite[1UL << siteBits];
+	memset(sites, 0, (1UL << siteBits) * sizeof(ProfileSite));
+	siteCount = 0;
+	for (unsigned long i = 0; i < oldSize; i++) {
+		if (old[i].samples) {
+			*findSite(old[i].PC) = old[i];
+		}
+	}
+	delete[] old;
+	last = nullptr;
+}
+
+unsigned long PCProfiler::getSamples()
+{
+	return samples;
+}
+
+unsigned long PCProfiler::getInstructions()
+{
+	return samples * period;
+}
+
+unsigned long PCProfiler::getLoads()
+{
+	unsigned long loads = 0;
+	for (ProfileSite &site : getSites()) {
+		loads += site.loads;
+	}
+	return loads * period;
+}
+
+unsigned long PCProfiler::getStores()
+{
+	unsigned long stores = 0;
+	for (ProfileSite &site : getSites()) {
+		stores += site.stores;
+	}
+	return stores * period;
+}
+
+vector<ProfileSite> PCProfiler::getSites()
+{
+	vector<ProfileSite> list;
+
+	for (unsigned long i = 0; i < (1UL << siteBits); i++) {
+		if (sites[i].samples) {
+			list.push_back(sites[i]);
+		}
+	}
+	sort(list.begin(), list.end(), [](const ProfileSite &a, const ProfileSite &b) {
+		return a.PC < b.PC;
+	});
+	return list;
+}
+
+/**
+ * Busca linear na tabela ordenada: a simbolização só é feita nos
+ * relatórios, uma vez por PC amostrado.
+ */
+void PCProfiler::lookup(uint64_t pc, const ProfileSymbol **function,
+		const ProfileSymbol **label)
+{
+	if (!symbolsSorted) {
+		stable_sort(symbols.begin(), symbols.end(),
+				[](const ProfileSymbol &a, const ProfileSymbol &b) {
+			return a.address < b.address;
+		});
+		symbolsSorted = true;
+	}
+
+	*function = nullptr;
+	*label = nullptr;
+	for (const ProfileSymbol &symbol : symbols) {
+		if (symbol.address > pc) {
+			break;
+		}
+		if (symbol.size) {
+			// um rótulo não passa de um símbolo com tamanho
+			*label = nullptr;
+			if (pc < symbol.address + symbol.size) {
+				*function = &symbol;
+			}
+		} else {
+			*label = &symbol;
+		}
+	}
+}
+
+string PCProfiler::symbolize(uint64_t pc)
+{
+	const ProfileSymbol *function;
+	const ProfileSymbol *label;
+	ostringstream name;
+
+	lookup(pc, &function, &label);
+	const ProfileSymbol *symbol = label ? label : function;
+	if (!symbol) {
+		name << "0x" << hex << pc;
+	} else {
+		name << symbol->name;
+		if (pc != symbol->address) {
+			name << "+0x" << hex << pc - symbol->address;
+		}
+	}
+	return name.str();
+}
+
+string PCProfiler::stack(uint64_t pc)
+{
+	const ProfileSymbol *function;
+	const ProfileSymbol *label;
+	ostringstream frames;
+
+	lookup(pc, &function, &label);
+	if (function) {
+		frames << function->name << ";";
+	}
+	if (label) {
+		frames << label->name << ";";
+	}
+	frames << "0x" << hex << pc;
+	return frames.str();
+}
+
+void PCProfiler::writeFlat(ostream &out, int top)
+{
+	vector<ProfileSite> list = getSites();
+	ios::fmtflags flags = out.flags();
+	char fill = out.fill(' ');
+
+	// contadores por símbolo (rótulo ou função mais interno)
+	struct Totals {
+		unsigned long samples;
+		unsigned long loads;
+		unsigned long stores;
+	};
+	map<string, Totals> bySymbol;
+	for (ProfileSite &site : list) {
+		const ProfileSymbol *function;
+		const ProfileSymbol *label;
+		lookup(site.PC, &function, &label);
+		const ProfileSymbol *symbol = label ? label : function;
+		Totals &totals = bySymbol[symbol ? symbol->name : "(sem símbolo)"];
+		totals.samples += site.samples;
+		totals.loads += site.loads;
+		totals.stores += site.stores;
+	}
+	vector<pair<string, Totals>> rows(bySymbol.begin(), bySymbol.end());
+	stable_sort(rows.begin(), rows.end(),
+			[](const pair<string, Totals> &a, const pair<string, Totals> &b) {
+		return a.second.samples > b.second.samples;
+	});
+
+	out << "Perfil de PCs: " << dec << samples << " amostras (1 em " << period
+			<< "), instruções: " << getInstructions() << ", leituras: "
+			<< getLoads() << ", escritas: " << getStores() << endl;
+	out << "      %  acum. %   instruções     leituras     escritas  símbolo" << endl;
+	double cumulative = 0;
+	for (auto &row : rows) {
+		double percent = samples ? 100.0 * row.second.samples / samples : 0;
+		cumulative += percent;
+		out << fixed << setprecision(2) << setw(7) << percent << setw(9) << cumulative
+				<< setw(13) << row.second.samples * period
+				<< setw(13) << row.second.loads * period
+				<< setw(13) << row.second.stores * period
+				<< "  " << row.first << endl;
+	}
+
+	// PCs com mais instruções
+	stable_sort(list.begin(), list.end(), [](const ProfileSite &a, const ProfileSite &b) {
+		return a.samples > b.samples;
+	});
+	if ((int)list.size() > top) {
+		list.resize(top);
+	}
+	out << "PCs com mais instruções:" << endl;
+	for (ProfileSite &site : list) {
+		out << "    0x" << hex << setw(8) << setfill('0') << site.PC << setfill(' ')
+				<< dec << " " << fixed << setprecision(2) << setw(6)
+				<< (samples ? 100.0 * site.samples / samples : 0) << "%"
+				<< " instruções: " << setw(10) << site.samples * period
+				<< " leituras: " << setw(10) << site.loads * period
+				<< " escritas: " << setw(10) << site.stores * period
+				<< "  " << symbolize(site.PC) << endl;
+	}
+	out.flags(flags);
+	out.fill(fill);
+}
+
+void PCProfiler::writeFolded(ostream &out, ProfileMetric metric)
+{
+	for (ProfileSite &site : getSites()) {
+		unsigned long weight = (metric == PROFILE_INSTRUCTIONS)
+				? site.samples : site.loads + site.stores;
+		if (weight) {
+			out << stack(site.PC) << " " << dec << weight * period << endl;
+		}
+	}
+}
+
+void PCProfiler::reset()
+{
+	samples = 0;
+	siteCount = 0;
+	last = nullptr;
+	memset(sites, 0, (1UL << siteBits) * sizeof(ProfileSite));
+}
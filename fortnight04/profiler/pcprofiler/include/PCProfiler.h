@@ -0,0 +1,234 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) PCProfiler - Counts retired instructions and data accesses per PC,
+	exactly or sampled, and reports them by ELF symbol. Part of armethyst
+	project.
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) PCProfiler - Conta instruções retiradas e acessos a dados por PC,
+	exata ou amostralmente, e os relata por símbolo ELF. Parte do projeto
+	armethyst.
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Capacidade inicial (log2) da tabela de PCs e número de PCs listados por
+// writeFlat()
+#define PROFILE_SITES_BITS 10
+#define PROFILE_REPORT_TOP 20
+
+/**
+ * Métrica usada como peso das pilhas em writeFolded(): instruções
+ * retiradas ou acessos a dados (leituras e escritas).
+ */
+enum ProfileMetric {PROFILE_INSTRUCTIONS, PROFILE_ACCESSES};
+
+/**
+ * PC amostrado e seus contadores: instruções retiradas no PC e leituras e
+ * escritas de dados feitas por elas, em amostras (ver PCProfiler).
+ */
+struct ProfileSite {
+	uint64_t PC;
+	unsigned long samples;
+	unsigned long loads;
+	unsigned long stores;
+};
+
+/**
+ * Símbolo usado na simbolização: funções e variáveis têm tamanho; rótulos
+ * (por exemplo, .L3, quando o montador os mantém na tabela de símbolos)
+ * têm tamanho 0 e valem até o próximo símbolo.
+ */
+struct ProfileSymbol {
+	std::string name;
+	uint64_t address;
+	uint64_t size;
+};
+
+/**
+ * Profiler de PCs.
+ *
+ * A CPU informa as instruções amostradas com record(). Com período 1 todas
+ * as instruções retiradas são registradas (contagem exata); com período N,
+ * o intervalo até a próxima amostra é sorteado entre 1 e 2N - 1 (média N),
+ * para que um laço cujo número de instruções divida N não seja amostrado
+ * sempre no mesmo PC. Os relatórios estimam as contagens como amostras
+ * vezes o período.
+ *
+ * Os PCs são simbolizados pelos símbolos do ELF (addSymbol()): cada PC
+ * pertence à função que o contém e, dentro dela, ao último rótulo antes
+ * dele. writeFlat() escreve o perfil plano, por símbolo e por PC, e
+ * writeFolded() as pilhas "função;rótulo;PC peso", uma por linha, no
+ * formato de entrada do flamegraph.pl. Como BL e RET ainda não são
+ * decodificados, a pilha não inclui chamadores.
+ *
+ * O profiler não é thread-safe: cada CPU tem o seu (ver add()).
+ */
+class PCProfiler
+{
+	public:
+		/**
+		 * Profiler que amostra, em média, uma em cada period instruções
+		 * (1: todas).
+		 */
+		PCProfiler(unsigned long period = 1);
+		~PCProfiler();
+
+		unsigned long getPeriod();
+
+		/**
+		 * Instruções até a próxima amostra.
+		 */
+		unsigned long nextInterval() {
+			if (period == 1) {
+				return 1;
+			}
+			// xorshift64
+			random ^= random << 13;
+			random ^= random >> 7;
+			random ^= random << 17;
+			return 1 + random % (2 * period - 1);
+		};
+
+		/**
+		 * Registra a instrução amostrada em pc, que fez loads leituras e
+		 * stores escritas de dados.
+		 */
+		void record(uint64_t pc, int loads, int stores) {
+			if (!last || (last->PC != pc)) {
+				last = findSite(pc);
+			}
+			last->samples++;
+			last->loads += loads;
+			last->stores += stores;
+			samples++;
+		};
+
+		/**
+		 * Soma as amostras de other (por exemplo, de outro núcleo).
+		 *
+		 * Retorna 0: se somou e
+		 *		   1: se os períodos forem diferentes.
+		 */
+		int add(PCProfiler &other);
+
+		/**
+		 * Acrescenta um símbolo usado na simbolização (size = 0: rótulo).
+		 */
+		void addSymbol(std::string name, uint64_t address, uint64_t size);
+		int getSymbolCount();
+
+		/**
+		 * Nome de pc: símbolo mais interno que o contém, seguido de
+		 * "+0x<deslocamento>" se pc não for o seu início, ou o próprio
+		 * endereço, se nenhum símbolo o contiver.
+		 */
+		std::string symbolize(uint64_t pc);
+
+		/**
+		 * Amostras registradas e estimativas (amostras vezes o período)
+		 * de instruções, leituras e escritas.
+		 */
+		unsigned long getSamples();
+		unsigned long getInstructions();
+		unsigned long getLoads();
+		unsigned long getStores();
+
+		/**
+		 * PCs amostrados, em ordem de endereço.
+		 */
+		std::vector<ProfileSite> getSites();
+
+		/**
+		 * Escreve o perfil plano: instruções, leituras e escritas
+		 * estimadas por símbolo, em ordem decrescente de instruções, e os
+		 * top PCs com mais instruções.
+		 */
+		void writeFlat(std::ostream &out, int top = PROFILE_REPORT_TOP);
+
+		/**
+		 * Escreve as pilhas de cada PC amostrado com peso estimado pela
+		 * métrica metric (PCs com peso 0 são omitidos).
+		 */
+		void writeFolded(std::ostream &out, ProfileMetric metric = PROFILE_INSTRUCTIONS);
+
+		/**
+		 * Descarta as amostras (os símbolos são mantidos).
+		 */
+		void reset();
+
+	private:
+		unsigned long period;
+		uint64_t random;
+		unsigned long samples;
+
+		// PCs amostrados: tabela de espalhamento com endereçamento aberto
+		// (entradas vazias têm samples = 0); last é a entrada do último PC
+		ProfileSite *sites;
+		int siteBits;
+		unsigned long siteCount;
+		ProfileSite *last;
+
+		// símbolos, ordenados por endereço sob demanda
+		std::vector<ProfileSymbol> symbols;
+		bool symbolsSorted;
+
+		/**
+		 * Entrada de pc, criada se necessário.
+		 */
+		ProfileSite *findSite(uint64_t pc);
+
+		/**
+		 * Dobra a capacidade da tabela de PCs.
+		 */
+		void growSites();
+
+		/**
+		 * Função (símbolo com tamanho que contém pc) e rótulo (último
+		 * símbolo sem tamanho antes de pc, dentro da função, se houver)
+		 * de pc; nullptr se não houver.
+		 */
+		void lookup(uint64_t pc, const ProfileSymbol **function,
+				const ProfileSymbol **label);
+
+		/**
+		 * Pilha de pc: "função;rótulo;0x<pc>", sem os níveis ausentes.
+		 */
+		std::string stack(uint64_t pc);
+};
@@ -36,22 +36,64 @@
 #include "config.h"
 
 #include "SimpleMemoryTest.h"
-#include "BasicCPUTest.h"
-
+#include "PagedMemory.h"
+#include "TLBMemory.h"
+#include "ElfLoader.h"
+#include "CachedMemory.h"
+#include "BranchMonitor.h"
+#include "MemoryTrace.h"
+#include "AsyncTraceWriter.h"
+#include "PCProfiler.h"
+
+// (EN) CPU test class, chosen in the makefile from CPUImpl
+// (PT) classe de teste da CPU, escolhida no makefile a partir de CPUImpl
+#ifndef CPUTEST
+#define CPUTEST BasicCPUTest
+#define CPUTEST_H "BasicCPUTest.h"
+#endif
+#include CPUTEST_H
+
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 
 using namespace std;
 
+typedef CPUTEST CPUTest;
+
 #define STARTSP 0x1000 // endereço inicial da pilha: 4096
 
 #define CALLTEST() test(instruction,cpu,memory,startAddress,startSP,xpctdIR,xpctdA,xpctdB,xpctdALUctrl,xpctdMEMctrl,xpctdWBctrl,xpctdALUout,xpctdMDR,xpctdRd)
 
 #define RESETTEST()	startAddress=-1;xpctdIR=-1;xpctdA=-1;xpctdB=-1;xpctdALUctrl=ALUctrlFlag::ALU_UNDEF;xpctdALUout=-1;xpctdMEMctrl=MEMctrlFlag::MEM_UNDEF;xpctdMDR=-1;xpctdWBctrl=WBctrlFlag::WB_UNDEF;xpctdRd=-1;cpu->resetFlags();memory->resetLastDataMemAccess();
 
-void test(BasicCPUTest* cpu, SimpleMemoryTest* memory);
+void test(CPUTest* cpu, SimpleMemoryTest* memory);
+void testDecodeCache(CPUTest* cpu, SimpleMemoryTest* memory);
+void testSelfModifyingCode();
+void testRun(SimpleMemoryTest* memory);
+void testRegisterFile(CPUTest* cpu, SimpleMemoryTest* memory);
+void testConditionFlags(SimpleMemoryTest* memory);
+void testConditionalInstructions();
+void testPagedMemory();
+void testTLBMemory();
+void testLoadBinary();
+void testElfLoader();
+void testGuardPages();
+void testCachedMemory();
+void testBranchPredictors();
+void testMemoryTrace();
+void testAsyncTrace();
+void testPerfCounters();
+void testPerfCountersAliasedBlocks();
+void testPCProfiler();
+void testBlockTransfers(SimpleMemoryTest* memory);
+void testLoadStorePair();
+void testUnalignedAccesses(SimpleMemoryTest* memory);
+void testLoadStoreSubword();
+void testAdvSIMD();
 void test(string instruction,
-			BasicCPUTest* cpu,
+			CPUTest* cpu,
 			SimpleMemoryTest* memory,
 			long startAddress,
 			long startSP,
@@ -73,12 +115,17 @@ int main()
 	
 	// (EN) create CPU
 	// (PT) cria CPU
-	BasicCPUTest *cpu = new BasicCPUTest(memory);
+	CPUTest *cpu = new CPUTest(memory);
 		
-	// (EN) load executable binary
-	// (PT) carrega binário executável
-	memory->loadBinary(FILENAME);
-	memory->relocateManual();
+	// (EN) load and relocate the executable binary
+	// (PT) carrega e realoca o binário executável
+	ElfLoader loader(FILENAME);
+	if (loader.load()) {
+		cout << "Falha ao carregar " << FILENAME << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	memory->loadBinary(loader.getImageFile());
 	
 	// (EN) create human readable representation of the binary file
 	// (PT) cria representação legível do arquivo binário
@@ -92,6 +139,75 @@ int main()
 	//		Como não temos o caminho de dados completo, faremos apenas testes.
 	test(cpu, memory);
 	
+	// Teste do ciclo completo da máquina (run)
+	testRun(memory);
+	
+	// Teste da cache de instruções decodificadas
+	testDecodeCache(cpu, memory);
+	
+	// Teste de escrita sobre instrução já executada (B.cond interpretado)
+	testSelfModifyingCode();
+	
+	// Teste do banco de registradores (ZR e largura de Wn)
+	testRegisterFile(cpu, memory);
+	
+	// Teste das flags NZCV ('cmp w0, 9' e 'ble .L3')
+	testConditionFlags(memory);
+	
+	// Teste de ADDS, SUBS, CSEL e B.cond, comparados com BasicCPU
+	testConditionalInstructions();
+	
+	// Teste da memória paginada
+	testPagedMemory();
+	
+	// Teste das TLBs
+	testTLBMemory();
+	
+	// Teste da carga de binários por mmap
+	testLoadBinary();
+	
+	// Teste do carregador ELF (leiaute, realocações, 'main' e cache)
+	testElfLoader();
+	
+	// Teste das páginas de guarda (DATA_ABORT)
+	testGuardPages();
+	
+	// Teste da hierarquia de caches
+	testCachedMemory();
+	
+	// Teste dos preditores de desvios
+	testBranchPredictors();
+	
+	// Teste do registro binário de acessos à memória
+	testMemoryTrace();
+	
+	// Teste do registro de acessos em thread de fundo
+	testAsyncTrace();
+	
+	// Teste dos contadores de desempenho
+	testPerfCounters();
+	
+	// Teste dos contadores com blocos a 4 KiB de distância (JitCPU)
+	testPerfCountersAliasedBlocks();
+	
+	// Teste do profiler de PCs (exato e amostrado)
+	testPCProfiler();
+	
+	// Teste dos acessos em bloco e em pares das memórias
+	testBlockTransfers(memory);
+	
+	// Teste de LDP e STP (uma transação por instrução)
+	testLoadStorePair();
+	
+	// Teste dos acessos de 8, 16, 32 e 64 bits desalinhados
+	testUnalignedAccesses(memory);
+	
+	// Teste de LDRB, LDRH, LDRSB, LDRSH, STRB e STRH
+	testLoadStoreSubword();
+	
+	// Teste das instruções AdvSIMD e de ponto flutuante
+	testAdvSIMD();
+	
 	return 0;
 }
 
@@ -99,7 +215,7 @@ int main()
  * Testa o estágio IF e testa parcialmente os estágios ID e EXI, somente
  * para as instruções 'sub sp, sp, #16' e 'add w1, w1, w0'.
  */
-void test(BasicCPUTest* cpu, SimpleMemoryTest* memory)
+void test(CPUTest* cpu, SimpleMemoryTest* memory)
 {
 	string instruction;
 
@@ -173,14 +289,14 @@ void test(BasicCPUTest* cpu, SimpleMemoryTest* memory)
 	xpctdA = STARTSP; 		// SP deve ser lido para A
 	xpctdB = 12;			// valor imediato do offset
 	xpctdALUctrl = ALUctrlFlag::ADD;
-	xpctdMEMctrl = MEMctrlFlag::READ64;
+	xpctdMEMctrl = MEMctrlFlag::READ32;	// 32 bits com extensão de sinal
 	xpctdWBctrl = WBctrlFlag::RegWrite;
 	
 	xpctdALUout = xpctdA + xpctdB;
 
 	// force data in memory
 	xpctdRd = STARTSP << 2;
-	memory->writeData64(xpctdALUout, STARTSP << 2);
+	memory->writeData32(xpctdALUout, STARTSP << 2);
 
 	CALLTEST();
 	RESETTEST();
@@ -303,230 +419,2067 @@ void test(BasicCPUTest* cpu, SimpleMemoryTest* memory)
 }
 
 /**
- * Testa o estágio IF.
+ * Executa o programa com run() a partir de 'sub sp, sp, #16' até a
+ * primeira instrução não implementada, 'adrp x0, v' em 0x4c, depois de
+ * 'sub', 'str', 'b .L2', 'ldr', 'cmp w0, 9' e 'ble .L3'.
  */
-void testIF(BasicCPUTest* cpu, int xpctdIR)
+void testRun(SimpleMemoryTest* memory)
 {
-	//
-	// Testa IF
-	//
-	cout << "Testando IF..." << endl;
-	
-	// executa
-	cpu->runIF();
-	cout << "	IR=0x" << cpu->getIR()
-			<< ";  Esperado IR=0x" << xpctdIR << endl;
-	
-	// verifica
-	if (cpu->getIR() != xpctdIR) {
-		cout << "IF() FALHOU!" << endl;
+	cout << "#\n#\n#\n# Testing run()...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	CPUTest *cpu = new CPUTest(memory);
+	int result = cpu->run(0x40);
+	cout << "	result=" << result << "; PC=0x" << cpu->getPC()
+			<< "; instructions=" << cpu->getInstructionCount() << endl;
+	cout << "Esperados: result=1; PC=0x4c; instructions=6" << endl;
+	if ((result != 1) || (cpu->getPC() != 0x4c)
+			|| (cpu->getInstructionCount() != 6)) {
+		cout << "run() FALHOU!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
+	delete cpu;
 
-	cout << "IF() passou no teste!" << endl << endl;
+	cout << "run() passou no teste!" << endl << endl;
 }
 
 /**
- * Testa o estágio ID.
+ * Testa a cache de instruções decodificadas: uma instrução já decodificada
+ * não é decodificada de novo e a escrita sobre ela invalida a entrada.
  */
-void testID(BasicCPUTest* cpu,
-			int xpctdIR,
-			int xpctdA,
-			int xpctdB,
-			ALUctrlFlag xpctdALUctrl,
-			MEMctrlFlag xpctdMEMctrl,
-			WBctrlFlag xpctdWBctrl)
+void testDecodeCache(CPUTest* cpu, SimpleMemoryTest* memory)
 {
-	//
-	// Testa ID (depende do sucesso no teste de IF)
-	//
-	cout << "Testando ID..." << endl;
-	
-	// executa
-	int iderror = cpu->runID();
-	
-	// verifica se a instrução está implementada
-	if (iderror) {
-		cout << "Instrução não implementada: 0x" << xpctdIR << endl;
+	cout << "#\n#\n#\n# Testing decode cache...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	unsigned long hits = cpu->getDecodeCacheHits();
+	unsigned long misses = cpu->getDecodeCacheMisses();
+
+	// 'sub sp, sp, #16' já foi decodificada em test()
+	cpu->setPC(0x40);
+	cpu->setSP(STARTSP);
+	cpu->runIF();
+	cpu->runID();
+	cout << "	hits=0x" << cpu->getDecodeCacheHits()
+			<< "; misses=0x" << cpu->getDecodeCacheMisses() << endl;
+	if ((cpu->getDecodeCacheHits() != hits + 1)
+			|| (cpu->getDecodeCacheMisses() != misses)
+			|| (cpu->getA() != STARTSP) || (cpu->getB() != 16)
+			|| (cpu->getALUctrl() != ALUctrlFlag::SUB)) {
+		cout << "Decode cache FALHOU no acerto!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
 
-	// verifica leitura de registradores
-	long A = cpu->getA();
-	long B = cpu->getB();
-	cout << "	A=0x" << A << "; B=0x" << B << endl;
-	cout << "Esperados: A=0x" << xpctdA << "; B=0x" << xpctdB << endl;
-	if ((A != xpctdA) || (B != xpctdB)){
-		cout << "ID() FALHOU na leitura de registradores!" << endl;
+	// 'str w1, [x0]' com x0 = 0x40 sobrescreve 'sub sp, sp, #16'
+	unsigned int subIR = memory->readInstruction32(0x40);
+	cpu->setPC(0x74);
+	cpu->setX(0,0x40);
+	cpu->setW(1,subIR);
+	cpu->runIF();
+	cpu->runID();
+	cpu->runEXI();
+	cpu->runMEM();
+	if (cpu->getDecodeCacheInvalidations() == 0) {
+		cout << "Decode cache FALHOU na invalidação!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
 
-	cout << "ID() passou no teste de leitura de registradores!" << endl << endl;
-
-	// verifica ALUctrl
-	ALUctrlFlag ALUctrl = cpu->getALUctrl();
-	cout << "	ALUctrl=0x" << ALUctrl << "; Esperado ALUctrl=0x"
-			<< xpctdALUctrl << endl;
-	if (ALUctrl != xpctdALUctrl)
-	{
-		cout << "ID() FALHOU no set do controle da ULA!" << endl;
+	// a instrução em 0x40 deve ser decodificada outra vez
+	misses = cpu->getDecodeCacheMisses();
+	cpu->setPC(0x40);
+	cpu->runIF();
+	cpu->runID();
+	if (cpu->getDecodeCacheMisses() != misses + 1) {
+		cout << "Decode cache FALHOU: entrada invalidada foi usada!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
 
-	cout << "ID() passou no teste de set do controle da ULA!" << endl << endl;
+	cout << "Decode cache passou no teste!" << endl << endl;
+}
 
-	// verifica MEMctrl
-	MEMctrlFlag MEMctrl = cpu->getMEMctrl();
-	cout << "	MEMctrl=0x" << MEMctrl << "; Esperado MEMctrl=0x"
-			<< xpctdMEMctrl << endl;
-	if (MEMctrl != xpctdMEMctrl)
-	{
-		cout << "ID() FALHOU no set do controle de MEM!" << endl;
+/**
+ * Testa a escrita sobre uma instrução que já foi executada. Na JitCPU o
+ * bloco traduzido 0x40-0x48 termina antes do 'strb' em 0x4C, que é
+ * executado pelos estágios (e fica na cache de instruções decodificadas).
+ * Na segunda volta do laço, 'str w3, [x2]' (código gerado) troca o 'strb'
+ * por 'strh w0, [x6, #40]', também executada pelos estágios, que deve ser
+ * decodificada de novo; na primeira, x2 aponta para dados.
+ */
+void testSelfModifyingCode()
+{
+	cout << "#\n#\n#\n# Testing self-modifying code...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	static const unsigned int program[] = {
+		0xB9000043,		// loop: str w3, [x2]
+		0x8B070042,		// add x2, x2, x7
+		0x91000400,		// add x0, x0, #1
+		0x390080C0,		// strb w0, [x6, #32] (trocada por 'strh w0, [x6, #40]')
+		0xF100081F,		// cmp x0, #2
+		0x54FFFF61,		// b.ne loop
+		0xA9007CC0		// stp x0, xzr, [x6]
+	};
+	int count = sizeof(program) / sizeof(program[0]);
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	for (int i = 0; i < count; i++) {
+		memory->writeData32(0x40 + 4*i, program[i]);
+	}
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setStackPointer(0x1000);
+	cpu->setRegister(2, 0x2000);
+	cpu->setRegister(3, 0x790050C0); // strh w0, [x6, #40]
+	cpu->setRegister(6, 0x3000);
+	cpu->setRegister(7, 0x4C - 0x2000);
+	cpu->run(0x40);
+
+	long x0 = memory->readData64(0x3000);
+	int byte = memory->readData32(0x3020);
+	int half = memory->readData32(0x3028);
+	cout << "	x0=0x" << x0 << "; [x6, #32]=0x" << byte << "; [x6, #40]=0x" << half << endl;
+	cout << "Esperados: x0=0x2; [x6, #32]=0x1; [x6, #40]=0x2" << endl;
+	if ((cpu->getPC() != 0x40 + 4 * count) || (x0 != 2) || (byte != 1) || (half != 2)) {
+		cout << "Código automodificável FALHOU: instrução antiga executada!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
+	delete cpu;
+	delete memory;
 
-	cout << "ID() passou no teste de set do controle de MEM!" << endl << endl;
+	cout << "Código automodificável passou no teste!" << endl << endl;
+}
 
-	// verifica WBctrl
-	WBctrlFlag WBctrl = cpu->getWBctrl();
-	cout << "	WBctrl=0x" << WBctrl << "; Esperado WBctrl=0x"
-			<< xpctdWBctrl << endl;
-	if (WBctrl != xpctdWBctrl)
-	{
-		cout << "ID() FALHOU no set do controle de WB!" << endl;
+/**
+ * Testa o banco de registradores unificado: 'str wzr, [sp, 12]' escreve 0
+ * (e não SP) e 'add w1, w1, w0' escreve o resultado de 32 bits estendido
+ * com zeros em X1.
+ */
+void testRegisterFile(CPUTest* cpu, SimpleMemoryTest* memory)
+{
+	cout << "#\n#\n#\n# Testing register file...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	// 'str wzr, [sp, 12]'
+	cpu->setPC(0x44);
+	cpu->setSP(STARTSP);
+	memory->writeData32(STARTSP + 12, -1);
+	cpu->runIF();
+	cpu->runID();
+	cpu->runEXI();
+	cpu->runMEM();
+	cout << "	[sp, 12]=0x" << memory->readData32(STARTSP + 12)
+			<< ";  Esperado [sp, 12]=0x0" << endl;
+	if (memory->readData32(STARTSP + 12) != 0) {
+		cout << "Banco de registradores FALHOU: WZR não é zero!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
 
-	cout << "ID() passou no teste de set do controle de WB!" << endl << endl;
+	// 'add w1, w1, w0' com w1 = 0xFFFFFFFF e w0 = 2
+	cpu->setPC(0x68);
+	cpu->setX(1, -1);
+	cpu->setW(0, 2);
+	cpu->runIF();
+	cpu->runID();
+	cpu->runEXI();
+	cpu->runMEM();
+	cpu->runWB();
+	cout << "	X1=0x" << cpu->getRd() << ";  Esperado X1=0x1" << endl;
+	if (cpu->getRd() != 1) {
+		cout << "Banco de registradores FALHOU: Wd não foi estendido com zeros!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
 
-	cout << "ID() passou nos testes de set dos controles da ULA, MEM e WB!" << endl << endl;
+	cout << "Banco de registradores passou no teste!" << endl << endl;
 }
 
 /**
- * Testa o estágio EXI.
+ * Executa 'cmp w0, 9' e 'ble .L3' (0x88 e 0x8c) para vários valores de w0,
+ * inclusive negativos: o desvio para .L3 (0x4c) só é tomado se w0 <= 9.
  */
-void testEXI(BasicCPUTest* cpu, long xpctdALUout)
+void testConditionFlags(SimpleMemoryTest* memory)
 {
-	//
-	// Testa EXI (depende do sucesso no teste de ID)
-	//
-	cout << "Testando EXI..." << endl;
+	static const int values[] = {5, 9, 10, -1, (int)0x80000000};
 	
-	// executa
-	int exierror = cpu->runEXI();
-	if (exierror) {
-		cout << "Controle não implementado: 0x" << cpu->getALUctrl() << endl;
-		cout << "EXI() FALHOU!" << endl;
+	cout << "#\n#\n#\n# Testing condition flags...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	for (int w0 : values) {
+		long xpctdPC = (w0 <= 9) ? 0x4c : 0x90;
+		
+		CPUTest *cpu = new CPUTest(memory);
+		cpu->setW(0, w0);
+		cpu->setInstructionLimit(2);
+		int result = cpu->run(0x88);
+		cout << "	w0=0x" << w0 << "; result=" << result << "; PC=0x" << cpu->getPC()
+				<< ";  Esperados result=0; PC=0x" << xpctdPC << endl;
+		if ((result != 0) || (cpu->getPC() != xpctdPC)) {
+			cout << "Flags FALHOU!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+		delete cpu;
+	}
+
+	cout << "Flags passou no teste!" << endl << endl;
+}
+
+/**
+ * Executa um programa com ADDS, SUBS, CMN, CMP, CSEL e B.cond, de 32 e 64
+ * bits, e compara os resultados (escritos em 0x3000-0x304F por STP) com os
+ * de BasicCPU. Na JitCPU, B.cond e CSEL testam tanto flags de um SUBS do
+ * mesmo bloco quanto flags de antes do bloco ou de um ADDS.
+ */
+void testConditionalInstructions()
+{
+	cout << "#\n#\n#\n# Testing conditional instructions...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	static const unsigned int program[] = {
+		0x2B0B0141,		// loop: adds w1, w10, w11
+		0x9A9F61A2,		// csel x2, x13, xzr, vs
+		0x9A9F41A3,		// csel x3, x13, xzr, mi
+		0xAB0B0184,		// adds x4, x12, x11
+		0x9A9F81A5,		// csel x5, x13, xzr, hi
+		0x9A8B21A7,		// csel x7, x13, x11, cs
+		0x1A8D0188,		// csel w8, w12, w13, eq
+		0xA9000CC2,		// stp x2, x3, [x6]
+		0xA9011CC5,		// stp x5, x7, [x6, #16]
+		0xA90204C8,		// stp x8, x1, [x6, #32]
+		0xEB0C016E,		// subs x14, x11, x12
+		0x14000001,		// b next
+		0x54000043,		// next: b.lo taken1
+		0x91019129,		// add x9, x9, #100
+		0xB100057F,		// taken1: cmn x11, #1
+		0x54000043,		// b.lo taken2
+		0x910FA129,		// add x9, x9, #1000
+		0x6B0B019F,		// taken2: cmp w12, w11
+		0x9A9FB1AF,		// csel x15, x13, xzr, lt
+		0x9A9F81B0,		// csel x16, x13, xzr, hi
+		0x91000529,		// add x9, x9, #1
+		0xF1000D3F,		// cmp x9, #3
+		0x54FFFD4B,		// b.lt loop
+		0xA90338C9,		// stp x9, x14, [x6, #48]
+		0xA90440CF		// stp x15, x16, [x6, #64]
+	};
+	// x2, x3, x5, x7, x8, x1, x9, x14, x15 e x16
+	static const long xpctd[] = {5, 5, 0, 5, 0xFFFFFFFF, 0x80000000, 3, 2, 5, 5};
+	const int results = sizeof(xpctd) / sizeof(xpctd[0]);
+	int count = sizeof(program) / sizeof(program[0]);
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	long x[2][results];
+	for (int c = 0; c < 2; c++) {
+		for (int i = 0; i < count; i++) {
+			memory->writeData32(0x40 + 4*i, program[i]);
+		}
+		BasicCPU *cpu = c ? (BasicCPU*)new CPUTest(memory) : new BasicCPU(memory);
+		cpu->setStackPointer(0x1000);
+		cpu->setRegister(6, 0x3000);
+		cpu->setRegister(10, 0x7FFFFFFF);
+		cpu->setRegister(11, 1);
+		cpu->setRegister(12, -1);
+		cpu->setRegister(13, 5);
+		cpu->run(0x40);
+		for (int i = 0; i < results; i++) {
+			x[c][i] = memory->readData64(0x3000 + 8*i);
+			memory->writeData64(0x3000 + 8*i, 0);
+		}
+		delete cpu;
+	}
+	delete memory;
+
+	for (int i = 0; i < results; i++) {
+		cout << "	[0x" << 0x3000 + 8*i << "] BasicCPU=0x" << x[0][i]
+				<< "; CPUTest=0x" << x[1][i] << ";  Esperado 0x" << xpctd[i] << endl;
+		if ((x[0][i] != xpctd[i]) || (x[1][i] != xpctd[i])) {
+			cout << "Instruções condicionais FALHOU!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+	}
+
+	cout << "Instruções condicionais passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa PagedMemory: endereços esparsos em todo o espaço de 64 bits (uma
+ * página alocada por endereço distinto), leitura de página nunca escrita
+ * (0, sem alocação) e execução de run() com a pilha em um endereço alto.
+ */
+void testPagedMemory()
+{
+	// 0x0 e 0xFF8 estão na mesma página; 0x0-0x2FFF compartilham as
+	// tabelas (raiz + 3), 0x123456789000 compartilha só a raiz (+ 2) e o
+	// topo não compartilha nada (+ 3)
+	static const unsigned long addresses[] = {
+		0x0, 0xFF8, 0x1000, 0x123456789000, 0xFFFFFFFFFFFFFFF8
+	};
+	
+	cout << "#\n#\n#\n# Testing PagedMemory...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	PagedMemory *paged = new PagedMemory(MEMORY_SIZE);
+	if ((paged->readData64(0x7FFF00000000) != 0) || (paged->getPagesAllocated() != 0)) {
+		cout << "PagedMemory FALHOU: leitura de página nunca escrita!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
 	
-	// verifica ALUout
-	long ALUout = cpu->getALUout();
-	cout << "	ALUout=0x"
-			<< setfill('0') << setw(8) << ALUout
-			<< "; Esperado ALUout=0x"
-			<< setfill('0') << setw(8) << xpctdALUout << endl;
-	if (ALUout != xpctdALUout)
-	{
-		cout << "EXI() FALHOU!" << endl;
+	for (unsigned long address : addresses) {
+		paged->writeData64(address, address ^ 0x5A5A5A5A5A5A5A5A);
+	}
+	paged->writeData32(0x2004, -2);
+	for (unsigned long address : addresses) {
+		if ((unsigned long)paged->readData64(address) != (address ^ 0x5A5A5A5A5A5A5A5A)) {
+			cout << "PagedMemory FALHOU no endereço 0x" << address << "!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+	}
+	cout << "	páginas=" << paged->getPagesAllocated()
+			<< "; tabelas=" << paged->getTablesAllocated()
+			<< ";  Esperados páginas=5; tabelas=9" << endl;
+	if ((paged->readData32(0x2004) != -2) || (paged->readData64(0x2000) != (long)0xFFFFFFFE00000000UL)
+			|| (paged->getPagesAllocated() != 5) || (paged->getTablesAllocated() != 9)) {
+		cout << "PagedMemory FALHOU!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
+	delete paged;
 	
-	cout << "EXI() passou no teste!" << endl;
+	// isummation.o com a pilha próxima do topo do espaço de 48 bits
+	paged = new PagedMemory(MEMORY_SIZE);
+	paged->loadBinary(FILENAME);
+	CPUTest *cpu = new CPUTest(paged);
+	cpu->setSP(0x7FFFFFFFF000);
+	int result = cpu->run(0x40);
+	cout << "	result=" << result << "; PC=0x" << cpu->getPC()
+			<< "; instructions=" << cpu->getInstructionCount() << endl;
+	cout << "Esperados: result=1; PC=0x4c; instructions=6" << endl;
+	if ((result != 1) || (cpu->getPC() != 0x4c)
+			|| (cpu->getInstructionCount() != 6)
+			|| (paged->findPage(0x7FFFFFFFF000 - 16) == nullptr)) {
+		cout << "PagedMemory FALHOU em run()!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete paged;
+
+	cout << "PagedMemory passou no teste!" << endl << endl;
 }
 
 /**
- * Testa o estágio MEM - NAO IMPLEMENTADO.
+ * Testa TLBMemory: acertos e faltas nas TLBs de instruções e de dados,
+ * invalidação das entradas quando a página é liberada e execução de run()
+ * com os mesmos resultados de SimpleMemory.
  */
-void testMEM(BasicCPUTest* cpu,
-				SimpleMemoryTest* memory,
-				MEMctrlFlag xpctdMEMctrl,
-				long xpctdALUout)
+void testTLBMemory()
 {
-	//
-	// Test MEM (depends on the success of previous stages)
-	//
-	cout << "Testing MEM..." << endl;
+	cout << "#\n#\n#\n# Testing TLBMemory...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	TLBMemory *tlb = new TLBMemory(MEMORY_SIZE);
 	
-	// executa
-	int memerror = cpu->runMEM();
-	if (memerror) {
-		cout << "Controle não implementado: 0x" << cpu->getMEMctrl() << endl;
-		cout << "MEM() FALHOU!" << endl;
+	// leitura de página nunca escrita: falta, sem alocação
+	tlb->readData32(0x5000);
+	// escrita: falta; escrita e leituras seguintes na mesma página: acertos
+	tlb->writeData64(0x5008, 0x1122334455667788);
+	tlb->writeData32(0x5ffc, 7);
+	tlb->readData64(0x5008);
+	tlb->readData32(0x5ffc);
+	// página que disputa a mesma entrada (mapeamento direto): falta
+	tlb->writeData32(0x5000 + TLB_ENTRIES * GUEST_PAGE_SIZE, 1);
+	tlb->readData32(0x5ffc);
+	cout << "	dtlb: hits=" << tlb->getDTLBHits() << "; misses=" << tlb->getDTLBMisses()
+			<< ";  Esperados hits=3; misses=4" << endl;
+	if ((tlb->getDTLBHits() != 3) || (tlb->getDTLBMisses() != 4)
+			|| (tlb->readData64(0x5008) != 0x1122334455667788)
+			|| (tlb->readData32(0x5ffc) != 7) || (tlb->getPagesAllocated() != 2)) {
+		cout << "TLBMemory FALHOU na TLB de dados!" << endl;
 		cout << "Saindo..." << endl;
 		exit(1);
 	}
-		
-	//
-	// Test access type
-	//
 	
-	// map MEMctrlFlag to SimpleMemoryTest::MemAccessType
-	SimpleMemoryTest::MemAccessType xpctdLastDataMemAccess;
-	switch (xpctdMEMctrl) {
-		case MEMctrlFlag::MEM_NONE:
-			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_NONE;
-			break;
-		case MEMctrlFlag::READ32:
-			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ32;
-			break;
-		case MEMctrlFlag::READ64:
-			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ64;
-			break;
-		case MEMctrlFlag::WRITE32:
-			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE32;
-			break;
-		case MEMctrlFlag::WRITE64:
-			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE64;
-			break;
+	// a página liberada não pode mais ser acessada pela TLB
+	tlb->unmapPage(0x5000);
+	if ((tlb->readData32(0x5ffc) != 0) || (tlb->getPagesAllocated() != 1)) {
+		cout << "TLBMemory FALHOU: entrada não invalidada em unmapPage()!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
 	}
-
-	SimpleMemoryTest::MemAccessType lastDataMemAccess =
-			memory->getLastDataMemAccess();
-	cout << "	Testing MEM access type..." << endl;
-	cout << "		Expected access type: "
-			<< xpctdLastDataMemAccess << endl;
-	cout << "		Executed access type: "
-			<< lastDataMemAccess << endl;
-	if (xpctdLastDataMemAccess != lastDataMemAccess) {
-		// incorrect memory access type
-		cout << "MEM() FAILED!" << endl;
-		cout << "Exit..." << endl;
+	delete tlb;
+	
+	// isummation.o: mesmos resultados de SimpleMemory, com as instruções
+	// buscadas pela TLB de instruções
+	tlb = new TLBMemory(MEMORY_SIZE);
+	tlb->loadBinary(FILENAME);
+	CPUTest *cpu = new CPUTest(tlb);
+	int result = cpu->run(0x40);
+	cout << "	result=" << result << "; PC=0x" << cpu->getPC()
+			<< "; instructions=" << cpu->getInstructionCount()
+			<< "; itlb: hits=" << tlb->getITLBHits()
+			<< "; misses=" << tlb->getITLBMisses() << endl;
+	cout << "Esperados: result=1; PC=0x4c; instructions=6; itlb: misses=1" << endl;
+	if ((result != 1) || (cpu->getPC() != 0x4c)
+			|| (cpu->getInstructionCount() != 6) || (tlb->getITLBMisses() != 1)) {
+		cout << "TLBMemory FALHOU em run()!" << endl;
+		cout << "Saindo..." << endl;
 		exit(1);
-	} else {
-		cout << "	MEM() executed the correct access type!" << endl;
 	}
+	delete cpu;
+	delete tlb;
 
-	//
-	// Test content
-	//
+	cout << "TLBMemory passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa loadBinary com um binário maior que 64 KiB (o tamanho do arquivo
+ * era truncado em 16 bits): SimpleMemory e PagedMemory leem o arquivo
+ * inteiro, escritas em uma instância não aparecem em outra nem no arquivo
+ * (MAP_PRIVATE) e PagedMemory não aloca páginas para o arquivo.
+ */
+#define LARGE_BINARY "runtest_large.bin"
+#define LARGE_BINARY_SIZE 0x18000
+void testLoadBinary()
+{
+	cout << "#\n#\n#\n# Testing loadBinary()...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	// cada palavra do arquivo guarda o próprio endereço
+	ofstream ofp(LARGE_BINARY, ios::out|ios::binary);
+	for (unsigned int address = 0; address < LARGE_BINARY_SIZE; address += 4) {
+		ofp.write((char*)&address, 4);
+	}
+	ofp.close();
+
+	SimpleMemory *simple = new SimpleMemory(2 * LARGE_BINARY_SIZE);
+	PagedMemory *paged = new PagedMemory(MEMORY_SIZE);
+	PagedMemory *other = new PagedMemory(MEMORY_SIZE);
+	simple->loadBinary(LARGE_BINARY);
+	paged->loadBinary(LARGE_BINARY);
+	other->loadBinary(LARGE_BINARY);
+	simple->writeData32(0x10000, -1);
+	paged->writeData32(0x10000, -1);
 	
-	// no memory access -> success
-	if (xpctdMEMctrl == MEMctrlFlag::MEM_NONE) {
-		cout << "	No content to be tested!" << endl;
-		cout << "MEM() test: SUCCESS!" << endl;
-		return;
+	for (unsigned int address = 0x4; address < LARGE_BINARY_SIZE; address += 0x7FFC) {
+		if ((simple->readData32(address) != (int)address)
+				|| (paged->readData32(address) != (int)address)) {
+			cout << "loadBinary FALHOU no endereço 0x" << address << "!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
 	}
+	cout << "	[0x10000]: simple=0x" << simple->readData32(0x10000)
+			<< "; paged=0x" << paged->readData32(0x10000)
+			<< "; other=0x" << other->readData32(0x10000)
+			<< "; [fim do arquivo]=0x" << simple->readData32(LARGE_BINARY_SIZE) << endl;
+	cout << "	páginas: mapeadas=0x" << paged->getFilePages()
+			<< "; alocadas=0x" << paged->getPagesAllocated() << endl;
+	if ((simple->readData32(0x10000) != -1) || (paged->readData32(0x10000) != -1)
+			|| (other->readData32(0x10000) != 0x10000)
+			|| (simple->readData32(LARGE_BINARY_SIZE) != 0)
+			|| (paged->getFilePages() != LARGE_BINARY_SIZE / GUEST_PAGE_SIZE)
+			|| (paged->getPagesAllocated() != 0)) {
+		cout << "loadBinary FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete simple;
+	delete paged;
+	delete other;
 	
-	// get read or written content (access depends on 32 or 64 bit mode)
-	long memData, xpctdMemData;
-	switch (xpctdMEMctrl) {
-		case MEMctrlFlag::READ32:
-			cout << "	READ Mode: testing read content..." << endl;
-			memData = (long)memory->readData32(xpctdALUout);
-			xpctdMemData = cpu->getMDR();
-			break;
-		case MEMctrlFlag::READ64:
-			cout << "	READ Mode: testing read content..." << endl;
-			memData = memory->readData64(xpctdALUout);
+	// o arquivo não foi alterado
+	unsigned int word = 0;
+	ifstream ifp(LARGE_BINARY, ios::in|ios::binary);
+	ifp.seekg(0x10000);
+	ifp.read((char*)&word, 4);
+	ifp.close();
+	remove(LARGE_BINARY);
+	if (word != 0x10000) {
+		cout << "loadBinary FALHOU: escrita alterou o arquivo!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "loadBinary passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa o carregador ELF com isummation.o: .text fica em 0x40 (posição no
+ * arquivo), .data (v) em 0xa0 e .bss (summ) logo após o fim do arquivo
+ * (0x570); as realocações ADR_PREL_PG_HI21 e ADD_ABS_LO12_NC de v e summ
+ * são aplicadas e 'main' é o ponto de entrada. A segunda carga vem da
+ * cache.
+ */
+void testElfLoader()
+{
+	cout << "#\n#\n#\n# Testing ElfLoader...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	ElfLoader *loader = new ElfLoader(FILENAME);
+	const ElfSymbol *v, *summ;
+	const ElfSection *text;
+	if (loader->load() || !(v = loader->findSymbol("v"))
+			|| !(summ = loader->findSymbol("summ"))
+			|| !(text = loader->findSection(".text"))) {
+		cout << "ElfLoader FALHOU na carga!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	cout << "	main=0x" << loader->getEntryPoint() << "; .text=0x" << text->address
+			<< "; v=0x" << v->address << "; summ=0x" << summ->address
+			<< "; imagem=0x" << loader->getImageSize() << endl;
+	cout << "Esperados: main=0x40; .text=0x40; v=0xa0; summ=0x570; imagem=0x574" << endl;
+	if ((loader->getEntryPoint() != 0x40) || (text->address != 0x40)
+			|| (text->size != 0x5c) || (v->address != 0xa0) || (v->size != 40)
+			|| (summ->address != 0x570) || (loader->getImageSize() != 0x574)) {
+		cout << "ElfLoader FALHOU no leiaute!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// 'adrp x0, v' continua na página 0; os 'add' recebem o deslocamento
+	// de v e summ na página
+	SimpleMemory *image = new SimpleMemory(MEMORY_SIZE);
+	image->loadBinary(loader->getImageFile());
+	cout << "	[0x4c]=0x" << image->readInstruction32(0x4c)
+			<< "; [0x50]=0x" << image->readInstruction32(0x50)
+			<< "; [0x60]=0x" << image->readInstruction32(0x60)
+			<< "; [0x70]=0x" << image->readInstruction32(0x70) << endl;
+	if ((image->readInstruction32(0x4c) != 0x90000000)
+			|| (image->readInstruction32(0x50) != 0x91028000)
+			|| (image->readInstruction32(0x60) != 0x9115C000)
+			|| (image->readInstruction32(0x70) != 0x9115C000)
+			|| (image->readData32(0xa0) != 5) || (image->readData32(0xc4) != 8)
+			|| (image->readData32(0x570) != 0)) {
+		cout << "ElfLoader FALHOU nas realocações!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete image;
+
+	ElfLoader *again = new ElfLoader(FILENAME);
+	if (again->load() || !again->isCached() || (again->getRelocations() != 0)
+			|| (again->getEntryPoint() != loader->getEntryPoint())
+			|| (again->getImageFile() != loader->getImageFile())
+			|| !again->findSymbol("summ")
+			|| (again->findSymbol("summ")->address != summ->address)) {
+		cout << "ElfLoader FALHOU na cache!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete again;
+	delete loader;
+
+	cout << "ElfLoader passou no teste!" << endl << endl;
+}
+
+/**
+ * Executa a partir de startAddress, com x0 = x0, a instrução de acesso à
+ * memória em startAddress, que deve terminar a execução com DATA_ABORT no
+ * endereço x0, sem executar nenhuma instrução.
+ */
+void testDataAbort(SimpleMemory *memory, string instruction,
+		long startAddress, unsigned long x0)
+{
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setX(0, x0);
+	cpu->setW(1, 0x77);
+	int result = cpu->run(startAddress);
+	cout << "	" << instruction << " com x0=0x" << x0 << ": result=" << result
+			<< "; erro=" << cpu->getError() << "; endereço=0x"
+			<< cpu->getDataAbortAddress() << "; PC=0x" << cpu->getPC()
+			<< "; instructions=" << cpu->getInstructionCount() << endl;
+	if ((result != 1) || (cpu->getError() != CPU::CPUerrorCode::DATA_ABORT)
+			|| (cpu->getDataAbortAddress() != x0)
+			|| (cpu->getPC() != startAddress)
+			|| (cpu->getInstructionCount() != 0)) {
+		cout << "Páginas de guarda FALHARAM!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+}
+
+/**
+ * Testa as páginas de guarda de SimpleMemory: 'ldr w0, [x0]' (0x64) além
+ * do fim da memória e 'str w1, [x0]' (0x74) antes do início terminam com
+ * DATA_ABORT, sem alterar a memória, e uma execução seguinte é normal.
+ */
+void testGuardPages()
+{
+	cout << "#\n#\n#\n# Testing guard pages...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	memory->loadBinary(FILENAME);
+
+	testDataAbort(memory, "ldr w0, [x0]", 0x64, MEMORY_SIZE + 0x1000);
+	testDataAbort(memory, "str w1, [x0]", 0x74, -16);
+	testDataAbort(memory, "ldr w0, [x0]", 0x64, 0xFFFFFFF0);
+
+	// a armadilha foi desarmada: a execução termina em 'adrp x0, v'
+	CPUTest *cpu = new CPUTest(memory);
+	int result = cpu->run(0x40);
+	cout << "	result=" << result << "; PC=0x" << cpu->getPC()
+			<< "; instructions=" << cpu->getInstructionCount() << endl;
+	cout << "Esperados: result=1; PC=0x4c; instructions=6" << endl;
+	if ((result != 1) || (cpu->getError() != CPU::CPUerrorCode::ID_ERROR)
+			|| (cpu->getPC() != 0x4c) || (cpu->getInstructionCount() != 6)
+			|| (memory->readInstruction32(0x40) != 0xD10043FF)) {
+		cout << "Páginas de guarda FALHARAM após o DATA_ABORT!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+
+	cout << "Páginas de guarda passaram no teste!" << endl << endl;
+}
+
+/**
+ * Compara as estatísticas stats do nível name com as esperadas.
+ */
+void testCacheStats(string name, CacheStats stats, CacheStats xpctd)
+{
+	cout << "	" << name << ": leituras=" << stats.reads << "; escritas=" << stats.writes
+			<< "; acertos=" << stats.hits << "; faltas=" << stats.misses
+			<< "; despejos=" << stats.evictions << "; write-backs=" << stats.writebacks << endl;
+	if ((stats.reads != xpctd.reads) || (stats.writes != xpctd.writes)
+			|| (stats.hits != xpctd.hits) || (stats.misses != xpctd.misses)
+			|| (stats.evictions != xpctd.evictions)
+			|| (stats.writebacks != xpctd.writebacks)) {
+		cout << "Esperados: leituras=" << xpctd.reads << "; escritas=" << xpctd.writes
+				<< "; acertos=" << xpctd.hits << "; faltas=" << xpctd.misses
+				<< "; despejos=" << xpctd.evictions
+				<< "; write-backs=" << xpctd.writebacks << endl;
+		cout << "CachedMemory FALHOU no nível " << name << "!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+}
+
+/**
+ * Testa CachedMemory com uma L1D de 2 vias LRU e 8 conjuntos de linhas de
+ * 16 bytes (0x0, 0x80 e 0x100 caem no conjunto 0):
+ *	ler 0x0 (falta), ler 0x4 (acerto), escrever 0x80 (falta, aloca suja),
+ *	ler 0x100 (falta, despeja 0x0), ler 0x0 (falta, despeja 0x80 suja,
+ *	que é escrita na L2).
+ * Depois, com a L1D WRITE_THROUGH, escrever 0x40 (segue para a L2 sem
+ * alocar) e ler 0x40 (falta na L1D, acerto na L2).
+ */
+void testCachedMemory()
+{
+	cout << "#\n#\n#\n# Testing CachedMemory...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	CacheConfig l1 = {256, 2, 16, CacheReplacement::LRU, CacheWritePolicy::WRITE_BACK};
+	CacheConfig l2 = {1024, 4, 16, CacheReplacement::PLRU, CacheWritePolicy::WRITE_BACK};
+	CachedMemory *cached = new CachedMemory(new SimpleMemory(MEMORY_SIZE), l1, l1, l2);
+
+	cached->readData32(0x0);
+	cached->readData32(0x4);
+	cached->writeData32(0x80, 0x1234);
+	cached->readData32(0x100);
+	cached->readData32(0x0);
+	cached->readInstruction32(0x40);
+	cached->readInstruction32(0x44);
+	testCacheStats("L1D", cached->getLevel(CachedMemory::L1D)->getStats(), {4, 1, 1, 4, 2, 1});
+	testCacheStats("L1I", cached->getLevel(CachedMemory::L1I)->getStats(), {2, 0, 1, 1, 0, 0});
+	testCacheStats("L2", cached->getLevel(CachedMemory::L2)->getStats(), {5, 1, 2, 4, 0, 0});
+	if ((cached->getMemoryReads() != 4) || (cached->getMemoryWrites() != 0)
+			|| (cached->readData32(0x80) != 0x1234)) {
+		cout << "CachedMemory FALHOU na memória!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cached;
+
+	CacheConfig wt = {256, 2, 16, CacheReplacement::RANDOM, CacheWritePolicy::WRITE_THROUGH};
+	cached = new CachedMemory(new SimpleMemory(MEMORY_SIZE), l1, wt, l2);
+	cached->writeData32(0x40, 0x77);
+	cached->readData32(0x40);
+	testCacheStats("L1D (WT)", cached->getLevel(CachedMemory::L1D)->getStats(), {1, 1, 0, 2, 0, 1});
+	testCacheStats("L2 (WT)", cached->getLevel(CachedMemory::L2)->getStats(), {1, 1, 1, 1, 0, 0});
+	if (cached->readData32(0x40) != 0x77) {
+		cout << "CachedMemory FALHOU na memória!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cached;
+
+	cout << "CachedMemory passou no teste!" << endl << endl;
+}
+
+/**
+ * Compara os erros de cada preditor do monitor com os esperados.
+ */
+void testMispredictions(string name, BranchMonitor *monitor, vector<unsigned long> xpctd)
+{
+	cout << "	" << name << ":";
+	for (int p = 0; p < monitor->getPredictorCount(); p++) {
+		cout << " " << monitor->getPredictor(p)->getName() << "="
+				<< monitor->getMispredictions(p);
+	}
+	cout << endl;
+	for (int p = 0; p < monitor->getPredictorCount(); p++) {
+		if (monitor->getMispredictions(p) != xpctd[p]) {
+			cout << "Esperado: " << monitor->getPredictor(p)->getName()
+					<< "=" << xpctd[p] << endl;
+			cout << "Preditores de desvios FALHARAM em " << name << "!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+	}
+}
+
+/**
+ * Testa os preditores de desvios:
+ *	- laço de 10 iterações (9 tomados e 1 não tomado) executado 100 vezes:
+ *	  bimodal (e o contador da BTB) erra a primeira vez e uma vez por
+ *	  execução do laço; gshare e TAGE só erram enquanto aprendem o padrão
+ *	  pelo histórico;
+ *	- chamadas alternadas de 0x200 e 0x300 para a mesma função: a BTB
+ *	  erra as duas primeiras chamadas e todos os retornos, já que o
+ *	  destino do retorno alterna e não há pilha de endereços de retorno;
+ *	- run() do programa, que retira 'b .L2' (0x48) e 'ble .L3' (0x8c),
+ *	  ambos tomados e inéditos.
+ */
+void testBranchPredictors()
+{
+	cout << "#\n#\n#\n# Testing branch predictors...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	BranchMonitor *monitor = new BranchMonitor();
+	monitor->addPredictors(BRANCH_ALL_PREDICTORS);
+	for (int n = 0; n < 100; n++) {
+		for (int i = 0; i < 10; i++) {
+			bool taken = (i < 9);
+			monitor->retire(0x100, taken ? 0xF0 : 0x104, BRANCH_CONDITIONAL, taken);
+		}
+	}
+	testMispredictions("laço", monitor, {101, 21, 4, 101});
+
+	monitor->reset();
+	for (int n = 0; n < 50; n++) {
+		uint64_t call = (n % 2) ? 0x300 : 0x200;
+		monitor->retire(call, 0x1000, BRANCH_CALL, true);
+		monitor->retire(0x1010, call + 4, BRANCH_RETURN, true);
+	}
+	testMispredictions("chamadas", monitor, {0, 0, 0, 52});
+	delete monitor;
+
+	monitor = new BranchMonitor();
+	monitor->addPredictors("bimodal,btb");
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	memory->loadBinary(FILENAME);
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setBranchMonitor(monitor);
+	cpu->run(0x40);
+	vector<BranchSite> sites = monitor->getSites();
+	testMispredictions("run()", monitor, {1, 2});
+	if ((monitor->getBranches() != 2) || (sites.size() != 2)
+			|| (sites[0].PC != 0x48) || (sites[0].kind != BRANCH_DIRECT)
+			|| (sites[1].PC != 0x8c) || (sites[1].kind != BRANCH_CONDITIONAL)
+			|| (sites[1].taken != 1)) {
+		cout << "Preditores de desvios FALHARAM: desvios retirados por run()!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	monitor->printReport(cout, cpu->getInstructionCount());
+	delete cpu;
+	delete memory;
+	delete monitor;
+
+	cout << "Preditores de desvios passaram no teste!" << endl << endl;
+}
+
+/**
+ * Acessos sintéticos dos testes do registro: um laço de buscas
+ * sequenciais, leituras da pilha, escritas espalhadas (inclusive em
+ * endereços de 64 bits), acessos de 1 e 2 bytes e acessos largos (pares
+ * de 16 bytes e blocos de 64 a 263 bytes).
+ */
+#define TRACE_TEST_FILE "runtest_trace.bin"
+#define TRACE_TEST_ACCESSES 300000
+vector<TraceRecord> traceTestAccesses()
+{
+	vector<TraceRecord> accesses;
+	uint64_t random = 1;
+	for (int i = 0; accesses.size() < TRACE_TEST_ACCESSES; i++) {
+		accesses.push_back({TRACE_READ_INSTRUCTION, 4, 0x40 + 4 * (uint64_t)(i % 24)});
+		if (i % 3 == 0) {
+			accesses.push_back({TRACE_READ_DATA, 8, 0xfff0 - 8 * (uint64_t)(i % 4)});
+		}
+		if (i % 7 == 0) {
+			random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+			accesses.push_back({TRACE_WRITE_DATA, 4, random & ~3ULL});
+		}
+		if (i % 11 == 0) {
+			accesses.push_back({TRACE_READ_DATA, 1, 0x1000 + (uint64_t)i});
+			accesses.push_back({TRACE_WRITE_DATA, 2, 0x2000 + 2 * (uint64_t)i});
+		}
+		if (i % 13 == 0) {
+			accesses.push_back({TRACE_WRITE_DATA, 16, 0xffe0 - 16 * (uint64_t)(i % 2)});
+			accesses.push_back({TRACE_READ_DATA, 64 + i % 200, 0x4000 + (uint64_t)i});
+		}
+	}
+	return accesses;
+}
+
+/**
+ * Escreve os acessos em traceFile e os relê, comparando com os escritos.
+ *
+ * Retorna o tamanho do arquivo em bytes.
+ */
+unsigned long testTraceRoundTrip(string traceFile, bool compress, vector<TraceRecord> &accesses)
+{
+	TraceWriter *writer = new TraceWriter(traceFile, compress);
+	for (TraceRecord &access : accesses) {
+		writer->record(access.op, access.size, access.address);
+	}
+	writer->close();
+	unsigned long bytes = writer->getBytesWritten();
+	if (writer->getRecords() != accesses.size()) {
+		cout << "MemoryTrace FALHOU na escrita!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete writer;
+
+	TraceReader reader(traceFile);
+	TraceRecord record;
+	unsigned long n = 0;
+	while (!reader.next(&record)) {
+		if ((n >= accesses.size()) || (record.op != accesses[n].op)
+				|| (record.size != accesses[n].size)
+				|| (record.address != accesses[n].address)) {
+			cout << "MemoryTrace FALHOU no acesso " << n << "!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+		n++;
+	}
+	if (reader.hasError() || (n != accesses.size())) {
+		cout << "MemoryTrace FALHOU: " << n << " de " << accesses.size()
+				<< " acessos lidos!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	cout << "	" << (compress ? "comprimido" : "sem compressão") << ": "
+			<< bytes << " bytes (" << fixed << setprecision(2)
+			<< (double)bytes / accesses.size() << " bytes/acesso)" << endl;
+	return bytes;
+}
+
+/**
+ * Testa o registro binário de acessos à memória com os acessos de
+ * traceTestAccesses(), em vários blocos:
+ *	- escrita e leitura com e sem compressão;
+ *	- conversão para o texto de SimpleMemoryTest ("ri 0000000000000040");
+ *	- registro corrompido é detectado.
+ */
+#define TRACE_TEST_TEXT "runtest_trace.txt"
+void testMemoryTrace()
+{
+	cout << "#\n#\n#\n# Testing MemoryTrace...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	vector<TraceRecord> accesses = traceTestAccesses();
+
+	unsigned long raw = testTraceRoundTrip(TRACE_TEST_FILE, false, accesses);
+	unsigned long compressed = testTraceRoundTrip(TRACE_TEST_FILE, true, accesses);
+	if ((raw < 2 * TRACE_BLOCK_SIZE) || (compressed >= raw)) {
+		cout << "MemoryTrace FALHOU: esperados vários blocos e compressão!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// texto: mesmo formato de SimpleMemoryTest antes do registro binário
+	if (traceToText(TRACE_TEST_FILE, TRACE_TEST_TEXT)) {
+		cout << "MemoryTrace FALHOU na conversão para texto!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	static const char *opName[] = {"ri ", "rd ", "wd "};
+	ifstream text(TRACE_TEST_TEXT);
+	string line;
+	unsigned long n = 0;
+	while (getline(text, line)) {
+		ostringstream xpctd;
+		if (n < accesses.size()) {
+			xpctd << hex << opName[accesses[n].op] << setfill('0') << setw(16)
+					<< accesses[n].address;
+		}
+		if (line != xpctd.str()) {
+			cout << "Linha " << n << ": " << line << endl;
+			cout << "Esperado: " << xpctd.str() << endl;
+			cout << "MemoryTrace FALHOU na conversão para texto!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		}
+		n++;
+	}
+	text.close();
+	remove(TRACE_TEST_TEXT);
+	if (n != accesses.size()) {
+		cout << "MemoryTrace FALHOU: texto com " << n << " linhas!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// corrompe um byte no meio do registro
+	fstream file(TRACE_TEST_FILE, ios::in | ios::out | ios::binary);
+	file.seekg(compressed / 2);
+	char byte = file.get();
+	file.seekp(compressed / 2);
+	file.put(byte ^ 0x5A);
+	file.close();
+	TraceReader reader(TRACE_TEST_FILE);
+	TraceRecord record;
+	n = 0;
+	while (!reader.next(&record)) {
+		n++;
+	}
+	remove(TRACE_TEST_FILE);
+	cout << "	corrompido: " << n << " acessos lidos antes do erro" << endl;
+	if (!reader.hasError() || (n >= accesses.size())) {
+		cout << "MemoryTrace FALHOU: registro corrompido não detectado!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "MemoryTrace passou no teste!" << endl << endl;
+}
+
+/**
+ * Lê traceFile e retorna quantos acessos lidos formam, em ordem, uma
+ * subsequência de accesses (todos, se nenhum foi descartado), ou -1 se a
+ * leitura falhar ou algum acesso lido não estiver em accesses.
+ */
+long readTraceSubsequence(string traceFile, vector<TraceRecord> &accesses)
+{
+	TraceReader reader(traceFile);
+	TraceRecord record;
+	unsigned long n = 0;
+	long matched = 0;
+	while (!reader.next(&record)) {
+		while ((n < accesses.size()) && ((record.op != accesses[n].op)
+				|| (record.size != accesses[n].size)
+				|| (record.address != accesses[n].address))) {
+			n++;
+		}
+		if (n == accesses.size()) {
+			return -1;
+		}
+		n++;
+		matched++;
+	}
+	return reader.hasError() ? -1 : matched;
+}
+
+/**
+ * Testa AsyncTraceWriter com os acessos de traceTestAccesses() e um anel
+ * pequeno, que enche:
+ *	- TRACE_BLOCK: nenhum acesso se perde e flush() no meio deixa o
+ *	  arquivo legível até ali;
+ *	- TRACE_DROP: os acessos aceitos e os descartados somam o total, e os
+ *	  aceitos estão no arquivo, em ordem.
+ */
+void testAsyncTrace()
+{
+	cout << "#\n#\n#\n# Testing AsyncTraceWriter...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	vector<TraceRecord> accesses = traceTestAccesses();
+	unsigned long half = accesses.size() / 2;
+
+	AsyncTraceWriter *writer = new AsyncTraceWriter(TRACE_TEST_FILE, {64, TRACE_BLOCK, true});
+	for (unsigned long i = 0; i < half; i++) {
+		writer->record(accesses[i].op, accesses[i].size, accesses[i].address);
+	}
+	writer->flush();
+	long flushed = readTraceSubsequence(TRACE_TEST_FILE, accesses);
+	for (unsigned long i = half; i < accesses.size(); i++) {
+		writer->record(accesses[i].op, accesses[i].size, accesses[i].address);
+	}
+	writer->close();
+	long all = readTraceSubsequence(TRACE_TEST_FILE, accesses);
+	cout << "	TRACE_BLOCK: registros=" << writer->getRecords()
+			<< "; esperas=" << writer->getStalls()
+			<< "; após flush()=" << flushed << "; lidos=" << all << endl;
+	if ((writer->getRecords() != accesses.size()) || (writer->getDropped() != 0)
+			|| (flushed != (long)half) || (all != (long)accesses.size())) {
+		cout << "AsyncTraceWriter FALHOU com TRACE_BLOCK!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete writer;
+
+	writer = new AsyncTraceWriter(TRACE_TEST_FILE, {64, TRACE_DROP, false});
+	for (TraceRecord &access : accesses) {
+		writer->record(access.op, access.size, access.address);
+	}
+	writer->close();
+	all = readTraceSubsequence(TRACE_TEST_FILE, accesses);
+	remove(TRACE_TEST_FILE);
+	cout << "	TRACE_DROP: registros=" << writer->getRecords()
+			<< "; descartados=" << writer->getDropped() << "; lidos=" << all << endl;
+	if ((writer->getRecords() + writer->getDropped() != accesses.size())
+			|| (writer->getStalls() != 0) || (all != (long)writer->getRecords())) {
+		cout << "AsyncTraceWriter FALHOU com TRACE_DROP!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete writer;
+
+	cout << "AsyncTraceWriter passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa os contadores de desempenho com run() do programa a partir de 0x40:
+ * 'sub sp', 'str wzr', 'b .L2', 'ldr w0', 'cmp w0, 9' e 'ble .L3' (tomado)
+ * são retirados e 'adrp' termina com ID_ERROR. Com NO_STATS, tudo fica
+ * em 0.
+ */
+void testPerfCounters()
+{
+	cout << "#\n#\n#\n# Testing PerfCounters...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	memory->loadBinary(FILENAME);
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->run(0x40);
+	PerfCounters *perf = cpu->getPerfCounters();
+	ostringstream json;
+	perf->writeJSON(json);
+	cout << "	" << json.str() << endl;
+
+	unsigned long n = PERF_ENABLED ? 1 : 0;
+	if ((perf->getInstructions() != 6 * n)
+			|| (perf->groups[PERF_GROUP_DP_IMM] != 2 * n)
+			|| (perf->groups[PERF_GROUP_BRANCH] != 2 * n)
+			|| (perf->groups[PERF_GROUP_LOADSTORE] != 2 * n)
+			|| (perf->loads[PERF_WIDTH_32] != n) || (perf->stores[PERF_WIDTH_32] != n)
+			|| (perf->loads[PERF_WIDTH_64] != 0) || (perf->stores[PERF_WIDTH_64] != 0)
+			|| (perf->branches != 2 * n) || (perf->takenBranches != 2 * n)
+			|| (perf->stageErrors[CPU::CPUerrorCode::ID_ERROR] != n)
+			|| (json.str().find("\"instructions\": " + to_string(6 * n) + ",") != 1)) {
+		cout << "PerfCounters FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// o erro é contado uma vez, mesmo que a CPU seja executada de novo
+	cpu->runQuantum(0);
+	PerfCounters total;
+	total += *perf;
+	total += *perf;
+	if ((perf->stageErrors[CPU::CPUerrorCode::ID_ERROR] != n)
+			|| (total.getInstructions() != 12 * n) || (total.branches != 4 * n)) {
+		cout << "PerfCounters FALHOU na soma ou na contagem de erros!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+
+	cout << "PerfCounters passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa os contadores de desempenho de um laço com três blocos ligados
+ * diretamente, C (0x40) -> A (0x80) -> B (0x1080) -> C, comparando-os com os
+ * de BasicCPU. A e B estão a 4 KiB de distância: na JitCPU ocupam a mesma
+ * entrada da cache de blocos, e o código de A, ainda ligado a partir de C,
+ * continua a ser executado depois que a entrada passa a ser de B.
+ */
+void testPerfCountersAliasedBlocks()
+{
+	cout << "#\n#\n#\n# Testing PerfCounters with aliased blocks...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	static const struct {
+		long address;
+		unsigned int instruction;
+	} program[] = {
+		{0x40, 0x91000400},		// C: add x0, x0, #1
+		{0x44, 0x1400000F},		// b A
+		{0x80, 0xB9400041},		// A: ldr w1, [x2]
+		{0x84, 0x11000421},		// add w1, w1, #1
+		{0x88, 0x140003FE},		// b B
+		{0x1080, 0xB9000041},	// B: str w1, [x2]
+		{0x1084, 0xF100281F},	// cmp x0, #10
+		{0x1088, 0x54FF7DC1}	// b.ne C
+	};
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	PerfCounters perf[2];
+	int w1[2];
+	for (int c = 0; c < 2; c++) {
+		for (auto &p : program) {
+			memory->writeData32(p.address, p.instruction);
+		}
+		memory->writeData32(0x3000, 0);
+		BasicCPU *cpu = c ? (BasicCPU*)new CPUTest(memory) : new BasicCPU(memory);
+		cpu->setStackPointer(0x1000);
+		cpu->setRegister(2, 0x3000);
+		cpu->run(0x40);
+		perf[c] = *cpu->getPerfCounters();
+		w1[c] = memory->readData32(0x3000);
+		delete cpu;
+	}
+	delete memory;
+
+	ostringstream basic, tested;
+	perf[0].writeJSON(basic);
+	perf[1].writeJSON(tested);
+	cout << "	BasicCPU: " << basic.str() << endl;
+	cout << "	CPUTest:  " << tested.str() << endl;
+	unsigned long n = PERF_ENABLED ? 1 : 0;
+	if ((w1[0] != 10) || (w1[1] != 10) || (basic.str() != tested.str())
+			|| (perf[1].getInstructions() != 80 * n)
+			|| (perf[1].loads[PERF_WIDTH_32] != 10 * n)
+			|| (perf[1].stores[PERF_WIDTH_32] != 10 * n)) {
+		cout << "PerfCounters FALHOU com blocos a 4 KiB de distância!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "PerfCounters com blocos a 4 KiB de distância passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa o profiler de PCs:
+ *	- exato, no programa: as 6 instruções retiradas antes de 'adrp', com
+ *	  'str wzr, [sp, 12]' (0x44) e 'ldr w0, [sp, 12]' (0x84), simbolizadas
+ *	  pelos símbolos do ELF e pelos rótulos .L3 (0x4c) e .L2 (0x84), que o
+ *	  montador não mantém em isummation.o;
+ *	- amostrado 1 em 6, em um laço de 6 instruções: com intervalos
+ *	  sorteados, cada PC do laço recebe cerca de 1/6 das amostras (com
+ *	  intervalo fixo, todas cairiam no mesmo PC).
+ */
+void testPCProfiler()
+{
+	cout << "#\n#\n#\n# Testing PCProfiler...\n#\n#\n#\n" << endl;
+	cout << dec;
+
+	ElfLoader loader(FILENAME);
+	loader.load();
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	memory->loadBinary(loader.getImageFile());
+	CPUTest *cpu = new CPUTest(memory);
+	PCProfiler *profiler = new PCProfiler();
+	for (const ElfSymbol &symbol : loader.getSymbols()) {
+		profiler->addSymbol(symbol.name, symbol.address, symbol.size);
+	}
+	profiler->addSymbol(".L3", 0x4c, 0);
+	profiler->addSymbol(".L2", 0x84, 0);
+	cpu->setProfiler(profiler);
+	cpu->run(0x40);
+	profiler->writeFlat(cout);
+	ostringstream folded;
+	profiler->writeFolded(folded);
+	cout << folded.str();
+	ostringstream accesses;
+	profiler->writeFolded(accesses, PROFILE_ACCESSES);
+
+	vector<ProfileSite> sites = profiler->getSites();
+	if ((profiler->getInstructions() != 6) || (sites.size() != 6)
+			|| (profiler->getLoads() != 1) || (profiler->getStores() != 1)
+			|| (sites[1].PC != 0x44) || (sites[1].stores != 1)
+			|| (sites[3].PC != 0x84) || (sites[3].loads != 1)
+			|| (profiler->symbolize(0x40) != "main")
+			|| (profiler->symbolize(0x48) != "main+0x8")
+			|| (profiler->symbolize(0x88) != ".L2+0x4")
+			|| (profiler->symbolize(0x1000) != "0x1000")
+			|| (folded.str() != "main;0x40 1\nmain;0x44 1\nmain;0x48 1\n"
+					"main;.L2;0x84 1\nmain;.L2;0x88 1\nmain;.L2;0x8c 1\n")
+			|| (accesses.str() != "main;0x44 1\nmain;.L2;0x84 1\n")) {
+		cout << "PCProfiler FALHOU no perfil exato!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+	delete profiler;
+
+	// laço de 6 instruções (o mesmo do benchmark)
+	static const unsigned int loop[] = {
+		0xD10043FF,		// sub sp, sp, #16
+		0xB9400FE0,		// loop: ldr w0, [sp, 12]
+		0x0B000021,		// add w1, w1, w0
+		0xB9000BE1,		// str w1, [sp, 8]
+		0xB8647862,		// ldr w2, [x3, x4, lsl 2]
+		0xD10004A5,		// sub x5, x5, #1
+		0x17FFFFFB		// b loop
+	};
+	unsigned long instructions = 600000;
+	memory = new SimpleMemory(MEMORY_SIZE);
+	for (unsigned int i = 0; i < sizeof(loop) / sizeof(loop[0]); i++) {
+		memory->writeData32(0x40 + 4*i, loop[i]);
+	}
+	cpu = new CPUTest(memory);
+	profiler = new PCProfiler(6);
+	cpu->setProfiler(profiler);
+	cpu->setInstructionLimit(instructions);
+	cpu->run(0x40);
+	profiler->writeFlat(cout, 6);
+
+	sites = profiler->getSites();
+	bool spread = (sites.size() >= 6);
+	for (ProfileSite &site : sites) {
+		double share = (double)site.samples / profiler->getSamples();
+		if ((site.PC != 0x40) && ((share < 0.15) || (share > 0.18))) {
+			spread = false;
+		}
+	}
+	double estimate = (double)profiler->getInstructions() / instructions;
+	PCProfiler *other = new PCProfiler(6);
+	other->add(*profiler);
+	PCProfiler *exact = new PCProfiler();
+	if (!spread || (estimate < 0.97) || (estimate > 1.03)
+			|| (other->add(*profiler) != 0) || (exact->add(*profiler) != 1)
+			|| (other->getSamples() != 2 * profiler->getSamples())
+			|| (other->getSites().size() != sites.size())) {
+		cout << "PCProfiler FALHOU no perfil amostrado!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+	delete profiler;
+	delete other;
+	delete exact;
+
+	cout << "PCProfiler passou no teste!" << endl << endl;
+}
+
+/**
+ * Memória que só tem os acessos escalares de SimpleMemory e usa as
+ * versões padrão de Memory dos acessos em bloco e em pares.
+ */
+class ScalarMemory : public SimpleMemory
+{
+public:
+	ScalarMemory(int size) : SimpleMemory(size) {};
+
+	void readBlock(unsigned long address, void *buffer, unsigned long size) {
+		Memory::readBlock(address, buffer, size);
+	};
+	void writeBlock(unsigned long address, const void *buffer, unsigned long size) {
+		Memory::writeBlock(address, buffer, size);
+	};
+	void readPair64(unsigned long address, long *first, long *second) {
+		Memory::readPair64(address, first, second);
+	};
+	void writePair64(unsigned long address, long first, long second) {
+		Memory::writePair64(address, first, second);
+	};
+};
+
+/**
+ * Escreve um bloco de 100 bytes não alinhado que cruza a página em 0x2000
+ * e um par que cruza a página em 0x3000, e confere o que é lido em bloco,
+ * em pares e pelos acessos de 32 e 64 bits.
+ */
+void testBlockTransfer(string name, Memory *memory)
+{
+	unsigned char block[100];
+	unsigned char read[sizeof(block) + 2];
+	for (unsigned int i = 0; i < sizeof(block); i++) {
+		block[i] = 0x80 + i;
+	}
+	memory->writeData32(0x1FFC, 0x7F7F7F7F);
+	memory->writeData32(0x2060, 0x7F7F7F7F);
+	memory->writeBlock(0x1FFD, block, sizeof(block));
+	memory->readBlock(0x1FFC, read, sizeof(read));
+
+	long first, second;
+	memory->writePair64(0x2FF8, 0x1111222233334444L, 0x5555666677778888L);
+	memory->readPair64(0x2FF8, &first, &second);
+
+	if ((read[0] != 0x7F) || memcmp(read + 1, block, sizeof(block))
+			|| (read[sizeof(read) - 1] != 0x7F)
+			|| ((unsigned int)memory->readData32(0x2000) != 0x86858483)
+			|| (first != 0x1111222233334444L) || (second != 0x5555666677778888L)
+			|| (memory->readData64(0x3000) != 0x5555666677778888L)) {
+		cout << "Acessos em bloco FALHARAM em " << name << "!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	cout << "	" << name << ": OK" << endl;
+}
+
+/**
+ * Testa readBlock, writeBlock, readPair64 e writePair64 em todas as
+ * memórias (e nas versões padrão de Memory), as consultas à L1D de
+ * CachedMemory (uma por linha tocada) e o registro de SimpleMemoryTest
+ * (um único acesso largo).
+ */
+void testBlockTransfers(SimpleMemoryTest *memoryTest)
+{
+	cout << "#\n#\n#\n# Testing block transfers...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	ScalarMemory *scalar = new ScalarMemory(MEMORY_SIZE);
+	SimpleMemory *simple = new SimpleMemory(MEMORY_SIZE);
+	PagedMemory *paged = new PagedMemory(MEMORY_SIZE);
+	TLBMemory *tlb = new TLBMemory(MEMORY_SIZE);
+	CachedMemory *cached = new CachedMemory(new SimpleMemory(MEMORY_SIZE));
+	testBlockTransfer("Memory", scalar);
+	testBlockTransfer("SimpleMemory", simple);
+	testBlockTransfer("PagedMemory", paged);
+	testBlockTransfer("TLBMemory", tlb);
+	testBlockTransfer("CachedMemory", cached);
+
+	// páginas nunca escritas são lidas como 0, sem alocar
+	unsigned char zeros[16] = {1};
+	long first = 1, second = 1;
+	unsigned long pages = paged->getPagesAllocated();
+	paged->readBlock(0x10000FF8, zeros, sizeof(zeros));
+	paged->readPair64(0x20000000, &first, &second);
+	if (zeros[0] || zeros[15] || first || second || (paged->getPagesAllocated() != pages)) {
+		cout << "Acessos em bloco FALHARAM em páginas não escritas!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// um par dentro de uma página é uma única tradução
+	unsigned long hits = tlb->getDTLBHits() + tlb->getDTLBMisses();
+	tlb->readPair64(0x2000, &first, &second);
+	if (tlb->getDTLBHits() + tlb->getDTLBMisses() != hits + 1) {
+		cout << "Pares FALHARAM na TLB!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// L1D: um par na linha é um acesso; um bloco de 100 bytes a partir de
+	// 0x1030 toca 3 linhas de 64 bytes
+	cached->resetStats();
+	cached->readPair64(0x1000, &first, &second);
+	cached->writePair64(0x1038, first, second);
+	unsigned char block[100] = {0};
+	cached->writeBlock(0x1030, block, sizeof(block));
+	CacheStats l1d = cached->getLevel(CachedMemory::L1D)->getStats();
+	if ((l1d.reads != 1) || (l1d.writes != 2 + 3)) {
+		cout << "Acessos em bloco FALHARAM na L1D: " << dec << l1d.reads
+				<< " leituras, " << l1d.writes << " escritas!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// SimpleMemoryTest registra cada acesso em bloco ou em par como um só
+	SimpleMemoryTest::MemAccessType types[4];
+	memoryTest->readBlock(0x800, block, 24);
+	types[0] = memoryTest->getLastDataMemAccess();
+	memoryTest->writeBlock(0x800, block, 24);
+	types[1] = memoryTest->getLastDataMemAccess();
+	memoryTest->readPair64(0x800, &first, &second);
+	types[2] = memoryTest->getLastDataMemAccess();
+	memoryTest->writePair64(0x800, first, second);
+	types[3] = memoryTest->getLastDataMemAccess();
+	memoryTest->resetLastDataMemAccess();
+	if ((types[0] != SimpleMemoryTest::MAT_READBLOCK)
+			|| (types[1] != SimpleMemoryTest::MAT_WRITEBLOCK)
+			|| (types[2] != SimpleMemoryTest::MAT_READPAIR64)
+			|| (types[3] != SimpleMemoryTest::MAT_WRITEPAIR64)) {
+		cout << "Acessos em bloco FALHARAM em SimpleMemoryTest!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	delete scalar;
+	delete simple;
+	delete paged;
+	delete tlb;
+	delete cached;
+
+	cout << "Acessos em bloco passaram no teste!" << endl << endl;
+}
+
+/**
+ * Executa um prólogo e um epílogo com LDP e STP, de 32 e 64 bits, com
+ * offset, pre-index e post-index, e confere, pelo que o programa escreve
+ * em 0x3000, os registradores lidos, o write-back de SP e de x12, as
+ * consultas à L1D (uma por instrução, duas no par que cruza a linha em
+ * 0x2040) e os contadores de desempenho.
+ */
+void testLoadStorePair()
+{
+	cout << "#\n#\n#\n# Testing LDP/STP...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	static const unsigned int program[] = {
+		0xA9BE7BFD,		// stp x29, x30, [sp, #-32]!
+		0x29020BE1,		// stp w1, w2, [sp, #16]
+		0xA94013E3,		// ldp x3, x4, [sp]
+		0x29421BE5,		// ldp w5, w6, [sp, #16]
+		0xA8C27BFD,		// ldp x29, x30, [sp], #32
+		0xA87E23E7,		// ldnp x7, x8, [sp, #-32]
+		0xA900A969,		// stp x9, x10, [x11, #8]
+		0xA8811183,		// stp x3, x4, [x12], #16
+		0xA8811985,		// stp x5, x6, [x12], #16
+		0xA9002187,		// stp x7, x8, [x12]
+		0x910003ED,		// mov x13, sp
+		0xA901318D		// stp x13, x12, [x12, #16]
+	};
+	int count = sizeof(program) / sizeof(program[0]);
+	SimpleMemory *simple = new SimpleMemory(MEMORY_SIZE);
+	for (int i = 0; i < count; i++) {
+		simple->writeData32(0x40 + 4*i, program[i]);
+	}
+	CachedMemory *memory = new CachedMemory(simple);
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setStackPointer(0x1000);
+	cpu->setRegister(29, 0x1111222233334444L);
+	cpu->setRegister(30, 0x5555666677778888L);
+	cpu->setRegister(1, 0xAAAAAAAA12345678L);
+	cpu->setRegister(2, 0xBBBBBBBB9ABCDEF0L);
+	cpu->setRegister(9, 0x99);
+	cpu->setRegister(10, 0x1010);
+	cpu->setRegister(11, 0x2030);
+	cpu->setRegister(12, 0x3000);
+	cpu->run(0x40);
+	CacheStats l1d = memory->getLevel(CachedMemory::L1D)->getStats();
+
+	static const long xpctd[] = {
+		0x1111222233334444L, 0x5555666677778888L,	// x3, x4
+		0x12345678L, 0x9ABCDEF0L,					// x5, x6 (ldp de Wn)
+		0x1111222233334444L, 0x5555666677778888L,	// x7, x8
+		0x1000, 0x3020								// SP, x12
+	};
+	bool ok = (cpu->getPC() == 0x40 + 4 * count)
+			&& (memory->readData64(0x2038) == 0x99)
+			&& (memory->readData64(0x2040) == 0x1010);
+	for (int i = 0; i < 8; i++) {
+		long value = memory->readData64(0x3000 + 8*i);
+		cout << "	[0x" << 0x3000 + 8*i << "] = 0x" << value << endl;
+		ok = ok && (value == xpctd[i]);
+	}
+
+	PerfCounters *perf = cpu->getPerfCounters();
+	unsigned long n = PERF_ENABLED ? 1 : 0;
+	if (!ok || (l1d.reads != 4) || (l1d.writes != 8)
+			|| (perf->getInstructions() != 12 * n)
+			|| (perf->groups[PERF_GROUP_LOADSTORE] != 11 * n)
+			|| (perf->loads[PERF_WIDTH_128] != 3 * n) || (perf->loads[PERF_WIDTH_64] != n)
+			|| (perf->stores[PERF_WIDTH_128] != 6 * n) || (perf->stores[PERF_WIDTH_64] != n)) {
+		cout << "LDP/STP FALHARAM: L1D com " << dec << l1d.reads << " leituras e "
+				<< l1d.writes << " escritas" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+
+	cout << "LDP/STP passaram no teste!" << endl << endl;
+}
+
+/**
+ * Escreve um dado de 64 bits que cruza a página (e a linha) em 0x3000 e
+ * sobrescreve parte dele com escritas de 8 e 16 bits, conferindo cada byte
+ * pelas leituras desalinhadas de 8, 16, 32 e 64 bits (com extensão de
+ * sinal nas de 8 e 16 bits).
+ */
+void testUnalignedAccess(string name, Memory *memory)
+{
+	memory->writeData64(0x2FFD, 0x8877665544332211L);
+	bool ok = (memory->readData64(0x2FFD) == (long)0x8877665544332211UL)
+			&& (memory->readData32(0x2FFE) == 0x55443322)
+			&& (memory->readData16(0x2FFF) == 0x4433)
+			&& (memory->readData8(0x2FFD) == 0x11)
+			&& (memory->readData8(0x3004) == (signed char)0x88);
+
+	// bytes a partir de 0x2FFD: 11 22 80 7F 55 66 77 01
+	memory->writeData16(0x2FFF, 0x7F80);
+	memory->writeData8(0x3004, 0x01);
+	ok = ok && (memory->readData64(0x2FFD) == 0x017766557F802211L)
+			&& (memory->readData32(0x3001) == 0x01776655)
+			&& (memory->readData16(0x2FFE) == (short)0x8022)
+			&& (memory->readData8(0x2FFF) == (signed char)0x80)
+			&& (memory->readData8(0x3000) == 0x7F)
+			&& (memory->readData8(0x3005) == 0);
+
+	if (!ok) {
+		cout << "Acessos desalinhados FALHARAM em " << name << "!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	cout << "	" << name << ": OK" << endl;
+}
+
+/**
+ * Testa os acessos desalinhados e de 8 e 16 bits em todas as memórias, as
+ * consultas à L1D de CachedMemory (duas quando o dado cruza a linha), a
+ * leitura de uma página não escrita que cruza a página e o registro de
+ * SimpleMemoryTest.
+ */
+void testUnalignedAccesses(SimpleMemoryTest *memoryTest)
+{
+	cout << "#\n#\n#\n# Testing unaligned accesses...\n#\n#\n#\n" << endl;
+
+	SimpleMemory *simple = new SimpleMemory(MEMORY_SIZE);
+	PagedMemory *paged = new PagedMemory(MEMORY_SIZE);
+	TLBMemory *tlb = new TLBMemory(MEMORY_SIZE);
+	CachedMemory *cached = new CachedMemory(new SimpleMemory(MEMORY_SIZE));
+	testUnalignedAccess("SimpleMemory", simple);
+	testUnalignedAccess("PagedMemory", paged);
+	testUnalignedAccess("TLBMemory", tlb);
+	testUnalignedAccess("CachedMemory", cached);
+
+	// a parte na página nunca escrita é lida como 0, sem alocar
+	unsigned long pages = paged->getPagesAllocated();
+	paged->writeData8(0x10000FFF, 0x5A);
+	long value = paged->readData64(0x10000FFC);
+	if ((value != 0x5A000000L) || (paged->getPagesAllocated() != pages + 1)) {
+		cout << "Acessos desalinhados FALHARAM em páginas não escritas!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// L1D: o dado que cruza a linha toca duas linhas; os demais, uma
+	cached->resetStats();
+	cached->readData64(0x2FFD);
+	cached->readData32(0x3001);
+	cached->writeData16(0x303F, 0);
+	cached->writeData8(0x303F, 0);
+	CacheStats l1d = cached->getLevel(CachedMemory::L1D)->getStats();
+	if ((l1d.reads != 2 + 1) || (l1d.writes != 2 + 1)) {
+		cout << "Acessos desalinhados FALHARAM na L1D: " << dec << l1d.reads
+				<< " leituras, " << l1d.writes << " escritas!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// SimpleMemoryTest registra os acessos de 8 e 16 bits
+	SimpleMemoryTest::MemAccessType types[4];
+	memoryTest->writeData8(0x801, 0);
+	types[0] = memoryTest->getLastDataMemAccess();
+	memoryTest->readData8(0x801);
+	types[1] = memoryTest->getLastDataMemAccess();
+	memoryTest->writeData16(0x803, 0);
+	types[2] = memoryTest->getLastDataMemAccess();
+	memoryTest->readData16(0x803);
+	types[3] = memoryTest->getLastDataMemAccess();
+	memoryTest->resetLastDataMemAccess();
+	if ((types[0] != SimpleMemoryTest::MAT_WRITE8)
+			|| (types[1] != SimpleMemoryTest::MAT_READ8)
+			|| (types[2] != SimpleMemoryTest::MAT_WRITE16)
+			|| (types[3] != SimpleMemoryTest::MAT_READ16)) {
+		cout << "Acessos de 8 e 16 bits FALHARAM em SimpleMemoryTest!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	delete simple;
+	delete paged;
+	delete tlb;
+	delete cached;
+
+	cout << "Acessos desalinhados passaram no teste!" << endl << endl;
+}
+
+/**
+ * Executa loads e stores de bytes e halfwords nas formas unsigned offset,
+ * unscaled, register offset (LSL, UXTW e SXTW, com e sem deslocamento),
+ * pre-index e post-index, e confere os registradores (que o programa escreve em 0x3010), os dados
+ * escritos a partir de 0x2FFF (desalinhados, cruzando a página) e os
+ * contadores de desempenho por largura.
+ */
+void testLoadStoreSubword()
+{
+	cout << "#\n#\n#\n# Testing LDRB/LDRH/STRB/STRH...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	static const unsigned int program[] = {
+		0x7862D820,		// ldrh w0, [x1, w2, sxtw #1]
+		0x39400022,		// ldrb w2, [x1]
+		0x39800423,		// ldrsb x3, [x1, #1]
+		0x39C00824,		// ldrsb w4, [x1, #2]
+		0x78401025,		// ldurh w5, [x1, #1]
+		0x79800826,		// ldrsh x6, [x1, #4]
+		0x78E97827,		// ldrsh w7, [x1, x9, lsl #1]
+		0x38401428,		// ldrb w8, [x1], #1
+		0x786C482B,		// ldrh w11, [x1, w12, uxtw]
+		0x38AEC82D,		// ldrsb x13, [x1, w14, sxtw]
+		0x39000542,		// strb w2, [x10, #1]
+		0x79000546,		// strh w6, [x10, #2]
+		0x78005145,		// sturh w5, [x10, #5]
+		0x381FFD44,		// strb w4, [x10, #-1]!
+		0x78008547,		// strh w7, [x10], #8
+		0xA9000DE2,		// stp x2, x3, [x15]
+		0xA90115E4,		// stp x4, x5, [x15, #16]
+		0xA9021DE6,		// stp x6, x7, [x15, #32]
+		0xA9032DE8,		// stp x8, x11, [x15, #48]
+		0xA90405ED,		// stp x13, x1, [x15, #64]
+		0xA90501EA		// stp x10, x0, [x15, #80]
+	};
+	int count = sizeof(program) / sizeof(program[0]);
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	for (int i = 0; i < count; i++) {
+		memory->writeData32(0x40 + 4*i, program[i]);
+	}
+	memory->writeData64(0x1FF8, 0x0000C0DE00000000L);
+	memory->writeData64(0x2000, 0x0807F6F584838281L);
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setStackPointer(0x1000);
+	cpu->setRegister(1, 0x2000);
+	cpu->setRegister(2, 0x66FFFFFFFEL);
+	cpu->setRegister(9, 3);
+	cpu->setRegister(10, 0x3000);
+	cpu->setRegister(12, 0x7700000002L);
+	cpu->setRegister(14, 0x55FFFFFFFFL);
+	cpu->setRegister(15, 0x3010);
+	cpu->run(0x40);
+
+	static const long xpctd[] = {
+		0x81, (long)0xFFFFFFFFFFFFFF82UL,			// x2 (ldrb), x3 (ldrsb Xt)
+		0xFFFFFF83, 0x8382,							// x4 (ldrsb Wt), x5 (ldurh)
+		(long)0xFFFFFFFFFFFFF6F5UL, 0x0807,			// x6 (ldrsh Xt), x7 (ldrsh Wt)
+		0x81, 0xF584,								// x8 (post-index), x11 (uxtw)
+		(long)0xFFFFFFFFFFFFFF81UL, 0x2001,			// x13 (sxtw), x1
+		0x3007, 0xC0DE								// x10 (pre e post-index), x0 (sxtw #1)
+	};
+	bool ok = (cpu->getPC() == 0x40 + 4 * count)
+			&& (memory->readData64(0x2FFF) == (long)0x838200F6F5810807UL)
+			&& (memory->readData8(0x3007) == 0);
+	for (int i = 0; i < 12; i++) {
+		long value = memory->readData64(0x3010 + 8*i);
+		cout << "	[0x" << 0x3010 + 8*i << "] = 0x" << value << endl;
+		ok = ok && (value == xpctd[i]);
+	}
+
+	PerfCounters *perf = cpu->getPerfCounters();
+	unsigned long n = PERF_ENABLED ? 1 : 0;
+	if (!ok || (perf->loads[PERF_WIDTH_8] != 5 * n) || (perf->loads[PERF_WIDTH_16] != 5 * n)
+			|| (perf->stores[PERF_WIDTH_8] != 2 * n) || (perf->stores[PERF_WIDTH_16] != 3 * n)) {
+		cout << "LDRB/LDRH/STRB/STRH FALHARAM!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+
+	cout << "LDRB/LDRH/STRB/STRH passaram no teste!" << endl << endl;
+}
+
+/**
+ * Executa um programa com instruções AdvSIMD e de ponto flutuante: a soma
+ * vetorizada de 16 words (LDR Qt post-index, ADD .4S e ADDV), operações
+ * inteiras e de ponto flutuante vetoriais e escalares, MOVI, DUP, UMOV,
+ * FMOV e LD1/ST1 de 1 a 4 registradores. Confere os registradores
+ * vetoriais e inteiros que o programa escreve a partir de 0x3000 (inclusive
+ * a parte alta zerada das escritas escalares e de 64 bits) e os contadores
+ * de desempenho. Uma codificação não alocada vizinha de MOVI (o2 = 1)
+ * termina com ID_ERROR.
+ */
+void testAdvSIMD()
+{
+	cout << "#\n#\n#\n# Testing AdvSIMD...\n#\n#\n#\n" << endl;
+	cout << hex;
+
+	static const unsigned int program[] = {
+		0x6F00E400,		// movi v0.2d, #0
+		0x3CC10421,		// loop: ldr q1, [x1], #16
+		0x4EA18400,		// add v0.4s, v0.4s, v1.4s
+		0xF1000442,		// subs x2, x2, #1
+		0x54FFFFA1,		// b.ne loop
+		0x4EB1B802,		// addv s2, v0.4s
+		0x1E260043,		// fmov w3, s2
+		0x0E1C3C08,		// umov w8, v0.s[3]
+		0x4C40A884,		// ld1 {v4.4s, v5.4s}, [x4]
+		0x4E25D486,		// fadd v6.4s, v4.4s, v5.4s
+		0x6E25DC87,		// fmul v7.4s, v4.4s, v5.4s
+		0x4CC67CA8,		// ld1 {v8.2d}, [x5], x6
+		0x4E080CEA,		// dup v10.2d, x7
+		0x6E6AFD09,		// fdiv v9.2d, v8.2d, v10.2d
+		0x4E183D09,		// umov x9, v8.d[1]
+		0x9E6700EB,		// fmov d11, x7
+		0x1E6B296C,		// fadd d12, d11, d11
+		0x4E219C2D,		// mul v13.16b, v1.16b, v1.16b
+		0x4EA11C0E,		// orr v14.16b, v0.16b, v1.16b
+		0x6E61840F,		// sub v15.8h, v0.8h, v1.8h
+		0x4C9FA966,		// st1 {v6.4s, v7.4s}, [x11], #32
+		0x3C810569,		// str q9, [x11], #16
+		0x4C8C2D6C,		// st1 {v12.2d, v13.2d, v14.2d, v15.2d}, [x11], x12
+		0x4F002430,		// movi v16.4s, #1, lsl #8
+		0x4E010D51,		// dup v17.16b, w10
+		0x4E71BA32,		// addv h18, v17.8h
+		0x0E31BA33,		// addv b19, v17.8b
+		0x4C002970,		// st1 {v16.4s, v17.4s, v18.4s, v19.4s}, [x11]
+		0x2E301E34,		// eor v20.8b, v17.8b, v16.8b
+		0xFC1F8DB4,		// str d20, [x13, #-8]!
+		0xBC5FC035,		// ldur s21, [x1, #-4]
+		0x1E253899,		// fsub s25, s4, s5
+		0xBD0009B5,		// str s21, [x13, #8]
+		0xBD000DB9,		// str s25, [x13, #12]
+		0xA90121A3,		// stp x3, x8, [x13, #16]
+		0xA90215A9,		// stp x9, x5, [x13, #32]
+		0xA90335AB		// stp x11, x13, [x13, #48]
+	};
+	int count = sizeof(program) / sizeof(program[0]);
+	SimpleMemory *memory = new SimpleMemory(MEMORY_SIZE);
+	for (int i = 0; i < count; i++) {
+		memory->writeData32(0x40 + 4*i, program[i]);
+	}
+	for (int i = 0; i < 16; i++) {
+		memory->writeData32(0x2000 + 4*i, i + 1);
+	}
+	// floats {1.5, 2, -3, 10} e {0.5, 4, 1.5, 0.25}; doubles {3, -7}
+	memory->writeData64(0x2100, 0x400000003FC00000L);
+	memory->writeData64(0x2108, 0x41200000C0400000L);
+	memory->writeData64(0x2110, 0x408000003F000000L);
+	memory->writeData64(0x2118, 0x3E8000003FC00000L);
+	memory->writeData64(0x2200, 0x4008000000000000L);
+	memory->writeData64(0x2208, (long)0xC01C000000000000UL);
+	CPUTest *cpu = new CPUTest(memory);
+	cpu->setStackPointer(0x1000);
+	cpu->setRegister(1, 0x2000);
+	cpu->setRegister(2, 4);
+	cpu->setRegister(4, 0x2100);
+	cpu->setRegister(5, 0x2200);
+	cpu->setRegister(6, 16);
+	cpu->setRegister(7, 0x4000000000000000L); // 2.0
+	cpu->setRegister(10, 0x1234);
+	cpu->setRegister(11, 0x3000);
+	cpu->setRegister(12, 64);
+	cpu->setRegister(13, 0x3108);
+	cpu->run(0x40);
+
+	static const unsigned long xpctd[] = {
+		0x40C0000040000000, 0x41240000BFC00000,	// v6: {2, 6, -1.5, 10.25}
+		0x410000003F400000, 0x40200000C0900000,	// v7: {0.75, 8, -4.5, 2.5}
+		0x3FF8000000000000, 0xC00C000000000000,	// v9: {1.5, -3.5}
+		0x4010000000000000, 0,					// v12: d12 = 4
+		0x000000C4000000A9, 0x00000000000000E1,	// v13: bytes de {13, 14, 15, 16} ao quadrado
+		0x0000002E0000001D, 0x000000380000002F,	// v14: {28, 32, 36, 40} | {13, 14, 15, 16}
+		0x000000120000000F, 0x0000001800000015,	// v15: {28, 32, 36, 40} - {13, 14, 15, 16}
+		0x0000010000000100, 0x0000010000000100,	// v16: movi
+		0x3434343434343434, 0x3434343434343434,	// v17: dup
+		0xA1A0, 0,								// v18: addv .8h
+		0xA0, 0,								// v19: addv .8b
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0x3434353434343534,						// d20: eor .8b
+		0x3F80000000000010,						// s21 = 16, s25 = 1.0
+		0x88, 0x28,								// x3 (addv), x8 (umov)
+		0xC01C000000000000, 0x2210,				// x9 (umov), x5 (post-index Xm)
+		0x3070, 0x3100							// x11, x13 (post-index e pre-index)
+	};
+	int words = sizeof(xpctd) / sizeof(xpctd[0]);
+	bool ok = (cpu->getPC() == 0x40 + 4 * count);
+	for (int i = 0; i < words; i++) {
+		long value = memory->readData64(0x3000 + 8*i);
+		cout << "	[0x" << 0x3000 + 8*i << "] = 0x" << value << endl;
+		ok = ok && (value == (long)xpctd[i]);
+	}
+
+	// loads: 4 LDR Qt e 3 registradores de LD1 (128 bits) e LDUR St;
+	// stores: 11 registradores de ST1 e STR Qt e 3 STP (128 bits), STR Dt
+	// e 2 STR St
+	PerfCounters *perf = cpu->getPerfCounters();
+	unsigned long n = PERF_ENABLED ? 1 : 0;
+	if (!ok || (perf->loads[PERF_WIDTH_128] != 7 * n) || (perf->loads[PERF_WIDTH_32] != 1 * n)
+			|| (perf->stores[PERF_WIDTH_128] != 14 * n) || (perf->stores[PERF_WIDTH_64] != 1 * n)
+			|| (perf->stores[PERF_WIDTH_32] != 2 * n)
+			|| (perf->groups[PERF_GROUP_SIMD_FP] != 24 * n)) {
+		cout << "AdvSIMD FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+
+	// com o2 (bit 11) em 1, a instrução não é MOVI: não alocada
+	memory->writeData32(0x40, 0x4F002C30);
+	cpu = new CPUTest(memory);
+	if ((cpu->run(0x40) != 1) || (cpu->getError() != CPU::CPUerrorCode::ID_ERROR)
+			|| (cpu->getPC() != 0x40)) {
+		cout << "AdvSIMD FALHOU: MOVI com o2 = 1 decodificado!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	delete cpu;
+	delete memory;
+
+	cout << "AdvSIMD passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa o estágio IF.
+ */
+void testIF(CPUTest* cpu, int xpctdIR)
+{
+	//
+	// Testa IF
+	//
+	cout << "Testando IF..." << endl;
+	
+	// executa
+	cpu->runIF();
+	cout << "	IR=0x" << cpu->getIR()
+			<< ";  Esperado IR=0x" << xpctdIR << endl;
+	
+	// verifica
+	if (cpu->getIR() != xpctdIR) {
+		cout << "IF() FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "IF() passou no teste!" << endl << endl;
+}
+
+/**
+ * Testa o estágio ID.
+ */
+void testID(CPUTest* cpu,
+			int xpctdIR,
+			int xpctdA,
+			int xpctdB,
+			ALUctrlFlag xpctdALUctrl,
+			MEMctrlFlag xpctdMEMctrl,
+			WBctrlFlag xpctdWBctrl)
+{
+	//
+	// Testa ID (depende do sucesso no teste de IF)
+	//
+	cout << "Testando ID..." << endl;
+	
+	// executa
+	int iderror = cpu->runID();
+	
+	// verifica se a instrução está implementada
+	if (iderror) {
+		cout << "Instrução não implementada: 0x" << xpctdIR << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	// verifica leitura de registradores
+	long A = cpu->getA();
+	long B = cpu->getB();
+	cout << "	A=0x" << A << "; B=0x" << B << endl;
+	cout << "Esperados: A=0x" << xpctdA << "; B=0x" << xpctdB << endl;
+	if ((A != xpctdA) || (B != xpctdB)){
+		cout << "ID() FALHOU na leitura de registradores!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "ID() passou no teste de leitura de registradores!" << endl << endl;
+
+	// verifica ALUctrl
+	ALUctrlFlag ALUctrl = cpu->getALUctrl();
+	cout << "	ALUctrl=0x" << ALUctrl << "; Esperado ALUctrl=0x"
+			<< xpctdALUctrl << endl;
+	if (ALUctrl != xpctdALUctrl)
+	{
+		cout << "ID() FALHOU no set do controle da ULA!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "ID() passou no teste de set do controle da ULA!" << endl << endl;
+
+	// verifica MEMctrl
+	MEMctrlFlag MEMctrl = cpu->getMEMctrl();
+	cout << "	MEMctrl=0x" << MEMctrl << "; Esperado MEMctrl=0x"
+			<< xpctdMEMctrl << endl;
+	if (MEMctrl != xpctdMEMctrl)
+	{
+		cout << "ID() FALHOU no set do controle de MEM!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "ID() passou no teste de set do controle de MEM!" << endl << endl;
+
+	// verifica WBctrl
+	WBctrlFlag WBctrl = cpu->getWBctrl();
+	cout << "	WBctrl=0x" << WBctrl << "; Esperado WBctrl=0x"
+			<< xpctdWBctrl << endl;
+	if (WBctrl != xpctdWBctrl)
+	{
+		cout << "ID() FALHOU no set do controle de WB!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+
+	cout << "ID() passou no teste de set do controle de WB!" << endl << endl;
+
+	cout << "ID() passou nos testes de set dos controles da ULA, MEM e WB!" << endl << endl;
+}
+
+/**
+ * Testa o estágio EXI.
+ */
+void testEXI(CPUTest* cpu, long xpctdALUout)
+{
+	//
+	// Testa EXI (depende do sucesso no teste de ID)
+	//
+	cout << "Testando EXI..." << endl;
+	
+	// executa
+	int exierror = cpu->runEXI();
+	if (exierror) {
+		cout << "Controle não implementado: 0x" << cpu->getALUctrl() << endl;
+		cout << "EXI() FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	
+	// verifica ALUout
+	long ALUout = cpu->getALUout();
+	cout << "	ALUout=0x"
+			<< setfill('0') << setw(8) << ALUout
+			<< "; Esperado ALUout=0x"
+			<< setfill('0') << setw(8) << xpctdALUout << endl;
+	if (ALUout != xpctdALUout)
+	{
+		cout << "EXI() FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+	
+	cout << "EXI() passou no teste!" << endl;
+}
+
+/**
+ * Testa o estágio MEM - NAO IMPLEMENTADO.
+ */
+void testMEM(CPUTest* cpu,
+				SimpleMemoryTest* memory,
+				MEMctrlFlag xpctdMEMctrl,
+				long xpctdALUout,
+				long xpctdMDR)
+{
+	//
+	// Test MEM (depends on the success of previous stages)
+	//
+	cout << "Testing MEM..." << endl;
+	
+	// executa
+	int memerror = cpu->runMEM();
+	if (memerror) {
+		cout << "Controle não implementado: 0x" << cpu->getMEMctrl() << endl;
+		cout << "MEM() FALHOU!" << endl;
+		cout << "Saindo..." << endl;
+		exit(1);
+	}
+		
+	//
+	// Test access type
+	//
+	
+	// map MEMctrlFlag to SimpleMemoryTest::MemAccessType
+	SimpleMemoryTest::MemAccessType xpctdLastDataMemAccess =
+			SimpleMemoryTest::MemAccessType::MAT_NONE;
+	switch (xpctdMEMctrl) {
+		case MEMctrlFlag::MEM_UNDEF:
+			cout << "	Controle de memória esperado indefinido!" << endl;
+			cout << "MEM() FALHOU!" << endl;
+			cout << "Saindo..." << endl;
+			exit(1);
+		case MEMctrlFlag::MEM_NONE:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_NONE;
+			break;
+		case MEMctrlFlag::READ32:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ32;
+			break;
+		case MEMctrlFlag::READ64:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ64;
+			break;
+		case MEMctrlFlag::WRITE32:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE32;
+			break;
+		case MEMctrlFlag::WRITE64:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE64;
+			break;
+		case MEMctrlFlag::READ8:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ8;
+			break;
+		case MEMctrlFlag::WRITE8:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE8;
+			break;
+		case MEMctrlFlag::READ16:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READ16;
+			break;
+		case MEMctrlFlag::WRITE16:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITE16;
+			break;
+		case MEMctrlFlag::READPAIR32:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READBLOCK;
+			break;
+		case MEMctrlFlag::WRITEPAIR32:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITEBLOCK;
+			break;
+		case MEMctrlFlag::READPAIR64:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READPAIR64;
+			break;
+		case MEMctrlFlag::WRITEPAIR64:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITEPAIR64;
+			break;
+		case MEMctrlFlag::READV:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_READBLOCK;
+			break;
+		case MEMctrlFlag::WRITEV:
+			xpctdLastDataMemAccess = SimpleMemoryTest::MemAccessType::MAT_WRITEBLOCK;
+			break;
+	}
+
+	SimpleMemoryTest::MemAccessType lastDataMemAccess =
+			memory->getLastDataMemAccess();
+	cout << "	Testing MEM access type..." << endl;
+	cout << "		Expected access type: "
+			<< xpctdLastDataMemAccess << endl;
+	cout << "		Executed access type: "
+			<< lastDataMemAccess << endl;
+	if (xpctdLastDataMemAccess != lastDataMemAccess) {
+		// incorrect memory access type
+		cout << "MEM() FAILED!" << endl;
+		cout << "Exit..." << endl;
+		exit(1);
+	} else {
+		cout << "	MEM() executed the correct access type!" << endl;
+	}
+
+	//
+	// Test content
+	//
+	
+	// no memory access -> success
+	if (xpctdMEMctrl == MEMctrlFlag::MEM_NONE) {
+		cout << "	No content to be tested!" << endl;
+		cout << "MEM() test: SUCCESS!" << endl;
+		return;
+	}
+
+	// vector registers are not visible here (see testAdvSIMD)
+	if ((xpctdMEMctrl == MEMctrlFlag::READV)
+			|| (xpctdMEMctrl == MEMctrlFlag::WRITEV)) {
+		cout << "	Vector content not tested!" << endl;
+		cout << "MEM() test: SUCCESS!" << endl;
+		return;
+	}
+	
+	// get read or written content (access depends on 32 or 64 bit mode;
+	// pairs are tested by their first register)
+	long memData = 0, xpctdMemData = 0;
+	switch (xpctdMEMctrl) {
+		case MEMctrlFlag::READ32:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = (long)memory->readData32(xpctdALUout);
+			xpctdMemData = cpu->getMDR();
+			break;
+		case MEMctrlFlag::READ64:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = memory->readData64(xpctdALUout);
 			xpctdMemData = cpu->getMDR();
 			break;
 		case MEMctrlFlag::WRITE32:
@@ -539,6 +2492,52 @@ void testMEM(BasicCPUTest* cpu,
 			memData = memory->readData64(xpctdALUout);
 			xpctdMemData = cpu->getRd();
 			break;
+		case MEMctrlFlag::READ8:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = memory->readData8(xpctdALUout);
+			xpctdMemData = cpu->getMDR();
+			break;
+		case MEMctrlFlag::WRITE8:
+			cout << "	WRITE Mode: testing written content..." << endl;
+			memData = memory->readData8(xpctdALUout);
+			xpctdMemData = (signed char)cpu->getRd();
+			break;
+		case MEMctrlFlag::READ16:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = memory->readData16(xpctdALUout);
+			xpctdMemData = cpu->getMDR();
+			break;
+		case MEMctrlFlag::WRITE16:
+			cout << "	WRITE Mode: testing written content..." << endl;
+			memData = memory->readData16(xpctdALUout);
+			xpctdMemData = (short)cpu->getRd();
+			break;
+		case MEMctrlFlag::READPAIR32:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = (unsigned int)memory->readData32(xpctdALUout);
+			xpctdMemData = cpu->getMDR();
+			break;
+		case MEMctrlFlag::WRITEPAIR32:
+			cout << "	WRITE Mode: testing written content..." << endl;
+			memData = (unsigned int)memory->readData32(xpctdALUout);
+			xpctdMemData = (unsigned int)cpu->getRd();
+			break;
+		case MEMctrlFlag::READPAIR64:
+			cout << "	READ Mode: testing read content..." << endl;
+			memData = memory->readData64(xpctdALUout);
+			xpctdMemData = cpu->getMDR();
+			break;
+		case MEMctrlFlag::WRITEPAIR64:
+			cout << "	WRITE Mode: testing written content..." << endl;
+			memData = memory->readData64(xpctdALUout);
+			xpctdMemData = cpu->getRd();
+			break;
+		case MEMctrlFlag::MEM_UNDEF:
+		case MEMctrlFlag::MEM_NONE:
+		case MEMctrlFlag::READV:
+		case MEMctrlFlag::WRITEV:
+			// handled above
+			break;
 	}
 	
 	// memory content verbose
@@ -546,6 +2545,15 @@ void testMEM(BasicCPUTest* cpu,
 	cout << "		Effective memory content: 0x"	<< memData << endl;
 	cout << "		Address tested: 0x" << xpctdALUout << endl;
 
+	// MDR, if the test sets it (RESETTEST leaves it at -1)
+	if ((xpctdMDR != -1) && (cpu->getMDR() != xpctdMDR)) {
+		cout << "		Expected MDR: 0x" << xpctdMDR
+				<< "; MDR: 0x" << cpu->getMDR() << endl;
+		cout << "	MDR FAILED..." << endl;
+		cout << "MEM() FAILED!" << endl;
+		exit(1);
+	}
+
 	// finish content test
 	if (memData == xpctdMemData) {
 		cout << "	Memory content OK..." << endl;
@@ -562,7 +2570,7 @@ void testMEM(BasicCPUTest* cpu,
 /**
  * Testa o estágio WB.
  */
-void testWB(BasicCPUTest* cpu,
+void testWB(CPUTest* cpu,
 		WBctrlFlag xpctdWBctrl,
 		long xpctdRd)
 {
@@ -580,7 +2588,6 @@ void testWB(BasicCPUTest* cpu,
 		exit(1);
 	}
 	
-	bool ok = true;
 	unsigned long Rd = cpu->getRd();
 	if(xpctdWBctrl == WBctrlFlag::RegWrite)
 	{
@@ -589,7 +2596,7 @@ void testWB(BasicCPUTest* cpu,
 			<< "; Esperado xpctdRd=0x"
 			<< setfill('0') << setw(8) << xpctdRd << endl;
 			
-		if (Rd != xpctdRd)
+		if (Rd != (unsigned long)xpctdRd)
 		{
 			cout << "WB() FALHOU!" << endl;
 			cout << "Saindo..." << endl;
@@ -605,7 +2612,7 @@ void testWB(BasicCPUTest* cpu,
  * para a instrução 'sub sp, sp, #16'.
  */
 void test(string instruction,
-			BasicCPUTest* cpu,
+			CPUTest* cpu,
 			SimpleMemoryTest* memory,
 			long startAddress,
 			long startSP,
@@ -629,7 +2636,7 @@ void test(string instruction,
 	cout << "Iniciando processador..." << endl;
 	cout << "	PC: 0x" << startAddress << endl;
 	cout << "	SP: 0x" << startSP << endl;
-	cpu->run(startAddress);
+	cpu->setPC(startAddress);
 	cpu->setSP(startSP);
 	cout << "processor iniciado." << endl << endl;
 	
@@ -640,7 +2647,7 @@ void test(string instruction,
 	
 	testEXI(cpu, xpctdALUout);
 
-	testMEM(cpu, memory, xpctdMEMctrl, xpctdALUout);
+	testMEM(cpu, memory, xpctdMEMctrl, xpctdALUout, xpctdMDR);
 	
 	testWB(cpu, xpctdWBctrl, xpctdRd);
 	
@@ -0,0 +1,190 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) AsyncTraceWriter - memory trace written by a background thread
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) AsyncTraceWriter - registro de acessos escrito por uma thread de fundo
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "AsyncTraceWriter.h"
+
+#include <chrono>
+
+using namespace std;
+
+// Esperas ociosas da thread de fundo cedendo o processador antes de passar
+// a dormir TRACE_IDLE_SLEEP_US a cada espera
+#define TRACE_IDLE_YIELDS 16
+#define TRACE_IDLE_SLEEP_US 50
+
+AsyncTraceWriter::AsyncTraceWriter(string filename, AsyncTraceConfig config)
+	: writer{filename, config.compress}, backpressure{config.backpressure}
+{
+	unsigned long capacity = 2;
+	while (capacity < config.capacity) {
+		capacity <<= 1;
+	}
+	ring = new Slot[capacity];
+	mask = capacity - 1;
+	open = writer.isOpen();
+
+	head.store(0);
+	tailCache = 0;
+	dropped = 0;
+	stalls = 0;
+	flushTicket = 0;
+	tail.store(0);
+	bytesWritten.store(writer.getBytesWritten());
+	flushRequested.store(0);
+	flushCompleted.store(0);
+	stopping.store(false);
+
+	consumer = thread(&AsyncTraceWriter::drain, this);
+}
+
+AsyncTraceWriter::~AsyncTraceWriter()
+{
+	close();
+	delete[] ring;
+}
+
+bool AsyncTraceWriter::isOpen()
+{
+	return open;
+}
+
+int AsyncTraceWriter::waitForSpace(uint64_t h)
+{
+	tailCache = tail.load(memory_order_acquire);
+	if (h - tailCache <= mask) {
+		return 0;
+	}
+	if (backpressure == TRACE_DROP) {
+		dropped++;
+		return 1;
+	}
+	stalls++;
+	do {
+		this_thread::yield();
+		tailCache = tail.load(memory_order_acquire);
+	} while (h - tailCache > mask);
+	return 0;
+}
+
+void AsyncTraceWriter::drain()
+{
+	int idle = 0;
+	uint64_t t = tail.load(memory_order_relaxed);
+	for (;;) {
+		uint64_t h = head.load(memory_order_acquire);
+		if (h != t) {
+			for (; t != h; t++) {
+				Slot *slot = &ring[t & mask];
+				writer.record((TraceOp)slot->op, slot->size, slot->address);
+				if ((t & (TRACE_RING_RELEASE - 1)) == TRACE_RING_RELEASE - 1) {
+					tail.store(t + 1, memory_order_release);
+				}
+			}
+			tail.store(t, memory_order_release);
+			bytesWritten.store(writer.getBytesWritten(), memory_order_relaxed);
+			idle = 0;
+			continue;
+		}
+
+		// anel vazio: pedidos de flush e de término valem para os acessos
+		// publicados antes deles, portanto o anel é relido depois
+		uint64_t requested = flushRequested.load(memory_order_acquire);
+		bool stop = stopping.load(memory_order_acquire);
+		if (head.load(memory_order_acquire) != t) {
+			continue;
+		}
+		if (requested != flushCompleted.load(memory_order_relaxed)) {
+			writer.flush();
+			bytesWritten.store(writer.getBytesWritten(), memory_order_relaxed);
+			flushCompleted.store(requested, memory_order_release);
+			continue;
+		}
+		if (stop) {
+			return;
+		}
+
+		if (++idle < TRACE_IDLE_YIELDS) {
+			this_thread::yield();
+		} else {
+			this_thread::sleep_for(chrono::microseconds(TRACE_IDLE_SLEEP_US));
+		}
+	}
+}
+
+void AsyncTraceWriter::flush()
+{
+	if (!consumer.joinable()) {
+		return;
+	}
+	uint64_t ticket = ++flushTicket;
+	flushRequested.store(ticket, memory_order_release);
+	while (flushCompleted.load(memory_order_acquire) < ticket) {
+		this_thread::yield();
+	}
+}
+
+void AsyncTraceWriter::close()
+{
+	if (consumer.joinable()) {
+		stopping.store(true, memory_order_release);
+		consumer.join();
+		writer.close();
+		bytesWritten.store(writer.getBytesWritten());
+	}
+}
+
+unsigned long AsyncTraceWriter::getRecords()
+{
+	return head.load(memory_order_relaxed);
+}
+
+unsigned long AsyncTraceWriter::getDropped()
+{
+	return dropped;
+}
+
+unsigned long AsyncTraceWriter::getStalls()
+{
+	return stalls;
+}
+
+unsigned long AsyncTraceWriter::getBytesWritten()
+{
+	return bytesWritten.load(memory_order_relaxed);
+}
@@ -0,0 +1,175 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) AsyncTraceWriter - memory trace written by a background thread
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) AsyncTraceWriter - registro de acessos escrito por uma thread de fundo
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include "MemoryTrace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Capacidade padrão do anel (acessos; potência de 2), tamanho da linha de
+// cache do hospedeiro, que separa os índices do produtor e do consumidor, e
+// acessos codificados pelo consumidor entre liberações de espaço no anel
+#define TRACE_RING_CAPACITY (1 << 16)
+#define TRACE_HOST_LINE_SIZE 64
+#define TRACE_RING_RELEASE 1024
+
+/**
+ * O que record() faz quando o anel está cheio: esperar a thread de fundo
+ * (nenhum acesso se perde) ou descartar o acesso (contado em getDropped()).
+ */
+enum TraceBackpressure {TRACE_BLOCK, TRACE_DROP};
+
+struct AsyncTraceConfig {
+	unsigned long capacity;			// acessos; arredondada para potência de 2
+	TraceBackpressure backpressure;
+	bool compress;					// ver TraceWriter
+};
+
+/**
+ * Registro de acessos assíncrono.
+ *
+ * record() só grava o acesso (16 bytes) em um anel SPSC (um produtor, um
+ * consumidor) sem travas e publica o novo índice; uma thread de fundo
+ * esvazia o anel, codifica os acessos e os escreve com um TraceWriter.
+ *
+ * Cada índice do anel fica em sua própria linha de cache, e o produtor
+ * guarda uma cópia do índice do consumidor, relida apenas quando o anel
+ * parece cheio. O consumidor libera o espaço a cada TRACE_RING_RELEASE
+ * acessos codificados.
+ *
+ * Apenas uma thread pode chamar record(), flush() e close().
+ */
+class AsyncTraceWriter
+{
+	public:
+		AsyncTraceWriter(std::string filename, AsyncTraceConfig config =
+				{TRACE_RING_CAPACITY, TRACE_BLOCK, true});
+		~AsyncTraceWriter();
+
+		bool isOpen();
+
+		/**
+		 * Registra o acesso op de size bytes (size > 0) em address.
+		 */
+		void record(TraceOp op, int size, uint64_t address) {
+			uint64_t h = head.load(std::memory_order_relaxed);
+			if (h - tailCache > mask && waitForSpace(h)) {
+				return;
+			}
+			Slot *slot = &ring[h & mask];
+			slot->address = address;
+			slot->op = op;
+			slot->size = size;
+			head.store(h + 1, std::memory_order_release);
+		};
+
+		/**
+		 * Espera a thread de fundo escrever todos os acessos registrados e
+		 * o buffer do arquivo.
+		 */
+		void flush();
+
+		/**
+		 * Escreve os acessos pendentes, termina a thread de fundo e fecha o
+		 * arquivo. record() não pode ser chamado depois.
+		 */
+		void close();
+
+		/**
+		 * Estatísticas:
+		 *	- registros: acessos aceitos pelo anel;
+		 *	- descartados: acessos perdidos com o anel cheio (TRACE_DROP);
+		 *	- esperas: vezes em que record() esperou espaço (TRACE_BLOCK);
+		 *	- bytes escritos no arquivo até agora.
+		 */
+		unsigned long getRecords();
+		unsigned long getDropped();
+		unsigned long getStalls();
+		unsigned long getBytesWritten();
+
+	private:
+		struct Slot {
+			uint64_t address;
+			uint32_t op;
+			uint32_t size;
+		};
+
+		TraceWriter writer;
+		bool open;
+		TraceBackpressure backpressure;
+		Slot *ring;
+		uint64_t mask;
+		std::thread consumer;
+
+		// produtor
+		alignas(TRACE_HOST_LINE_SIZE) std::atomic<uint64_t> head;
+		uint64_t tailCache;
+		unsigned long dropped;
+		unsigned long stalls;
+		uint64_t flushTicket;
+
+		// consumidor
+		alignas(TRACE_HOST_LINE_SIZE) std::atomic<uint64_t> tail;
+		uint64_t headCache;
+		std::atomic<unsigned long> bytesWritten;
+
+		// controle
+		alignas(TRACE_HOST_LINE_SIZE) std::atomic<uint64_t> flushRequested;
+		std::atomic<uint64_t> flushCompleted;
+		std::atomic<bool> stopping;
+
+		/**
+		 * Caminho lento de record(), com o anel aparentemente cheio: relê
+		 * o índice do consumidor e, se o anel estiver mesmo cheio, espera
+		 * ou descarta conforme backpressure.
+		 *
+		 * Retorna 0: se há espaço para o acesso h e
+		 *		   1: se o acesso deve ser descartado.
+		 */
+		int waitForSpace(uint64_t h);
+
+		/**
+		 * Laço da thread de fundo.
+		 */
+		void drain();
+};
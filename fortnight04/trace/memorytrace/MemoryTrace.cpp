@@ -0,0 +1,532 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) MemoryTrace - compact binary trace of memory accesses
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) MemoryTrace - registro binário compacto de acessos à memória
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "MemoryTrace.h"
+
+#include <cstring>
+
+using namespace std;
+
+/**
+ * FNV-1a de 32 bits.
+ */
+static uint32_t checksum(const uint8_t *data, unsigned long size)
+{
+	uint32_t hash = 2166136261u;
+	for (unsigned long i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * TraceWriter
+ */
+TraceWriter::TraceWriter(string filename, bool compress)
+	: file{filename, ios::out | ios::binary | ios::trunc}, compress{compress}
+{
+	buffer = new uint8_t[TRACE_BLOCK_SIZE];
+	compressed = new uint8_t[TRACE_BLOCK_SIZE];
+	used = 0;
+	blockRecords = 0;
+	next[0] = next[1] = 0;
+	records = 0;
+	bytesWritten = 0;
+
+	TraceFileHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.flags = 0;
+	file.write((const char*)&header, sizeof(header));
+	bytesWritten += sizeof(header);
+}
+
+TraceWriter::~TraceWriter()
+{
+	close();
+	delete[] buffer;
+	delete[] compressed;
+}
+
+bool TraceWriter::isOpen()
+{
+	return file.is_open() && file.good();
+}
+
+void TraceWriter::writeBlock()
+{
+	if (used == 0) {
+		return;
+	}
+
+	TraceBlockHeader header;
+	header.magic = TRACE_BLOCK_MAGIC;
+	header.codec = TRACE_CODEC_RAW;
+	header.records = blockRecords;
+	header.rawSize = used;
+	header.storedSize = used;
+	header.checksum = checksum(buffer, used);
+
+	const uint8_t *data = buffer;
+	if (compress) {
+		// só comprime se ganhar ao menos um byte
+		unsigned long size = traceCompress(buffer, used, compressed, used - 1);
+		if (size > 0) {
+			header.codec = TRACE_CODEC_LZ;
+			header.storedSize = size;
+			data = compressed;
+		}
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)data, header.storedSize);
+	bytesWritten += sizeof(header) + header.storedSize;
+	records += blockRecords;
+
+	used = 0;
+	blockRecords = 0;
+	next[0] = next[1] = 0;
+}
+
+void TraceWriter::recordWide(TraceOp op, int size, uint64_t address)
+{
+	int stream = (op != TRACE_READ_INSTRUCTION);
+	uint64_t delta = address - next[stream];
+	uint64_t zigzag = (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+	int n = zigzag ? (71 - __builtin_clzll(zigzag)) >> 3 : 0;
+	uint8_t *p = buffer + used;
+
+	*p++ = ((op << 2) << 4) | TRACE_WIDE_RECORD;
+	*p++ = n;
+	uint32_t length = size;
+	do {
+		*p++ = (length & 0x7F) | (length > 0x7F ? 0x80 : 0);
+		length >>= 7;
+	} while (length);
+	for (int i = 0; i < n; i++) {
+		*p++ = (uint8_t)zigzag;
+		zigzag >>= 8;
+	}
+	used = p - buffer;
+	next[stream] = address + size;
+	blockRecords++;
+	if (used > TRACE_BLOCK_SIZE - TRACE_MAX_RECORD) {
+		writeBlock();
+	}
+}
+
+void TraceWriter::flush()
+{
+	writeBlock();
+	file.flush();
+}
+
+void TraceWriter::close()
+{
+	if (file.is_open()) {
+		writeBlock();
+		file.close();
+	}
+}
+
+unsigned long TraceWriter::getRecords()
+{
+	return records + blockRecords;
+}
+
+unsigned long TraceWriter::getBytesWritten()
+{
+	return bytesWritten;
+}
+
+/*
+ * TraceReader
+ */
+TraceReader::TraceReader(string filename)
+	: file{filename, ios::in | ios::binary}
+{
+	buffer = new uint8_t[TRACE_BLOCK_SIZE];
+	stored = new uint8_t[TRACE_BLOCK_SIZE];
+	size = 0;
+	position = 0;
+	predicted[0] = predicted[1] = 0;
+	error = false;
+
+	TraceFileHeader header;
+	file.read((char*)&header, sizeof(header));
+	valid = file.gcount() == sizeof(header)
+			&& memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) == 0
+			&& (header.version >= 1) && (header.version <= TRACE_VERSION);
+}
+
+TraceReader::~TraceReader()
+{
+	delete[] buffer;
+	delete[] stored;
+}
+
+bool TraceReader::isOpen()
+{
+	return valid;
+}
+
+bool TraceReader::hasError()
+{
+	return error || !valid;
+}
+
+int TraceReader::readBlock()
+{
+	TraceBlockHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (file.gcount() == 0) {
+		return 1;	// fim do registro
+	}
+	if (file.gcount() != sizeof(header)
+			|| header.magic != TRACE_BLOCK_MAGIC
+			|| header.rawSize == 0
+			|| header.rawSize > TRACE_BLOCK_SIZE
+			|| header.storedSize > TRACE_BLOCK_SIZE
+			|| (header.codec == TRACE_CODEC_RAW
+				&& header.storedSize != header.rawSize)
+			|| (header.codec != TRACE_CODEC_RAW
+				&& header.codec != TRACE_CODEC_LZ)) {
+		error = true;
+		return 1;
+	}
+
+	uint8_t *data = header.codec == TRACE_CODEC_RAW ? buffer : stored;
+	file.read((char*)data, header.storedSize);
+	if ((unsigned long)file.gcount() != header.storedSize) {
+		error = true;
+		return 1;
+	}
+	if (header.codec == TRACE_CODEC_LZ
+			&& traceDecompress(stored, header.storedSize, buffer,
+					TRACE_BLOCK_SIZE) != header.rawSize) {
+		error = true;
+		return 1;
+	}
+	if (checksum(buffer, header.rawSize) != header.checksum) {
+		error = true;
+		return 1;
+	}
+
+	size = header.rawSize;
+	position = 0;
+	predicted[0] = predicted[1] = 0;
+	return 0;
+}
+
+int TraceReader::next(TraceRecord *record)
+{
+	if (!valid || error) {
+		return 1;
+	}
+	if (position >= size && readBlock()) {
+		return 1;
+	}
+
+	uint8_t control = buffer[position++];
+	int op = control >> 6;
+	int n = control & 0xF;
+	int accessSize = 1 << ((control >> 4) & 3);
+	if ((n == TRACE_WIDE_RECORD) && !(control & 0x30) && (position < size)) {
+		// acesso largo: n e o tamanho em LEB128 (até 31 bits)
+		n = buffer[position++];
+		uint64_t length = 0;
+		for (int shift = 0; ; shift += 7) {
+			if ((position >= size) || (shift > 28)) {
+				error = true;
+				return 1;
+			}
+			uint8_t byte = buffer[position++];
+			length |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+		}
+		if ((length == 0) || (length > 0x7FFFFFFF)) {
+			error = true;
+			return 1;
+		}
+		accessSize = length;
+	}
+	if (op > TRACE_WRITE_DATA || n > 8 || position + n > size) {
+		error = true;
+		return 1;
+	}
+
+	uint64_t zigzag = 0;
+	for (int i = 0; i < n; i++) {
+		zigzag |= (uint64_t)buffer[position++] << (8 * i);
+	}
+	uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+
+	int stream = (op != TRACE_READ_INSTRUCTION);
+	record->op = (TraceOp)op;
+	record->size = accessSize;
+	record->address = predicted[stream] + delta;
+	predicted[stream] = record->address + record->size;
+	return 0;
+}
+
+/*
+ * Conversão para texto
+ */
+int traceToText(string traceFile, string textFile)
+{
+	static const char *opName[] = {"ri ", "rd ", "wd "};
+	static const char hexDigit[] = "0123456789abcdef";
+
+	TraceReader reader(traceFile);
+	if (!reader.isOpen()) {
+		return 1;
+	}
+	ofstream out(textFile, ios::out | ios::trunc);
+	if (!out.is_open()) {
+		return 1;
+	}
+
+	// mesmo formato de 'out << hex << "rd " << setfill('0') << setw(16)
+	// << address << endl', sem a formatação do iostream
+	char line[20];
+	TraceRecord record;
+	while (!reader.next(&record)) {
+		memcpy(line, opName[record.op], 3);
+		for (int i = 0; i < 16; i++) {
+			line[18 - i] = hexDigit[(record.address >> (4 * i)) & 0xF];
+		}
+		line[19] = '\n';
+		out.write(line, sizeof(line));
+	}
+	out.close();
+	return reader.hasError() ? 1 : 0;
+}
+
+/*
+ * Compressão LZ
+ *
+ * Sequências: token (nibble alto: número de literais; nibble baixo:
+ * comprimento da repetição - TRACE_LZ_MIN_MATCH; 15 indica que o valor
+ * continua em bytes seguintes, somados até um byte diferente de 255),
+ * literais, e distância da repetição em 2 bytes little-endian. A última
+ * sequência tem apenas literais.
+ */
+#define TRACE_LZ_MIN_MATCH 4
+#define TRACE_LZ_HASH_BITS 12
+#define TRACE_LZ_MAX_OFFSET 65535
+// nenhuma repetição começa nos últimos TRACE_LZ_TAIL bytes do bloco
+#define TRACE_LZ_TAIL 12
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * Escreve o excesso de um comprimento (value >= 15) em bytes de 255.
+ *
+ * Retorna 0: se coube em [*op, end) e
+ *		   1: caso contrário.
+ */
+static int writeLength(uint8_t **op, uint8_t *end, unsigned long value)
+{
+	value -= 15;
+	while (value >= 255) {
+		if (*op >= end) {
+			return 1;
+		}
+		*(*op)++ = 255;
+		value -= 255;
+	}
+	if (*op >= end) {
+		return 1;
+	}
+	*(*op)++ = (uint8_t)value;
+	return 0;
+}
+
+/**
+ * Escreve a sequência com literals bytes a partir de literal e, se
+ * matchLength > 0, uma repetição de matchLength bytes a offset bytes atrás.
+ *
+ * Retorna 0: se coube em [*op, end) e
+ *		   1: caso contrário.
+ */
+static int writeSequence(uint8_t **op, uint8_t *end, const uint8_t *literal,
+		unsigned long literals, unsigned long offset, unsigned long matchLength)
+{
+	unsigned long match = matchLength ? matchLength - TRACE_LZ_MIN_MATCH : 0;
+	if (*op >= end) {
+		return 1;
+	}
+	*(*op)++ = (uint8_t)(((literals < 15 ? literals : 15) << 4)
+			| (match < 15 ? match : 15));
+	if (literals >= 15 && writeLength(op, end, literals)) {
+		return 1;
+	}
+	if ((unsigned long)(end - *op) < literals) {
+		return 1;
+	}
+	memcpy(*op, literal, literals);
+	*op += literals;
+	if (matchLength == 0) {
+		return 0;
+	}
+	if (end - *op < 2) {
+		return 1;
+	}
+	*(*op)++ = (uint8_t)offset;
+	*(*op)++ = (uint8_t)(offset >> 8);
+	return match >= 15 ? writeLength(op, end, match) : 0;
+}
+
+unsigned long traceCompress(const uint8_t *in, unsigned long size,
+		uint8_t *out, unsigned long capacity)
+{
+	// posição + 1 da última ocorrência de cada hash (0: nenhuma)
+	uint32_t table[1 << TRACE_LZ_HASH_BITS];
+	memset(table, 0, sizeof(table));
+
+	uint8_t *op = out;
+	uint8_t *end = out + capacity;
+	unsigned long anchor = 0;
+	unsigned long ip = 0;
+	unsigned long limit = size > TRACE_LZ_TAIL ? size - TRACE_LZ_TAIL : 0;
+
+	while (ip < limit) {
+		uint32_t sequence = read32(in + ip);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - TRACE_LZ_HASH_BITS);
+		unsigned long candidate = table[hash];
+		table[hash] = ip + 1;
+		if (candidate == 0 || ip - (candidate - 1) > TRACE_LZ_MAX_OFFSET
+				|| read32(in + candidate - 1) != sequence) {
+			ip++;
+			continue;
+		}
+		candidate--;
+
+		// os últimos bytes ficam sempre como literais
+		unsigned long length = TRACE_LZ_MIN_MATCH;
+		while (ip + length < size - 5 && in[candidate + length] == in[ip + length]) {
+			length++;
+		}
+		if (writeSequence(&op, end, in + anchor, ip - anchor, ip - candidate, length)) {
+			return 0;
+		}
+		ip += length;
+		anchor = ip;
+	}
+	if (writeSequence(&op, end, in + anchor, size - anchor, 0, 0)) {
+		return 0;
+	}
+	return op - out;
+}
+
+/**
+ * Lê o excesso de um comprimento escrito por writeLength.
+ *
+ * Retorna 0: se os bytes estão em [*ip, end) e
+ *		   1: caso contrário.
+ */
+static int readLength(const uint8_t **ip, const uint8_t *end, unsigned long *value)
+{
+	uint8_t byte;
+	do {
+		if (*ip >= end) {
+			return 1;
+		}
+		byte = *(*ip)++;
+		*value += byte;
+	} while (byte == 255);
+	return 0;
+}
+
+unsigned long traceDecompress(const uint8_t *in, unsigned long size,
+		uint8_t *out, unsigned long capacity)
+{
+	const uint8_t *ip = in;
+	const uint8_t *inEnd = in + size;
+	uint8_t *op = out;
+	uint8_t *outEnd = out + capacity;
+
+	while (ip < inEnd) {
+		uint8_t token = *ip++;
+
+		unsigned long literals = token >> 4;
+		if (literals == 15 && readLength(&ip, inEnd, &literals)) {
+			return 0;
+		}
+		if ((unsigned long)(inEnd - ip) < literals
+				|| (unsigned long)(outEnd - op) < literals) {
+			return 0;
+		}
+		memcpy(op, ip, literals);
+		ip += literals;
+		op += literals;
+		if (ip == inEnd) {
+			break;	// última sequência
+		}
+
+		if (inEnd - ip < 2) {
+			return 0;
+		}
+		unsigned long offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		unsigned long length = token & 0xF;
+		if (length == 15 && readLength(&ip, inEnd, &length)) {
+			return 0;
+		}
+		length += TRACE_LZ_MIN_MATCH;
+		if (offset == 0 || offset > (unsigned long)(op - out)
+				|| (unsigned long)(outEnd - op) < length) {
+			return 0;
+		}
+		// byte a byte: a repetição pode sobrepor a saída (offset < length)
+		const uint8_t *match = op - offset;
+		for (unsigned long i = 0; i < length; i++) {
+			op[i] = match[i];
+		}
+		op += length;
+	}
+	return op - out;
+}
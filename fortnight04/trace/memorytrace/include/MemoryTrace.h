@@ -0,0 +1,260 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) MemoryTrace - compact binary trace of memory accesses
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) MemoryTrace - registro binário compacto de acessos à memória
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * Formato do registro (trace) binário de acessos à memória.
+ *
+ * O arquivo começa com um cabeçalho (TraceFileHeader) seguido de blocos.
+ * Cada bloco tem um cabeçalho (TraceBlockHeader) e até TRACE_BLOCK_SIZE
+ * bytes de registros, armazenados sem compressão ou comprimidos com
+ * TRACE_CODEC_LZ. Cada bloco pode ser decodificado sozinho: a predição de
+ * endereços recomeça a cada bloco.
+ *
+ * Registro de acesso: um byte de controle e 0 a 8 bytes de delta.
+ *	- nibble alto: operação (bits 3-2, TraceOp) e log2 do tamanho do
+ *	  acesso (bits 1-0);
+ *	- nibble baixo: número n de bytes (little-endian) que seguem com o
+ *	  delta em zigzag (n = 0: delta 0).
+ * O delta é a diferença entre o endereço e o endereço predito, que é o
+ * endereço seguinte ao último acesso do mesmo fluxo (instruções ou dados).
+ * Uma busca sequencial de instruções, ou uma varredura sequencial de
+ * dados, ocupa 1 byte por acesso.
+ *
+ * Acessos largos (pares de LDP/STP e blocos, de tamanho diferente de 1, 2,
+ * 4 e 8 bytes) têm nibble baixo TRACE_WIDE_RECORD e bits 1-0 em 0; seguem
+ * um byte com n, o tamanho em LEB128 (7 bits por byte, bit 7 indica que
+ * há mais bytes) e os n bytes do delta. A versão 1 do formato não tem
+ * acessos largos e continua sendo lida.
+ */
+#define TRACE_MAGIC "ARMTRACE"
+#define TRACE_VERSION 2
+#define TRACE_BLOCK_MAGIC 0x4B4C4254	// "TBLK"
+#define TRACE_BLOCK_SIZE (256 * 1024)
+#define TRACE_WIDE_RECORD 0xF
+#define TRACE_MAX_RECORD 15
+
+// Codificação dos dados do bloco
+#define TRACE_CODEC_RAW 0
+#define TRACE_CODEC_LZ 1
+
+/**
+ * Operação registrada: busca de instrução, leitura e escrita de dados
+ * (no texto: ri, rd e wd).
+ */
+enum TraceOp {TRACE_READ_INSTRUCTION, TRACE_READ_DATA, TRACE_WRITE_DATA};
+
+struct TraceFileHeader {
+	char magic[8];			// TRACE_MAGIC
+	uint32_t version;
+	uint32_t flags;			// reservado (0)
+};
+
+struct TraceBlockHeader {
+	uint32_t magic;			// TRACE_BLOCK_MAGIC
+	uint32_t codec;			// TRACE_CODEC_RAW ou TRACE_CODEC_LZ
+	uint32_t records;		// número de registros do bloco
+	uint32_t rawSize;		// bytes dos registros decodificados
+	uint32_t storedSize;	// bytes armazenados após o cabeçalho
+	uint32_t checksum;		// FNV-1a dos bytes decodificados
+};
+
+/**
+ * Acesso registrado.
+ */
+struct TraceRecord {
+	TraceOp op;
+	int size;				// bytes: 1, 2, 4, 8 ou largo (qualquer outro)
+	uint64_t address;
+};
+
+/**
+ * Escrita do registro.
+ *
+ * Os registros são codificados em um buffer de TRACE_BLOCK_SIZE bytes,
+ * escrito no arquivo (comprimido, se compress) apenas quando enche ou no
+ * close(). record() não faz chamadas ao sistema.
+ */
+class TraceWriter
+{
+	public:
+		TraceWriter(std::string filename, bool compress = true);
+		~TraceWriter();
+
+		bool isOpen();
+
+		/**
+		 * Registra o acesso op de size bytes (size > 0) em address.
+		 */
+		void record(TraceOp op, int size, uint64_t address) {
+			static const uint8_t log2Size[9] = {0, 0, 1, 0, 2, 0, 0, 0, 3};
+			if ((size > 8) || (size & (size - 1))) {
+				recordWide(op, size, address);
+				return;
+			}
+			int stream = (op != TRACE_READ_INSTRUCTION);
+			uint64_t delta = address - next[stream];
+			uint64_t zigzag = (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+			int n = zigzag ? (71 - __builtin_clzll(zigzag)) >> 3 : 0;
+			uint8_t *p = buffer + used;
+			
+			*p++ = (((op << 2) | log2Size[size]) << 4) | n;
+			for (int i = 0; i < n; i++) {
+				*p++ = (uint8_t)zigzag;
+				zigzag >>= 8;
+			}
+			used = p - buffer;
+			next[stream] = address + size;
+			blockRecords++;
+			if (used > TRACE_BLOCK_SIZE - TRACE_MAX_RECORD) {
+				writeBlock();
+			}
+		};
+
+		/**
+		 * Escreve o bloco corrente e o buffer do arquivo.
+		 */
+		void flush();
+
+		/**
+		 * Escreve o bloco corrente e fecha o arquivo.
+		 */
+		void close();
+
+		/**
+		 * Registros e bytes (cabeçalhos inclusive) escritos até agora.
+		 */
+		unsigned long getRecords();
+		unsigned long getBytesWritten();
+
+	private:
+		std::ofstream file;
+		bool compress;
+		uint8_t *buffer;
+		uint8_t *compressed;
+		unsigned long used;
+		unsigned long blockRecords;
+		uint64_t next[2];		// endereço predito de instruções e de dados
+
+		unsigned long records;
+		unsigned long bytesWritten;
+
+		/**
+		 * Escreve o bloco corrente (se não estiver vazio) e recomeça a
+		 * predição de endereços.
+		 */
+		void writeBlock();
+
+		/**
+		 * Registra um acesso largo (ver o formato acima).
+		 */
+		void recordWide(TraceOp op, int size, uint64_t address);
+};
+
+/**
+ * Leitura do registro, um acesso de cada vez.
+ */
+class TraceReader
+{
+	public:
+		TraceReader(std::string filename);
+		~TraceReader();
+
+		/**
+		 * Informa se o arquivo foi aberto e tem um cabeçalho válido.
+		 */
+		bool isOpen();
+
+		/**
+		 * Lê o próximo acesso em record.
+		 *
+		 * Retorna 0: se leu um acesso e
+		 *		   1: no fim do registro ou se o arquivo estiver corrompido
+		 *			  (ver hasError()).
+		 */
+		int next(TraceRecord *record);
+
+		bool hasError();
+
+	private:
+		std::ifstream file;
+		bool valid;
+		bool error;
+		uint8_t *buffer;
+		uint8_t *stored;
+		unsigned long size;		// bytes decodificados do bloco corrente
+		unsigned long position;
+		uint64_t predicted[2];
+
+		/**
+		 * Lê e decodifica o próximo bloco.
+		 *
+		 * Retorna 0: se leu um bloco e
+		 *		   1: no fim do arquivo ou se o bloco estiver corrompido.
+		 */
+		int readBlock();
+};
+
+/**
+ * Converte o registro binário traceFile para o formato de texto de
+ * SimpleMemoryTest (uma linha "ri|rd|wd <endereço em 16 dígitos hex>" por
+ * acesso) em textFile.
+ *
+ * Retorna 0: se converteu corretamente e
+ *		   1: se traceFile não existir ou estiver corrompido.
+ */
+int traceToText(std::string traceFile, std::string textFile);
+
+/**
+ * Compressão LZ dos blocos (sequências repetidas de até 64 KiB atrás,
+ * formato de tokens como o do LZ4).
+ *
+ * traceCompress retorna o tamanho comprimido, ou 0 se não couber em
+ * capacity bytes; traceDecompress retorna o tamanho descomprimido, ou 0
+ * se os dados forem inválidos ou não couberem em capacity bytes.
+ */
+unsigned long traceCompress(const uint8_t *in, unsigned long size,
+		uint8_t *out, unsigned long capacity);
+unsigned long traceDecompress(const uint8_t *in, unsigned long size,
+		uint8_t *out, unsigned long capacity);
@@ -0,0 +1,72 @@
+/* ----------------------------------------------------------------------------
+
+    (EN) tracetext - converts a binary memory trace to the text log
+		
+	armethyst - A simple ARM Simulator written in C++ for Computer Architecture
+    teaching purposes. Free software licensed under the MIT License (see license
+    below).
+
+    (PT) tracetext - converte o registro binário de acessos à memória para texto
+    
+	armethyst - Um simulador ARM simples escrito em C++ para o ensino de
+    Arquitetura de Computadores. Software livre licenciado pela MIT License
+    (veja a licença, em inglês, abaixo).
+
+    (EN) MIT LICENSE:
+
+    Copyright 2020 André Vital Saúde
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+   ----------------------------------------------------------------------------
+*/
+
+#include "config.h"
+
+#include "MemoryTrace.h"
+
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Converte o registro binário de SimpleMemoryTest (MEMORY_TRACE_FILE) para
+ * o formato de texto anterior (MEMORY_LOG_FILE), uma linha por acesso:
+ *
+ *	ri 0000000000000040
+ *	rd 000000000000fff8
+ *	wd 000000000000fff8
+ *
+ * Uso: tracetext [registro [texto]]
+ */
+int main(int argc, char *argv[])
+{
+	string traceFile = argc > 1 ? argv[1] : MEMORY_TRACE_FILE;
+	string textFile = argc > 2 ? argv[2] : MEMORY_LOG_FILE;
+	if (argc > 3) {
+		cerr << "Uso: " << argv[0] << " [registro [texto]]" << endl;
+		return 2;
+	}
+
+	if (traceToText(traceFile, textFile)) {
+		cerr << "Falha ao converter " << traceFile << endl;
+		return 1;
+	}
+	return 0;
+}